@@ -0,0 +1,88 @@
+#!/bin/bash
+
+# Copyright 2026  agent
+# Apache 2.0
+
+# This script measures the effect on decoding speed of renumbering the states
+# of the decoding graph with fstsortstates.  It decodes the same log-likelihoods
+# with latgen-faster-mapped using (a) the original graph, (b) the graph in
+# breadth-first order and (c) the graph ordered by visit counts collected from
+# a profiling run on separate data, and prints the real-time factor of each.
+# All decodes use one job and one thread so that the timings are comparable;
+# run it on an otherwise idle machine.  The word outputs should be the same up
+# to ties in the search.
+#
+# The log-likelihoods can be obtained e.g. from an nnet1 system with
+#  nnet-forward --class-frame-counts=... final.nnet "$feats" ark:loglikes.ark
+
+# Begin configuration section.
+max_active=7000
+beam=13.0
+lattice_beam=6.0
+acwt=0.083333
+flat=false  # if true, also convert the graphs with fstmakeflat, which keeps
+            # the arcs of consecutive states contiguous in memory.
+# End configuration section.
+
+echo "$0 $@"  # Print the command line for logging
+
+[ -f ./path.sh ] && . ./path.sh; # source the path.
+. parse_options.sh || exit 1;
+
+if [ $# != 5 ]; then
+   echo "Usage: $0 [options] <model> <graph-dir> <profile-loglikes-rspecifier> <test-loglikes-rspecifier> <work-dir>"
+   echo "e.g.: $0 exp/dnn5b/final.mdl exp/tri4b/graph_bd_tgpr \\"
+   echo "         ark:exp/dnn5b/dev93_loglikes.ark ark:exp/dnn5b/eval92_loglikes.ark exp/dnn5b/sort_states"
+   echo "main options (for others, see top of script file)"
+   echo "  --beam <beam>                                    # decoding beam"
+   echo "  --flat <true|false>                              # also test flat (memory-mapped) graphs"
+   exit 1;
+fi
+
+model=$1
+graphdir=$2
+profile_loglikes=$3
+test_loglikes=$4
+dir=$5
+
+mkdir -p $dir/log
+
+for f in $model $graphdir/HCLG.fst $graphdir/words.txt; do
+  [ ! -f $f ] && echo "$0: no such file $f" && exit 1;
+done
+
+decode_opts="--max-active=$max_active --beam=$beam --lattice-beam=$lattice_beam --acoustic-scale=$acwt --allow-partial=true"
+
+echo "$0: collecting state-visit counts"
+latgen-faster-mapped $decode_opts --write-state-visits=$dir/state_visits.vec \
+  $model $graphdir/HCLG.fst "$profile_loglikes" ark:/dev/null \
+  2>$dir/log/profile.log || exit 1;
+
+fstsortstates $graphdir/HCLG.fst $dir/HCLG.bfs.fst 2>$dir/log/sort_bfs.log || exit 1;
+fstsortstates --state-visits=$dir/state_visits.vec $graphdir/HCLG.fst \
+  $dir/HCLG.visits.fst 2>$dir/log/sort_visits.log || exit 1;
+cp $graphdir/HCLG.fst $dir/HCLG.orig.fst
+
+graphs="orig bfs visits"
+if $flat; then
+  for g in orig bfs visits; do
+    fstmakeflat $dir/HCLG.$g.fst $dir/HCLG.$g.flat.fst 2>$dir/log/flat_$g.log || exit 1;
+  done
+  graphs="$graphs orig.flat bfs.flat visits.flat"
+fi
+
+for g in $graphs; do
+  echo "$0: decoding with graph $g"
+  latgen-faster-mapped $decode_opts --word-symbol-table=$graphdir/words.txt \
+    $model $dir/HCLG.$g.fst "$test_loglikes" ark:/dev/null \
+    "ark,t:$dir/words.$g.txt" 2>$dir/log/decode_$g.log || exit 1;
+done
+
+for g in $graphs; do
+  rtf=$(grep 'real-time factor' $dir/log/decode_$g.log | \
+        perl -ne 'if (m/real-time factor assuming 100 frames\/sec is (\S+)/) { print $1; }')
+  if cmp -s $dir/words.orig.txt $dir/words.$g.txt; then same=yes; else same=no; fi
+  echo "graph=$g real-time-factor=$rtf same-output-as-orig=$same"
+done | tee $dir/results
+
+exit 0;
@@ -44,6 +44,10 @@ int main(int argc, char *argv[]) {
         "self-loops added.  The --reorder option controls whether the loop is added before\n"
         "the forward transition (if false), or afterward (if true).  The default (true)\n"
         "is recommended as the decoding will in that case be faster.\n"
+        "With --implicit=true, no self-loops are added; the graph is only\n"
+        "prepared for decoders that apply them on the fly (--implicit-self-loops\n"
+        "option of e.g. latgen-faster-mapped), which gives a graph about half\n"
+        "the size.\n"
         "Usage:   add-self-loops [options] transition-gmm/acoustic-model [fst-in] [fst-out]\n"
         "e.g.: \n"
         " add-self-loops --self-loop-scale=0.1 1.mdl HCLGa.fst HCLG.fst\n" 
@@ -51,6 +55,7 @@ int main(int argc, char *argv[]) {
     
     BaseFloat self_loop_scale = 1.0;
     bool reorder = true;
+    bool implicit = false;
     std::string disambig_in_filename;
 
     ParseOptions po(usage);
@@ -60,6 +65,10 @@ int main(int argc, char *argv[]) {
                 "List of disambiguation symbols on input of fst-in [input file]");
     po.Register("reorder", &reorder,
                 "If true, reorder symbols for more decoding efficiency");
+    po.Register("implicit", &implicit, "If true, do not add the self-loops "
+                "but prepare the graph for decoding with implicit self-loops "
+                "(requires --reorder=true; --self-loop-scale is then ignored "
+                "here and must be given to the decoder).");
     po.Read(argc, argv);
 
     if (po.NumArgs() < 1 || po.NumArgs() > 3) {
@@ -99,11 +108,17 @@ int main(int argc, char *argv[]) {
 
 
     // The work gets done here.
-    AddSelfLoops(trans_model,
-                 disambig_syms_in,
-                 self_loop_scale,
-                 reorder,
-                 fst);
+    if (implicit) {
+      if (!reorder)
+        KALDI_ERR << "add-self-loops: --implicit=true requires --reorder=true";
+      PrepareForImplicitSelfLoops(trans_model, disambig_syms_in, fst);
+    } else {
+      AddSelfLoops(trans_model,
+                   disambig_syms_in,
+                   self_loop_scale,
+                   reorder,
+                   fst);
+    }
 
     if (! fst->Write(fst_out_filename) )
       KALDI_ERR << "add-self-loops: error writing FST to "
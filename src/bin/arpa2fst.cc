@@ -38,7 +38,9 @@ int main(int argc, char *argv[]) {
     kaldi::ParseOptions po(usage);
 
     bool natural_base = true;
+    kaldi::ArpaParseOptions arpa_opts;
     po.Register("natural-base", &natural_base, "Use log-base e (not log-base 10)");
+    arpa_opts.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 1 && po.NumArgs() != 2) {
@@ -48,7 +50,7 @@ int main(int argc, char *argv[]) {
     std::string arpa_filename = po.GetArg(1),
         fst_filename = po.GetOptArg(2);
     
-    kaldi::LangModelFst lm;
+    kaldi::LangModelFst lm(arpa_opts);
     // read from standard input and write to standard output
     lm.Read(arpa_filename, kaldi::kArpaLm, NULL, natural_base);
     lm.Write(fst_filename);
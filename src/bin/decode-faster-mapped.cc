@@ -47,12 +47,17 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 0.1;
     bool allow_partial = true;
     std::string word_syms_filename;
+    std::string decoder_stats_wspecifier;
     FasterDecoderOptions decoder_opts;
     decoder_opts.Register(&po, true);  // true == include obscure settings.
     po.Register("binary", &binary, "Write output in binary mode");
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("allow-partial", &allow_partial, "Produce output even when final state was not reached");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("write-decoder-stats", &decoder_stats_wspecifier, "If "
+                "supplied, write for each utterance a matrix of per-frame "
+                "decoder statistics (see latgen-faster-mapped for the "
+                "columns).");
 
     po.Read(argc, argv);
 
@@ -74,6 +79,8 @@ int main(int argc, char *argv[]) {
 
     Int32VectorWriter alignment_writer(alignment_wspecifier);
 
+    BaseFloatMatrixWriter decoder_stats_writer(decoder_stats_wspecifier);
+
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_filename != "") {
       word_syms = fst::SymbolTable::ReadText(word_syms_filename);
@@ -88,12 +95,15 @@ int main(int argc, char *argv[]) {
     // It has to do with what happens on UNIX systems if you call fork() on a
     // large process: the page-table entries are duplicated, which requires a
     // lot of virtual memory.
-    VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_filename);
+    fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_filename);
 
     BaseFloat tot_like = 0.0;
     kaldi::int64 frame_count = 0;
     int num_success = 0, num_fail = 0;
     FasterDecoder decoder(*decode_fst, decoder_opts);
+    DecoderStats decoder_stats;
+    if (decoder_stats_writer.IsOpen())
+      decoder.SetStats(&decoder_stats);
 
     Timer timer;
 
@@ -109,6 +119,11 @@ int main(int argc, char *argv[]) {
 
       DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
       decoder.Decode(&decodable);
+      if (decoder_stats_writer.IsOpen()) {
+        Matrix<BaseFloat> stats_mat;
+        decoder_stats.GetMatrix(&stats_mat);
+        decoder_stats_writer.Write(key, stats_mat);
+      }
 
       VectorFst<LatticeArc> decoded;  // linear FST.
 
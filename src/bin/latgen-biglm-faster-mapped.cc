@@ -0,0 +1,198 @@
+// bin/latgen-biglm-faster-mapped.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/label-lookahead.h"
+#include "decoder/decodable-matrix.h"
+#include "lm/const-arpa-lm.h"
+#include "base/timer.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices, reading log-likelihoods as matrices, using a\n"
+        "decoding graph without a language model (HCL) that is composed on the\n"
+        "fly with a language model in ConstArpaLm format (see arpa-to-const-arpa).\n"
+        "This avoids building HCLG for large LMs.  HCL should be built as HCLG\n"
+        "would be but without G, i.e. with the word loop of L, with the\n"
+        "disambiguation symbols removed after determinization.\n"
+        "Note: with --use-lookahead=true, the graph costs of the individual\n"
+        "lattice arcs include the lookahead shifts, so only the total graph\n"
+        "cost of each complete path is the true HCL + LM cost.\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-biglm-faster-mapped [options] trans-model-in HCL-fst-in "
+        "const-arpa-lm-in loglikes-rspecifier lattice-wspecifier "
+        "[ words-wspecifier [alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    bool use_lookahead = true;
+    int32 num_cached_arcs = 1000000;
+    LatticeBiglmFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    lattice_write_opts.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+
+    po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("use-lookahead", &use_lookahead, "If true, prune using the "
+                "unigram cost of the best word each state of HCL can lead to "
+                "before the word label is reached (label lookahead).");
+    po.Register("num-cached-arcs", &num_cached_arcs, "Size of the cache of "
+                "language model arcs.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 5 || po.NumArgs() > 7) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_filename = po.GetArg(2),
+        lm_rxfilename = po.GetArg(3),
+        loglikes_rspecifier = po.GetArg(4),
+        lattice_wspecifier = po.GetArg(5),
+        words_wspecifier = po.GetOptArg(6),
+        alignment_wspecifier = po.GetOptArg(7);
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    ConstArpaLm const_arpa;
+    const_arpa.ReadMapped(lm_rxfilename);
+    ConstArpaLmCache lm_cache(const_arpa, num_cached_arcs);
+    ConstArpaLmDeterministicFst lm_dfst(&lm_cache);
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    SequentialBaseFloatMatrixReader loglike_reader(loglikes_rspecifier);
+    // It's important that we initialize decode_fst after loglike_reader, as it
+    // can prevent crashes on systems installed without enough virtual memory
+    // (see decode-faster-mapped.cc).
+    fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_filename);
+
+    std::vector<BaseFloat> lookahead;
+    if (use_lookahead) {
+      // Get the unigram costs of the words in HCL, and from them the
+      // lookahead costs of the states.
+      int32 max_word = 0;
+      for (fst::StateIterator<fst::Fst<StdArc> > siter(*decode_fst);
+           !siter.Done(); siter.Next())
+        for (fst::ArcIterator<fst::Fst<StdArc> > aiter(*decode_fst,
+                                                       siter.Value());
+             !aiter.Done(); aiter.Next())
+          max_word = std::max(max_word, aiter.Value().olabel);
+      std::vector<BaseFloat> unigram_costs(max_word + 1, 0.0);
+      std::vector<int32> empty_hist;
+      for (int32 w = 1; w <= max_word; w++) {
+        float logprob = const_arpa.GetNgramLogprob(w, empty_hist);
+        unigram_costs[w] = (logprob == std::numeric_limits<float>::min() ?
+                            std::numeric_limits<BaseFloat>::infinity() :
+                            -logprob);
+      }
+      ComputeLabelLookahead(*decode_fst, unigram_costs, &lookahead);
+    }
+
+    {
+      LatticeBiglmFasterDecoder decoder(*decode_fst, config, &lm_dfst);
+      if (use_lookahead)
+        decoder.SetLookahead(&lookahead);
+
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> loglikes (loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (loglikes.NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          continue;
+        }
+
+        DecodableMatrixScaledMapped decodable(trans_model, loglikes,
+                                              acoustic_scale);
+        double like;
+        if (DecodeUtteranceLatticeBiglmFaster(
+                decoder, decodable, trans_model, word_syms, utt,
+                acoustic_scale, determinize, allow_partial, &alignment_writer,
+                &words_writer, &compact_lattice_writer, &lattice_writer,
+                &like)) {
+          tot_like += like;
+          frame_count += loglikes.NumRows();
+          num_success++;
+        } else num_fail++;
+      }
+    }
+    delete decode_fst; // delete this only after decoder goes out of scope.
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
+              << frame_count<<" frames.";
+
+    if (word_syms) delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -49,10 +49,12 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
     TaskSequencerConfig sequencer_config; // has --num-threads option
 
     std::string word_syms_filename;
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     sequencer_config.Register(&po);
 
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
@@ -80,7 +82,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -100,12 +103,15 @@ int main(int argc, char *argv[]) {
     int num_success = 0, num_fail = 0;
     VectorFst<StdArc> *decode_fst = NULL; // only used if there is a single
                                           // decoding graph.
+    LatticeFasterDecoderPool *decoder_pool = NULL;  // likewise.
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       decode_fst = fst::ReadFstKaldi(fst_in_str);
+      // Decoders are reused across utterances, keeping their storage.
+      decoder_pool = new LatticeFasterDecoderPool(*decode_fst, config);
 
       {
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
@@ -120,16 +126,15 @@ int main(int argc, char *argv[]) {
             continue;
           }
       
-          LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
-                                                                   config);
           DecodableMatrixScaledMapped *decodable = 
               new DecodableMatrixScaledMapped(trans_model, acoustic_scale, loglikes);
           DecodeUtteranceLatticeFasterClass *task =
               new DecodeUtteranceLatticeFasterClass(
-                  decoder, decodable, trans_model, word_syms, utt,
+                  NULL, decodable, trans_model, word_syms, utt,
                   acoustic_scale, determinize, allow_partial, &alignment_writer,
                   &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &tot_like, &frame_count, &num_success, &num_fail, NULL);
+                  &tot_like, &frame_count, &num_success, &num_fail, NULL,
+                  decoder_pool);
 
           sequencer.Run(task); // takes ownership of "task",
           // and will delete it when done.
@@ -170,6 +175,7 @@ int main(int argc, char *argv[]) {
     }
     sequencer.Wait();
 
+    delete decoder_pool;  // must be deleted before decode_fst.
     if (decode_fst != NULL) delete decode_fst;
       
     double elapsed = timer.Elapsed();
@@ -27,6 +27,7 @@
 #include "fstext/fstext-lib.h"
 #include "decoder/decoder-wrappers.h"
 #include "decoder/decodable-matrix.h"
+#include "decoder/decoder-stats.h"
 #include "base/timer.h"
 
 
@@ -48,13 +49,30 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
+    ImplicitSelfLoopsConfig self_loops_config;
+    std::string state_visits_wxfilename;
+    std::string decoder_stats_wspecifier;
     
     std::string word_syms_filename;
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    self_loops_config.Register(&po);
+    po.Register("write-state-visits", &state_visits_wxfilename, "If supplied, "
+                "write to this file a vector with, for each graph state, the "
+                "number of frames on which it was active within the beam "
+                "(for use by fstsortstates).");
+    po.Register("write-decoder-stats", &decoder_stats_wspecifier, "If "
+                "supplied, write for each utterance a matrix of per-frame "
+                "decoder statistics, with columns: tokens before pruning, "
+                "tokens after pruning, arcs expanded, adaptive beam, "
+                "epsilon-closure iterations, and the time in seconds spent "
+                "on emitting arcs, nonemitting arcs, the beam cutoff and "
+                "pruning the lattice.");
     
     po.Read(argc, argv);
 
@@ -76,7 +94,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -85,12 +104,18 @@ int main(int argc, char *argv[]) {
 
     Int32VectorWriter alignment_writer(alignment_wspecifier);
 
+    BaseFloatMatrixWriter decoder_stats_writer(decoder_stats_wspecifier);
+    DecoderStats decoder_stats;
+
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_filename != "") 
       if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
         KALDI_ERR << "Could not read symbol table from file "
                    << word_syms_filename;
 
+    // Used for all the lattices if --determinize-num-threads > 1.
+    PersistentMultiThreader det_threader(config.det_opts.num_threads);
+
     double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
     int num_success = 0, num_fail = 0;
@@ -98,10 +123,18 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
+      std::vector<ImplicitSelfLoop> self_loops;
 
+      Vector<double> state_visits;
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
+        SetUpImplicitSelfLoops(self_loops_config, trans_model, *decode_fst,
+                               &self_loops, &decoder);
+        if (state_visits_wxfilename != "")
+          decoder.SetStateVisitCounts(&state_visits);
+        if (decoder_stats_writer.IsOpen())
+          decoder.SetStats(&decoder_stats);
     
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
           std::string utt = loglike_reader.Key();
@@ -120,15 +153,33 @@ int main(int argc, char *argv[]) {
                   decoder, decodable, trans_model, word_syms, utt,
                   acoustic_scale, determinize, allow_partial, &alignment_writer,
                   &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &like)) {
+                  &like, &det_threader)) {
             tot_like += like;
             frame_count += loglikes.NumRows();
             num_success++;
           } else num_fail++;
+          if (decoder_stats_writer.IsOpen()) {
+            Matrix<BaseFloat> stats_mat;
+            decoder_stats.GetMatrix(&stats_mat);
+            decoder_stats_writer.Write(utt, stats_mat);
+          }
         }
       }
+      if (state_visits_wxfilename != "") {
+        // Make sure the vector covers all states, even ones never visited.
+        int32 num_states = fst::CountStates(*decode_fst);
+        if (state_visits.Dim() < num_states)
+          state_visits.Resize(num_states, kCopyData);
+        WriteKaldiObject(state_visits, state_visits_wxfilename, true);
+      }
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
+      if (state_visits_wxfilename != "")
+        KALDI_ERR << "--write-state-visits is not supported when decoding "
+                  << "with a table of FSTs.";
+      if (self_loops_config.implicit_self_loops)
+        KALDI_ERR << "--implicit-self-loops is not supported when decoding "
+                  << "with a table of FSTs.";
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader loglike_reader(feature_rspecifier);          
       for (; !fst_reader.Done(); fst_reader.Next()) {
@@ -146,16 +197,24 @@ int main(int argc, char *argv[]) {
           continue;
         }
         LatticeFasterDecoder decoder(fst_reader.Value(), config);
+        if (decoder_stats_writer.IsOpen())
+          decoder.SetStats(&decoder_stats);
         DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
         double like;
         if (DecodeUtteranceLatticeFaster(
                 decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
                 determinize, allow_partial, &alignment_writer, &words_writer,
-                &compact_lattice_writer, &lattice_writer, &like)) {
+                &compact_lattice_writer, &lattice_writer, &like,
+                &det_threader)) {
           tot_like += like;
           frame_count += loglikes.NumRows();
           num_success++;
         } else num_fail++;
+        if (decoder_stats_writer.IsOpen()) {
+          Matrix<BaseFloat> stats_mat;
+          decoder_stats.GetMatrix(&stats_mat);
+          decoder_stats_writer.Write(utt, stats_mat);
+        }
       }
     }
       
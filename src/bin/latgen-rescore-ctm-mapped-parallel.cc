@@ -0,0 +1,371 @@
+// bin/latgen-rescore-ctm-mapped-parallel.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <numeric>
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "lat/lattice-rescore-ctm.h"
+#include "lm/const-arpa-lm.h"
+#include "base/timer.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+/// This class is like DecodeUtteranceLatticeFasterClass, and is for use with
+/// TaskSequencer in the same way, but instead of writing the lattice it
+/// rescores it and writes a ctm with confidences.  In operator () (which runs
+/// in a worker thread) we decode, determinize the lattice and call
+/// RescoreCompactLatticeToCtm(); the destructor (which runs in the main
+/// thread, in the order the tasks were given) writes the ctm lines.
+class DecodeRescoreCtmClass {
+ public:
+  // We take ownership of "decodable", as for
+  // DecodeUtteranceLatticeFasterClass.  The decoder is taken from
+  // "decoder_pool" in operator (), so that there are only as many decoders as
+  // threads, and is given back there.  "old_lm" is the LM that was in the
+  // decoding graph, projected on its output, sorted on its input labels and
+  // mapped to the lattice semiring (see RescoreCompactLattice()); it, and
+  // "new_lm", may be NULL if there is nothing to remove or add.  "new_lm" is
+  // shared by all the tasks, so it should have been created with
+  // thread_safe == true.  On error, "num_err" is incremented.
+  DecodeRescoreCtmClass(
+      const LatticeRescoreCtmOptions &opts,
+      BaseFloat decode_acoustic_scale,
+      BaseFloat frame_shift,
+      LatticeFasterDecoderPool *decoder_pool,
+      DecodableInterface *decodable,
+      const TransitionModel &trans_model,
+      const WordBoundaryInfo &word_boundary_info,
+      const fst::Fst<LatticeArc> *old_lm,
+      ConstArpaLmCache *new_lm,
+      std::string utt,
+      bool allow_partial,
+      std::ostream *ctm_stream,
+      int64 *frame_sum,  // on success, adds #frames to this.
+      int64 *word_sum,  // on success, adds #words in the ctm to this.
+      int32 *num_done,  // on success (incl. partial decode), increments this.
+      int32 *num_err):  // on failure, increments this.
+      opts_(opts), decode_acoustic_scale_(decode_acoustic_scale),
+      frame_shift_(frame_shift), decoder_pool_(decoder_pool), decoder_(NULL),
+      decodable_(decodable),
+      trans_model_(&trans_model), word_boundary_info_(&word_boundary_info),
+      old_lm_(old_lm), new_lm_(new_lm), utt_(utt),
+      allow_partial_(allow_partial), ctm_stream_(ctm_stream),
+      frame_sum_(frame_sum), word_sum_(word_sum), num_done_(num_done),
+      num_err_(num_err), computed_(false), success_(false), num_frames_(0),
+      bayes_risk_(0.0) { }
+
+  void operator () () {  // Decoding, rescoring etc. happen here.
+    computed_ = true;
+    decoder_ = decoder_pool_->Get();
+    success_ = Compute();
+    // Give back the decoder as soon as we're done with it.
+    decoder_pool_->Return(decoder_);
+    decoder_ = NULL;
+    delete decodable_;
+    decodable_ = NULL;
+  }
+
+  ~DecodeRescoreCtmClass() {  // Output happens here.
+    if (!computed_)
+      KALDI_ERR << "Destructor called without operator (), error in "
+                << "calling code.";
+
+    if (!success_) {
+      if (num_err_ != NULL) (*num_err_)++;
+      return;
+    }
+    for (size_t i = 0; i < words_.size(); i++) {
+      KALDI_ASSERT(words_[i] != 0);  // Should not have epsilons.
+      (*ctm_stream_) << utt_ << " 1 " << (frame_shift_ * times_[i].first)
+                     << ' '
+                     << (frame_shift_ * (times_[i].second - times_[i].first))
+                     << ' ' << words_[i] << ' ' << conf_[i] << '\n';
+    }
+    if (words_.empty())
+      KALDI_LOG << "For utterance " << utt_ << ", Bayes Risk " << bayes_risk_
+                << ", no words.";
+    else
+      KALDI_LOG << "For utterance " << utt_ << ", Bayes Risk " << bayes_risk_
+                << ", avg. confidence per-word "
+                << std::accumulate(conf_.begin(), conf_.end(), 0.0) /
+          words_.size();
+    if (frame_sum_ != NULL) *frame_sum_ += num_frames_;
+    if (word_sum_ != NULL) *word_sum_ += words_.size();
+    if (num_done_ != NULL) (*num_done_)++;
+  }
+
+ private:
+  // Does the work of operator ().  Returns false on failure.
+  bool Compute() {
+    if (!decoder_->Decode(decodable_)) {
+      KALDI_WARN << "Failed to decode file " << utt_;
+      return false;
+    }
+    if (!decoder_->ReachedFinal()) {
+      if (allow_partial_) {
+        KALDI_WARN << "Outputting partial output for utterance " << utt_
+                   << " since no final-state reached\n";
+      } else {
+        KALDI_WARN << "Not producing output for utterance " << utt_
+                   << " since no final-state reached and "
+                   << "--allow-partial=false.\n";
+        return false;
+      }
+    }
+    num_frames_ = decoder_->NumFramesDecoded();
+
+    CompactLattice clat;
+    {
+      Lattice lat;
+      decoder_->GetRawLattice(&lat);
+      if (lat.NumStates() == 0)
+        KALDI_ERR << "Unexpected problem getting lattice for utterance "
+                  << utt_;
+      fst::Connect(&lat);
+      if (!DeterminizeLatticePhonePrunedWrapper(
+              *trans_model_, &lat, decoder_->GetOptions().lattice_beam, &clat,
+              decoder_->GetOptions().det_opts))
+        KALDI_WARN << "Determinization finished earlier than the beam for "
+                   << "utterance " << utt_;
+    }
+    // Remove the acoustic scaling as latgen-faster-mapped does before writing
+    // the lattice, so the rescoring keeps the same paths as the pipeline.
+    if (decode_acoustic_scale_ != 0.0)
+      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / decode_acoustic_scale_),
+                        &clat);
+
+    ConstArpaLmDeterministicFst *new_lm_dfst = NULL;
+    if (new_lm_ != NULL)
+      new_lm_dfst = new ConstArpaLmDeterministicFst(new_lm_);
+    bool ans = RescoreCompactLatticeToCtm(opts_, *trans_model_,
+                                          word_boundary_info_, old_lm_,
+                                          new_lm_dfst, utt_, &clat, &words_,
+                                          &times_, &conf_, &bayes_risk_);
+    delete new_lm_dfst;
+    return ans;
+  }
+
+  // The following variables correspond to inputs:
+  LatticeRescoreCtmOptions opts_;
+  BaseFloat decode_acoustic_scale_;
+  BaseFloat frame_shift_;
+  LatticeFasterDecoderPool *decoder_pool_;
+  LatticeFasterDecoder *decoder_;  // Only set inside operator ().
+  DecodableInterface *decodable_;
+  const TransitionModel *trans_model_;
+  const WordBoundaryInfo *word_boundary_info_;
+  const fst::Fst<LatticeArc> *old_lm_;
+  ConstArpaLmCache *new_lm_;
+  std::string utt_;
+  bool allow_partial_;
+  std::ostream *ctm_stream_;
+  int64 *frame_sum_;
+  int64 *word_sum_;
+  int32 *num_done_;
+  int32 *num_err_;
+
+  // The following variables are stored by the computation.
+  bool computed_;  // operator () was called.
+  bool success_;  // we have a ctm (possibly from a partial decode).
+  int32 num_frames_;
+  BaseFloat bayes_risk_;
+  std::vector<int32> words_;  // The one-best words, times and confidences.
+  std::vector<std::pair<BaseFloat, BaseFloat> > times_;
+  std::vector<BaseFloat> conf_;
+};
+
+}  // end namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Decode, reading log-likelihoods as matrices, using multiple threads,\n"
+        "and produce a ctm with confidences from lattices rescored with a\n"
+        "ConstArpaLm language model, without writing the lattices out.  This\n"
+        "does the same as latgen-faster-mapped, lattice-lmrescore\n"
+        "--lm-scale=-1 with old-lm-fst-in, lattice-lmrescore-const-arpa,\n"
+        "lattice-add-penalty, lattice-align-words and lattice-to-ctm-conf.\n"
+        "The acoustic scale for the posteriors is --ctm-acoustic-scale, as\n"
+        "for lattice-to-ctm-conf --acoustic-scale (by default the decoding\n"
+        "acoustic scale).\n"
+        "The ctm is relative to the utterance and has word-ids, as for\n"
+        "lattice-to-ctm-conf.\n"
+        " (model is needed only for the integer mappings in its transition-model)\n"
+        "Usage: latgen-rescore-ctm-mapped-parallel [options] trans-model-in "
+        "fst-in old-lm-fst-in const-arpa-lm-in word-boundary-file "
+        "loglikes-rspecifier ctm-wxfilename\n"
+        " e.g.: latgen-rescore-ctm-mapped-parallel --num-threads=8 final.mdl "
+        "HCLG.fst \\\n"
+        "   'fstproject --project_output=true data/lang/G.fst |' "
+        "data/lang_big/G.carpa \\\n"
+        "   data/lang/phones/word_boundary.int ark:loglikes.ark 1.ctm\n"
+        "See also: latgen-faster-mapped-parallel, lattice-to-ctm-conf\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1, ctm_acoustic_scale = -1.0,
+        frame_shift = 0.01;
+    int32 lm_cache_size = 1000000, max_lm_states = 1000000;
+    LatticeFasterDecoderConfig config;
+    LatticeRescoreCtmOptions rescore_opts;
+    WordBoundaryInfoNewOpts word_boundary_opts;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+
+    config.Register(&po);
+    rescore_opts.Register(&po);
+    word_boundary_opts.Register(&po);
+    sequencer_config.Register(&po);
+
+    po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
+    po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("ctm-acoustic-scale", &ctm_acoustic_scale, "Scaling factor "
+                "for acoustic likelihoods in the posteriors for the ctm, as "
+                "lattice-to-ctm-conf --acoustic-scale; if negative, "
+                "--acoustic-scale is used.");
+    po.Register("frame-shift", &frame_shift, "Time in seconds between "
+                "frames, for the ctm.");
+    po.Register("lm-cache-size", &lm_cache_size, "Number of n-gram lookups "
+                "in the new LM to cache (the cache is shared by all the "
+                "threads).");
+    po.Register("max-lm-states", &max_lm_states, "If more than this many "
+                "history states of the new LM have been visited, we start a "
+                "new cache for the next utterances, to limit memory use.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 7) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_filename = po.GetArg(2),
+        old_lm_fst_rxfilename = po.GetArg(3),
+        lm_rxfilename = po.GetArg(4),
+        word_boundary_rxfilename = po.GetArg(5),
+        loglikes_rspecifier = po.GetArg(6),
+        ctm_wxfilename = po.GetArg(7);
+
+    rescore_opts.acoustic_scale = (ctm_acoustic_scale < 0.0 ? acoustic_scale :
+                                   ctm_acoustic_scale);
+    if (!config.determinize_lattice)
+      KALDI_ERR << "--determinize-lattice=false is not supported.";
+    if (ClassifyWspecifier(ctm_wxfilename, NULL, NULL, NULL) != kNoWspecifier)
+      KALDI_ERR << "The output ctm file should not be a wspecifier. "
+                << "Please use things like 1.ctm istead of ark:-";
+
+    TransitionModel trans_model;
+    ReadKaldiObject(model_in_filename, &trans_model);
+
+    WordBoundaryInfo word_boundary_info(word_boundary_opts,
+                                        word_boundary_rxfilename);
+
+    // The old LM is removed as lattice-lmrescore does it, so we map it to the
+    // lattice semiring.  We do that once here, rather than with a MapFst for
+    // each lattice, so that the threads can share it.
+    VectorFst<LatticeArc> old_lm_fst;
+    {
+      VectorFst<StdArc> *std_old_lm_fst =
+          fst::ReadFstKaldi(old_lm_fst_rxfilename);
+      fst::ArcMap(*std_old_lm_fst, &old_lm_fst,
+                  fst::StdToLatticeMapper<BaseFloat>());
+      delete std_old_lm_fst;
+      if (old_lm_fst.Properties(fst::kILabelSorted, true) == 0) {
+        // Make sure LM is sorted on ilabel.
+        fst::ArcSort(&old_lm_fst, fst::ILabelCompare<LatticeArc>());
+      }
+    }
+
+    ConstArpaLm const_arpa;
+    const_arpa.ReadMapped(lm_rxfilename);
+    // The LM history states and n-gram lookups are shared by all the threads.
+    ConstArpaLmCache lm_cache(const_arpa, lm_cache_size, true, max_lm_states);
+
+    Output ko(ctm_wxfilename, false); // false == non-binary writing mode.
+    ko.Stream() << std::fixed;  // Set to "fixed" floating point model, where precision() specifies
+    // the #digits after the decimal point.
+    ko.Stream().precision(2);
+
+    kaldi::int64 frame_count = 0, word_count = 0;
+    int num_success = 0, num_fail = 0;
+
+    SequentialBaseFloatMatrixReader loglike_reader(loglikes_rspecifier);
+    // It's important that we initialize decode_fst after loglike_reader, as it
+    // can prevent crashes on systems installed without enough virtual memory
+    // (see decode-faster-mapped.cc).
+    VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_filename);
+    {
+      // The decoders are reused across utterances, keeping their storage.
+      LatticeFasterDecoderPool decoder_pool(*decode_fst, config);
+      TaskSequencer<DecodeRescoreCtmClass> sequencer(sequencer_config);
+
+      for (; !loglike_reader.Done(); loglike_reader.Next()) {
+        std::string utt = loglike_reader.Key();
+        Matrix<BaseFloat> *loglikes =
+            new Matrix<BaseFloat>(loglike_reader.Value());
+        loglike_reader.FreeCurrent();
+        if (loglikes->NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          delete loglikes;
+          continue;
+        }
+        DecodableMatrixScaledMapped *decodable =
+            new DecodableMatrixScaledMapped(trans_model, acoustic_scale,
+                                            loglikes);
+        DecodeRescoreCtmClass *task = new DecodeRescoreCtmClass(
+            rescore_opts, acoustic_scale, frame_shift, &decoder_pool,
+            decodable, trans_model, word_boundary_info, &old_lm_fst,
+            &lm_cache, utt, allow_partial, &ko.Stream(), &frame_count,
+            &word_count, &num_success, &num_fail);
+        sequencer.Run(task); // takes ownership of "task",
+        // and will delete it when done.
+      }
+      sequencer.Wait();
+    }
+    delete decode_fst; // delete this only after the decoders are deleted.
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor per thread assuming 100 frames/sec is "
+              << (sequencer_config.num_threads*elapsed*100.0/frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Wrote " << word_count << " words to the ctm.";
+
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -48,9 +48,11 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeTrackingDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
     
     std::string word_syms_filename;
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
@@ -86,7 +88,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -21,7 +21,7 @@
 #define KALDI_DECODER_BIGLM_FASTER_DECODER_H_
 
 #include "util/stl-utils.h"
-#include "util/hash-list.h"
+#include "util/open-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
@@ -235,7 +235,7 @@ class BiglmFasterDecoder {
       }
     }
   };
-  typedef HashList<PairId, Token*>::Elem Elem;
+  typedef DecoderHashList<PairId, Token*>::Elem Elem;
 
 
   /// Gets the weight cutoff.  Also counts the active tokens.
@@ -468,10 +468,10 @@ class BiglmFasterDecoder {
     }
   }
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by PairId.
-  HashList<PairId, Token*> toks_;
+  // DecoderHashList is HashList or OpenHashList (see ../util/open-hash-list.h).
+  // It actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by PairId.
+  DecoderHashList<PairId, Token*> toks_;
   const fst::Fst<fst::StdArc> &fst_;
   fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst_;
   BiglmFasterDecoderOptions opts_;
@@ -69,6 +69,15 @@ class DecodableMatrixScaledMapped: public DecodableInterface {
     return scale_ * (*likes_)(frame, trans_model_.TransitionIdToPdf(tid));
   }
 
+  virtual void LogLikelihoods(int32 frame, const std::vector<int32> &tids,
+                              std::vector<BaseFloat> *loglikes) {
+    loglikes->resize(tids.size());
+    const BaseFloat *row_data = likes_->RowData(frame);
+    for (size_t i = 0; i < tids.size(); i++)
+      (*loglikes)[i] =
+          scale_ * row_data[trans_model_.TransitionIdToPdf(tids[i])];
+  }
+
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
@@ -184,6 +193,14 @@ class DecodableMatrixScaled: public DecodableInterface {
     return scale_ * likes_(frame, tid);
   }
 
+  virtual void LogLikelihoods(int32 frame, const std::vector<int32> &tids,
+                              std::vector<BaseFloat> *loglikes) {
+    loglikes->resize(tids.size());
+    const BaseFloat *row_data = likes_.RowData(frame);
+    for (size_t i = 0; i < tids.size(); i++)
+      (*loglikes)[i] = scale_ * row_data[tids[i]];
+  }
+
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return likes_.NumCols(); }
 
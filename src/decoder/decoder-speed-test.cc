@@ -0,0 +1,252 @@
+// decoder/decoder-speed-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdlib>
+#include <fstream>
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "fstext/rand-fst.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/faster-decoder.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/lattice-faster-online-decoder.h"
+
+namespace kaldi {
+
+/* This compares the speed of FasterDecoder, LatticeFasterDecoder and
+   LatticeFasterOnlineDecoder over a range of beams, on a random graph and
+   random acoustic scores, so it needs no models or data and the results are
+   repeatable (for a given --seed) on any machine.  The graph is made with
+   RandFst() and then, to make it a bit more like HCLG, we add a self-loop
+   with a random pdf to each state.  For each decoder and beam we report the
+   frames decoded per second (including getting the lattice or best path), the
+   average number of active tokens per frame, and the peak resident memory of
+   the process so far (from /proc/self/status; as this only increases, it
+   reflects the most expensive configuration run so far).  With
+   --decoder-num-threads=N, LatticeFasterDecoder is also run with N threads.
+*/
+
+struct DecoderSpeedTestOptions {
+  int32 num_states;
+  int32 num_arcs_per_state;
+  int32 num_pdfs;
+  int32 num_frames;
+  int32 num_utts;
+  BaseFloat acoustic_scale;
+  std::string beams;
+  int32 seed;
+
+  DecoderSpeedTestOptions(): num_states(20000), num_arcs_per_state(4),
+                             num_pdfs(2000), num_frames(300), num_utts(5),
+                             acoustic_scale(0.1), beams("11:13:15"),
+                             seed(0) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("num-states", &num_states, "Number of states in the "
+                 "random graph (before trimming).");
+    po->Register("num-arcs-per-state", &num_arcs_per_state, "Average number "
+                 "of arcs per state in the random graph, not counting the "
+                 "self-loops.");
+    po->Register("num-pdfs", &num_pdfs, "Number of distinct input labels "
+                 "(acoustic scores) in the random graph.");
+    po->Register("num-frames", &num_frames, "Number of frames per utterance.");
+    po->Register("num-utts", &num_utts, "Number of utterances to decode for "
+                 "each decoder and beam.");
+    po->Register("acoustic-scale", &acoustic_scale, "Scale on the random "
+                 "log-likelihoods, which have unit variance.");
+    po->Register("beams", &beams, "Colon-separated list of beams to try.");
+    po->Register("seed", &seed, "Seed for the random numbers.");
+  }
+};
+
+
+// Returns the peak resident set size of this process in kB, or -1 if it
+// can't be worked out (e.g. not on Linux).
+int64 PeakMemoryKb() {
+  std::ifstream is("/proc/self/status");
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return std::atol(line.c_str() + 6);
+  }
+  return -1;
+}
+
+
+fst::VectorFst<fst::StdArc> *SyntheticGraph(
+    const DecoderSpeedTestOptions &opts) {
+  using fst::StdArc;
+  fst::RandFstOptions rand_opts;
+  rand_opts.n_syms = opts.num_pdfs + 1;  // label zero is epsilon.
+  rand_opts.n_states = opts.num_states;
+  rand_opts.n_arcs = static_cast<size_t>(opts.num_states) *
+      opts.num_arcs_per_state;
+  rand_opts.n_final = opts.num_states / 100 + 1;
+  rand_opts.allow_empty = false;
+  rand_opts.acyclic = false;
+  rand_opts.weight_multiplier = 1.0;
+  fst::VectorFst<StdArc> *fst = fst::RandFst<StdArc>(rand_opts);
+  for (StdArc::StateId s = 0; s < fst->NumStates(); s++) {
+    StdArc arc(RandInt(1, opts.num_pdfs), 0, StdArc::Weight(0.7), s);
+    fst->AddArc(s, arc);
+  }
+  return fst;
+}
+
+
+// Decodes all the utterances with "decoder", which may be any of the decoders
+// with Decode(), SetStats() and GetBestPath(); lattice decoders also get the
+// raw lattice.  Prints the statistics.  The timed decoding is done without
+// DecoderStats, which would slow it down; we count the tokens in a second,
+// untimed pass.
+template<class Decoder>
+void TimeDecoder(const std::string &name, BaseFloat beam,
+                 const std::vector<Matrix<BaseFloat> > &loglikes,
+                 BaseFloat acoustic_scale, Decoder *decoder) {
+  int64 num_frames = 0;
+  double time = 0.0;
+  decoder->SetStats(NULL);
+  for (size_t i = 0; i < loglikes.size(); i++) {
+    DecodableMatrixScaled decodable(loglikes[i], acoustic_scale);
+    Timer timer;
+    decoder->Decode(&decodable);
+    fst::VectorFst<LatticeArc> path;
+    decoder->GetBestPath(&path);
+    time += timer.Elapsed();
+    num_frames += loglikes[i].NumRows();
+  }
+
+  DecoderStats stats;
+  decoder->SetStats(&stats);
+  double num_tokens = 0.0;
+  for (size_t i = 0; i < loglikes.size(); i++) {
+    DecodableMatrixScaled decodable(loglikes[i], acoustic_scale);
+    decoder->Decode(&decodable);
+    for (int32 f = 0; f < stats.NumFrames(); f++)
+      num_tokens += stats.Get(f, DecoderStats::kTokensBeforePruning);
+  }
+  decoder->SetStats(NULL);
+  KALDI_LOG << name << " with beam " << beam << ": "
+            << (num_frames / time) << " frames/sec, "
+            << (num_tokens / num_frames) << " tokens/frame, peak memory "
+            << PeakMemoryKb() << " kB";
+}
+
+// LatticeFasterDecoder and LatticeFasterOnlineDecoder are normally used to get
+// lattices, so we include that in the time.
+template<class Decoder>
+class LatticeGetter {
+ public:
+  explicit LatticeGetter(Decoder *decoder): decoder_(decoder) { }
+  void SetStats(DecoderStats *stats) { decoder_->SetStats(stats); }
+  bool Decode(DecodableInterface *decodable) {
+    return decoder_->Decode(decodable);
+  }
+  bool GetBestPath(fst::VectorFst<LatticeArc> *path) {
+    Lattice lat;
+    decoder_->GetRawLattice(&lat);
+    fst::ShortestPath(lat, path);
+    return (path->Start() != fst::kNoStateId);
+  }
+ private:
+  Decoder *decoder_;
+};
+
+
+void DecoderSpeedTest(const DecoderSpeedTestOptions &opts,
+                      const LatticeFasterDecoderConfig &config) {
+  std::vector<BaseFloat> beams;
+  if (!SplitStringToFloats(opts.beams, ":", true, &beams) || beams.empty())
+    KALDI_ERR << "Bad --beams option " << opts.beams;
+
+  srand(opts.seed);
+  fst::VectorFst<fst::StdArc> *fst = SyntheticGraph(opts);
+  std::vector<Matrix<BaseFloat> > loglikes(opts.num_utts);
+  for (int32 i = 0; i < opts.num_utts; i++) {
+    loglikes[i].Resize(opts.num_frames, opts.num_pdfs + 1);
+    loglikes[i].SetRandn();
+  }
+  KALDI_LOG << "Graph has " << fst->NumStates() << " states and "
+            << fst::NumArcs(*fst) << " arcs; peak memory before decoding is "
+            << PeakMemoryKb() << " kB";
+
+  for (size_t b = 0; b < beams.size(); b++) {
+    LatticeFasterDecoderConfig lat_config(config);
+    lat_config.beam = beams[b];
+    FasterDecoderOptions faster_opts;
+    faster_opts.beam = beams[b];
+    faster_opts.max_active = config.max_active;
+    faster_opts.min_active = config.min_active;
+    faster_opts.beam_delta = config.beam_delta;
+    faster_opts.hash_ratio = config.hash_ratio;
+    {
+      FasterDecoder decoder(*fst, faster_opts);
+      TimeDecoder("FasterDecoder", beams[b], loglikes, opts.acoustic_scale,
+                  &decoder);
+    }
+    {
+      LatticeFasterDecoderConfig serial_config(lat_config);
+      serial_config.num_threads = 1;
+      LatticeFasterDecoder decoder(*fst, serial_config);
+      LatticeGetter<LatticeFasterDecoder> getter(&decoder);
+      TimeDecoder("LatticeFasterDecoder", beams[b], loglikes,
+                  opts.acoustic_scale, &getter);
+    }
+    if (config.num_threads > 1) {
+      LatticeFasterDecoder decoder(*fst, lat_config);
+      LatticeGetter<LatticeFasterDecoder> getter(&decoder);
+      std::ostringstream name;
+      name << "LatticeFasterDecoder[" << config.num_threads << " threads]";
+      TimeDecoder(name.str(), beams[b], loglikes, opts.acoustic_scale,
+                  &getter);
+    }
+    {
+      LatticeFasterOnlineDecoder decoder(*fst, lat_config);
+      LatticeGetter<LatticeFasterOnlineDecoder> getter(&decoder);
+      TimeDecoder("LatticeFasterOnlineDecoder", beams[b], loglikes,
+                  opts.acoustic_scale, &getter);
+    }
+  }
+  delete fst;
+}
+
+} // end namespace kaldi
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  const char *usage =
+      "Speed test for the decoders, on a random graph with random acoustic\n"
+      "scores.  With no arguments, runs with the default options.\n"
+      "Usage: decoder-speed-test [options]\n"
+      " e.g.: decoder-speed-test --num-states=500000 --beams=10:12:14:16\n"
+      "       decoder-speed-test --num-states=500000 --decoder-num-threads=4\n";
+  ParseOptions po(usage);
+  DecoderSpeedTestOptions opts;
+  LatticeFasterDecoderConfig config;
+  opts.Register(&po);
+  config.Register(&po);  // --beam is ignored; we use --beams.
+  po.Read(argc, argv);
+  if (po.NumArgs() != 0) {
+    po.PrintUsage();
+    exit(1);
+  }
+  DecoderSpeedTest(opts, config);
+  std::cout << "Test OK.\n";
+}
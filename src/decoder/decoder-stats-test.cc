@@ -0,0 +1,62 @@
+// decoder/decoder-stats-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/decoder-stats.h"
+
+namespace kaldi {
+
+void TestDecoderStats() {
+  DecoderStats stats;
+  KALDI_ASSERT(stats.NumFrames() == 0);
+
+  // Add() and Set() add frames as needed, and the new entries are zero.
+  stats.Add(2, DecoderStats::kArcsExpanded, 10);
+  KALDI_ASSERT(stats.NumFrames() == 3);
+  KALDI_ASSERT(stats.Get(0, DecoderStats::kArcsExpanded) == 0.0);
+  stats.Add(2, DecoderStats::kArcsExpanded, 5);
+  KALDI_ASSERT(stats.Get(2, DecoderStats::kArcsExpanded) == 15.0);
+  stats.Set(4, DecoderStats::kAdaptiveBeam, 7.5);
+  stats.Set(4, DecoderStats::kAdaptiveBeam, 8.5);
+  KALDI_ASSERT(stats.NumFrames() == 5);
+  KALDI_ASSERT(stats.Get(4, DecoderStats::kAdaptiveBeam) == 8.5);
+  stats.Add(1, DecoderStats::kCutoffTime, 0.25);
+  stats.Add(1, DecoderStats::kPruningTime, 0.5);
+
+  Matrix<BaseFloat> mat;
+  stats.GetMatrix(&mat);
+  KALDI_ASSERT(mat.NumRows() == 5 && mat.NumCols() == DecoderStats::kNumStats);
+  for (int32 f = 0; f < mat.NumRows(); f++)
+    for (int32 s = 0; s < mat.NumCols(); s++)
+      KALDI_ASSERT(mat(f, s) ==
+                   stats.Get(f, static_cast<DecoderStats::StatType>(s)));
+  KALDI_ASSERT(mat(1, DecoderStats::kCutoffTime) == 0.25 &&
+               mat(1, DecoderStats::kPruningTime) == 0.5);
+
+  stats.Reset();
+  KALDI_ASSERT(stats.NumFrames() == 0);
+  stats.GetMatrix(&mat);
+  KALDI_ASSERT(mat.NumRows() == 0);
+}
+
+}  // end namespace kaldi
+
+int main() {
+  kaldi::TestDecoderStats();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,32 @@
+// decoder/decoder-stats.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/decoder-stats.h"
+
+namespace kaldi {
+
+void DecoderStats::GetMatrix(Matrix<BaseFloat> *mat) const {
+  int32 num_frames = NumFrames();
+  mat->Resize(num_frames, kNumStats, kUndefined);
+  for (int32 f = 0; f < num_frames; f++)
+    for (int32 s = 0; s < kNumStats; s++)
+      (*mat)(f, s) = stats_[static_cast<size_t>(f) * kNumStats + s];
+}
+
+}  // namespace kaldi
@@ -0,0 +1,95 @@
+// decoder/decoder-stats.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_DECODER_STATS_H_
+#define KALDI_DECODER_DECODER_STATS_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+/**
+   DecoderStats collects per-frame statistics about the search, for profiling
+   and for tuning the beams.  You attach it to a decoder with SetStats() (see
+   LatticeFasterDecoder and FasterDecoder); the decoder clears it in
+   InitDecoding(), so after decoding an utterance it contains that utterance's
+   statistics.  GetMatrix() outputs them as a matrix with one row per frame
+   and one column per statistic (in the order of the enum StatType), which is
+   convenient for writing as a table (see --write-decoder-stats in
+   latgen-faster-mapped).
+ */
+class DecoderStats {
+ public:
+  enum StatType {
+    kTokensBeforePruning = 0,  // tokens active before applying the beam.
+    kTokensAfterPruning,   // tokens within the beam, whose arcs we expand.
+    kArcsExpanded,         // arcs (emitting and nonemitting) that survived
+                           // pruning.
+    kAdaptiveBeam,         // the beam after applying max-active/min-active.
+    kEpsilonIterations,    // states popped from the queue while processing
+                           // nonemitting arcs.
+    kEmittingTime,         // seconds spent processing emitting arcs.
+    kNonemittingTime,      // seconds spent processing nonemitting arcs.
+    kCutoffTime,           // seconds spent working out the beam cutoff.
+    kPruningTime,          // seconds spent pruning the lattice.
+    kNumStats
+  };
+
+  DecoderStats() { }
+
+  /// Removes all the frames.
+  void Reset() { stats_.clear(); }
+
+  /// Adds "value" to statistic "stat" of frame "frame" (zero-based), adding
+  /// frames if needed.
+  void Add(int32 frame, StatType stat, double value) {
+    KALDI_ASSERT(frame >= 0);
+    size_t index = static_cast<size_t>(frame) * kNumStats + stat;
+    if (index >= stats_.size())
+      stats_.resize((frame + 1) * static_cast<size_t>(kNumStats), 0.0);
+    stats_[index] += value;
+  }
+
+  /// Sets statistic "stat" of frame "frame", adding frames if needed.
+  void Set(int32 frame, StatType stat, double value) {
+    Add(frame, stat, 0.0);
+    stats_[static_cast<size_t>(frame) * kNumStats + stat] = value;
+  }
+
+  double Get(int32 frame, StatType stat) const {
+    KALDI_ASSERT(frame >= 0 && frame < NumFrames());
+    return stats_[static_cast<size_t>(frame) * kNumStats + stat];
+  }
+
+  int32 NumFrames() const { return stats_.size() / kNumStats; }
+
+  /// Outputs the statistics as a matrix of dimension NumFrames() by kNumStats.
+  void GetMatrix(Matrix<BaseFloat> *mat) const;
+
+ private:
+  // The statistics, indexed by frame * kNumStats + stat.
+  std::vector<double> stats_;
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_DECODER_STATS_H_
@@ -23,7 +23,49 @@
 namespace kaldi {
 
 
+LatticeFasterDecoderPool::LatticeFasterDecoderPool(
+    const fst::Fst<fst::StdArc> &fst,
+    const LatticeFasterDecoderConfig &config):
+    fst_(fst), config_(config), num_in_use_(0) {
+  config_.Check();
+}
+
+LatticeFasterDecoder *LatticeFasterDecoderPool::Get() {
+  LatticeFasterDecoder *ans = NULL;
+  mutex_.Lock();
+  num_in_use_++;
+  if (!free_decoders_.empty()) {
+    ans = free_decoders_.back();
+    free_decoders_.pop_back();
+  }
+  mutex_.Unlock();
+  // Construct outside the lock, so other threads don't have to wait.
+  if (ans == NULL)
+    ans = new LatticeFasterDecoder(fst_, config_);
+  return ans;
+}
 
+void LatticeFasterDecoderPool::Return(LatticeFasterDecoder *decoder) {
+  KALDI_ASSERT(decoder != NULL);
+  mutex_.Lock();
+  KALDI_ASSERT(num_in_use_ > 0);
+  num_in_use_--;
+  free_decoders_.push_back(decoder);
+  mutex_.Unlock();
+}
+
+LatticeFasterDecoderPool::~LatticeFasterDecoderPool() {
+  mutex_.Lock();
+  int32 num_in_use = num_in_use_;
+  mutex_.Unlock();
+  if (num_in_use != 0)
+    KALDI_ERR << "Destroying decoder pool while " << num_in_use
+              << " decoders are still in use.";
+  KALDI_VLOG(1) << "Decoder pool created " << free_decoders_.size()
+                << " decoders.";
+  for (size_t i = 0; i < free_decoders_.size(); i++)
+    delete free_decoders_[i];
+}
 
 
 DecodeUtteranceLatticeFasterClass::DecodeUtteranceLatticeFasterClass(
@@ -43,7 +85,8 @@ DecodeUtteranceLatticeFasterClass::DecodeUtteranceLatticeFasterClass(
     int64 *frame_sum, // on success, adds #frames to this.
     int32 *num_done, // on success (including partial decode), increments this.
     int32 *num_err,  // on failure, increments this.
-    int32 *num_partial):  // If partial decode (final-state not reached), increments this.
+    int32 *num_partial,  // If partial decode (final-state not reached), increments this.
+    LatticeFasterDecoderPool *decoder_pool):
     decoder_(decoder), decodable_(decodable), trans_model_(&trans_model),
     word_syms_(word_syms), utt_(utt), acoustic_scale_(acoustic_scale),
     determinize_(determinize), allow_partial_(allow_partial),
@@ -53,9 +96,11 @@ DecodeUtteranceLatticeFasterClass::DecodeUtteranceLatticeFasterClass(
     lattice_writer_(lattice_writer),
     like_sum_(like_sum), frame_sum_(frame_sum),
     num_done_(num_done), num_err_(num_err),
-    num_partial_(num_partial),
+    num_partial_(num_partial), decoder_pool_(decoder_pool),
     computed_(false), success_(false), partial_(false),
-    clat_(NULL), lat_(NULL) { }
+    clat_(NULL), lat_(NULL) {
+  KALDI_ASSERT((decoder == NULL) == (decoder_pool != NULL));
+}
 
 
 void DecodeUtteranceLatticeFasterClass::operator () () {
@@ -63,6 +108,8 @@ void DecodeUtteranceLatticeFasterClass::operator () () {
   computed_ = true; // Just means this function was called-- a check on the
   // calling code.
   success_ = true;
+  if (decoder_pool_ != NULL)
+    decoder_ = decoder_pool_->Get();
   using fst::VectorFst;
   if (!decoder_->Decode(decodable_)) {
     KALDI_WARN << "Failed to decode file " << utt_;
@@ -80,7 +127,31 @@ void DecodeUtteranceLatticeFasterClass::operator () () {
       success_ = false;
     }
   }
-  if (!success_) return;
+  if (success_) {
+    ComputeOutput();
+  }
+  // We're done with the decoder and the decodable, so free them here and
+  // not in the destructor: with a decoder pool, this lets the next utterance
+  // reuse the decoder while this one waits for its output to be written.
+  if (decoder_pool_ != NULL)
+    decoder_pool_->Return(decoder_);
+  else
+    delete decoder_;
+  decoder_ = NULL;
+  delete decodable_;
+  decodable_ = NULL;
+}
+
+void DecodeUtteranceLatticeFasterClass::ComputeOutput() {
+  { // First do some stuff with word-level traceback...
+    fst::VectorFst<LatticeArc> decoded;
+    decoder_->GetBestPath(&decoded);
+    if (decoded.NumStates() == 0) {
+      // Shouldn't really reach this point as already checked success.
+      KALDI_ERR << "Failed to get traceback for utterance " << utt_;
+    }
+    GetLinearSymbolSequence(decoded, &alignment_, &words_, &weight_);
+  }
 
   // Get lattice, and do determinization if requested.
   lat_ = new Lattice;
@@ -117,39 +188,21 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
   if (!success_) {
     if (num_err_ != NULL) (*num_err_)++;
   } else { // successful decode.
-    // Getting the one-best output is lightweight enough that we can do it in
-    // the destructor (easier than adding more variables to the class, and
-    // will rarely slow down the main thread.)
-    double likelihood;
-    LatticeWeight weight;
-    int32 num_frames;
-    { // First do some stuff with word-level traceback...
-      // This is basically for diagnostics.
-      fst::VectorFst<LatticeArc> decoded;
-      decoder_->GetBestPath(&decoded);
-      if (decoded.NumStates() == 0) {
-        // Shouldn't really reach this point as already checked success.
-        KALDI_ERR << "Failed to get traceback for utterance " << utt_;
-      }
-      std::vector<int32> alignment;
-      std::vector<int32> words;
-      GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-      num_frames = alignment.size();
-      if (words_writer_->IsOpen())
-        words_writer_->Write(utt_, words);
-      if (alignments_writer_->IsOpen())
-        alignments_writer_->Write(utt_, alignment);
-      if (word_syms_ != NULL) {
-        std::cerr << utt_ << ' ';
-        for (size_t i = 0; i < words.size(); i++) {
-          std::string s = word_syms_->Find(words[i]);
-          if (s == "")
-            KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
-          std::cerr << s << ' ';
-        }
-        std::cerr << '\n';
+    int32 num_frames = alignment_.size();
+    double likelihood = -(weight_.Value1() + weight_.Value2());
+    if (words_writer_->IsOpen())
+      words_writer_->Write(utt_, words_);
+    if (alignments_writer_->IsOpen())
+      alignments_writer_->Write(utt_, alignment_);
+    if (word_syms_ != NULL) {
+      std::cerr << utt_ << ' ';
+      for (size_t i = 0; i < words_.size(); i++) {
+        std::string s = word_syms_->Find(words_[i]);
+        if (s == "")
+          KALDI_ERR << "Word-id " << words_[i] << " not in symbol table.";
+        std::cerr << s << ' ';
       }
-      likelihood = -(weight.Value1() + weight.Value2());
+      std::cerr << '\n';
     }
 
     // Ouptut the lattices.
@@ -178,7 +231,7 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
               << (likelihood / num_frames) << " over "
               << num_frames << " frames.";
     KALDI_VLOG(2) << "Cost for utterance " << utt_ << " is "
-                  << weight.Value1() << " + " << weight.Value2();
+                  << weight_.Value1() << " + " << weight_.Value2();
 
     // Now output the various diagnostic variables.
     if (like_sum_ != NULL) *like_sum_ += likelihood;
@@ -186,16 +239,14 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
     if (num_done_ != NULL) (*num_done_)++;
     if (partial_ && num_partial_ != NULL) (*num_partial_)++;
   }
-  // We were given ownership of these two objects that were passed in in
-  // the initializer.
-  delete decoder_;
-  delete decodable_;
 }
 
 
-// Takes care of output.  Returns true on success.
-bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+// Takes care of output.  Returns true on success.  This is the implementation
+// of DecodeUtteranceLatticeFaster() and DecodeUtteranceLatticeBiglmFaster().
+template <class Decoder>
+static bool DecodeUtteranceLatticeFasterTpl(
+    Decoder &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -207,7 +258,8 @@ bool DecodeUtteranceLatticeFaster(
     Int32VectorWriter *words_writer,
     CompactLatticeWriter *compact_lattice_writer,
     LatticeWriter *lattice_writer,
-    double *like_ptr) { // puts utterance's like in like_ptr on success.
+    double *like_ptr, // puts utterance's like in like_ptr on success.
+    PersistentMultiThreader *det_threader) {
   using fst::VectorFst;
 
   if (!decoder.Decode(&decodable)) {
@@ -269,7 +321,8 @@ bool DecodeUtteranceLatticeFaster(
             &lat,
             decoder.GetOptions().lattice_beam,
             &clat,
-            decoder.GetOptions().det_opts))
+            decoder.GetOptions().det_opts,
+            det_threader))
       KALDI_WARN << "Determinization finished earlier than the beam for "
                  << "utterance " << utt;
     // We'll write the lattice without acoustic scaling.
@@ -291,6 +344,48 @@ bool DecodeUtteranceLatticeFaster(
   return true;
 }
 
+bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr, // puts utterance's like in like_ptr on success.
+    PersistentMultiThreader *det_threader) {
+  return DecodeUtteranceLatticeFasterTpl(
+      decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
+      determinize, allow_partial, alignment_writer, words_writer,
+      compact_lattice_writer, lattice_writer, like_ptr, det_threader);
+}
+
+bool DecodeUtteranceLatticeBiglmFaster(
+    LatticeBiglmFasterDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr, // puts utterance's like in like_ptr on success.
+    PersistentMultiThreader *det_threader) {
+  return DecodeUtteranceLatticeFasterTpl(
+      decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
+      determinize, allow_partial, alignment_writer, words_writer,
+      compact_lattice_writer, lattice_writer, like_ptr, det_threader);
+}
+
 // Takes care of output.  Returns true on success.
 bool DecodeUtteranceLatticeSimple(
     LatticeSimpleDecoder &decoder, // not const but is really an input.
@@ -389,6 +484,17 @@ bool DecodeUtteranceLatticeSimple(
 }
 
 
+// see comment in header.
+void SetUpImplicitSelfLoops(const ImplicitSelfLoopsConfig &config,
+                            const TransitionModel &trans_model,
+                            const fst::Fst<fst::StdArc> &fst,
+                            std::vector<ImplicitSelfLoop> *self_loops,
+                            LatticeFasterDecoder *decoder) {
+  if (!config.implicit_self_loops) return;
+  GetImplicitSelfLoops(trans_model, fst, config.self_loop_scale, self_loops);
+  decoder->SetImplicitSelfLoops(self_loops);
+}
+
 // see comment in header.
 void ModifyGraphForCarefulAlignment(
     fst::VectorFst<fst::StdArc> *fst) {
@@ -23,6 +23,8 @@
 #include "itf/options-itf.h"
 #include "decoder/lattice-faster-decoder.h"
 #include "decoder/lattice-simple-decoder.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "thread/kaldi-mutex.h"
 
 // This header contains declarations from various convenience functions that are called
 // from binary-level programs such as gmm-decode-faster.cc, gmm-align-compiled.cc, and
@@ -49,6 +51,36 @@ struct AlignConfig {
 };
 
 
+/// Options for decoding a graph made without self-loops (see add-self-loops
+/// --implicit), whose self-loops the decoder applies on the fly; see
+/// GetImplicitSelfLoops() and LatticeFasterDecoder::SetImplicitSelfLoops().
+struct ImplicitSelfLoopsConfig {
+  bool implicit_self_loops;
+  BaseFloat self_loop_scale;
+
+  ImplicitSelfLoopsConfig(): implicit_self_loops(false),
+                             self_loop_scale(0.1) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("implicit-self-loops", &implicit_self_loops, "If true, the "
+                 "graph has no self-loops (see add-self-loops --implicit) and "
+                 "the decoder applies them on the fly; --self-loop-scale must "
+                 "match the value used in graph creation.");
+    po->Register("self-loop-scale", &self_loop_scale, "Scale on self-loop "
+                 "probabilities; only used if --implicit-self-loops=true.");
+  }
+};
+
+/// If config.implicit_self_loops is true, works out the self-loops of "fst"
+/// into "self_loops" and tells "decoder" to use them; otherwise does nothing.
+/// "self_loops" must outlive the decoder's use of "fst".
+void SetUpImplicitSelfLoops(const ImplicitSelfLoopsConfig &config,
+                            const TransitionModel &trans_model,
+                            const fst::Fst<fst::StdArc> &fst,
+                            std::vector<ImplicitSelfLoop> *self_loops,
+                            LatticeFasterDecoder *decoder);
+
+
 /// AlignUtteranceWapper is a wrapper for alignment code used in training, that
 /// is called from many different binaries, e.g. gmm-align, gmm-align-compiled,
 /// sgmm-align, etc.  The writers for alignments and words will only be written
@@ -93,7 +125,10 @@ void ModifyGraphForCarefulAlignment(
 /// involves table readers and writers; we've just put it here as there is no
 /// other obvious place to put it.  If determinize == false, it writes to
 /// lattice_writer, else to compact_lattice_writer.  The writers for
-/// alignments and words will only be written to if they are open.
+/// alignments and words will only be written to if they are open.  If
+/// --determinize-num-threads is more than one, the lattice is determinized
+/// using the threads of "det_threader" if it is non-NULL (binaries keep one
+/// for all utterances), else of a temporary PersistentMultiThreader.
 bool DecodeUtteranceLatticeFaster(
     LatticeFasterDecoder &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
@@ -107,19 +142,77 @@ bool DecodeUtteranceLatticeFaster(
     Int32VectorWriter *words_writer,
     CompactLatticeWriter *compact_lattice_writer,
     LatticeWriter *lattice_writer,
-    double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
+    double *like_ptr,  // puts utterance's likelihood in like_ptr on success.
+    PersistentMultiThreader *det_threader = NULL);
+
+/// As DecodeUtteranceLatticeFaster(), but for LatticeBiglmFasterDecoder; used
+/// in gmm-latgen-biglm-faster and latgen-biglm-faster-mapped.
+bool DecodeUtteranceLatticeBiglmFaster(
+    LatticeBiglmFasterDecoder &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignments_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr,  // puts utterance's likelihood in like_ptr on success.
+    PersistentMultiThreader *det_threader = NULL);
+
+/// LatticeFasterDecoderPool is a thread-safe pool of decoders that all decode
+/// with the same graph and configuration; it is used in multi-threaded
+/// programs such as latgen-faster-mapped-parallel.  A decoder that has been
+/// returned keeps its hash table and its token and link storage, so reusing it
+/// for the next utterance saves the setup cost and the allocation and
+/// deallocation of that storage.  We create decoders on demand, so the number
+/// of decoders is the largest number ever in use at one time; if you get them
+/// in the tasks given to TaskSequencer, as DecodeUtteranceLatticeFasterClass
+/// does, that is at most the --num-threads option.
+class LatticeFasterDecoderPool {
+ public:
+  /// "fst" is not copied, so it must outlive this object.
+  LatticeFasterDecoderPool(const fst::Fst<fst::StdArc> &fst,
+                           const LatticeFasterDecoderConfig &config);
+
+  /// Gets a decoder from the pool, or creates one if none is free.  You
+  /// don't need to call InitDecoding() on it if you call Decode().
+  LatticeFasterDecoder *Get();
+
+  /// Gives "decoder", which must have been obtained from Get(), back to the
+  /// pool.
+  void Return(LatticeFasterDecoder *decoder);
+
+  /// Deletes the decoders; all of them must have been returned.
+  ~LatticeFasterDecoderPool();
+ private:
+  const fst::Fst<fst::StdArc> &fst_;
+  LatticeFasterDecoderConfig config_;
+  std::vector<LatticeFasterDecoder*> free_decoders_;
+  int32 num_in_use_;
+  Mutex mutex_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoderPool);
+};
 
 /// This class basically does the same job as the function
 /// DecodeUtteranceLatticeFaster, but in a way that allows us
 /// to build a multi-threaded command line program more easily,
 /// using code in ../thread/kaldi-task-sequence.h.  The main
-/// computation takes place in operator (), and the output happens
-/// in the destructor.
+/// computation takes place in operator (), which also gives the decoder
+/// back (to the pool, if there is one), and the output happens in the
+/// destructor.  Note: with --determinize-num-threads > 1, each task
+/// determinizes its lattice with a temporary PersistentMultiThreader.
 class DecodeUtteranceLatticeFasterClass {
  public:
   // Initializer sets various variables.
   // NOTE: we "take ownership" of "decoder" and "decodable".  These
-  // are deleted by the destructor.  On error, "num_err" is incremented.
+  // are deleted at the end of operator ().  If "decoder_pool" is non-NULL,
+  // "decoder" must be NULL: operator () then gets a decoder from the pool and
+  // gives it back when it is done, so that the pool only needs as many
+  // decoders as there are threads.  On error, "num_err" is incremented.
   DecodeUtteranceLatticeFasterClass(
       LatticeFasterDecoder *decoder,
       DecodableInterface *decodable,
@@ -137,10 +230,14 @@ class DecodeUtteranceLatticeFasterClass {
       int64 *frame_sum, // on success, adds #frames to this.
       int32 *num_done, // on success (including partial decode), increments this.
       int32 *num_err,  // on failure, increments this.
-      int32 *num_partial);  // If partial decode (final-state not reached), increments this.
+      int32 *num_partial,  // If partial decode (final-state not reached), increments this.
+      LatticeFasterDecoderPool *decoder_pool = NULL);
   void operator () (); // The decoding happens here.
   ~DecodeUtteranceLatticeFasterClass(); // Output happens here.
  private:
+  // Called from operator () on success; gets the best path and the lattice.
+  void ComputeOutput();
+
   // The following variables correspond to inputs:
   LatticeFasterDecoder *decoder_;
   DecodableInterface *decodable_;
@@ -159,11 +256,15 @@ class DecodeUtteranceLatticeFasterClass {
   int32 *num_done_;
   int32 *num_err_;
   int32 *num_partial_;
+  LatticeFasterDecoderPool *decoder_pool_;
 
   // The following variables are stored by the computation.
   bool computed_; // operator ()  was called.
   bool success_; // decoding succeeded (possibly partial)
   bool partial_; // decoding was partial.
+  std::vector<int32> alignment_; // Best path, if success_ == true.
+  std::vector<int32> words_;
+  LatticeWeight weight_;
   CompactLattice *clat_; // Stored output, if determinize_ == true.
   Lattice *lat_; // Stored output, if determinize_ == false.
 };
@@ -19,16 +19,21 @@
 // limitations under the License.
 
 #include "decoder/faster-decoder.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
 
 FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
                              const FasterDecoderOptions &opts):
-    fst_(fst), config_(opts), num_frames_decoded_(-1) {
+    fst_(fst), config_(opts), num_frames_decoded_(-1), stats_(NULL),
+    last_tok_cnt_(0) {
   KALDI_ASSERT(config_.hash_ratio >= 1.0);  // less doesn't make much sense.
   KALDI_ASSERT(config_.max_active > 1);
   KALDI_ASSERT(config_.min_active >= 0 && config_.min_active < config_.max_active);
+  config_.rtf_opts.Check();
+  KALDI_ASSERT(!config_.rtf_opts.Enabled() ||
+               config_.rtf_opts.min_max_active >= config_.min_active);
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
@@ -36,21 +41,23 @@ FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
 void FasterDecoder::InitDecoding() {
   // clean up from last time:
   ClearToks(toks_.Clear());
+  if (stats_ != NULL)
+    stats_->Reset();
+  beam_controller_.Configure(config_.rtf_opts, config_.beam,
+                             config_.max_active);
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   Arc dummy_arc(0, 0, Weight::One(), start_state);
   toks_.Insert(start_state, new Token(dummy_arc, NULL));
-  ProcessNonemitting(std::numeric_limits<float>::max());
   num_frames_decoded_ = 0;
+  ProcessNonemitting(std::numeric_limits<float>::max());
 }
 
 
 void FasterDecoder::Decode(DecodableInterface *decodable) {
   InitDecoding();
-  while (!decodable->IsLastFrame(num_frames_decoded_ - 1)) {
-    double weight_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(weight_cutoff);
-  }
+  while (!decodable->IsLastFrame(num_frames_decoded_ - 1))
+    DecodeFrame(decodable);
 }
 
 void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
@@ -67,11 +74,17 @@ void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
   if (max_num_frames >= 0)
     target_frames_decoded = std::min(target_frames_decoded,
                                      num_frames_decoded_ + max_num_frames);
-  while (num_frames_decoded_ < target_frames_decoded) {
-    // note: ProcessEmitting() increments num_frames_decoded_
-    double weight_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(weight_cutoff); 
-  }    
+  while (num_frames_decoded_ < target_frames_decoded)
+    DecodeFrame(decodable);
+}
+
+void FasterDecoder::DecodeFrame(DecodableInterface *decodable) {
+  Timer frame_timer;
+  // note: ProcessEmitting() increments num_frames_decoded_
+  double weight_cutoff = ProcessEmitting(decodable);
+  ProcessNonemitting(weight_cutoff);
+  if (beam_controller_.Enabled())
+    beam_controller_.FrameDone(frame_timer.Elapsed(), last_tok_cnt_);
 }
 
 
@@ -152,7 +165,12 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
                                 BaseFloat *adaptive_beam, Elem **best_elem) {
   double best_cost = std::numeric_limits<double>::infinity();
   size_t count = 0;
-  if (config_.max_active == std::numeric_limits<int32>::max() &&
+  // These are config_.beam and config_.max_active unless --target-rtf is set.
+  BaseFloat beam = (beam_controller_.Enabled() ? beam_controller_.Beam() :
+                    config_.beam);
+  int32 max_active = (beam_controller_.Enabled() ?
+                      beam_controller_.MaxActive() : config_.max_active);
+  if (max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
       double w = e->val->cost_;
@@ -162,8 +180,8 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
-    return best_cost + config_.beam;
+    if (adaptive_beam != NULL) *adaptive_beam = beam;
+    return best_cost + beam;
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -175,15 +193,15 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    double beam_cutoff = best_cost + config_.beam,
+    double beam_cutoff = best_cost + beam,
         min_active_cutoff = std::numeric_limits<double>::infinity(),
         max_active_cutoff = std::numeric_limits<double>::infinity();
     
-    if (tmp_array_.size() > static_cast<size_t>(config_.max_active)) {
+    if (tmp_array_.size() > static_cast<size_t>(max_active)) {
       std::nth_element(tmp_array_.begin(),
-                       tmp_array_.begin() + config_.max_active,
+                       tmp_array_.begin() + max_active,
                        tmp_array_.end());
-      max_active_cutoff = tmp_array_[config_.max_active];
+      max_active_cutoff = tmp_array_[max_active];
     }
     if (max_active_cutoff < beam_cutoff) { // max_active is tighter than beam.
       if (adaptive_beam)
@@ -195,8 +213,8 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
       else {
         std::nth_element(tmp_array_.begin(),
                          tmp_array_.begin() + config_.min_active,
-                         tmp_array_.size() > static_cast<size_t>(config_.max_active) ?
-                         tmp_array_.begin() + config_.max_active :
+                         tmp_array_.size() > static_cast<size_t>(max_active) ?
+                         tmp_array_.begin() + max_active :
                          tmp_array_.end());
         min_active_cutoff = tmp_array_[config_.min_active];
       }
@@ -206,7 +224,7 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
         *adaptive_beam = min_active_cutoff - best_cost + config_.beam_delta;
       return min_active_cutoff;
     } else {
-      *adaptive_beam = config_.beam;
+      *adaptive_beam = beam;
       return beam_cutoff;
     }
   }
@@ -227,9 +245,18 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   size_t tok_cnt;
   BaseFloat adaptive_beam;
   Elem *best_elem = NULL;
+  Timer timer;
   double weight_cutoff = GetCutoff(last_toks, &tok_cnt,
                                    &adaptive_beam, &best_elem);
+  last_tok_cnt_ = tok_cnt;
   KALDI_VLOG(3) << tok_cnt << " tokens active.";
+  if (stats_ != NULL) {
+    stats_->Add(frame, DecoderStats::kCutoffTime, timer.Elapsed());
+    timer.Reset();
+    stats_->Set(frame, DecoderStats::kTokensBeforePruning, tok_cnt);
+    stats_->Set(frame, DecoderStats::kAdaptiveBeam, adaptive_beam);
+  }
+  int32 num_toks_kept = 0, num_arcs = 0;  // only needed for stats_.
   PossiblyResizeHash(tok_cnt);  // This makes sure the hash is always big enough.
     
   // This is the cutoff we use after adding in the log-likes (i.e.
@@ -267,6 +294,7 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     Token *tok = e->val;
     if (tok->cost_ < weight_cutoff) {  // not pruned.
       // np++;
+      num_toks_kept++;
       KALDI_ASSERT(state == tok->arc_.nextstate);
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
            !aiter.Done();
@@ -276,6 +304,7 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
           BaseFloat ac_cost =  - decodable->LogLikelihood(frame, arc.ilabel);
           double new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
           if (new_weight < next_weight_cutoff) {  // not pruned..
+            num_arcs++;
             Token *new_tok = new Token(arc, ac_cost, tok);
             Elem *e_found = toks_.Find(arc.nextstate);
             if (new_weight + adaptive_beam < next_weight_cutoff)
@@ -298,6 +327,11 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     Token::TokenDelete(e->val);
     toks_.Delete(e);
   }
+  if (stats_ != NULL) {
+    stats_->Set(frame, DecoderStats::kTokensAfterPruning, num_toks_kept);
+    stats_->Add(frame, DecoderStats::kArcsExpanded, num_arcs);
+    stats_->Add(frame, DecoderStats::kEmittingTime, timer.Elapsed());
+  }
   num_frames_decoded_++;
   return next_weight_cutoff;
 }
@@ -305,12 +339,15 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
 // TODO: first time we go through this, could avoid using the queue.
 void FasterDecoder::ProcessNonemitting(double cutoff) {
   // Processes nonemitting arcs for one frame. 
+  Timer timer;
+  int32 num_iters = 0, num_arcs = 0;  // only needed for stats_.
   KALDI_ASSERT(queue_.empty());
   for (const Elem *e = toks_.GetList(); e != NULL;  e = e->tail)
     queue_.push_back(e->key);
   while (!queue_.empty()) {
     StateId state = queue_.back();
     queue_.pop_back();
+    num_iters++;
     Token *tok = toks_.Find(state)->val;  // would segfault if state not
     // in toks_ but this can't happen.
     if (tok->cost_ > cutoff) { // Don't bother processing successors.
@@ -326,6 +363,7 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
         if (new_tok->cost_ > cutoff) {  // prune
           Token::TokenDelete(new_tok);
         } else {
+          num_arcs++;
           Elem *e_found = toks_.Find(arc.nextstate);
           if (e_found == NULL) {
             toks_.Insert(arc.nextstate, new_tok);
@@ -343,6 +381,14 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
       }
     }
   }
+  // "frame" is the frame we just decoded, or -1 if we were called from
+  // InitDecoding(), which we don't record.
+  int32 frame = num_frames_decoded_ - 1;
+  if (stats_ != NULL && frame >= 0) {
+    stats_->Add(frame, DecoderStats::kEpsilonIterations, num_iters);
+    stats_->Add(frame, DecoderStats::kArcsExpanded, num_arcs);
+    stats_->Add(frame, DecoderStats::kNonemittingTime, timer.Elapsed());
+  }
 }
 
 void FasterDecoder::ClearToks(Elem *list) {
@@ -23,10 +23,12 @@
 
 #include "util/stl-utils.h"
 #include "itf/options-itf.h"
-#include "util/hash-list.h"
+#include "util/open-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
+#include "decoder/decoder-stats.h"
+#include "decoder/rtf-beam-controller.h"
 
 namespace kaldi {
 
@@ -36,6 +38,7 @@ struct FasterDecoderOptions {
   int32 min_active;
   BaseFloat beam_delta;
   BaseFloat hash_ratio;
+  RtfBeamControllerOptions rtf_opts;
   FasterDecoderOptions(): beam(16.0),
                           max_active(std::numeric_limits<int32>::max()),
                           min_active(20), // This decoder mostly used for
@@ -45,6 +48,7 @@ struct FasterDecoderOptions {
   void Register(OptionsItf *po, bool full) {  /// if "full", use obscure
     /// options too.
     /// Depends on program.
+    rtf_opts.Register(po);
     po->Register("beam", &beam, "Decoder beam");
     po->Register("max-active", &max_active, "Decoder max active states.");
     po->Register("min-active", &min_active,
@@ -69,6 +73,11 @@ class FasterDecoder {
                 const FasterDecoderOptions &config);
 
   void SetOptions(const FasterDecoderOptions &config) { config_ = config; }
+
+  /// If you call this with non-NULL "stats", the decoder records per-frame
+  /// statistics in it (see decoder-stats.h); it is cleared in InitDecoding().
+  /// The pointer is not owned here; call with NULL to stop.
+  void SetStats(DecoderStats *stats) { stats_ = stats; }
   
   ~FasterDecoder() { ClearToks(toks_.Clear()); }
 
@@ -146,7 +155,7 @@ class FasterDecoder {
 #endif
     }
   };
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef DecoderHashList<StateId, Token*>::Elem Elem;
 
 
   /// Gets the weight cutoff.  Also counts the active tokens.
@@ -163,10 +172,14 @@ class FasterDecoder {
   // TODO: first time we go through this, could avoid using the queue.
   void ProcessNonemitting(double cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.
-  HashList<StateId, Token*> toks_;
+  // Decodes one frame, for Decode() and AdvanceDecoding(); if --target-rtf is
+  // set, tells beam_controller_ how long it took.
+  void DecodeFrame(DecodableInterface *decodable);
+
+  // DecoderHashList is HashList or OpenHashList (see ../util/open-hash-list.h).
+  // It actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by StateId.
+  DecoderHashList<StateId, Token*> toks_;
   const fst::Fst<fst::StdArc> &fst_;
   FasterDecoderOptions config_;
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
@@ -176,6 +189,17 @@ class FasterDecoder {
   // Keep track of the number of frames decoded in the current file.
   int32 num_frames_decoded_;
 
+  // Set by SetStats(); normally NULL.
+  DecoderStats *stats_;
+
+  // If --target-rtf is set, supplies the beam and max-active used in
+  // GetCutoff().  Only InitDecoding() configures it, so OnlineFasterDecoder,
+  // which adjusts config_.beam itself, does not use it.
+  RtfBeamController beam_controller_;
+  // The number of tokens GetCutoff() saw on the last frame; for
+  // beam_controller_.
+  size_t last_tok_cnt_;
+
   // It might seem unclear why we call ClearToks(toks_.Clear()).
   // There are two separate cleanup tasks we need to do at when we start a new file.
   // one is to delete the Token objects in the list; the other is to delete
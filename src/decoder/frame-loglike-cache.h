@@ -0,0 +1,120 @@
+// decoder/frame-loglike-cache.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_FRAME_LOGLIKE_CACHE_H_
+#define KALDI_DECODER_FRAME_LOGLIKE_CACHE_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/decodable-itf.h"
+
+namespace kaldi {
+
+/** FrameLoglikeCache holds the log-likelihoods of the current frame, indexed
+    by the index (transition-id), for LatticeFasterDecoder and
+    LatticeFasterOnlineDecoder.  It can be filled in two ways:
+
+     - lazily, by LogLikelihood(), which asks the decodable object for each
+       index the first time it is needed on the frame.  The decoders use this
+       in their (single-threaded) arc-expansion loop, so no extra pass over
+       the arcs is needed to find out which indices will be used.
+
+     - in a batch: the caller calls Request() for each index as it goes
+       through the tokens, then Compute(), which gets them all with a single
+       DecodableInterface::LogLikelihoods() call; after that, Cached() may be
+       called concurrently from several threads.  The multi-threaded
+       expansion in LatticeFasterDecoder uses this, so the worker threads
+       never call into the decodable object.
+
+    An index passed to Request() has no value until Compute() is called; after
+    that, LogLikelihood() may be used for it too.
+*/
+class FrameLoglikeCache {
+ public:
+  FrameLoglikeCache(): decodable_(NULL), frame_(-1) { }
+
+  /// Forgets everything; call this when starting a new utterance, since frame
+  /// numbers start again from zero.
+  void Reset() {
+    std::fill(last_frame_.begin(), last_frame_.end(), -1);
+    frame_ = -1;
+  }
+
+  /// Starts a new frame; "frame" is the zero-based frame index as used by the
+  /// decodable object.
+  void NewFrame(DecodableInterface *decodable, int32 frame) {
+    decodable_ = decodable;
+    frame_ = frame;
+    size_t num_indices = decodable->NumIndices() + 1;  // indices are one-based.
+    if (last_frame_.size() < num_indices) {
+      last_frame_.resize(num_indices, -1);
+      loglikes_.resize(num_indices);
+    }
+    requested_.clear();
+  }
+
+  /// Returns the log-likelihood of "index" on the current frame, computing
+  /// it if this is the first time it has been asked for on this frame.
+  inline BaseFloat LogLikelihood(int32 index) {
+    KALDI_ASSERT(static_cast<size_t>(index) < last_frame_.size() &&
+                 "Likely graph/model mismatch");
+    if (last_frame_[index] != frame_) {
+      last_frame_[index] = frame_;
+      loglikes_[index] = decodable_->LogLikelihood(frame_, index);
+    }
+    return loglikes_[index];
+  }
+
+  /// Notes that "index" will be needed on this frame; see Compute().
+  inline void Request(int32 index) {
+    KALDI_ASSERT(static_cast<size_t>(index) < last_frame_.size() &&
+                 "Likely graph/model mismatch");
+    if (last_frame_[index] != frame_) {
+      last_frame_[index] = frame_;
+      requested_.push_back(index);
+    }
+  }
+
+  /// Gets the log-likelihoods of all the indices given to Request() since
+  /// NewFrame(), with one call to the decodable object.
+  void Compute() {
+    decodable_->LogLikelihoods(frame_, requested_, &batch_loglikes_);
+    KALDI_ASSERT(batch_loglikes_.size() == requested_.size());
+    for (size_t i = 0; i < requested_.size(); i++)
+      loglikes_[requested_[i]] = batch_loglikes_[i];
+  }
+
+  /// Returns a log-likelihood that was computed by Compute(); does not modify
+  /// anything, so it is safe to call from several threads.
+  inline BaseFloat Cached(int32 index) const { return loglikes_[index]; }
+
+ private:
+  DecodableInterface *decodable_;
+  int32 frame_;
+  std::vector<BaseFloat> loglikes_;  // loglikes, indexed by index.
+  std::vector<int32> last_frame_;  // for each index, the last frame on which
+                                   // it was computed or requested, or -1.
+  std::vector<int32> requested_;  // the indices given to Request().
+  std::vector<BaseFloat> batch_loglikes_;  // their loglikes, in that order.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FrameLoglikeCache);
+};
+
+}  // end namespace kaldi
+
+#endif  // KALDI_DECODER_FRAME_LOGLIKE_CACHE_H_
@@ -0,0 +1,76 @@
+// decoder/label-lookahead-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/label-lookahead.h"
+#include "fstext/rand-fst.h"
+
+namespace kaldi {
+
+// Shifts the costs of "fst" by the lookahead costs the way
+// LatticeBiglmFasterDecoder does: adds lookahead[t] - lookahead[s] to each arc
+// from s to t and subtracts lookahead[s] from the final-cost of s.
+void ApplyLookahead(const std::vector<BaseFloat> &lookahead,
+                    fst::VectorFst<fst::StdArc> *fst) {
+  using fst::StdArc;
+  for (StdArc::StateId s = 0; s < fst->NumStates(); s++) {
+    for (fst::MutableArcIterator<fst::VectorFst<StdArc> > aiter(fst, s);
+         !aiter.Done(); aiter.Next()) {
+      StdArc arc = aiter.Value();
+      arc.weight = StdArc::Weight(arc.weight.Value() +
+                                  lookahead[arc.nextstate] - lookahead[s]);
+      aiter.SetValue(arc);
+    }
+    if (fst->Final(s) != StdArc::Weight::Zero())
+      fst->SetFinal(s, StdArc::Weight(fst->Final(s).Value() - lookahead[s]));
+  }
+}
+
+// The lookahead must not change the cost of any complete path: the shifts
+// telescope, and the lookahead cost of the start state is zero.
+void TestLabelLookaheadKeepsPathCosts() {
+  using fst::StdArc;
+  fst::RandFstOptions opts;
+  opts.allow_empty = false;
+  opts.acyclic = true;  // the shifted costs may be negative.
+  fst::VectorFst<StdArc> *fst = fst::RandFst<StdArc>(opts);
+  std::vector<BaseFloat> label_costs(opts.n_syms);
+  for (size_t i = 0; i < label_costs.size(); i++)
+    label_costs[i] = 10.0 * RandUniform();
+
+  std::vector<BaseFloat> lookahead;
+  ComputeLabelLookahead(*fst, label_costs, &lookahead);
+  KALDI_ASSERT(lookahead.size() == static_cast<size_t>(fst->NumStates()) &&
+               lookahead[fst->Start()] == 0.0);
+
+  fst::VectorFst<StdArc> shifted(*fst);
+  ApplyLookahead(lookahead, &shifted);
+  KALDI_ASSERT(fst::RandEquivalent(*fst, shifted, 5/*paths*/, 0.01/*delta*/,
+                                   kaldi::Rand()/*seed*/,
+                                   100/*path length, max*/));
+  delete fst;
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++)
+    TestLabelLookaheadKeepsPathCosts();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,86 @@
+// decoder/label-lookahead.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <functional>
+#include <queue>
+#include "decoder/label-lookahead.h"
+
+namespace kaldi {
+
+void ComputeLabelLookahead(const fst::Fst<fst::StdArc> &fst,
+                           const std::vector<BaseFloat> &label_costs,
+                           std::vector<BaseFloat> *lookahead) {
+  typedef fst::StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  const BaseFloat infinity = std::numeric_limits<BaseFloat>::infinity();
+
+  StateId num_states = fst::CountStates(fst);
+  KALDI_ASSERT(fst.Start() != fst::kNoStateId);
+  // cost[s] is c(s) as in the header; to start with, just the minimum over
+  // the arcs leaving s that have output labels.
+  std::vector<BaseFloat> cost(num_states, infinity);
+  // The predecessors of each state via arcs with no output label.
+  std::vector<std::vector<StateId> > preds(num_states);
+  for (StateId s = 0; s < num_states; s++) {
+    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      Label olabel = arc.olabel;
+      if (olabel != 0) {
+        BaseFloat c = (static_cast<size_t>(olabel) < label_costs.size() ?
+                       label_costs[olabel] : 0.0);
+        cost[s] = std::min(cost[s], c);
+      } else if (arc.nextstate != s) {
+        preds[arc.nextstate].push_back(s);
+      }
+    }
+  }
+
+  // Propagate the costs backwards along arcs without output labels.  This is
+  // Dijkstra's algorithm with zero-cost edges, so each state is finalized the
+  // first time it is popped with its current cost.
+  typedef std::pair<BaseFloat, StateId> QueueElem;
+  std::priority_queue<QueueElem, std::vector<QueueElem>,
+                      std::greater<QueueElem> > queue;
+  for (StateId s = 0; s < num_states; s++)
+    if (cost[s] != infinity)
+      queue.push(QueueElem(cost[s], s));
+  while (!queue.empty()) {
+    QueueElem elem = queue.top();
+    queue.pop();
+    if (elem.first > cost[elem.second]) continue;  // stale entry.
+    const std::vector<StateId> &p = preds[elem.second];
+    for (size_t i = 0; i < p.size(); i++) {
+      if (cost[p[i]] > elem.first) {
+        cost[p[i]] = elem.first;
+        queue.push(QueueElem(elem.first, p[i]));
+      }
+    }
+  }
+
+  BaseFloat start_cost = cost[fst.Start()];
+  if (start_cost == infinity) start_cost = 0.0;
+  lookahead->resize(num_states);
+  for (StateId s = 0; s < num_states; s++)
+    (*lookahead)[s] = (cost[s] == infinity ? 0.0 : cost[s] - start_cost);
+}
+
+
+}  // namespace kaldi
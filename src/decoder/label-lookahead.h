@@ -0,0 +1,57 @@
+// decoder/label-lookahead.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LABEL_LOOKAHEAD_H_
+#define KALDI_DECODER_LABEL_LOOKAHEAD_H_
+
+#include <vector>
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+
+namespace kaldi {
+
+/**
+   Computes lookahead costs for the states of "fst", for use by
+   LatticeBiglmFasterDecoder::SetLookahead() when decoding with a graph that
+   does not contain the language model, such as HCL, which is composed with
+   the LM on the fly.  In such a graph, the LM cost of a word is only known
+   when we cross the arc with the word as its output label, which is too late
+   for effective pruning.
+
+   For each state s, let c(s) be the minimum of label_costs[w] over the output
+   labels w that can be reached from s by a path whose arcs (other than the
+   last) have no output labels; label_costs would normally be the unigram
+   costs of the words.  In a determinized HCL, the word labels are delayed
+   until the word is known, so c(s) is the cost of the best word with the
+   pronunciation prefix that led to s.  We output (*lookahead)[s] = c(s) -
+   c(start), or 0 for states from which no output label can be reached.  The
+   decoder adds (*lookahead)[t] - (*lookahead)[s] to the cost of each arc
+   from s to t and subtracts (*lookahead)[s] from the final-cost of s, which
+   does not change the cost of any complete path (but the graph costs of
+   the individual arcs of the lattice include the shifts).  Output labels
+   that are outside label_costs are taken to have zero cost.
+ */
+void ComputeLabelLookahead(const fst::Fst<fst::StdArc> &fst,
+                           const std::vector<BaseFloat> &label_costs,
+                           std::vector<BaseFloat> *lookahead);
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_LABEL_LOOKAHEAD_H_
@@ -43,6 +43,13 @@ typedef LatticeFasterDecoderConfig LatticeBiglmFasterDecoderConfig;
     DeterministicOnDemandFst follows through the epsilons in G for you
     (assuming G is a standard backoff language model) and makes it look
     like a determinized FST.
+
+    It can also be used without a difference LM, to decode with HCL (i.e. a
+    graph with no language model) composed on the fly with the full LM,
+    e.g. a ConstArpaLmDeterministicFst (see latgen-biglm-faster-mapped).  This
+    avoids building HCLG, which for large LMs may be impractical.  In that
+    case you should call SetLookahead(), so that LM costs are anticipated
+    before the word labels are crossed (see label-lookahead.h).
 */
 
 class LatticeBiglmFasterDecoder {
@@ -58,7 +65,7 @@ class LatticeBiglmFasterDecoder {
       const fst::Fst<fst::StdArc> &fst,      
       const LatticeBiglmFasterDecoderConfig &config,
       fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst):
-      fst_(fst), lm_diff_fst_(lm_diff_fst), config_(config),
+      fst_(fst), lm_diff_fst_(lm_diff_fst), lookahead_(NULL), config_(config),
       warned_noarc_(false), num_toks_(0) {
     config.Check();
     KALDI_ASSERT(fst.Start() != fst::kNoStateId &&
@@ -67,6 +74,16 @@ class LatticeBiglmFasterDecoder {
   }
   void SetOptions(const LatticeBiglmFasterDecoderConfig &config) { config_ = config; } 
   LatticeBiglmFasterDecoderConfig GetOptions() { return config_; } 
+
+  /// Sets lookahead costs, indexed by state of "fst", as computed by
+  /// ComputeLabelLookahead() in label-lookahead.h.  They make the decoder
+  /// prune using an estimate of the LM cost of the words that each token may
+  /// be about to output; they do not change the costs of complete paths,
+  /// but the graph costs of the individual lattice arcs include them.
+  /// The vector is not copied; call with NULL to turn this off.
+  void SetLookahead(const std::vector<BaseFloat> *lookahead) {
+    lookahead_ = lookahead;
+  }
   ~LatticeBiglmFasterDecoder() {
     DeleteElems(toks_.Clear());    
     ClearActiveTokens();
@@ -236,6 +253,11 @@ class LatticeBiglmFasterDecoder {
   static inline StateId PairToLmState(PairId state_pair) {
     return static_cast<StateId>(static_cast<uint32>(state_pair >> 32));
   }
+
+  // Returns the lookahead cost of "state" (see SetLookahead()), or zero.
+  inline BaseFloat LookaheadCost(StateId state) const {
+    return (lookahead_ == NULL ? 0.0 : (*lookahead_)[state]);
+  }
   
   struct Token;
   // ForwardLinks are the links from a token to a token on the next frame.
@@ -447,7 +469,7 @@ class LatticeBiglmFasterDecoder {
           lm_state = PairToLmState(state_pair);
       Token *tok = e->val;
       BaseFloat final_cost = fst_.Final(state).Value() +
-          lm_diff_fst_->Final(lm_state).Value();
+          lm_diff_fst_->Final(lm_state).Value() - LookaheadCost(state);
       tok_to_final_cost[tok] = final_cost;
       best_cost_final = std::min(best_cost_final, tok->tot_cost + final_cost);
       best_cost_nofinal = std::min(best_cost_nofinal, tok->tot_cost);
@@ -703,6 +725,7 @@ class LatticeBiglmFasterDecoder {
       StateId state = PairToState(state_pair), // state in "fst"
           lm_state = PairToLmState(state_pair);
       Token *tok = best_elem->val;
+      BaseFloat lookahead_cost = LookaheadCost(state);
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
@@ -711,7 +734,9 @@ class LatticeBiglmFasterDecoder {
           PropagateLm(lm_state, &arc); // may affect "arc.weight".
           // We don't need the return value (the new LM state).
           arc.weight = Times(arc.weight,
-                             Weight(-decodable->LogLikelihood(frame-1, arc.ilabel)));
+                             Weight(-decodable->LogLikelihood(frame-1, arc.ilabel)
+                                    + LookaheadCost(arc.nextstate)
+                                    - lookahead_cost));
           BaseFloat new_weight = arc.weight.Value() + tok->tot_cost;
           if (new_weight + adaptive_beam < next_cutoff)
             next_cutoff = new_weight + adaptive_beam;
@@ -729,6 +754,7 @@ class LatticeBiglmFasterDecoder {
           lm_state = PairToLmState(state_pair);
       Token *tok = e->val;
       if (tok->tot_cost <=  cur_cutoff) {
+        BaseFloat lookahead_cost = LookaheadCost(state);
         for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
              !aiter.Done();
              aiter.Next()) {
@@ -737,7 +763,8 @@ class LatticeBiglmFasterDecoder {
             Arc arc(arc_ref);
             StateId next_lm_state = PropagateLm(lm_state, &arc);
             BaseFloat ac_cost = -decodable->LogLikelihood(frame-1, arc.ilabel),
-                graph_cost = arc.weight.Value(),
+                graph_cost = arc.weight.Value() +
+                    LookaheadCost(arc.nextstate) - lookahead_cost,
                 cur_cost = tok->tot_cost,
                 tot_cost = cur_cost + ac_cost + graph_cost;
             if (tot_cost > next_cutoff) continue;
@@ -800,6 +827,7 @@ class LatticeBiglmFasterDecoder {
       // but since most states are emitting it's not a huge issue.
       tok->DeleteForwardLinks(); // necessary when re-visiting
       tok->links = NULL;
+      BaseFloat lookahead_cost = LookaheadCost(state);
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
           !aiter.Done();
           aiter.Next()) {
@@ -807,7 +835,8 @@ class LatticeBiglmFasterDecoder {
         if (arc_ref.ilabel == 0) {  // propagate nonemitting only...
           Arc arc(arc_ref);
           StateId next_lm_state = PropagateLm(lm_state, &arc);          
-          BaseFloat graph_cost = arc.weight.Value(),
+          BaseFloat graph_cost = arc.weight.Value() +
+              LookaheadCost(arc.nextstate) - lookahead_cost,
               tot_cost = cur_cost + graph_cost;
           if (tot_cost < cutoff) {
             bool changed;
@@ -840,6 +869,8 @@ class LatticeBiglmFasterDecoder {
   // make it class member to avoid internal new/delete.
   const fst::Fst<fst::StdArc> &fst_;
   fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst_;  
+  const std::vector<BaseFloat> *lookahead_;  // set by SetLookahead(); may be
+                                             // NULL.
   LatticeBiglmFasterDecoderConfig config_;
   bool warned_noarc_;  
   int32 num_toks_; // current total #toks allocated...
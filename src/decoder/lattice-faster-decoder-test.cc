@@ -0,0 +1,135 @@
+// decoder/lattice-faster-decoder-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/faster-decoder.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/rand-fst.h"
+#include "fstext/fstext-utils.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+// Returns a small random graph whose input labels are epsilon or in the range
+// [1, num_pdfs], with a self-loop on each state (as HCLG has) so that most
+// utterances can reach a final state.  Like HCLG it has no epsilon cycles,
+// which would give cycles in the lattice: input-epsilon arcs only go to
+// higher-numbered states.
+fst::VectorFst<fst::StdArc> *RandDecodingGraph(int32 num_pdfs) {
+  using fst::StdArc;
+  fst::RandFstOptions opts;
+  opts.n_syms = num_pdfs + 1;
+  opts.allow_empty = false;
+  fst::VectorFst<StdArc> *fst = fst::RandFst<StdArc>(opts);
+  for (StdArc::StateId s = 0; s < fst->NumStates(); s++) {
+    for (fst::MutableArcIterator<fst::VectorFst<StdArc> > aiter(fst, s);
+         !aiter.Done(); aiter.Next()) {
+      StdArc arc = aiter.Value();
+      if (arc.ilabel == 0 && arc.nextstate <= s) {
+        arc.ilabel = RandInt(1, num_pdfs);
+        aiter.SetValue(arc);
+      }
+    }
+  }
+  for (StdArc::StateId s = 0; s < fst->NumStates(); s++)
+    fst->AddArc(s, StdArc(RandInt(1, num_pdfs), 0, StdArc::Weight(0.5), s));
+  return fst;
+}
+
+BaseFloat PathCost(const Lattice &path) {
+  std::vector<int32> alignment, words;
+  LatticeWeight weight;
+  fst::GetLinearSymbolSequence(path, &alignment, &words, &weight);
+  return weight.Value1() + weight.Value2();
+}
+
+// With beams so wide that nothing is pruned, FasterDecoder and
+// LatticeFasterDecoder both do exact Viterbi decoding, so their best paths
+// must have the same cost.  Both keep their tokens in DecoderHashList, so this
+// also checks the decoders with OpenHashList when this directory is built with
+// -DKALDI_OPEN_HASH_LIST (see "make test_open_hash_list" in ../Makefile).
+void TestDecodersAgree() {
+  int32 num_pdfs = RandInt(1, 10);
+  fst::VectorFst<fst::StdArc> *fst = RandDecodingGraph(num_pdfs);
+  Matrix<BaseFloat> loglikes(RandInt(1, 20), num_pdfs + 1);
+  loglikes.SetRandn();
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+
+  FasterDecoderOptions faster_opts;
+  faster_opts.beam = 1000.0;
+  FasterDecoder faster_decoder(*fst, faster_opts);
+  faster_decoder.Decode(&decodable);
+
+  LatticeFasterDecoderConfig lat_config;
+  lat_config.beam = 1000.0;
+  LatticeFasterDecoder lat_decoder(*fst, lat_config);
+  lat_decoder.Decode(&decodable);
+
+  KALDI_ASSERT(faster_decoder.ReachedFinal() == lat_decoder.ReachedFinal());
+  Lattice faster_path, lat_path;
+  if (faster_decoder.GetBestPath(&faster_path)) {
+    KALDI_ASSERT(lat_decoder.GetBestPath(&lat_path));
+    KALDI_ASSERT(std::abs(PathCost(faster_path) - PathCost(lat_path)) < 0.01);
+  }
+  delete fst;
+}
+
+// The multi-threaded arc expansion (--decoder-num-threads) must give exactly
+// the same lattice as the single-threaded code.  We use beams that are narrow
+// enough for pruning to happen, and decode twice with each decoder so that the
+// reuse of its per-thread buffers is tested too.
+void TestMultiThreadedDecoding() {
+  int32 num_pdfs = RandInt(1, 10);
+  fst::VectorFst<fst::StdArc> *fst = RandDecodingGraph(num_pdfs);
+  LatticeFasterDecoderConfig config;
+  config.beam = RandInt(1, 8);
+  config.lattice_beam = RandInt(1, 4);
+  config.min_active = RandInt(0, 2);
+  if (RandInt(0, 1) == 0)
+    config.max_active = RandInt(2, 10);
+  LatticeFasterDecoder serial_decoder(*fst, config);
+  config.num_threads = RandInt(2, 4);
+  LatticeFasterDecoder threaded_decoder(*fst, config);
+
+  for (int32 i = 0; i < 2; i++) {
+    Matrix<BaseFloat> loglikes(RandInt(1, 20), num_pdfs + 1);
+    loglikes.SetRandn();
+    DecodableMatrixScaled decodable(loglikes, 1.0);
+    serial_decoder.Decode(&decodable);
+    threaded_decoder.Decode(&decodable);
+    KALDI_ASSERT(serial_decoder.NumFramesDecoded() ==
+                 threaded_decoder.NumFramesDecoded());
+    Lattice serial_lat, threaded_lat;
+    serial_decoder.GetRawLattice(&serial_lat);
+    threaded_decoder.GetRawLattice(&threaded_lat);
+    KALDI_ASSERT(fst::Equal(serial_lat, threaded_lat));
+  }
+  delete fst;
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    TestDecodersAgree();
+  for (int32 i = 0; i < 50; i++)
+    TestMultiThreadedDecoding();
+  std::cout << "Test OK.\n";
+}
@@ -26,13 +26,16 @@
 
 #include "decoder/lattice-faster-decoder.h"
 #include "lat/lattice-functions.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
 LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
                                            const LatticeFasterDecoderConfig &config):
-    fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
+    threader_(NULL), fst_(fst), delete_fst_(false), self_loops_(NULL),
+    state_visit_counts_(NULL), stats_(NULL), last_tok_cnt_(0), config_(config),
+    num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -40,7 +43,9 @@ LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
 
 LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
                                            fst::Fst<fst::StdArc> *fst):
-    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
+    threader_(NULL), fst_(*fst), delete_fst_(true), self_loops_(NULL),
+    state_visit_counts_(NULL), stats_(NULL), last_tok_cnt_(0), config_(config),
+    num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -49,6 +54,8 @@ LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &con
 LatticeFasterDecoder::~LatticeFasterDecoder() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
+  delete threader_;
+  DeletePointers(&workspaces_);
   if (delete_fst_) delete &(fst_);
 }
 
@@ -61,10 +68,34 @@ void LatticeFasterDecoder::InitDecoding() {
   num_toks_ = 0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  loglikes_.Reset();
+  beam_controller_.Configure(config_.rtf_opts, config_.beam,
+                             config_.max_active);
+  if (stats_ != NULL)
+    stats_->Reset();
+  if (state_visit_counts_ != NULL) {
+    // Size it once here so AccumulateStateVisits() never has to resize it.
+    // CountStates() is fast for ExpandedFsts, such as the normal graph types.
+    int32 num_states = fst::CountStates(fst_);
+    if (state_visit_counts_->Dim() < num_states)
+      state_visit_counts_->Resize(num_states, kCopyData);
+  }
+  if (config_.num_threads > 1) {
+    if (threader_ == NULL || threader_->NumThreads() != config_.num_threads) {
+      delete threader_;
+      threader_ = new PersistentMultiThreader(config_.num_threads);
+    }
+    while (workspaces_.size() < static_cast<size_t>(config_.num_threads))
+      workspaces_.push_back(new EmittingWorkspace);
+  } else {
+    delete threader_;
+    threader_ = NULL;
+  }
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+  Token *start_tok =
+      new (token_pool_.Allocate()) Token(0.0, 0.0, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -81,12 +112,8 @@ bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
   // terms of features), but note that the decodable object uses zero-based
   // numbering, which we have to correct for when we call it.
 
-  while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
-    if (NumFramesDecoded() % config_.prune_interval == 0)
-      PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
-  }
+  while (!decodable->IsLastFrame(NumFramesDecoded() - 1))
+    DecodeFrame(decodable);
   FinalizeDecoding();
 
   // Returns true if we have any kind of traceback available (not necessarily
@@ -241,7 +268,8 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+    Token *new_tok = new (token_pool_.Allocate())
+        Token(tot_cost, extra_cost, NULL, toks);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -314,7 +342,7 @@ void LatticeFasterDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -401,7 +429,7 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -460,7 +488,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_pool_.Free(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -474,6 +502,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
 void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
+  Timer timer;
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -500,6 +529,10 @@ void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
   }
   KALDI_VLOG(4) << "PruneActiveTokens: pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
+  // We attribute this to the frame we are about to decode.
+  if (stats_ != NULL)
+    stats_->Add(cur_frame_plus_one, DecoderStats::kPruningTime,
+                timer.Elapsed());
 }
 
 void LatticeFasterDecoder::ComputeFinalCosts(
@@ -517,7 +550,7 @@ void LatticeFasterDecoder::ComputeFinalCosts(
     StateId state = final_toks->key;
     Token *tok = final_toks->val;
     const Elem *next = final_toks->tail;
-    BaseFloat final_cost = fst_.Final(state).Value();
+    BaseFloat final_cost = fst_.Final(state).Value() + ForwardCost(state);
     BaseFloat cost = tok->tot_cost,
         cost_with_final = cost + final_cost;
     best_cost = std::min(cost, best_cost);
@@ -558,19 +591,26 @@ void LatticeFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
   if (max_num_frames >= 0)
     target_frames_decoded = std::min(target_frames_decoded,
                                      NumFramesDecoded() + max_num_frames);
-  while (NumFramesDecoded() < target_frames_decoded) {
-    if (NumFramesDecoded() % config_.prune_interval == 0) {
-      PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    }
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
-  }
+  while (NumFramesDecoded() < target_frames_decoded)
+    DecodeFrame(decodable);
+}
+
+void LatticeFasterDecoder::DecodeFrame(DecodableInterface *decodable) {
+  Timer frame_timer;
+  if (NumFramesDecoded() % config_.prune_interval == 0)
+    PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+  // note: ProcessEmitting() increments NumFramesDecoded().
+  BaseFloat cost_cutoff = ProcessEmitting(decodable);
+  ProcessNonemitting(cost_cutoff);
+  if (beam_controller_.Enabled())
+    beam_controller_.FrameDone(frame_timer.Elapsed(), last_tok_cnt_);
 }
 
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
 void LatticeFasterDecoder::FinalizeDecoding() {
+  Timer timer;
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -585,6 +625,9 @@ void LatticeFasterDecoder::FinalizeDecoding() {
   PruneTokensForFrame(0);
   KALDI_VLOG(4) << "pruned tokens from " << num_toks_begin
                 << " to " << num_toks_;
+  if (stats_ != NULL && final_frame_plus_one > 0)
+    stats_->Add(final_frame_plus_one - 1, DecoderStats::kPruningTime,
+                timer.Elapsed());
 }
 
 /// Gets the weight cutoff.  Also counts the active tokens.
@@ -593,7 +636,10 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
-  if (config_.max_active == std::numeric_limits<int32>::max() &&
+  // These are config_.beam and config_.max_active unless --target-rtf is set.
+  BaseFloat beam = beam_controller_.Beam();
+  int32 max_active = beam_controller_.MaxActive();
+  if (max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
       BaseFloat w = static_cast<BaseFloat>(e->val->tot_cost);
@@ -603,8 +649,8 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
-    return best_weight + config_.beam;
+    if (adaptive_beam != NULL) *adaptive_beam = beam;
+    return best_weight + beam;
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -617,18 +663,18 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
     }
     if (tok_count != NULL) *tok_count = count;
 
-    BaseFloat beam_cutoff = best_weight + config_.beam,
+    BaseFloat beam_cutoff = best_weight + beam,
         min_active_cutoff = std::numeric_limits<BaseFloat>::infinity(),
         max_active_cutoff = std::numeric_limits<BaseFloat>::infinity();
 
     KALDI_VLOG(6) << "Number of tokens active on frame " << NumFramesDecoded()
                   << " is " << tmp_array_.size();
     
-    if (tmp_array_.size() > static_cast<size_t>(config_.max_active)) {
+    if (tmp_array_.size() > static_cast<size_t>(max_active)) {
       std::nth_element(tmp_array_.begin(),
-                       tmp_array_.begin() + config_.max_active,
+                       tmp_array_.begin() + max_active,
                        tmp_array_.end());
-      max_active_cutoff = tmp_array_[config_.max_active];
+      max_active_cutoff = tmp_array_[max_active];
     }
     if (max_active_cutoff < beam_cutoff) { // max_active is tighter than beam.
       if (adaptive_beam)
@@ -640,8 +686,8 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
       else {
         std::nth_element(tmp_array_.begin(),
                          tmp_array_.begin() + config_.min_active,
-                         tmp_array_.size() > static_cast<size_t>(config_.max_active) ?
-                         tmp_array_.begin() + config_.max_active :
+                         tmp_array_.size() > static_cast<size_t>(max_active) ?
+                         tmp_array_.begin() + max_active :
                          tmp_array_.end());
         min_active_cutoff = tmp_array_[config_.min_active];
       }
@@ -651,12 +697,21 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
         *adaptive_beam = min_active_cutoff - best_weight + config_.beam_delta;
       return min_active_cutoff;
     } else {
-      *adaptive_beam = config_.beam;
+      *adaptive_beam = beam;
       return beam_cutoff;
     }
   }
 }
 
+void LatticeFasterDecoder::AccumulateStateVisits(const Elem *final_toks,
+                                                 BaseFloat cur_cutoff) {
+  Vector<double> &counts = *state_visit_counts_;
+  for (const Elem *e = final_toks; e != NULL; e = e->tail) {
+    if (e->val->tot_cost <= cur_cutoff)
+      counts(e->key) += 1.0;  // sized in InitDecoding().
+  }
+}
+
 BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
@@ -670,12 +725,34 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   Elem *best_elem = NULL;
   BaseFloat adaptive_beam;
   size_t tok_cnt;
+  Timer timer;
   BaseFloat cur_cutoff = GetCutoff(final_toks, &tok_cnt, &adaptive_beam, &best_elem);
+  last_tok_cnt_ = tok_cnt;
   KALDI_VLOG(6) << "Adaptive beam on frame " << NumFramesDecoded() << " is "
                 << adaptive_beam;
+  if (stats_ != NULL) {
+    stats_->Add(frame, DecoderStats::kCutoffTime, timer.Elapsed());
+    timer.Reset();
+    stats_->Set(frame, DecoderStats::kTokensBeforePruning, tok_cnt);
+    stats_->Set(frame, DecoderStats::kAdaptiveBeam, adaptive_beam);
+    size_t num_toks_kept = 0;
+    for (const Elem *e = final_toks; e != NULL; e = e->tail)
+      if (e->val->tot_cost <= cur_cutoff) num_toks_kept++;
+    stats_->Set(frame, DecoderStats::kTokensAfterPruning, num_toks_kept);
+  }
   
   PossiblyResizeHash(tok_cnt);  // This makes sure the hash is always big enough.
 
+  // In the single-threaded case the likelihoods are computed as they are
+  // first needed on this frame; in the multi-threaded case, all the ones we
+  // will need are computed here, at once.
+  loglikes_.NewFrame(decodable, frame);
+  if (threader_ != NULL)
+    CollectEmittingTokens(final_toks, cur_cutoff);
+
+  if (state_visit_counts_ != NULL)
+    AccumulateStateVisits(final_toks, cur_cutoff);
+
   BaseFloat next_cutoff = std::numeric_limits<BaseFloat>::infinity();
   // pruning "online" before having seen all tokens
 
@@ -689,19 +766,27 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     StateId state = best_elem->key;
     Token *tok = best_elem->val;
     cost_offset = - tok->tot_cost;
+    Weight forward_weight(ForwardCost(state));
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
       Arc arc = aiter.Value();
       if (arc.ilabel != 0) {  // propagate..
-        arc.weight = Times(arc.weight,
-                           Weight(cost_offset -
-                                  decodable->LogLikelihood(frame, arc.ilabel)));
+        arc.weight = Times(Times(arc.weight, forward_weight),
+                           Weight(cost_offset - loglikes_.LogLikelihood(arc.ilabel)));
         BaseFloat new_weight = arc.weight.Value() + tok->tot_cost;
         if (new_weight + adaptive_beam < next_cutoff)
           next_cutoff = new_weight + adaptive_beam;
       }
     }
+    Arc arc;
+    if (GetSelfLoop(state, &arc)) {
+      arc.weight = Times(arc.weight,
+                         Weight(cost_offset - loglikes_.LogLikelihood(arc.ilabel)));
+      BaseFloat new_weight = arc.weight.Value() + tok->tot_cost;
+      if (new_weight + adaptive_beam < next_cutoff)
+        next_cutoff = new_weight + adaptive_beam;
+    }
   }
 
   // Store the offset on the acoustic likelihoods that we're applying.
@@ -710,6 +795,20 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   cost_offsets_.resize(frame + 1, 0.0);
   cost_offsets_[frame] = cost_offset;
 
+  int32 num_arcs = 0;  // number of arcs within the beam; only for stats_.
+
+  if (threader_ != NULL) {
+    // Multi-threaded version of the loop below; the result is the same.
+    num_arcs = ExpandEmittingArcs(frame, cost_offset, adaptive_beam,
+                                  &next_cutoff);
+    DeleteElems(final_toks);
+    if (stats_ != NULL) {
+      stats_->Add(frame, DecoderStats::kArcsExpanded, num_arcs);
+      stats_->Add(frame, DecoderStats::kEmittingTime, timer.Elapsed());
+    }
+    return next_cutoff;
+  }
+
   // the tokens are now owned here, in final_toks, and the hash is empty.
   // 'owned' is a complex thing here; the point is we need to call DeleteElem
   // on each elem 'e' to let toks_ know we're done with them.
@@ -718,37 +817,361 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     StateId state = e->key;
     Token *tok = e->val;
     if (tok->tot_cost <= cur_cutoff) {
+      BaseFloat forward_cost = ForwardCost(state);
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
         const Arc &arc = aiter.Value();
-        if (arc.ilabel != 0) {  // propagate..
-          BaseFloat ac_cost = cost_offset -
-              decodable->LogLikelihood(frame, arc.ilabel),
-              graph_cost = arc.weight.Value(),
-              cur_cost = tok->tot_cost,
-              tot_cost = cur_cost + ac_cost + graph_cost;
-          if (tot_cost > next_cutoff) continue;
-          else if (tot_cost + adaptive_beam < next_cutoff)
-            next_cutoff = tot_cost + adaptive_beam; // prune by best current token
-          // Note: the frame indexes into active_toks_ are one-based,
-          // hence the + 1.
-          Token *next_tok = FindOrAddToken(arc.nextstate,
-                                           frame + 1, tot_cost, NULL);
-          // NULL: no change indicator needed
-
-          // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
-        }
+        if (arc.ilabel != 0 &&  // propagate..
+            PropagateEmitting(tok, frame, arc,
+                              arc.weight.Value() + forward_cost, cost_offset,
+                              adaptive_beam, &next_cutoff))
+          num_arcs++;
       } // for all arcs
+      // The implicit self-loop, if any, comes after the other arcs, as it
+      // would in a graph with self-loops added by AddSelfLoops().
+      Arc self_loop;
+      if (GetSelfLoop(state, &self_loop) &&
+          PropagateEmitting(tok, frame, self_loop, self_loop.weight.Value(),
+                            cost_offset, adaptive_beam, &next_cutoff))
+        num_arcs++;
     }
     e_tail = e->tail;
     toks_.Delete(e); // delete Elem
   }
+  if (stats_ != NULL) {
+    stats_->Add(frame, DecoderStats::kArcsExpanded, num_arcs);
+    stats_->Add(frame, DecoderStats::kEmittingTime, timer.Elapsed());
+  }
   return next_cutoff;
 }
 
+inline bool LatticeFasterDecoder::PropagateEmitting(Token *tok, int32 frame,
+                                                    const Arc &arc,
+                                                    BaseFloat graph_cost,
+                                                    BaseFloat cost_offset,
+                                                    BaseFloat adaptive_beam,
+                                                    BaseFloat *next_cutoff) {
+  BaseFloat ac_cost = cost_offset - loglikes_.LogLikelihood(arc.ilabel),
+      cur_cost = tok->tot_cost,
+      tot_cost = cur_cost + ac_cost + graph_cost;
+  if (tot_cost > *next_cutoff) return false;
+  else if (tot_cost + adaptive_beam < *next_cutoff)
+    *next_cutoff = tot_cost + adaptive_beam; // prune by best current token
+  // Note: the frame indexes into active_toks_ are one-based,
+  // hence the + 1.
+  Token *next_tok = FindOrAddToken(arc.nextstate,
+                                   frame + 1, tot_cost, NULL);
+  // NULL: no change indicator needed
+
+  // Add ForwardLink from tok to next_tok (put on head of list tok->links)
+  tok->links = new (link_pool_.Allocate())
+      ForwardLink(next_tok, arc.ilabel, arc.olabel, graph_cost,
+                  ac_cost, tok->links);
+  return true;
+}
+
+// This does one stage of the multi-threaded version of ProcessEmitting(); see
+// the comments for CollectEmittingTokens() and ExpandEmittingArcs().
+class LatticeFasterDecoder::EmittingJob: public PersistentMultiThreader::Job {
+ public:
+  enum Stage {
+    kRequestLoglikes,  // find the indices needed, for each block.
+    kExpandArcs,  // expand the emitting arcs of each block.
+    kPruneArcs,  // apply the exact cutoff, and sort the arcs by owner.
+    kFindTokens,  // work out the new tokens that each thread owns.
+    kAddLinks  // add the ForwardLinks out of the tokens of each block.
+  };
+
+  EmittingJob(LatticeFasterDecoder *decoder, BaseFloat cost_offset,
+              BaseFloat adaptive_beam, BaseFloat next_cutoff):
+      decoder_(decoder), stage_(kRequestLoglikes), cost_offset_(cost_offset),
+      adaptive_beam_(adaptive_beam), next_cutoff_(next_cutoff) { }
+
+  void SetStage(Stage stage) { stage_ = stage; }
+
+  typedef DecoderHashList<StateId, int32>::Elem IndexElem;
+
+  void operator() (int32 thread_id, int32 num_threads) {
+    EmittingWorkspace *workspace = decoder_->workspaces_[thread_id];
+    switch (stage_) {
+      case kRequestLoglikes:
+        RequestLoglikes(thread_id, num_threads, workspace); break;
+      case kExpandArcs:
+        ExpandArcs(thread_id, num_threads, workspace); break;
+      case kPruneArcs:
+        PruneArcs(thread_id, num_threads, workspace); break;
+      case kFindTokens:
+        FindTokens(thread_id, num_threads, workspace); break;
+      case kAddLinks:
+        AddLinks(num_threads, workspace); break;
+    }
+  }
+ private:
+  // Gets the range of expand_toks_ that this thread expands.
+  void GetBlock(int32 thread_id, int32 num_threads,
+                size_t *start, size_t *end) const {
+    size_t num_toks = decoder_->expand_toks_.size(),
+        block_size = (num_toks + num_threads - 1) / num_threads;
+    *start = std::min(num_toks, block_size * thread_id);
+    *end = std::min(num_toks, *start + block_size);
+  }
+
+  inline void Request(Label ilabel, EmittingWorkspace *workspace) {
+    std::vector<char> &is_requested = workspace->is_requested;
+    if (static_cast<size_t>(ilabel) >= is_requested.size())
+      is_requested.resize(ilabel + 1, 0);
+    if (!is_requested[ilabel]) {
+      is_requested[ilabel] = 1;
+      workspace->requested.push_back(ilabel);
+    }
+  }
+
+  void RequestLoglikes(int32 thread_id, int32 num_threads,
+                       EmittingWorkspace *workspace) {
+    for (size_t i = 0; i < workspace->requested.size(); i++)
+      workspace->is_requested[workspace->requested[i]] = 0;
+    workspace->requested.clear();
+    size_t start, end;
+    GetBlock(thread_id, num_threads, &start, &end);
+    for (size_t i = start; i < end; i++) {
+      StateId state = decoder_->expand_toks_[i].first;
+      for (fst::ArcIterator<fst::Fst<Arc> > aiter(decoder_->fst_, state);
+           !aiter.Done();
+           aiter.Next()) {
+        Label ilabel = aiter.Value().ilabel;
+        if (ilabel != 0)
+          Request(ilabel, workspace);
+      }
+      Arc self_loop;
+      if (decoder_->GetSelfLoop(state, &self_loop))
+        Request(self_loop.ilabel, workspace);
+    }
+  }
+
+  // This is the same as the loop in ProcessEmitting(), except that
+  // next_cutoff only takes account of arcs seen by this thread.
+  void ExpandArcs(int32 thread_id, int32 num_threads,
+                  EmittingWorkspace *workspace) {
+    const FrameLoglikeCache &loglikes = decoder_->loglikes_;
+    workspace->arcs.clear();
+    BaseFloat next_cutoff = next_cutoff_;
+    size_t start, end;
+    GetBlock(thread_id, num_threads, &start, &end);
+    for (size_t i = start; i < end; i++) {
+      StateId state = decoder_->expand_toks_[i].first;
+      Token *tok = decoder_->expand_toks_[i].second;
+      BaseFloat forward_cost = decoder_->ForwardCost(state);
+      for (fst::ArcIterator<fst::Fst<Arc> > aiter(decoder_->fst_, state);
+           !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc = aiter.Value();
+        if (arc.ilabel != 0)
+          Expand(tok, arc, arc.weight.Value() + forward_cost, loglikes,
+                 &next_cutoff, &(workspace->arcs));
+      }
+      Arc self_loop;
+      if (decoder_->GetSelfLoop(state, &self_loop))
+        Expand(tok, self_loop, self_loop.weight.Value(), loglikes,
+               &next_cutoff, &(workspace->arcs));
+    }
+    workspace->next_cutoff = next_cutoff;
+  }
+
+  inline void Expand(Token *tok, const Arc &arc, BaseFloat graph_cost,
+                     const FrameLoglikeCache &loglikes,
+                     BaseFloat *next_cutoff,
+                     std::vector<ExpandedArc> *arcs) {
+    BaseFloat ac_cost = cost_offset_ - loglikes.Cached(arc.ilabel),
+        cur_cost = tok->tot_cost,
+        tot_cost = cur_cost + ac_cost + graph_cost;
+    if (tot_cost > *next_cutoff) return;
+    else if (tot_cost + adaptive_beam_ < *next_cutoff)
+      *next_cutoff = tot_cost + adaptive_beam_;
+    ExpandedArc expanded_arc;
+    expanded_arc.source = tok;
+    expanded_arc.nextstate = arc.nextstate;
+    expanded_arc.ilabel = arc.ilabel;
+    expanded_arc.olabel = arc.olabel;
+    expanded_arc.graph_cost = graph_cost;
+    expanded_arc.ac_cost = ac_cost;
+    expanded_arc.tot_cost = tot_cost;
+    expanded_arc.next_tok = -1;
+    arcs->push_back(expanded_arc);
+  }
+
+  // An arc the single-threaded code would prune can only lower next_cutoff
+  // to a value above the one it already had, so the cutoff it has at the
+  // start of this thread's block is just the lowest of the cutoffs the
+  // earlier blocks finished with.
+  void PruneArcs(int32 thread_id, int32 num_threads,
+                 EmittingWorkspace *workspace) {
+    BaseFloat next_cutoff = next_cutoff_;
+    for (int32 t = 0; t < thread_id; t++)
+      next_cutoff = std::min(next_cutoff,
+                             decoder_->workspaces_[t]->next_cutoff);
+    std::vector<ExpandedArc> &arcs = workspace->arcs;
+    std::vector<std::vector<int32> > &arcs_by_dest = workspace->arcs_by_dest;
+    arcs_by_dest.resize(num_threads);
+    for (int32 t = 0; t < num_threads; t++)
+      arcs_by_dest[t].clear();
+    size_t num_kept = 0;
+    for (size_t i = 0; i < arcs.size(); i++) {
+      const ExpandedArc &arc = arcs[i];
+      if (arc.tot_cost > next_cutoff) continue;
+      else if (arc.tot_cost + adaptive_beam_ < next_cutoff)
+        next_cutoff = arc.tot_cost + adaptive_beam_;
+      arcs_by_dest[DestinationThread(arc.nextstate, num_threads)].push_back(
+          num_kept);
+      arcs[num_kept++] = arc;
+    }
+    arcs.resize(num_kept);
+  }
+
+  // Goes through the arcs to the states this thread owns in the order the
+  // single-threaded code would, doing what FindOrAddToken() would do.
+  void FindTokens(int32 thread_id, int32 num_threads,
+                  EmittingWorkspace *workspace) {
+    std::vector<NewToken> &new_toks = workspace->new_toks;
+    DecoderHashList<StateId, int32> &new_tok_index = workspace->new_tok_index;
+    new_toks.clear();
+    // This is like PossiblyResizeHash(); the + 1 is because HashList can't
+    // have size zero.
+    size_t hash_size = 1 + static_cast<size_t>(
+        decoder_->config_.hash_ratio * decoder_->expand_toks_.size() /
+        num_threads);
+    if (hash_size > new_tok_index.Size())
+      new_tok_index.SetSize(hash_size);
+    for (int32 t = 0; t < num_threads; t++) {
+      std::vector<ExpandedArc> &arcs = decoder_->workspaces_[t]->arcs;
+      const std::vector<int32> &indexes =
+          decoder_->workspaces_[t]->arcs_by_dest[thread_id];
+      for (size_t i = 0; i < indexes.size(); i++) {
+        ExpandedArc &arc = arcs[indexes[i]];
+        IndexElem *e = new_tok_index.Find(arc.nextstate);
+        if (e == NULL) {
+          NewToken new_tok;
+          new_tok.state = arc.nextstate;
+          new_tok.tot_cost = arc.tot_cost;
+          new_tok.first_thread = t;
+          new_tok.first_arc = indexes[i];
+          new_tok.tok = NULL;
+          arc.next_tok = new_toks.size();
+          new_tok_index.Insert(arc.nextstate, arc.next_tok);
+          new_toks.push_back(new_tok);
+        } else {
+          arc.next_tok = e->val;
+          if (new_toks[e->val].tot_cost > arc.tot_cost)
+            new_toks[e->val].tot_cost = arc.tot_cost;
+        }
+      }
+    }
+    for (IndexElem *e = new_tok_index.Clear(), *e_tail; e != NULL; e = e_tail) {
+      e_tail = e->tail;
+      new_tok_index.Delete(e);
+    }
+  }
+
+  void AddLinks(int32 num_threads, EmittingWorkspace *workspace) {
+    const std::vector<ExpandedArc> &arcs = workspace->arcs;
+    for (size_t i = 0; i < arcs.size(); i++) {
+      const ExpandedArc &arc = arcs[i];
+      Token *next_tok = decoder_->workspaces_[
+          DestinationThread(arc.nextstate, num_threads)]->new_toks[
+              arc.next_tok].tok;
+      Token *tok = arc.source;
+      tok->links = new (workspace->link_memory[i])
+          ForwardLink(next_tok, arc.ilabel, arc.olabel, arc.graph_cost,
+                      arc.ac_cost, tok->links);
+    }
+  }
+
+  LatticeFasterDecoder *decoder_;
+  Stage stage_;
+  BaseFloat cost_offset_;
+  BaseFloat adaptive_beam_;
+  BaseFloat next_cutoff_;
+};
+
+void LatticeFasterDecoder::CollectEmittingTokens(const Elem *final_toks,
+                                                 BaseFloat cur_cutoff) {
+  expand_toks_.clear();
+  for (const Elem *e = final_toks; e != NULL; e = e->tail)
+    if (e->val->tot_cost <= cur_cutoff)
+      expand_toks_.push_back(std::make_pair(e->key, e->val));
+  EmittingJob job(this, 0.0, 0.0, 0.0);
+  job.SetStage(EmittingJob::kRequestLoglikes);
+  threader_->Run(&job);
+  // Each thread's list has no repeats, so this is at most num_threads times
+  // the number of distinct indices.
+  for (int32 t = 0; t < threader_->NumThreads(); t++) {
+    const std::vector<int32> &requested = workspaces_[t]->requested;
+    for (size_t i = 0; i < requested.size(); i++)
+      loglikes_.Request(requested[i]);
+  }
+  loglikes_.Compute();
+}
+
+int32 LatticeFasterDecoder::ExpandEmittingArcs(int32 frame,
+                                               BaseFloat cost_offset,
+                                               BaseFloat adaptive_beam,
+                                               BaseFloat *next_cutoff) {
+  int32 num_threads = threader_->NumThreads();
+  KALDI_ASSERT(workspaces_.size() >= static_cast<size_t>(num_threads));
+  EmittingJob job(this, cost_offset, adaptive_beam, *next_cutoff);
+  job.SetStage(EmittingJob::kExpandArcs);
+  threader_->Run(&job);
+  job.SetStage(EmittingJob::kPruneArcs);
+  threader_->Run(&job);
+  job.SetStage(EmittingJob::kFindTokens);
+  threader_->Run(&job);
+
+  // Create the Tokens in the order in which the single-threaded code would
+  // have reached them, i.e. in order of their first arc.  The pools are not
+  // thread-safe, so we also get the memory for the ForwardLinks here.
+  Token *&toks = active_toks_[frame + 1].toks;
+  std::vector<size_t> next_new_tok(num_threads, 0);
+  while (true) {
+    int32 best_thread = -1;
+    const NewToken *best_new_tok = NULL;
+    for (int32 t = 0; t < num_threads; t++) {
+      const std::vector<NewToken> &new_toks = workspaces_[t]->new_toks;
+      if (next_new_tok[t] == new_toks.size()) continue;
+      const NewToken &new_tok = new_toks[next_new_tok[t]];
+      if (best_new_tok == NULL ||
+          new_tok.first_thread < best_new_tok->first_thread ||
+          (new_tok.first_thread == best_new_tok->first_thread &&
+           new_tok.first_arc < best_new_tok->first_arc)) {
+        best_thread = t;
+        best_new_tok = &new_tok;
+      }
+    }
+    if (best_thread == -1) break;
+    NewToken &new_tok =
+        workspaces_[best_thread]->new_toks[next_new_tok[best_thread]++];
+    new_tok.tok = new (token_pool_.Allocate())
+        Token(new_tok.tot_cost, 0.0, NULL, toks);
+    toks = new_tok.tok;
+    num_toks_++;
+    toks_.Insert(new_tok.state, new_tok.tok);
+  }
+  int32 num_arcs = 0;
+  for (int32 t = 0; t < num_threads; t++) {
+    EmittingWorkspace *workspace = workspaces_[t];
+    size_t n = workspace->arcs.size();
+    workspace->link_memory.resize(n);
+    for (size_t i = 0; i < n; i++)
+      workspace->link_memory[i] = link_pool_.Allocate();
+    num_arcs += n;
+    // The cutoff for ProcessNonemitting() is the one after all the blocks.
+    *next_cutoff = std::min(*next_cutoff, workspace->next_cutoff);
+  }
+
+  job.SetStage(EmittingJob::kAddLinks);
+  threader_->Run(&job);
+  return num_arcs;
+}
+
 void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
@@ -762,6 +1185,8 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
   // but in the baseline code, turning this vector into a set to fix this
   // problem did not improve overall speed.
   
+  Timer timer;
+  int32 num_iters = 0, num_arcs = 0;  // only needed for stats_.
   KALDI_ASSERT(queue_.empty());
   for (const Elem *e = toks_.GetList(); e != NULL;  e = e->tail)
     queue_.push_back(e->key);
@@ -775,6 +1200,7 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
   while (!queue_.empty()) {
     StateId state = queue_.back();
     queue_.pop_back();
+    num_iters++;
 
     Token *tok = toks_.Find(state)->val;  // would segfault if state not in toks_ but this can't happen.
     BaseFloat cur_cost = tok->tot_cost;
@@ -784,14 +1210,15 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
+    tok->DeleteForwardLinks(&link_pool_); // necessary when re-visiting
     tok->links = NULL;
+    BaseFloat forward_cost = ForwardCost(state);
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel == 0) {  // propagate nonemitting only...
-        BaseFloat graph_cost = arc.weight.Value(),
+        BaseFloat graph_cost = arc.weight.Value() + forward_cost,
             tot_cost = cur_cost + graph_cost;
         if (tot_cost < cutoff) {
           bool changed;
@@ -799,8 +1226,9 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = new (link_pool_.Allocate())
+              ForwardLink(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
+          num_arcs++;
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -809,6 +1237,12 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
       }
     } // for all arcs
   } // while queue not empty
+  // frame == -1 is the initial call from InitDecoding(); we don't record it.
+  if (stats_ != NULL && frame >= 0) {
+    stats_->Add(frame, DecoderStats::kEpsilonIterations, num_iters);
+    stats_->Add(frame, DecoderStats::kArcsExpanded, num_arcs);
+    stats_->Add(frame, DecoderStats::kNonemittingTime, timer.Elapsed());
+  }
 }
 
 
@@ -820,19 +1254,22 @@ void LatticeFasterDecoder::DeleteElems(Elem *list) {
 }
 
 void LatticeFasterDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
-    }
+  // All Tokens and ForwardLinks live in token_pool_ and link_pool_, so rather
+  // than deleting them one by one we release them all at once.
+  KALDI_ASSERT(token_pool_.NumInUse() == static_cast<size_t>(num_toks_));
+  if (!active_toks_.empty()) {
+    KALDI_VLOG(3) << "Peak arena size was " << token_pool_.PeakNumInUse()
+                  << " tokens and " << link_pool_.PeakNumInUse()
+                  << " forward links ("
+                  << (token_pool_.PeakMemoryInUse() +
+                      link_pool_.PeakMemoryInUse()) / 1024 << " KB)";
   }
+  token_pool_.FreeAll();
+  link_pool_.FreeAll();
+  token_pool_.ResetPeak();
+  link_pool_.ResetPeak();
   active_toks_.clear();
-  KALDI_ASSERT(num_toks_ == 0);
+  num_toks_ = 0;
 }
 
 // static
@@ -28,12 +28,19 @@
 
 
 #include "util/stl-utils.h"
-#include "util/hash-list.h"
+#include "util/open-hash-list.h"
+#include "util/memory-pool.h"
+#include "thread/kaldi-thread.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
+#include "hmm/hmm-utils.h"
+#include "matrix/kaldi-vector.h"
 #include "fstext/fstext-lib.h"
 #include "lat/determinize-lattice-pruned.h"
 #include "lat/kaldi-lattice.h"
+#include "decoder/decoder-stats.h"
+#include "decoder/frame-loglike-cache.h"
+#include "decoder/rtf-beam-controller.h"
 
 namespace kaldi {
 
@@ -47,6 +54,9 @@ struct LatticeFasterDecoderConfig {
                             // command-line program.
   BaseFloat beam_delta; // has nothing to do with beam_ratio
   BaseFloat hash_ratio;
+  int32 num_threads;
+  int32 determinize_period;
+  int32 determinize_delay;
   BaseFloat prune_scale;   // Note: we don't make this configurable on the command line,
                            // it's not a very important parameter.  It affects the
                            // algorithm that prunes the tokens as we go.
@@ -54,6 +64,9 @@ struct LatticeFasterDecoderConfig {
   // LatticeFasterDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeFaster.
   fst::DeterminizeLatticePhonePrunedOptions det_opts;
+  // Options for adjusting the beam and max-active to a target real-time factor
+  // (see rtf-beam-controller.h); disabled by default.
+  RtfBeamControllerOptions rtf_opts;
   
   LatticeFasterDecoderConfig(): beam(16.0),
                                 max_active(std::numeric_limits<int32>::max()),
@@ -63,9 +76,13 @@ struct LatticeFasterDecoderConfig {
                                 determinize_lattice(true),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
+                                num_threads(1),
+                                determinize_period(0),
+                                determinize_delay(25),
                                 prune_scale(0.1) { }
   void Register(OptionsItf *po) {
     det_opts.Register(po);
+    rtf_opts.Register(po);
     po->Register("beam", &beam, "Decoding beam.");
     po->Register("max-active", &max_active, "Decoder max active states.");
     po->Register("min-active", &min_active, "Decoder minimum #active states.");
@@ -80,11 +97,29 @@ struct LatticeFasterDecoderConfig {
                  "max-active constraint is applied.  Larger is more accurate.");
     po->Register("hash-ratio", &hash_ratio, "Setting used in decoder to control"
                  " hash behavior");
+    po->Register("decoder-num-threads", &num_threads, "Number of threads used "
+                 "to expand emitting arcs within a single utterance.  The "
+                 "output is identical to the single-threaded case.  Do not use "
+                 "this if the graph is computed on demand.  Currently only "
+                 "supported by LatticeFasterDecoder.");
+    po->Register("determinize-period", &determinize_period, "If >0, "
+                 "determinize the lattice incrementally during decoding, in "
+                 "chunks of this many frames, so that little is left to do at "
+                 "the end of the utterance.  Currently only supported by "
+                 "LatticeFasterOnlineDecoder.");
+    po->Register("determinize-delay", &determinize_delay, "With "
+                 "--determinize-period, the number of most recent frames that "
+                 "are not determinized yet because they may still be pruned.");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
                  && prune_interval > 0 && beam_delta > 0.0 && hash_ratio >= 1.0
+                 && num_threads >= 1 && determinize_period >= 0
+                 && determinize_delay >= 0
                  && prune_scale > 0.0 && prune_scale < 1.0);
+    rtf_opts.Check();
+    // We must not reduce max-active below min-active.
+    KALDI_ASSERT(!rtf_opts.Enabled() || rtf_opts.min_max_active >= min_active);
   }
 };
 
@@ -117,6 +152,37 @@ class LatticeFasterDecoder {
   const LatticeFasterDecoderConfig &GetOptions() const {
     return config_;
   }
+
+  /// Makes the decoder apply the self-loops and forward-transition costs on
+  /// the fly, so that it can decode a graph built without self-loops (about
+  /// half the size); see GetImplicitSelfLoops() in ../hmm/hmm-utils.h.  The
+  /// output is the same as decoding the graph with the self-loops added.
+  /// "self_loops" is indexed by graph state; it is not copied, so it must
+  /// outlive this object, and must have been computed for the graph this
+  /// decoder was constructed with.  Call with NULL to turn this off.
+  void SetImplicitSelfLoops(const std::vector<ImplicitSelfLoop> *self_loops) {
+    KALDI_ASSERT(self_loops == NULL ||
+                 self_loops->size() ==
+                 static_cast<size_t>(fst::CountStates(fst_)));
+    self_loops_ = self_loops;
+  }
+
+  /// If you call this with non-NULL "counts", then on each frame the decoder
+  /// adds one to (*counts)(s) for each graph state s whose arcs it expands
+  /// (i.e. each active state within the beam).  InitDecoding() resizes
+  /// "counts" (keeping its contents) to the number of states in the graph if
+  /// it is smaller.
+  /// This is used to profile the graph, for reordering its states (see
+  /// fstsortstates).  The pointer is not owned here; call with NULL to stop.
+  void SetStateVisitCounts(Vector<double> *counts) {
+    state_visit_counts_ = counts;
+  }
+
+  /// If you call this with non-NULL "stats", the decoder records per-frame
+  /// statistics (active tokens, arcs expanded, the adaptive beam and the time
+  /// taken by each phase) in it; it is cleared in InitDecoding().  The pointer
+  /// is not owned here; call with NULL to stop.
+  void SetStats(DecoderStats *stats) { stats_ = stats; }
   
   ~LatticeFasterDecoder();
 
@@ -244,11 +310,11 @@ class LatticeFasterDecoder {
     inline Token(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLink *links,
                  Token *next):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next) { }
-    inline void DeleteForwardLinks() {
+    inline void DeleteForwardLinks(MemoryPool<ForwardLink> *link_pool) {
       ForwardLink *l = links, *m;
       while (l != NULL) {
         m = l->next;
-        delete l;
+        link_pool->Free(l);
         l = m;
       }
       links = NULL;
@@ -265,7 +331,7 @@ class LatticeFasterDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef DecoderHashList<StateId, Token*>::Elem Elem;
 
   void PossiblyResizeHash(size_t num_toks);
 
@@ -338,32 +404,183 @@ class LatticeFasterDecoder {
   BaseFloat GetCutoff(Elem *list_head, size_t *tok_count,
                       BaseFloat *adaptive_beam, Elem **best_elem);
 
+  /// Decodes one frame, for Decode() and AdvanceDecoding(): prunes the
+  /// lattice if it is time to, processes the emitting and nonemitting arcs
+  /// and, if --target-rtf is set, tells beam_controller_ how long it took.
+  void DecodeFrame(DecodableInterface *decodable);
+
+  /// Adds to state_visit_counts_ for each token in "final_toks" within
+  /// "cur_cutoff"; called from ProcessEmitting() if state_visit_counts_ is set.
+  void AccumulateStateVisits(const Elem *final_toks, BaseFloat cur_cutoff);
+
   /// Processes emitting arcs for one frame.  Propagates from prev_toks_ to cur_toks_.
   /// Returns the cost cutoff for subsequent ProcessNonemitting() to use.
   BaseFloat ProcessEmitting(DecodableInterface *decodable);
 
+  /// Propagates "tok", which is on frame "frame", along one emitting arc
+  /// whose graph cost is "graph_cost", subject to the beam; this is the inner
+  /// loop of ProcessEmitting().  Returns true if the arc was within the beam.
+  inline bool PropagateEmitting(Token *tok, int32 frame, const Arc &arc,
+                                BaseFloat graph_cost, BaseFloat cost_offset,
+                                BaseFloat adaptive_beam,
+                                BaseFloat *next_cutoff);
+
+  /// Returns the cost that has to be added to the arcs leaving "state" and to
+  /// its final-prob; this is nonzero only if SetImplicitSelfLoops() was called.
+  inline BaseFloat ForwardCost(StateId state) const {
+    return (self_loops_ == NULL ? 0.0 : (*self_loops_)[state].forward_cost);
+  }
+
+  /// Returns the self-loop that SetImplicitSelfLoops() implies on "state" (as
+  /// an arc), or false if there is none.
+  inline bool GetSelfLoop(StateId state, Arc *arc) const {
+    if (self_loops_ == NULL || (*self_loops_)[state].self_loop_tid == 0)
+      return false;
+    const ImplicitSelfLoop &self_loop = (*self_loops_)[state];
+    *arc = Arc(self_loop.self_loop_tid, 0,
+               Weight(self_loop.self_loop_cost), state);
+    return true;
+  }
+
+  // An ExpandedArc is an emitting transition out of a token on the previous
+  // frame, that has survived pruning so far.  They are used in the
+  // multi-threaded version of ProcessEmitting(); see ExpandEmittingArcs().
+  struct ExpandedArc {
+    Token *source;
+    StateId nextstate;
+    Label ilabel;
+    Label olabel;
+    BaseFloat graph_cost;
+    BaseFloat ac_cost;
+    BaseFloat tot_cost;
+    int32 next_tok;  // index into new_toks of the thread that owns nextstate.
+  };
+  // A NewToken is a token on the new frame, as found by the thread that owns
+  // its state in the multi-threaded version of ProcessEmitting().
+  struct NewToken {
+    StateId state;
+    BaseFloat tot_cost;
+    int32 first_thread;  // the first arc that reached it was
+    int32 first_arc;     // arcs[first_arc] of thread first_thread.
+    Token *tok;  // set when the Token is created.
+  };
+  // What each thread works on in the multi-threaded version of
+  // ProcessEmitting().  Thread t expands the emitting arcs of the t'th
+  // contiguous block of expand_toks_, and adds the ForwardLinks out of those
+  // tokens; it also owns the tokens on the new frame whose state s has
+  // DestinationThread(s) == t, and works out which ones there are and their
+  // costs.
+  struct EmittingWorkspace {
+    // The indices (transition-ids) on the emitting arcs of this block, and
+    // for each index, whether it is in "requested".
+    std::vector<int32> requested;
+    std::vector<char> is_requested;
+    // The emitting arcs of this block that are within the beam, in the order
+    // the single-threaded code goes through them.
+    std::vector<ExpandedArc> arcs;
+    // The "next_cutoff" after going through this block only.
+    BaseFloat next_cutoff;
+    // arcs_by_dest[u] lists the elements of "arcs" whose nextstate thread u
+    // owns.
+    std::vector<std::vector<int32> > arcs_by_dest;
+    // The new tokens this thread owns, in the order they were first reached,
+    // and a hash from their state to their index in new_toks.
+    std::vector<NewToken> new_toks;
+    DecoderHashList<StateId, int32> new_tok_index;
+    // Memory for the ForwardLinks of "arcs", from link_pool_.
+    std::vector<void*> link_memory;
+  };
+  class EmittingJob;
+
+  /// Returns the thread that owns the tokens for "state" in the multi-threaded
+  /// version of ProcessEmitting().  Consecutive states go to the same thread
+  /// in groups of 16, so that the keys in each thread's hash are not all
+  /// congruent modulo the hash size.
+  static inline int32 DestinationThread(StateId state, int32 num_threads) {
+    return (state >> 4) % num_threads;
+  }
+
+  /// This is called from ProcessEmitting() when config_.num_threads > 1, to
+  /// list the tokens in "final_toks" that are within "cur_cutoff" in
+  /// expand_toks_.  The worker threads can't call the decodable object, so
+  /// they go through the emitting arcs of those tokens, each thread its own
+  /// block, to find out which indices are needed; this function then gives
+  /// them to loglikes_ and calls loglikes_.Compute().
+  void CollectEmittingTokens(const Elem *final_toks, BaseFloat cur_cutoff);
+
+  /// This is called from ProcessEmitting() when config_.num_threads > 1,
+  /// after CollectEmittingTokens(), and does the work of the single-threaded
+  /// loop in ProcessEmitting(), with exactly the same result.  It goes like
+  /// this, each stage running on all the threads:
+  ///  - each thread expands the emitting arcs of its block of expand_toks_,
+  ///    pruning with its own "next_cutoff", which is never tighter than the
+  ///    one the single-threaded code would have had at that point;
+  ///  - each thread starts from the cutoff after the blocks before its own
+  ///    (this is exactly the cutoff the single-threaded code would have had
+  ///    there), prunes its arcs again, and sorts them by the thread that owns
+  ///    their nextstate;
+  ///  - each thread goes through the arcs to the states it owns, in order,
+  ///    and works out the new tokens and their costs;
+  ///  - the calling thread creates the Tokens, in the order the
+  ///    single-threaded code would have, since that order determines the
+  ///    lattice and the order of toks_, and gets the memory for the
+  ///    ForwardLinks;
+  ///  - each thread adds the ForwardLinks out of the tokens of its block.
+  /// Returns the number of arcs within the beam, and outputs the cutoff for
+  /// ProcessNonemitting() to "next_cutoff", which on input is the cutoff
+  /// worked out from the best token.
+  int32 ExpandEmittingArcs(int32 frame, BaseFloat cost_offset,
+                           BaseFloat adaptive_beam, BaseFloat *next_cutoff);
+
   /// Processes nonemitting (epsilon) arcs for one frame.  Called after
   /// ProcessEmitting() on each frame.  The cost cutoff is computed by the
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.  It is indexed by frame-index
-  // plus one, where the frame-index is zero-based, as used in decodable object.
-  // That is, the emitting probs of frame t are accounted for in tokens at
-  // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
-  // the graph.
-  HashList<StateId, Token*> toks_;
+  // DecoderHashList is HashList or OpenHashList (see ../util/open-hash-list.h).
+  // It actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by
+  // StateId.  It is indexed by frame-index plus one, where the frame-index is
+  // zero-based, as used in decodable object.  That is, the emitting probs of
+  // frame t are accounted for in tokens at toks_[t+1].  The zeroth frame is
+  // for nonemitting transition at the start of the graph.
+  DecoderHashList<StateId, Token*> toks_;
+
+  // All Tokens and ForwardLinks are allocated from these pools (see
+  // ../util/memory-pool.h), which recycle freed objects and let
+  // ClearActiveTokens() release everything at once.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
   // must_prune_tokens).
+  // The following are only used if config_.num_threads > 1.
+  PersistentMultiThreader *threader_;  // created in InitDecoding().
+  // Tokens whose emitting arcs are to be expanded on this frame.
+  std::vector<std::pair<StateId, Token*> > expand_toks_;
+  // Indexed by thread; owned here.
+  std::vector<EmittingWorkspace*> workspaces_;
+
+  // The log-likelihoods of the frame being processed by ProcessEmitting().
+  FrameLoglikeCache loglikes_;
+
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
   // make it class member to avoid internal new/delete.
   const fst::Fst<fst::StdArc> &fst_;
   bool delete_fst_;
+  // Set by SetImplicitSelfLoops(); NULL if the graph has its own self-loops.
+  const std::vector<ImplicitSelfLoop> *self_loops_;
+  // Set by SetStateVisitCounts(); normally NULL.
+  Vector<double> *state_visit_counts_;
+  // Set by SetStats(); normally NULL.
+  DecoderStats *stats_;
+  // Supplies the beam and max-active used in GetCutoff().
+  RtfBeamController beam_controller_;
+  // The number of tokens GetCutoff() saw on the last frame; for
+  // beam_controller_.
+  size_t last_tok_cnt_;
   std::vector<BaseFloat> cost_offsets_; // This contains, for each
   // frame, an offset that was added to the acoustic likelihoods on that
   // frame in order to keep everything in a nice dynamic range.
@@ -0,0 +1,166 @@
+// decoder/lattice-faster-online-decoder-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-faster-online-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/rand-fst.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+// Returns a small random graph whose input labels are epsilon or in the range
+// [1, num_pdfs] and whose output labels are random words, with a self-loop on
+// each state and no epsilon cycles; see also lattice-faster-decoder-test.cc.
+fst::VectorFst<fst::StdArc> *RandDecodingGraph(int32 num_pdfs) {
+  using fst::StdArc;
+  fst::RandFstOptions opts;
+  opts.n_syms = num_pdfs + 1;
+  opts.allow_empty = false;
+  fst::VectorFst<StdArc> *fst = fst::RandFst<StdArc>(opts);
+  for (StdArc::StateId s = 0; s < fst->NumStates(); s++) {
+    for (fst::MutableArcIterator<fst::VectorFst<StdArc> > aiter(fst, s);
+         !aiter.Done(); aiter.Next()) {
+      StdArc arc = aiter.Value();
+      if (arc.ilabel == 0 && arc.nextstate <= s) {
+        arc.ilabel = RandInt(1, num_pdfs);
+        aiter.SetValue(arc);
+      }
+    }
+  }
+  for (StdArc::StateId s = 0; s < fst->NumStates(); s++)
+    fst->AddArc(s, StdArc(RandInt(1, num_pdfs), 0, StdArc::Weight(0.5), s));
+  return fst;
+}
+
+// Determinizes the whole raw lattice of "decoder" at once.  (The decoding
+// binaries use DeterminizeLatticePhonePruned(), but that needs a
+// TransitionModel; without phone determinization it is the same as this.)
+bool DeterminizeRawLattice(const LatticeFasterOnlineDecoder &decoder,
+                           bool use_final_probs, CompactLattice *clat) {
+  Lattice raw_lat;
+  if (!decoder.GetRawLattice(&raw_lat, use_final_probs))
+    return false;
+  fst::Invert(&raw_lat);
+  fst::ILabelCompare<LatticeArc> ilabel_comp;
+  fst::ArcSort(&raw_lat, ilabel_comp);
+  return fst::DeterminizeLatticePruned(raw_lat,
+                                       decoder.GetOptions().lattice_beam, clat);
+}
+
+// With lattice-beam so wide that nothing is pruned, the lattice determinized a
+// chunk at a time while decoding (see --determinize-period) must be equivalent
+// to the one we get by determinizing the raw lattice in one go, both in the
+// middle of the utterance and at the end.
+void TestIncrementalDeterminization() {
+  int32 num_pdfs = RandInt(1, 10);
+  fst::VectorFst<fst::StdArc> *fst = RandDecodingGraph(num_pdfs);
+  Matrix<BaseFloat> loglikes(RandInt(1, 30), num_pdfs + 1);
+  loglikes.SetRandn();
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 1000.0;
+  config.lattice_beam = 1000.0;
+  config.determinize_period = RandInt(1, 5);
+  config.determinize_delay = RandInt(0, 3);
+  LatticeFasterOnlineDecoder decoder(*fst, config);
+  decoder.InitDecoding();
+  while (decoder.NumFramesDecoded() < loglikes.NumRows()) {
+    decoder.AdvanceDecoding(&decodable, RandInt(1, 5));
+    bool use_final_probs = (RandInt(0, 1) == 0);
+    CompactLattice clat, clat_ref;
+    bool ans = decoder.GetLattice(&clat, use_final_probs);
+    if (!DeterminizeRawLattice(decoder, use_final_probs, &clat_ref))
+      continue;  // No lattice, or determinization hit max-mem.
+    KALDI_ASSERT(ans && fst::RandEquivalent(clat, clat_ref, 5/*paths*/,
+                                            0.01/*delta*/, kaldi::Rand(),
+                                            100/*path length, max*/));
+  }
+  delete fst;
+}
+
+// Gets the arcs of the linear FST "path", in order from the start.
+void GetPathArcs(const Lattice &path, std::vector<LatticeArc> *arcs) {
+  arcs->clear();
+  for (LatticeArc::StateId s = path.Start(); path.NumArcs(s) != 0; ) {
+    KALDI_ASSERT(path.NumArcs(s) == 1);
+    fst::ArcIterator<Lattice> aiter(path, s);
+    arcs->push_back(aiter.Value());
+    s = aiter.Value().nextstate;
+  }
+}
+
+// The path we keep up to date from the output of UpdateBestPath() must be the
+// one that GetBestPath() traces back, after each chunk of frames.  We use
+// normal beams, so that tokens are pruned and their memory reused.
+void TestUpdateBestPath() {
+  int32 num_pdfs = RandInt(1, 10);
+  fst::VectorFst<fst::StdArc> *fst = RandDecodingGraph(num_pdfs);
+  Matrix<BaseFloat> loglikes(RandInt(1, 100), num_pdfs + 1);
+  loglikes.SetRandn();
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = RandInt(2, 10);
+  config.max_active = RandInt(5, 100);
+  config.prune_interval = RandInt(1, 10);
+  LatticeFasterOnlineDecoder decoder(*fst, config);
+  decoder.InitDecoding();
+  std::vector<LatticeArc> path;
+  while (decoder.NumFramesDecoded() < loglikes.NumRows()) {
+    decoder.AdvanceDecoding(&decodable, RandInt(1, 5));
+    bool use_final_probs = (RandInt(0, 1) == 0);
+    int32 num_kept;
+    std::vector<LatticeArc> changed_arcs;
+    BaseFloat final_cost;
+    if (!decoder.UpdateBestPath(use_final_probs, &num_kept, &changed_arcs,
+                                &final_cost))
+      continue;
+    KALDI_ASSERT(num_kept <= static_cast<int32>(path.size()));
+    path.resize(num_kept);
+    path.insert(path.end(), changed_arcs.begin(), changed_arcs.end());
+
+    Lattice best_path;
+    KALDI_ASSERT(decoder.GetBestPath(&best_path, use_final_probs));
+    std::vector<LatticeArc> ref_path;
+    GetPathArcs(best_path, &ref_path);
+    KALDI_ASSERT(path.size() == ref_path.size());
+    for (size_t i = 0; i < path.size(); i++)
+      KALDI_ASSERT(path[i].ilabel == ref_path[i].ilabel &&
+                   path[i].olabel == ref_path[i].olabel &&
+                   fst::ApproxEqual(path[i].weight, ref_path[i].weight));
+    LatticeArc::StateId final_state = (ref_path.empty() ? best_path.Start() :
+                                       ref_path.back().nextstate);
+    KALDI_ASSERT(fst::ApproxEqual(best_path.Final(final_state),
+                                  LatticeWeight(final_cost, 0.0)));
+  }
+  delete fst;
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    TestIncrementalDeterminization();
+  for (int32 i = 0; i < 50; i++)
+    TestUpdateBestPath();
+  std::cout << "Test OK.\n";
+}
@@ -25,6 +25,7 @@
 
 #include "decoder/lattice-faster-online-decoder.h"
 #include "lat/lattice-functions.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
@@ -32,7 +33,8 @@ namespace kaldi {
 LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(
     const fst::Fst<fst::StdArc> &fst,
     const LatticeFasterDecoderConfig &config):
-    fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
+    fst_(fst), delete_fst_(false), config_(config), num_toks_(0),
+    num_frames_determinized_(0), last_tok_cnt_(0), stats_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -40,7 +42,8 @@ LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(
 
 LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(const LatticeFasterDecoderConfig &config,
                                                        fst::Fst<fst::StdArc> *fst):
-    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
+    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0),
+    num_frames_determinized_(0), last_tok_cnt_(0), stats_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -61,10 +64,22 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
   num_toks_ = 0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  loglikes_.Reset();
+  beam_controller_.Configure(config_.rtf_opts, config_.beam,
+                             config_.max_active);
+  if (stats_ != NULL)
+    stats_->Reset();
+  best_path_.clear();
+  fst::DeterminizeLatticePrunedOptions det_opts;
+  det_opts.max_mem = config_.det_opts.max_mem;
+  determinizer_.Init(config_.lattice_beam, det_opts);
+  num_frames_determinized_ = 0;
+  token_label_map_.clear();
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok =
+      new (token_pool_.Allocate()) Token(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -81,12 +96,8 @@ bool LatticeFasterOnlineDecoder::Decode(DecodableInterface *decodable) {
   // terms of features), but note that the decodable object uses zero-based
   // numbering, which we have to correct for when we call it.
 
-  while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
-    if (NumFramesDecoded() % config_.prune_interval == 0)
-      PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);  // Note: the value returned by
-    ProcessNonemitting(cost_cutoff);
-  }
+  while (!decodable->IsLastFrame(NumFramesDecoded() - 1))
+    DecodeFrame(decodable);
   FinalizeDecoding();
 
   // Returns true if we have any kind of traceback available (not necessarily
@@ -126,6 +137,7 @@ bool LatticeFasterOnlineDecoder::GetBestPath(Lattice *olat,
   BestPathIterator iter = BestPathEnd(use_final_probs, &final_graph_cost);
   if (iter.Done())
     return false;  // would have printed warning.
+
   StateId state = olat->AddState();
   olat->SetFinal(state, LatticeWeight(final_graph_cost, 0.0));
   while (!iter.Done()) {
@@ -141,6 +153,48 @@ bool LatticeFasterOnlineDecoder::GetBestPath(Lattice *olat,
 }
 
 
+bool LatticeFasterOnlineDecoder::UpdateBestPath(
+    bool use_final_probs, int32 *num_kept,
+    std::vector<LatticeArc> *changed_arcs, BaseFloat *final_graph_cost) {
+  changed_arcs->clear();
+  BestPathIterator iter = BestPathEnd(use_final_probs, final_graph_cost);
+  if (iter.Done())
+    return false;  // would have printed warning.
+
+  // Trace back until we reach a token on best_path_; "suffix" gets the rest
+  // of the path, in reverse order.  The frames of best_path_ never decrease,
+  // and those of "iter" never increase, so we look for the token among the
+  // elements of best_path_ on iter.frame, which are just before index "end".
+  std::vector<BestPathElem> suffix;
+  size_t end = best_path_.size(),
+      num_prefix = 0;  // the number of elements of best_path_ that we keep.
+  while (!iter.Done()) {
+    while (end > 0 && best_path_[end - 1].frame > iter.frame)
+      end--;
+    for (size_t i = end; i > 0 && best_path_[i - 1].frame == iter.frame; i--) {
+      if (best_path_[i - 1].tok == iter.tok) {
+        num_prefix = i;
+        break;
+      }
+    }
+    if (num_prefix != 0)
+      break;
+    BestPathElem elem;
+    elem.tok = iter.tok;
+    elem.frame = iter.frame;
+    iter = TraceBackBestPath(iter, &elem.arc);
+    suffix.push_back(elem);
+  }
+  best_path_.resize(num_prefix);
+  best_path_.insert(best_path_.end(), suffix.rbegin(), suffix.rend());
+  *num_kept = num_prefix;
+  changed_arcs->reserve(suffix.size());
+  for (size_t i = num_prefix; i < best_path_.size(); i++)
+    changed_arcs->push_back(best_path_[i].arc);
+  return true;
+}
+
+
 // Outputs an FST corresponding to the raw, state-level
 // tracebacks.
 bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
@@ -325,6 +379,158 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
 }
 
 
+bool LatticeFasterOnlineDecoder::GetLattice(CompactLattice *ofst,
+                                            bool use_final_probs) const {
+  ofst->DeleteStates();
+  Lattice raw_fst;
+  if (!GetRawLatticeChunk(num_frames_determinized_, NumFramesDecoded(),
+                          use_final_probs, &raw_fst, NULL, NULL))
+    return false;
+  // This leaves determinizer_ unchanged, so that decoding can continue.
+  if (!determinizer_.GetLatticeWithChunk(&raw_fst, ofst))
+    KALDI_WARN << "Lattice determinization terminated early (max-mem "
+               << "reached); the lattice will be more heavily pruned.";
+  return (ofst->NumStates() != 0);
+}
+
+bool LatticeFasterOnlineDecoder::GetRawLatticeChunk(
+    int32 frame_begin, int32 frame_end, bool use_final_probs, Lattice *olat,
+    unordered_map<Token*, Label> *token_label_map,
+    unordered_map<Label, BaseFloat> *token_label2final_cost) const {
+  typedef LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  typedef Arc::Label Label;
+
+  bool is_last_chunk = (token_label_map == NULL);
+  if (decoding_finalized_ && is_last_chunk && !use_final_probs)
+    KALDI_ERR << "You cannot call FinalizeDecoding() and then call "
+              << "GetLattice() with use_final_probs == false";
+  KALDI_ASSERT(frame_begin >= 0 && frame_begin <= frame_end &&
+               frame_end <= NumFramesDecoded() && frame_end > 0);
+  for (int32 f = frame_begin; f <= frame_end; f++) {
+    if (active_toks_[f].toks == NULL) {
+      KALDI_WARN << "GetRawLatticeChunk: no tokens active on frame " << f
+                 << ": not producing lattice.\n";
+      return false;
+    }
+  }
+
+  unordered_map<Token*, BaseFloat> final_costs_local;
+  const unordered_map<Token*, BaseFloat> &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (is_last_chunk && !decoding_finalized_ && use_final_probs)
+    ComputeFinalCosts(&final_costs_local, NULL, NULL);
+
+  unordered_map<Label, StateId> token_label2state;
+  determinizer_.InitializeRawLatticeChunk(olat, &token_label2state);
+
+  // Create the states.  The tokens on frame_begin were the last frame of the
+  // previous chunk (if any); the determinizer has already created their
+  // states, and the arcs leading to them.
+  unordered_map<Token*, StateId> tok_map;
+  for (int32 f = frame_begin; f <= frame_end; f++) {
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
+      if (f == frame_begin && frame_begin != 0) {
+        unordered_map<Token*, Label>::const_iterator iter =
+            token_label_map_.find(tok);
+        KALDI_ASSERT(iter != token_label_map_.end());
+        unordered_map<Label, StateId>::const_iterator iter2 =
+            token_label2state.find(iter->second);
+        if (iter2 != token_label2state.end())
+          tok_map[tok] = iter2->second;
+        // else the token was pruned away by the determinizer.
+      } else {
+        tok_map[tok] = olat->AddState();
+      }
+    }
+  }
+  if (frame_begin == 0) {
+    // The start token is the last one in the list for frame zero.
+    Token *start_tok = active_toks_[0].toks;
+    while (start_tok->next != NULL) start_tok = start_tok->next;
+    olat->AddArc(olat->Start(), Arc(0, 0, Weight::One(), tok_map[start_tok]));
+  }
+
+  StateId token_final_state = fst::kNoStateId;
+  Label next_token_label = LatticeIncrementalDeterminizer::kTokenLabelOffset;
+  for (int32 f = frame_begin; f <= frame_end; f++) {
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
+      unordered_map<Token*, StateId>::const_iterator iter = tok_map.find(tok);
+      if (iter == tok_map.end()) continue;
+      StateId cur_state = iter->second;
+      for (ForwardLink *l = tok->links; l != NULL; l = l->next) {
+        // The input-epsilon links on frame_begin belonged to the previous
+        // chunk, and the emitting links on frame_end belong to the next one.
+        if (l->ilabel == 0 ? (f == frame_begin && frame_begin != 0) :
+            (f == frame_end)) continue;
+        unordered_map<Token*, StateId>::const_iterator next_iter =
+            tok_map.find(l->next_tok);
+        KALDI_ASSERT(next_iter != tok_map.end());
+        BaseFloat cost_offset = (l->ilabel != 0 ? cost_offsets_[f] : 0.0);
+        olat->AddArc(cur_state,
+                     Arc(l->ilabel, l->olabel,
+                         Weight(l->graph_cost, l->acoustic_cost - cost_offset),
+                         next_iter->second));
+      }
+      if (f == frame_end) {
+        if (is_last_chunk) {
+          if (use_final_probs && !final_costs.empty()) {
+            unordered_map<Token*, BaseFloat>::const_iterator iter =
+                final_costs.find(tok);
+            if (iter != final_costs.end())
+              olat->SetFinal(cur_state, LatticeWeight(iter->second, 0));
+          } else {
+            olat->SetFinal(cur_state, LatticeWeight::One());
+          }
+        } else if (tok->extra_cost !=
+                   std::numeric_limits<BaseFloat>::infinity()) {
+          // The extra_cost is the difference between the best path through
+          // this token and the best path overall; we use it to make pruned
+          // determinization of the chunk prune about as it would for the
+          // whole lattice.
+          if (token_final_state == fst::kNoStateId) {
+            token_final_state = olat->AddState();
+            olat->SetFinal(token_final_state, LatticeWeight::One());
+          }
+          Label token_label = next_token_label++;
+          (*token_label_map)[tok] = token_label;
+          (*token_label2final_cost)[token_label] = tok->extra_cost;
+          olat->AddArc(cur_state, Arc(0, token_label,
+                                      Weight(tok->extra_cost, 0.0),
+                                      token_final_state));
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void LatticeFasterOnlineDecoder::PossiblyDeterminizeChunk() {
+  if (config_.determinize_period <= 0 ||
+      NumFramesDecoded() - num_frames_determinized_ <
+      config_.determinize_delay + config_.determinize_period)
+    return;
+  // Bring the extra_costs of the tokens up to date before we use them.
+  PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+  int32 frame_end = NumFramesDecoded() - config_.determinize_delay;
+  Lattice raw_fst;
+  unordered_map<Token*, Label> token_label_map;
+  unordered_map<Label, BaseFloat> token_label2final_cost;
+  if (!GetRawLatticeChunk(num_frames_determinized_, frame_end, false,
+                          &raw_fst, &token_label_map, &token_label2final_cost))
+    return;  // would have printed a warning; we'll try again next frame.
+  if (!determinizer_.AcceptRawLatticeChunk(token_label2final_cost, &raw_fst))
+    KALDI_WARN << "Lattice determinization terminated early (max-mem "
+               << "reached); the lattice will be more heavily pruned.";
+  token_label_map_.swap(token_label_map);
+  num_frames_determinized_ = frame_end;
+  KALDI_VLOG(3) << "Determinized lattice up to frame " << frame_end
+                << ", determinized lattice has "
+                << determinizer_.GetDeterminizedLattice().NumStates()
+                << " states.";
+}
+
 void LatticeFasterOnlineDecoder::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
@@ -351,7 +557,8 @@ inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddT
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = new (token_pool_.Allocate())
+        Token(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -425,7 +632,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -512,7 +719,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -572,7 +779,7 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_pool_.Free(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -758,14 +965,20 @@ void LatticeFasterOnlineDecoder::AdvanceDecoding(DecodableInterface *decodable,
   if (max_num_frames >= 0)
     target_frames_decoded = std::min(target_frames_decoded,
                                      NumFramesDecoded() + max_num_frames);
-  while (NumFramesDecoded() < target_frames_decoded) {
-    if (NumFramesDecoded() % config_.prune_interval == 0) {
-      PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    }
-    // note: ProcessEmitting() increments NumFramesDecoded().
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
-  }
+  while (NumFramesDecoded() < target_frames_decoded)
+    DecodeFrame(decodable);
+}
+
+void LatticeFasterOnlineDecoder::DecodeFrame(DecodableInterface *decodable) {
+  Timer frame_timer;
+  if (NumFramesDecoded() % config_.prune_interval == 0)
+    PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+  // note: ProcessEmitting() increments NumFramesDecoded().
+  BaseFloat cost_cutoff = ProcessEmitting(decodable);
+  ProcessNonemitting(cost_cutoff);
+  PossiblyDeterminizeChunk();
+  if (beam_controller_.Enabled())
+    beam_controller_.FrameDone(frame_timer.Elapsed(), last_tok_cnt_);
 }
 
 
@@ -795,7 +1008,10 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
-  if (config_.max_active == std::numeric_limits<int32>::max() &&
+  // These are config_.beam and config_.max_active unless --target-rtf is set.
+  BaseFloat beam = beam_controller_.Beam();
+  int32 max_active = beam_controller_.MaxActive();
+  if (max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
       BaseFloat w = static_cast<BaseFloat>(e->val->tot_cost);
@@ -805,8 +1021,8 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
-    return best_weight + config_.beam;
+    if (adaptive_beam != NULL) *adaptive_beam = beam;
+    return best_weight + beam;
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -819,18 +1035,18 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
     }
     if (tok_count != NULL) *tok_count = count;
     
-    BaseFloat beam_cutoff = best_weight + config_.beam,
+    BaseFloat beam_cutoff = best_weight + beam,
         min_active_cutoff = std::numeric_limits<BaseFloat>::infinity(),
         max_active_cutoff = std::numeric_limits<BaseFloat>::infinity();
 
     KALDI_VLOG(6) << "Number of tokens active on frame " << NumFramesDecoded()
                   << " is " << tmp_array_.size();
 
-    if (tmp_array_.size() > static_cast<size_t>(config_.max_active)) {
+    if (tmp_array_.size() > static_cast<size_t>(max_active)) {
       std::nth_element(tmp_array_.begin(),
-                       tmp_array_.begin() + config_.max_active,
+                       tmp_array_.begin() + max_active,
                        tmp_array_.end());
-      max_active_cutoff = tmp_array_[config_.max_active];
+      max_active_cutoff = tmp_array_[max_active];
     }
     if (max_active_cutoff < beam_cutoff) { // max_active is tighter than beam.
       if (adaptive_beam)
@@ -842,8 +1058,8 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
       else {
         std::nth_element(tmp_array_.begin(),
                          tmp_array_.begin() + config_.min_active,
-                         tmp_array_.size() > static_cast<size_t>(config_.max_active) ?
-                         tmp_array_.begin() + config_.max_active :
+                         tmp_array_.size() > static_cast<size_t>(max_active) ?
+                         tmp_array_.begin() + max_active :
                          tmp_array_.end());
         min_active_cutoff = tmp_array_[config_.min_active];
       }
@@ -854,7 +1070,7 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
         *adaptive_beam = min_active_cutoff - best_weight + config_.beam_delta;
       return min_active_cutoff;
     } else {
-      *adaptive_beam = config_.beam;
+      *adaptive_beam = beam;
       return beam_cutoff;
     }
   }
@@ -876,8 +1092,20 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
   BaseFloat adaptive_beam;
   size_t tok_cnt;
   BaseFloat cur_cutoff = GetCutoff(final_toks, &tok_cnt, &adaptive_beam, &best_elem);
+  last_tok_cnt_ = tok_cnt;
+  if (stats_ != NULL) {
+    stats_->Set(frame, DecoderStats::kTokensBeforePruning, tok_cnt);
+    stats_->Set(frame, DecoderStats::kAdaptiveBeam, adaptive_beam);
+    size_t num_toks_kept = 0;
+    for (const Elem *e = final_toks; e != NULL; e = e->tail)
+      if (e->val->tot_cost <= cur_cutoff) num_toks_kept++;
+    stats_->Set(frame, DecoderStats::kTokensAfterPruning, num_toks_kept);
+  }
   PossiblyResizeHash(tok_cnt);  // This makes sure the hash is always big enough.
 
+  // The likelihoods are computed as they are first needed on this frame.
+  loglikes_.NewFrame(decodable, frame);
+
   BaseFloat next_cutoff = std::numeric_limits<BaseFloat>::infinity();
   // pruning "online" before having seen all tokens
 
@@ -897,8 +1125,7 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
       Arc arc = aiter.Value();
       if (arc.ilabel != 0) {  // propagate..
         arc.weight = Times(arc.weight,
-                           Weight(cost_offset -
-                                  decodable->LogLikelihood(frame, arc.ilabel)));
+                           Weight(cost_offset - loglikes_.LogLikelihood(arc.ilabel)));
         BaseFloat new_weight = arc.weight.Value() + tok->tot_cost;
         if (new_weight + adaptive_beam < next_cutoff)
           next_cutoff = new_weight + adaptive_beam;
@@ -925,8 +1152,7 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
            aiter.Next()) {
         const Arc &arc = aiter.Value();
         if (arc.ilabel != 0) {  // propagate..
-          BaseFloat ac_cost = cost_offset -
-              decodable->LogLikelihood(frame, arc.ilabel),
+          BaseFloat ac_cost = cost_offset - loglikes_.LogLikelihood(arc.ilabel),
               graph_cost = arc.weight.Value(),
               cur_cost = tok->tot_cost,
               tot_cost = cur_cost + ac_cost + graph_cost;
@@ -940,8 +1166,9 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
+          tok->links = new (link_pool_.Allocate())
+              ForwardLink(next_tok, arc.ilabel, arc.olabel, graph_cost,
+                          ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -986,7 +1213,7 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
+    tok->DeleteForwardLinks(&link_pool_); // necessary when re-visiting
     tok->links = NULL;
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
@@ -1001,8 +1228,8 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = new (link_pool_.Allocate())
+              ForwardLink(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -1023,19 +1250,22 @@ void LatticeFasterOnlineDecoder::DeleteElems(Elem *list) {
 }
 
 void LatticeFasterOnlineDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
-    }
+  // All Tokens and ForwardLinks live in token_pool_ and link_pool_, so rather
+  // than deleting them one by one we release them all at once.
+  KALDI_ASSERT(token_pool_.NumInUse() == static_cast<size_t>(num_toks_));
+  if (!active_toks_.empty()) {
+    KALDI_VLOG(3) << "Peak arena size was " << token_pool_.PeakNumInUse()
+                  << " tokens and " << link_pool_.PeakNumInUse()
+                  << " forward links ("
+                  << (token_pool_.PeakMemoryInUse() +
+                      link_pool_.PeakMemoryInUse()) / 1024 << " KB)";
   }
+  token_pool_.FreeAll();
+  link_pool_.FreeAll();
+  token_pool_.ResetPeak();
+  link_pool_.ResetPeak();
   active_toks_.clear();
-  KALDI_ASSERT(num_toks_ == 0);
+  num_toks_ = 0;
 }
 
 // static
@@ -28,6 +28,7 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -35,6 +36,8 @@
 #include "lat/kaldi-lattice.h"
 // Use the same configuration class as LatticeFasterDecoder.
 #include "decoder/lattice-faster-decoder.h"
+#include "decoder/lattice-incremental-determinizer.h"
+#include "decoder/frame-loglike-cache.h"
 
 namespace kaldi {
 
@@ -80,6 +83,13 @@ class LatticeFasterOnlineDecoder {
   const LatticeFasterDecoderConfig &GetOptions() const {
     return config_;
   }
+
+  /// If you call this with non-NULL "stats", the decoder records the number
+  /// of active tokens before and after pruning and the adaptive beam for each
+  /// frame in it (unlike LatticeFasterDecoder, it does not record the arc
+  /// counts and timings); it is cleared in InitDecoding().  The pointer is not
+  /// owned here; call with NULL to stop.
+  void SetStats(DecoderStats *stats) { stats_ = stats; }
   
   ~LatticeFasterOnlineDecoder();
 
@@ -107,6 +117,23 @@ class LatticeFasterOnlineDecoder {
   bool GetBestPath(Lattice *ofst,
                    bool use_final_probs = true) const;
 
+  /// This is for getting partial results cheaply while decoding, where
+  /// GetBestPath() would trace back to the start of the utterance each time.
+  /// It updates the best path that the decoder keeps and outputs only the part
+  /// that changed since the previous call (or since InitDecoding()): the
+  /// first "num_kept" arcs of the previous path are unchanged, and
+  /// "changed_arcs" is set to the arcs that follow them, in order.  So the
+  /// caller can keep its own copy of the path up to date by removing all but
+  /// its first "num_kept" arcs and appending "changed_arcs".  The trace back
+  /// stops at the first token that is on the previous path, which is normally
+  /// within the last few frames.  The "nextstate" of the arcs means nothing;
+  /// "final_graph_cost" is set to the final-cost of the path, as used by
+  /// GetBestPath() ("use_final_probs" means the same as there).  Returns
+  /// false if there is no best path.
+  bool UpdateBestPath(bool use_final_probs, int32 *num_kept,
+                      std::vector<LatticeArc> *changed_arcs,
+                      BaseFloat *final_graph_cost);
+
   
   /// This function does a self-test of GetBestPath().  Returns true on
   /// success; returns false and prints a warning on failure.
@@ -143,6 +170,18 @@ class LatticeFasterOnlineDecoder {
   bool GetRawLattice(Lattice *ofst,
                      bool use_final_probs = true) const;
 
+  /// Outputs the lattice-determinized lattice (one path per word sequence),
+  /// pruned with lattice_beam.  Returns true if result is nonempty.  The
+  /// meaning of "use_final_probs" is as for GetRawLattice().  If
+  /// config.determinize_period > 0, most of the lattice was already
+  /// determinized while decoding, and only the frames since then are
+  /// determinized here; apart from that, this only copies the output once.
+  /// Otherwise it is equivalent to calling GetRawLattice() and
+  /// DeterminizeLatticePruned().  You may call this in the middle of the
+  /// utterance and then carry on decoding.
+  bool GetLattice(CompactLattice *ofst,
+                  bool use_final_probs = true) const;
+
   /// Behaves the same like GetRawLattice but only processes tokens whose
   /// extra_cost is smaller than the best-cost plus the specified beam.
   /// It is only worthwhile to call this function if beam is less than
@@ -240,11 +279,11 @@ class LatticeFasterOnlineDecoder {
                  Token *next, Token *backpointer):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
         backpointer(backpointer) { }
-    inline void DeleteForwardLinks() {
+    inline void DeleteForwardLinks(MemoryPool<ForwardLink> *link_pool) {
       ForwardLink *l = links, *m;
       while (l != NULL) {
         m = l->next;
-        delete l;
+        link_pool->Free(l);
         l = m;
       }
       links = NULL;
@@ -334,7 +373,12 @@ class LatticeFasterOnlineDecoder {
   /// Gets the weight cutoff.  Also counts the active tokens.
   BaseFloat GetCutoff(Elem *list_head, size_t *tok_count,
                       BaseFloat *adaptive_beam, Elem **best_elem);
-  
+
+  /// Decodes one frame, for Decode() and AdvanceDecoding(): prunes the
+  /// lattice if it is time to, processes the emitting and nonemitting arcs
+  /// and, if --target-rtf is set, tells beam_controller_ how long it took.
+  void DecodeFrame(DecodableInterface *decodable);
+
   /// Processes emitting arcs for one frame.  Propagates from prev_toks_ to cur_toks_.
   /// Returns the cost cutoff for subsequent ProcessNonemitting() to use.
   BaseFloat ProcessEmitting(DecodableInterface *decodable);
@@ -353,9 +397,18 @@ class LatticeFasterOnlineDecoder {
   // the graph.
   HashList<StateId, Token*> toks_;
 
+  // All Tokens and ForwardLinks are allocated from these pools (see
+  // ../util/memory-pool.h), which recycle freed objects and let
+  // ClearActiveTokens() release everything at once.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
+
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
   // must_prune_tokens).
+  // The log-likelihoods of the frame being processed by ProcessEmitting().
+  FrameLoglikeCache loglikes_;
+
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
   // make it class member to avoid internal new/delete.
@@ -406,6 +459,54 @@ class LatticeFasterOnlineDecoder {
 
   void ClearActiveTokens();
 
+  // Creates in "olat" the raw lattice for the frames [frame_begin, frame_end]
+  // (as indexes into active_toks_), for use with determinizer_; see
+  // LatticeIncrementalDeterminizer::AcceptRawLatticeChunk() for the format.
+  // The tokens on frame_begin are identified by token_label_map_ (unless
+  // frame_begin is zero).  If "token_label_map" is NULL this is the last
+  // chunk, and the tokens on frame_end get their final-probs (see
+  // GetRawLattice() for the meaning of use_final_probs); otherwise it outputs
+  // to "token_label_map" the token labels it gave the tokens on frame_end, and
+  // their costs to "token_label2final_cost".  Returns false if some frame has
+  // no tokens.
+  bool GetRawLatticeChunk(
+      int32 frame_begin, int32 frame_end, bool use_final_probs, Lattice *olat,
+      unordered_map<Token*, Label> *token_label_map,
+      unordered_map<Label, BaseFloat> *token_label2final_cost) const;
+
+  // If config_.determinize_period > 0 and enough frames have been decoded,
+  // determinizes the next chunk of the lattice.  Called after each frame.
+  void PossiblyDeterminizeChunk();
+
+  // The following are used when config_.determinize_period > 0.
+  LatticeIncrementalDeterminizer determinizer_;
+  // The index into active_toks_ of the last frame given to determinizer_.
+  int32 num_frames_determinized_;
+  // The token labels of the tokens on that frame.
+  unordered_map<Token*, Label> token_label_map_;
+
+  // Supplies the beam and max-active used in GetCutoff().
+  RtfBeamController beam_controller_;
+  // The number of tokens GetCutoff() saw on the last frame; for
+  // beam_controller_.
+  size_t last_tok_cnt_;
+
+  // Set by SetStats(); normally NULL.
+  DecoderStats *stats_;
+
+  // The best path kept by UpdateBestPath(), in order from the start; each
+  // element has a token and its frame (as in BestPathIterator), and the arc
+  // that TraceBackBestPath() output for it.  The tokens may since have been
+  // pruned and their memory reused, but the pair of the pointer and the frame
+  // is unique within an utterance: a token is only ever freed after its frame
+  // has been decoded, and new tokens are always on later frames.  Cleared in
+  // InitDecoding().
+  struct BestPathElem {
+    void *tok;
+    int32 frame;
+    LatticeArc arc;
+  };
+  std::vector<BestPathElem> best_path_;
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoder);
 };
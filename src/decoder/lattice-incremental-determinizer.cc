@@ -0,0 +1,417 @@
+// decoder/lattice-incremental-determinizer.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-incremental-determinizer.h"
+
+namespace kaldi {
+
+const LatticeIncrementalDeterminizer::Label
+LatticeIncrementalDeterminizer::kStateLabelOffset;
+const LatticeIncrementalDeterminizer::Label
+LatticeIncrementalDeterminizer::kTokenLabelOffset;
+
+void LatticeIncrementalDeterminizer::Init(
+    BaseFloat lattice_beam,
+    const fst::DeterminizeLatticePrunedOptions &det_opts) {
+  lattice_beam_ = lattice_beam;
+  det_opts_ = det_opts;
+  clat_.DeleteStates();
+  final_arcs_.clear();
+  forward_costs_.clear();
+  arcs_in_.clear();
+}
+
+LatticeIncrementalDeterminizer::StateId
+LatticeIncrementalDeterminizer::AddStateToClat() {
+  StateId s = clat_.AddState();
+  forward_costs_.push_back(std::numeric_limits<BaseFloat>::infinity());
+  arcs_in_.resize(arcs_in_.size() + 1);
+  return s;
+}
+
+void LatticeIncrementalDeterminizer::AddArcToClat(
+    StateId src, const CompactLatticeArc &arc) {
+  arcs_in_[arc.nextstate].push_back(
+      std::pair<StateId, int32>(src, clat_.NumArcs(src)));
+  clat_.AddArc(src, arc);
+  BaseFloat cost = forward_costs_[src] + arc.weight.Weight().Value1() +
+      arc.weight.Weight().Value2();
+  if (cost < forward_costs_[arc.nextstate])
+    forward_costs_[arc.nextstate] = cost;
+}
+
+void LatticeIncrementalDeterminizer::AddArcChain(
+    StateId src, StateId dest, Label olabel,
+    const CompactLatticeWeight &weight, Lattice *olat) {
+  const std::vector<int32> &string = weight.String();
+  LatticeWeight w = weight.Weight();
+  StateId cur = src;
+  for (size_t i = 0; i + 1 < string.size(); i++) {
+    StateId next = olat->AddState();
+    olat->AddArc(cur, LatticeArc(string[i], olabel, w, next));
+    olabel = 0;
+    w = LatticeWeight::One();
+    cur = next;
+  }
+  olat->AddArc(cur, LatticeArc(string.empty() ? 0 : string.back(), olabel, w,
+                               dest));
+}
+
+void LatticeIncrementalDeterminizer::GetRedetStates(
+    std::vector<StateId> *redet_states, std::vector<bool> *is_redet) const {
+  redet_states->clear();
+  is_redet->assign(clat_.NumStates(), false);
+  // The redeterminized states are the sources of final-arcs and all states
+  // reachable from them.  (States that were deleted are unreachable, with
+  // infinite forward cost.)
+  for (size_t i = 0; i < final_arcs_.size(); i++) {
+    StateId s = final_arcs_[i].state;
+    if (forward_costs_[s] != std::numeric_limits<BaseFloat>::infinity() &&
+        !(*is_redet)[s]) {
+      (*is_redet)[s] = true;
+      redet_states->push_back(s);
+    }
+  }
+  for (size_t i = 0; i < redet_states->size(); i++) {
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, (*redet_states)[i]);
+         !aiter.Done(); aiter.Next()) {
+      StateId nextstate = aiter.Value().nextstate;
+      if (!(*is_redet)[nextstate]) {
+        (*is_redet)[nextstate] = true;
+        redet_states->push_back(nextstate);
+      }
+    }
+  }
+}
+
+bool LatticeIncrementalDeterminizer::IsLiveArcIn(
+    StateId r, const std::pair<StateId, int32> &arc_in,
+    const std::vector<bool> &is_redet) const {
+  StateId u = arc_in.first;
+  int32 arc_index = arc_in.second;
+  if (is_redet[u] ||
+      forward_costs_[u] == std::numeric_limits<BaseFloat>::infinity() ||
+      arc_index >= static_cast<int32>(clat_.NumArcs(u)))
+    return false;
+  fst::ArcIterator<CompactLattice> aiter(clat_, u);
+  aiter.Seek(arc_index);
+  return (aiter.Value().nextstate == r);  // else it is a stale entry.
+}
+
+void LatticeIncrementalDeterminizer::InitializeRawLatticeChunk(
+    Lattice *olat,
+    unordered_map<Label, StateId> *token_label2state) const {
+  olat->DeleteStates();
+  token_label2state->clear();
+  StateId start = olat->AddState();
+  olat->SetStart(start);
+  if (clat_.NumStates() == 0)
+    return;  // First chunk.
+  std::vector<StateId> redet_states;
+  std::vector<bool> is_redet;
+  GetRedetStates(&redet_states, &is_redet);
+
+  // Map from redeterminized state of clat_ to state of olat.  If the start
+  // state of clat_ is redeterminized, it corresponds to the start state of
+  // olat; the frontier states are reached from the start state by arcs with
+  // state labels, and the rest only from other redeterminized states.
+  unordered_map<StateId, StateId> redet2state;
+  for (size_t i = 0; i < redet_states.size(); i++) {
+    StateId r = redet_states[i];
+    if (r == clat_.Start()) {
+      redet2state[r] = start;
+      continue;
+    }
+    StateId s = olat->AddState();
+    redet2state[r] = s;
+    const std::vector<std::pair<StateId, int32> > &arcs_in = arcs_in_[r];
+    for (size_t j = 0; j < arcs_in.size(); j++) {
+      if (IsLiveArcIn(r, arcs_in[j], is_redet)) {
+        olat->AddArc(start, LatticeArc(0, kStateLabelOffset + r,
+                                       LatticeWeight(forward_costs_[r], 0.0),
+                                       s));
+        break;
+      }
+    }
+  }
+  for (size_t i = 0; i < redet_states.size(); i++) {
+    StateId r = redet_states[i];
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, r);
+         !aiter.Done(); aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      AddArcChain(redet2state[r], redet2state[arc.nextstate], arc.olabel,
+                  arc.weight, olat);
+    }
+  }
+  for (size_t i = 0; i < final_arcs_.size(); i++) {
+    const FinalArc &final_arc = final_arcs_[i];
+    if (!is_redet[final_arc.state]) continue;  // unreachable.
+    StateId token_state;
+    unordered_map<Label, StateId>::iterator iter =
+        token_label2state->find(final_arc.token_label);
+    if (iter == token_label2state->end()) {
+      token_state = olat->AddState();
+      (*token_label2state)[final_arc.token_label] = token_state;
+    } else {
+      token_state = iter->second;
+    }
+    AddArcChain(redet2state[final_arc.state], token_state, 0,
+                final_arc.weight, olat);
+  }
+}
+
+bool LatticeIncrementalDeterminizer::DeterminizeChunk(
+    Lattice *raw_fst, CompactLattice *chunk) const {
+  // Determinize the chunk, with the labels (words, state labels and token
+  // labels) on the input side; this is as in DeterminizeLatticePruned().
+  fst::Connect(raw_fst);
+  fst::Invert(raw_fst);
+  if (!fst::TopSort(raw_fst))
+    KALDI_ERR << "Topological sorting of state-level lattice failed (probably"
+              << " your lexicon has empty words or your LM has epsilon cycles"
+              << ").";
+  fst::ILabelCompare<LatticeArc> ilabel_comp;
+  fst::ArcSort(raw_fst, ilabel_comp);
+  bool ans = fst::DeterminizeLatticePruned(*raw_fst, lattice_beam_, chunk,
+                                           det_opts_);
+  raw_fst->DeleteStates();
+  fst::Connect(chunk);
+  if (chunk->Properties(fst::kTopSorted, true) == 0)
+    fst::TopSort(chunk);
+  if (chunk->Start() == fst::kNoStateId)
+    KALDI_WARN << "Determinized lattice chunk is empty.";
+  return ans;
+}
+
+bool LatticeIncrementalDeterminizer::AcceptRawLatticeChunk(
+    const unordered_map<Label, BaseFloat> &token_label2final_cost,
+    Lattice *raw_fst) {
+  std::vector<StateId> redet_states;
+  std::vector<bool> is_redet;
+  GetRedetStates(&redet_states, &is_redet);
+  CompactLattice chunk;
+  bool ans = DeterminizeChunk(raw_fst, &chunk);
+
+  // Remove the arcs of the redeterminized states; they are replaced by the
+  // determinized chunk.  Apart from the start state, they become unreachable
+  // (we set their forward costs to infinity at the end).
+  for (size_t i = 0; i < redet_states.size(); i++)
+    clat_.DeleteArcs(redet_states[i]);
+
+  StateId chunk_start = chunk.Start();
+  std::vector<StateId> state_map(chunk.NumStates(), fst::kNoStateId);
+  // is_token_final[s] is true for states of "chunk" that are reached by
+  // token-label arcs; they are folded into the final-arcs.
+  std::vector<bool> is_token_final(chunk.NumStates(), false);
+  if (chunk_start != fst::kNoStateId) {
+    if (clat_.NumStates() == 0) {  // First chunk.
+      StateId s = AddStateToClat();
+      clat_.SetStart(s);
+      forward_costs_[s] = 0.0;
+      state_map[chunk_start] = s;
+    } else if (is_redet[clat_.Start()]) {
+      // The start state of the raw chunk stood for the start state of clat_.
+      state_map[chunk_start] = clat_.Start();
+    }  // else the start state only has arcs with state labels.
+  }
+  final_arcs_.clear();
+
+  for (StateId s = 0; s < chunk.NumStates(); s++) {
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, s);
+         !aiter.Done(); aiter.Next()) {
+      if (aiter.Value().olabel >= kTokenLabelOffset)
+        is_token_final[aiter.Value().nextstate] = true;
+    }
+  }
+
+  // The chunk is topologically sorted, so we see all the arcs entering a
+  // state before the arcs leaving it, and the forward costs are right.
+  for (StateId s = 0; s < chunk.NumStates(); s++) {
+    if (is_token_final[s]) continue;
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, s);
+         !aiter.Done(); aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      if (arc.olabel >= kTokenLabelOffset) {
+        // Final-arc: fold in the final weight of its destination and remove
+        // the cost we added for pruning.
+        KALDI_ASSERT(state_map[s] != fst::kNoStateId);
+        unordered_map<Label, BaseFloat>::const_iterator iter =
+            token_label2final_cost.find(arc.olabel);
+        if (iter == token_label2final_cost.end())
+          continue;  // The token was pruned away; nothing continues from it.
+        CompactLatticeWeight weight = fst::Times(arc.weight,
+                                                 chunk.Final(arc.nextstate));
+        LatticeWeight w = weight.Weight();
+        weight.SetWeight(LatticeWeight(w.Value1() - iter->second, w.Value2()));
+        final_arcs_.push_back(FinalArc(state_map[s], arc.olabel, weight));
+        continue;
+      }
+      if (state_map[arc.nextstate] == fst::kNoStateId)
+        state_map[arc.nextstate] = AddStateToClat();
+      StateId nextstate = state_map[arc.nextstate];
+      if (arc.olabel >= kStateLabelOffset) {
+        // Arc from the start state with a state label: redirect the arcs that
+        // entered that state of clat_ to "nextstate", after removing the
+        // forward cost we added for pruning.
+        KALDI_ASSERT(s == chunk_start);
+        StateId r = arc.olabel - kStateLabelOffset;
+        KALDI_ASSERT(r < static_cast<StateId>(is_redet.size()) && is_redet[r]);
+        LatticeWeight w = arc.weight.Weight();
+        CompactLatticeWeight weight(
+            LatticeWeight(w.Value1() - forward_costs_[r], w.Value2()),
+            arc.weight.String());
+        std::vector<std::pair<StateId, int32> > arcs_in;
+        arcs_in.swap(arcs_in_[r]);
+        for (size_t i = 0; i < arcs_in.size(); i++) {
+          if (!IsLiveArcIn(r, arcs_in[i], is_redet))
+            continue;
+          StateId u = arcs_in[i].first;
+          fst::MutableArcIterator<CompactLattice> maiter(&clat_, u);
+          maiter.Seek(arcs_in[i].second);
+          CompactLatticeArc arc_in = maiter.Value();
+          arc_in.weight = fst::Times(arc_in.weight, weight);
+          arc_in.nextstate = nextstate;
+          maiter.SetValue(arc_in);
+          arcs_in_[nextstate].push_back(arcs_in[i]);
+          BaseFloat cost = forward_costs_[u] + arc_in.weight.Weight().Value1()
+              + arc_in.weight.Weight().Value2();
+          if (cost < forward_costs_[nextstate])
+            forward_costs_[nextstate] = cost;
+        }
+        continue;
+      }
+      KALDI_ASSERT(state_map[s] != fst::kNoStateId);
+      CompactLatticeArc new_arc(arc);
+      new_arc.nextstate = nextstate;
+      AddArcToClat(state_map[s], new_arc);
+    }
+    if (state_map[s] != fst::kNoStateId &&
+        chunk.Final(s) != CompactLatticeWeight::Zero())
+      clat_.SetFinal(state_map[s], chunk.Final(s));
+  }
+  for (size_t i = 0; i < redet_states.size(); i++) {
+    StateId r = redet_states[i];
+    if (r != clat_.Start()) {
+      forward_costs_[r] = std::numeric_limits<BaseFloat>::infinity();
+      arcs_in_[r].clear();
+    }
+  }
+  return ans;
+}
+
+bool LatticeIncrementalDeterminizer::GetLatticeWithChunk(
+    Lattice *raw_fst, CompactLattice *clat) const {
+  std::vector<StateId> redet_states;
+  std::vector<bool> is_redet;
+  GetRedetStates(&redet_states, &is_redet);
+  CompactLattice chunk;
+  bool ans = DeterminizeChunk(raw_fst, &chunk);
+  clat->DeleteStates();
+  StateId chunk_start = chunk.Start();
+  if (chunk_start == fst::kNoStateId)
+    return ans;
+
+  // This does what AcceptRawLatticeChunk() would do to clat_, but outputs
+  // only the states in use: the states of clat_ that are reachable and not
+  // redeterminized (apart from the start state), followed by the states of
+  // the chunk.  Since both are topologically sorted, so is the output.
+  std::vector<StateId> clat_map(clat_.NumStates(), fst::kNoStateId);
+  for (StateId s = 0; s < clat_.NumStates(); s++)
+    if (forward_costs_[s] != std::numeric_limits<BaseFloat>::infinity() &&
+        (!is_redet[s] || s == clat_.Start()))
+      clat_map[s] = clat->AddState();
+  std::vector<StateId> state_map(chunk.NumStates(), fst::kNoStateId);
+  if (clat_.NumStates() == 0) {  // First chunk.
+    state_map[chunk_start] = clat->AddState();
+    clat->SetStart(state_map[chunk_start]);
+  } else {
+    clat->SetStart(clat_map[clat_.Start()]);
+    if (is_redet[clat_.Start()])
+      state_map[chunk_start] = clat_map[clat_.Start()];
+  }
+
+  // For each frontier state of clat_, the state of the chunk (numbered as in
+  // "clat") that replaces it and the weight to add to arcs entering it.
+  unordered_map<StateId, std::pair<StateId, CompactLatticeWeight> > redirect;
+  for (StateId s = 0; s < chunk.NumStates(); s++) {
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, s);
+         !aiter.Done(); aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      KALDI_ASSERT(arc.olabel < kTokenLabelOffset &&
+                   "GetLatticeWithChunk() is for the last chunk only.");
+      if (state_map[arc.nextstate] == fst::kNoStateId)
+        state_map[arc.nextstate] = clat->AddState();
+      StateId nextstate = state_map[arc.nextstate];
+      if (arc.olabel >= kStateLabelOffset) {
+        KALDI_ASSERT(s == chunk_start);
+        StateId r = arc.olabel - kStateLabelOffset;
+        LatticeWeight w = arc.weight.Weight();
+        redirect[r] = std::pair<StateId, CompactLatticeWeight>(
+            nextstate, CompactLatticeWeight(
+                LatticeWeight(w.Value1() - forward_costs_[r], w.Value2()),
+                arc.weight.String()));
+        continue;
+      }
+      KALDI_ASSERT(state_map[s] != fst::kNoStateId);
+      CompactLatticeArc new_arc(arc);
+      new_arc.nextstate = nextstate;
+      clat->AddArc(state_map[s], new_arc);
+    }
+    if (state_map[s] != fst::kNoStateId &&
+        chunk.Final(s) != CompactLatticeWeight::Zero())
+      clat->SetFinal(state_map[s], chunk.Final(s));
+  }
+
+  // Arcs into states that were pruned away, and final-arcs of tokens that
+  // were pruned away, may leave dead ends; only then do we need a Connect().
+  bool need_connect = false;
+  for (StateId s = 0; s < clat_.NumStates(); s++) {
+    if (clat_map[s] == fst::kNoStateId || is_redet[s]) continue;
+    if (clat_.NumArcs(s) == 0 && clat_.Final(s) == CompactLatticeWeight::Zero())
+      need_connect = true;
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, s);
+         !aiter.Done(); aiter.Next()) {
+      CompactLatticeArc arc = aiter.Value();
+      if (is_redet[arc.nextstate]) {
+        unordered_map<StateId,
+                      std::pair<StateId, CompactLatticeWeight> >::const_iterator
+            iter = redirect.find(arc.nextstate);
+        if (iter == redirect.end()) {
+          need_connect = true;
+          continue;
+        }
+        arc.weight = fst::Times(arc.weight, iter->second.second);
+        arc.nextstate = iter->second.first;
+      } else if (clat_map[arc.nextstate] == fst::kNoStateId) {
+        need_connect = true;
+        continue;
+      } else {
+        arc.nextstate = clat_map[arc.nextstate];
+      }
+      clat->AddArc(clat_map[s], arc);
+    }
+    if (clat_.Final(s) != CompactLatticeWeight::Zero())
+      clat->SetFinal(clat_map[s], clat_.Final(s));
+  }
+  if (need_connect)
+    fst::Connect(clat);
+  return ans;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,174 @@
+// decoder/lattice-incremental-determinizer.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_H_
+#define KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_H_
+
+#include <vector>
+#include "util/stl-utils.h"
+#include "fst/fstlib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+/**
+   LatticeIncrementalDeterminizer determinizes a lattice a chunk at a time, as
+   the decoder produces it, so that at the end of the utterance only the last
+   chunk remains to be determinized.  It is used by LatticeFasterOnlineDecoder
+   (see the options --determinize-period and --determinize-delay).
+
+   The decoder gives us the raw (state-level) lattice for a range of frames
+   [t_a, t_b].  Each token on frame t_b gets an arc to a single final state
+   with a "token label" (>= kTokenLabelOffset) as its olabel, meaning "the
+   lattice continues from this token".  After determinization these become
+   "final-arcs" of the determinized lattice clat_, which we keep separately
+   from it (in final_arcs_).  Since the token labels are distinct, paths
+   ending at different tokens are never merged.
+
+   When the next chunk (frames [t_b, t_c]) arrives, the states of clat_ that
+   have final-arcs, and all states reachable from them, have to be
+   determinized again together with the new chunk; we call these the
+   "redeterminized states".  InitializeRawLatticeChunk() creates the start of
+   the raw lattice for the new chunk: a copy of each redeterminized state, the
+   arcs of clat_ between those states, and the final-arcs, which lead to the
+   raw states for the tokens on frame t_b.  Each redeterminized state r that
+   is entered from the rest of clat_ (a "frontier" state) gets an arc from the
+   start state with "state label" kStateLabelOffset + r; the others are only
+   reached through the frontier states.  The decoder then adds the tokens
+   and links for the frames of the chunk.  After determinizing this,
+   AcceptRawLatticeChunk() deletes the arcs of the redeterminized states,
+   redirects the arcs that entered them from the rest of clat_ to the states
+   that follow the corresponding state labels, and adds the rest of the
+   determinized chunk.  The result is deterministic and, up to pruning,
+   equivalent to determinizing the whole lattice at once.
+
+   For pruning purposes, the state-label arcs carry the forward cost of the
+   state and the token-label arcs the "extra cost" of the token (see
+   token_label2final_cost), so that the paths in the chunk have approximately
+   the total costs they have in the whole lattice; we remove those costs
+   again afterwards.
+ */
+class LatticeIncrementalDeterminizer {
+ public:
+  typedef LatticeArc::StateId StateId;
+  typedef LatticeArc::Label Label;
+
+  // These must be larger than any word-id.
+  static const Label kStateLabelOffset = 500000000;
+  static const Label kTokenLabelOffset = 1000000000;
+
+  LatticeIncrementalDeterminizer(): lattice_beam_(10.0) { }
+
+  /// Starts a new utterance.  "lattice_beam" is the pruning beam used in
+  /// determinization.
+  void Init(BaseFloat lattice_beam,
+            const fst::DeterminizeLatticePrunedOptions &det_opts);
+
+  /// Creates the start of the raw lattice for the next chunk, in "olat"
+  /// (which is cleared first); state 0 is its start state.  Outputs to
+  /// "token_label2state", for each token label used in the previous chunk, the
+  /// state of olat that stands for the corresponding token; the caller adds the
+  /// arcs leaving those tokens.  For the first chunk, olat just has the start
+  /// state and the map is empty.
+  void InitializeRawLatticeChunk(
+      Lattice *olat,
+      unordered_map<Label, StateId> *token_label2state) const;
+
+  /// Determinizes the raw lattice chunk (which is destroyed) and appends it to
+  /// the determinized lattice.  Tokens that may be continued in a later chunk
+  /// must have an arc with ilabel 0 and a token label as olabel to a final
+  /// state that has no other arcs; the weight of the arc (for pruning) is given
+  /// in token_label2final_cost.  Token labels not in token_label2final_cost
+  /// (tokens that were pruned away) are ignored.  Returns false if
+  /// determinization hit the max-mem limit (in which case the output is still
+  /// usable, but more heavily pruned).
+  bool AcceptRawLatticeChunk(
+      const unordered_map<Label, BaseFloat> &token_label2final_cost,
+      Lattice *raw_fst);
+
+  /// Determinizes the last raw lattice chunk (which is destroyed; its tokens
+  /// on the final frame should have their final-probs, and no token labels)
+  /// and outputs to "clat" the determinized lattice of the whole utterance,
+  /// without changing this object, so decoding may continue.  Only the states
+  /// that are still in use are output, so "clat" normally needs no Connect().
+  /// Returns false if determinization hit the max-mem limit.
+  bool GetLatticeWithChunk(Lattice *raw_fst, CompactLattice *clat) const;
+
+  /// Returns the lattice determinized so far, without the chunk that is not
+  /// determinized yet.  Note: it may contain unreachable states.
+  const CompactLattice &GetDeterminizedLattice() const { return clat_; }
+
+ private:
+  // An arc leaving "state" of clat_ that continues into the token with label
+  // "token_label" in the next chunk.
+  struct FinalArc {
+    StateId state;
+    Label token_label;
+    CompactLatticeWeight weight;
+    FinalArc(StateId state, Label token_label,
+             const CompactLatticeWeight &weight):
+        state(state), token_label(token_label), weight(weight) { }
+  };
+
+  // Adds to "olat" a chain of arcs from "src" to "dest" with the transition-ids
+  // of "weight" as ilabels, "olabel" on the first arc, and the weight on the
+  // first arc.
+  static void AddArcChain(StateId src, StateId dest, Label olabel,
+                          const CompactLatticeWeight &weight, Lattice *olat);
+
+  // Outputs the redeterminized states (see above) in an order in which each
+  // state of clat_ they can reach follows them, and is_redet, indexed by state
+  // of clat_.
+  void GetRedetStates(std::vector<StateId> *redet_states,
+                      std::vector<bool> *is_redet) const;
+
+  // Returns true if "arc_in", an entry of arcs_in_[r], is still an arc of clat_
+  // entering r from a state that is in use and is not redeterminized.
+  bool IsLiveArcIn(StateId r, const std::pair<StateId, int32> &arc_in,
+                   const std::vector<bool> &is_redet) const;
+
+  // Determinizes the raw lattice chunk "raw_fst" (which is destroyed) to
+  // "chunk", which is connected and topologically sorted.
+  bool DeterminizeChunk(Lattice *raw_fst, CompactLattice *chunk) const;
+
+  // Adds an arc to clat_, keeping arcs_in_ and forward_costs_ up to date.
+  void AddArcToClat(StateId src, const CompactLatticeArc &arc);
+
+  StateId AddStateToClat();
+
+  BaseFloat lattice_beam_;
+  fst::DeterminizeLatticePrunedOptions det_opts_;
+
+  // The lattice determinized so far, without the final-arcs.
+  CompactLattice clat_;
+  // The final-arcs of clat_.
+  std::vector<FinalArc> final_arcs_;
+  // For each state of clat_, the best cost of reaching it from the start;
+  // infinity for states that have been deleted.  Only used for pruning.
+  std::vector<BaseFloat> forward_costs_;
+  // For each state of clat_, the arcs entering it, as pairs (source state,
+  // arc index).  May contain stale entries, which we detect and ignore.
+  std::vector<std::vector<std::pair<StateId, int32> > > arcs_in_;
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_LATTICE_INCREMENTAL_DETERMINIZER_H_
@@ -36,7 +36,8 @@ void LatticeSimpleDecoder::InitDecoding() {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+  Token *start_tok =
+      new (token_pool_.Allocate()) Token(0.0, 0.0, NULL, NULL);
   active_toks_[0].toks = start_tok;
   cur_toks_[start_state] = start_tok;
   num_toks_++;
@@ -204,7 +205,8 @@ inline LatticeSimpleDecoder::Token *LatticeSimpleDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+    Token *new_tok = new (token_pool_.Allocate())
+        Token(tot_cost, extra_cost, NULL, toks);
     toks = new_tok;
     num_toks_++;
     cur_toks_[state] = new_tok;
@@ -261,7 +263,7 @@ void LatticeSimpleDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link; // advance link but leave prev_link the same.
           *links_pruned = true;
         } else { // keep the link and update the tok_extra_cost if needed.
@@ -389,7 +391,7 @@ void LatticeSimpleDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Free(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -446,7 +448,7 @@ void LatticeSimpleDecoder::PruneTokensForFrame(int32 frame) {
       // and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_pool_.Free(tok);
       num_toks_--;
     } else {
       prev_tok = tok;
@@ -540,8 +542,9 @@ void LatticeSimpleDecoder::ProcessEmitting(DecodableInterface *decodable) {
                                          true, NULL);
           
         // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-        tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel, 
-                                     graph_cost, ac_cost, tok->links);
+        tok->links = new (link_pool_.Allocate())
+            ForwardLink(next_tok, arc.ilabel, arc.olabel, graph_cost, ac_cost,
+                        tok->links);
       }
     }
   }
@@ -584,7 +587,7 @@ void LatticeSimpleDecoder::ProcessNonemitting() {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks();
+    tok->DeleteForwardLinks(&link_pool_);
     tok->links = NULL;
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
@@ -599,8 +602,8 @@ void LatticeSimpleDecoder::ProcessNonemitting() {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           false, &changed);
           
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = new (link_pool_.Allocate())
+              ForwardLink(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
             
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -613,19 +616,22 @@ void LatticeSimpleDecoder::ProcessNonemitting() {
 }
 
 void LatticeSimpleDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
-    }
+  // All Tokens and ForwardLinks live in token_pool_ and link_pool_, so rather
+  // than deleting them one by one we release them all at once.
+  KALDI_ASSERT(token_pool_.NumInUse() == static_cast<size_t>(num_toks_));
+  if (!active_toks_.empty()) {
+    KALDI_VLOG(3) << "Peak arena size was " << token_pool_.PeakNumInUse()
+                  << " tokens and " << link_pool_.PeakNumInUse()
+                  << " forward links ("
+                  << (token_pool_.PeakMemoryInUse() +
+                      link_pool_.PeakMemoryInUse()) / 1024 << " KB)";
   }
+  token_pool_.FreeAll();
+  link_pool_.FreeAll();
+  token_pool_.ResetPeak();
+  link_pool_.ResetPeak();
   active_toks_.clear();
-  KALDI_ASSERT(num_toks_ == 0);
+  num_toks_ = 0;
 }
 
 // PruneCurrentTokens deletes the tokens from the "toks" map, but not
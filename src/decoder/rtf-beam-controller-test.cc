@@ -0,0 +1,76 @@
+// decoder/rtf-beam-controller-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/rtf-beam-controller.h"
+
+namespace kaldi {
+
+// With --target-rtf=1 and 10ms frames the budget is 0.01 seconds per frame;
+// we feed the controller synthetic frame times.
+void TestRtfBeamController() {
+  RtfBeamControllerOptions opts;
+  opts.target_rtf = 1.0;
+  opts.frame_shift = 0.01;
+  opts.min_beam = 8.0;
+  opts.min_max_active = 200;
+  RtfBeamController controller;
+  controller.Configure(opts, 16.0, 7000);
+  KALDI_ASSERT(controller.Enabled());
+  KALDI_ASSERT(controller.Beam() == 16.0 && controller.MaxActive() == 7000);
+
+  // Too slow: the beam goes down by beam_step per frame, and max-active
+  // below the number of active tokens, down to their minimum values.
+  controller.FrameDone(0.02, 5000);
+  KALDI_ASSERT(std::abs(controller.Beam() - (16.0 - opts.beam_step)) < 1.0e-5);
+  KALDI_ASSERT(controller.MaxActive() < 5000);
+  for (int32 i = 0; i < 200; i++)
+    controller.FrameDone(0.02, 5000);
+  KALDI_ASSERT(controller.Beam() == 8.0 && controller.MaxActive() == 200);
+
+  // Between 80% and 100% of the budget nothing changes.
+  for (int32 i = 0; i < 100; i++)
+    controller.FrameDone(0.009, 150);
+  KALDI_ASSERT(controller.Beam() == 8.0 && controller.MaxActive() == 200);
+
+  // A new utterance starts where the last one left off.
+  controller.Configure(opts, 16.0, 7000);
+  KALDI_ASSERT(controller.Beam() == 8.0 && controller.MaxActive() == 200);
+
+  // Fast enough: both are relaxed back up to the configured values (since
+  // max-active is more than twice the number of active tokens, it is not
+  // limiting us and goes straight back).
+  for (int32 i = 0; i < 1000; i++)
+    controller.FrameDone(0.001, 50);
+  KALDI_ASSERT(controller.Beam() == 16.0 && controller.MaxActive() == 7000);
+
+  // When disabled, the configured values are used whatever the frame times.
+  opts.target_rtf = 0.0;
+  controller.Configure(opts, 12.0, 3000);
+  KALDI_ASSERT(!controller.Enabled());
+  for (int32 i = 0; i < 100; i++)
+    controller.FrameDone(1.0, 3000);
+  KALDI_ASSERT(controller.Beam() == 12.0 && controller.MaxActive() == 3000);
+}
+
+}  // end namespace kaldi
+
+int main() {
+  kaldi::TestRtfBeamController();
+  std::cout << "Test OK.\n";
+}
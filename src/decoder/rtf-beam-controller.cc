@@ -0,0 +1,78 @@
+// decoder/rtf-beam-controller.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/rtf-beam-controller.h"
+
+namespace kaldi {
+
+void RtfBeamController::Configure(const RtfBeamControllerOptions &opts,
+                                  BaseFloat beam, int32 max_active) {
+  opts.Check();
+  // If we were at the configured values (e.g. this is the first call), move
+  // to the new configured values.
+  bool at_max_beam = (beam_ >= max_beam_),
+      at_max_max_active = (max_active_ >= max_max_active_);
+  opts_ = opts;
+  max_beam_ = beam;
+  max_max_active_ = max_active;
+  if (!opts_.Enabled() || at_max_beam)
+    beam_ = max_beam_;
+  else
+    beam_ = std::max(std::min(opts_.min_beam, max_beam_),
+                     std::min(beam_, max_beam_));
+  if (!opts_.Enabled() || at_max_max_active)
+    max_active_ = max_max_active_;
+  else
+    max_active_ = std::max(std::min(opts_.min_max_active, max_max_active_),
+                           std::min(max_active_, max_max_active_));
+}
+
+void RtfBeamController::FrameDone(double seconds, size_t num_active) {
+  if (!opts_.Enabled()) return;
+  // The smoothing constant: we average over roughly the last 10 frames.
+  const double kSmooth = 0.1;
+  if (avg_frame_time_ < 0.0) avg_frame_time_ = seconds;
+  else avg_frame_time_ = (1.0 - kSmooth) * avg_frame_time_ + kSmooth * seconds;
+
+  double budget = opts_.target_rtf * opts_.frame_shift;
+  BaseFloat min_beam = std::min(opts_.min_beam, max_beam_);
+  int32 min_max_active = std::min(opts_.min_max_active, max_max_active_);
+  if (avg_frame_time_ > budget) {
+    // Too slow: tighten the beam, and make max-active a constraint on the
+    // current number of tokens.
+    beam_ = std::max(min_beam, beam_ - opts_.beam_step);
+    double limit = 0.95 * std::min<double>(max_active_, num_active);
+    max_active_ = std::max(min_max_active, static_cast<int32>(limit));
+  } else if (avg_frame_time_ < 0.8 * budget) {
+    // Fast enough, with a margin so we don't oscillate: relax them.
+    beam_ = std::min(max_beam_, beam_ + 0.5f * opts_.beam_step);
+    if (max_active_ < max_max_active_) {
+      if (max_active_ > 2.0 * num_active)  // it is not limiting us anyway.
+        max_active_ = max_max_active_;
+      else
+        max_active_ = static_cast<int32>(
+            std::min<double>(max_max_active_, 1.05 * max_active_ + 1.0));
+    }
+  }
+  KALDI_VLOG(6) << "Average time per frame is " << avg_frame_time_
+                << " vs. budget " << budget << ": beam is " << beam_
+                << ", max-active is " << max_active_;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,118 @@
+// decoder/rtf-beam-controller.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_RTF_BEAM_CONTROLLER_H_
+#define KALDI_DECODER_RTF_BEAM_CONTROLLER_H_
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+struct RtfBeamControllerOptions {
+  BaseFloat target_rtf;
+  BaseFloat frame_shift;
+  BaseFloat min_beam;
+  int32 min_max_active;
+  BaseFloat beam_step;  // Note: we don't make this configurable on the command
+                        // line.  It is the amount by which we reduce the beam
+                        // on each frame that is too slow; we increase it by
+                        // half this on frames that are fast enough.
+
+  RtfBeamControllerOptions(): target_rtf(0.0), frame_shift(0.01),
+                              min_beam(8.0), min_max_active(200),
+                              beam_step(0.1) { }
+  void Register(OptionsItf *po) {
+    po->Register("target-rtf", &target_rtf, "If >0, the real-time factor the "
+                 "decoder aims for: it measures the time taken per frame and "
+                 "reduces the beam and max-active (down to --rtf-min-beam and "
+                 "--rtf-min-max-active) when it is too slow, restoring them "
+                 "(up to --beam and --max-active) when there is time to "
+                 "spare.");
+    po->Register("rtf-frame-shift", &frame_shift, "With --target-rtf, the "
+                 "frame shift in seconds, used to convert the real-time "
+                 "factor to a time budget per frame.");
+    po->Register("rtf-min-beam", &min_beam, "With --target-rtf, the smallest "
+                 "beam the decoder may use.");
+    po->Register("rtf-min-max-active", &min_max_active, "With --target-rtf, "
+                 "the smallest max-active the decoder may use (must be at "
+                 "least --min-active).");
+  }
+  bool Enabled() const { return target_rtf > 0.0; }
+  void Check() const {
+    KALDI_ASSERT(target_rtf >= 0.0 && frame_shift > 0.0 && min_beam > 0.0
+                 && min_max_active > 1 && beam_step > 0.0);
+  }
+};
+
+
+/**
+   RtfBeamController adjusts the beam and max-active of a decoder on the fly so
+   that it decodes at a target real-time factor.  The decoder calls
+   FrameDone() after each frame with the time that frame took, and takes the
+   beam and max-active for the next frame from Beam() and MaxActive().  We
+   smooth the frame times, and while they are over budget we reduce the beam
+   by beam_step per frame and reduce max-active to a bit less than the number
+   of active tokens; when they are comfortably under budget we move both back
+   towards their configured values (which are also the upper limits).  So
+   when a server is overloaded, accuracy degrades gradually instead of the
+   decoder falling behind.
+
+   Because the frame times include everything the decoder does on that frame
+   (including, e.g., computing neural-net outputs on demand), the resulting
+   real-time factor is that of the whole decoding, not just the search.  If
+   the controller is disabled (target_rtf == 0), Beam() and MaxActive() just
+   return the configured values.
+ */
+class RtfBeamController {
+ public:
+  RtfBeamController(): max_beam_(16.0),
+                       max_max_active_(std::numeric_limits<int32>::max()),
+                       beam_(max_beam_), max_active_(max_max_active_),
+                       avg_frame_time_(-1.0) { }
+
+  /// Sets the options and the configured beam and max-active, which are the
+  /// upper limits.  The decoders call this from InitDecoding().  The current
+  /// values are kept (within the new limits), so that if the decoder object is
+  /// reused, a new utterance starts where the previous one left off.
+  void Configure(const RtfBeamControllerOptions &opts, BaseFloat beam,
+                 int32 max_active);
+
+  bool Enabled() const { return opts_.Enabled(); }
+
+  /// Tells the controller that a frame took "seconds" to decode, and that
+  /// "num_active" tokens were active on it (before pruning).
+  void FrameDone(double seconds, size_t num_active);
+
+  BaseFloat Beam() const { return beam_; }
+  int32 MaxActive() const { return max_active_; }
+
+ private:
+  RtfBeamControllerOptions opts_;
+  BaseFloat max_beam_;  // the configured beam.
+  int32 max_max_active_;  // the configured max-active.
+  BaseFloat beam_;  // the current beam.
+  int32 max_active_;  // the current max-active.
+  double avg_frame_time_;  // smoothed time per frame; -1 if no frames yet.
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_RTF_BEAM_CONTROLLER_H_
@@ -0,0 +1,71 @@
+// fstbin/fstmakeflat.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/kaldi-io.h"
+#include "util/parse-options.h"
+#include "fst/fstlib.h"
+#include "fstext/flat-fst.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Converts an FST (e.g. HCLG.fst) to the read-only \"flat\" format, which\n"
+        "the decoding programs memory-map instead of reading, so that large\n"
+        "graphs load instantly and are shared between processes via the page\n"
+        "cache.  The output is native-endian.  See fstext/flat-fst.h.\n"
+        "\n"
+        "Usage:  fstmakeflat [in.fst [out.fst] ]\n"
+        "e.g.: fstmakeflat exp/tri3/graph/HCLG.fst exp/tri3/graph/HCLG.flat.fst\n";
+
+    ParseOptions po(usage);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() > 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = po.GetOptArg(1),
+        fst_out_filename = po.GetOptArg(2);
+    if (fst_out_filename == "") fst_out_filename = "-";
+
+    Fst<StdArc> *fst = ReadFstKaldiGeneric(fst_in_filename);
+
+    bool binary = true, write_header = false;
+    Output ko(fst_out_filename, binary, write_header);
+    FlatFst::WriteFst(*fst, ko.Stream());
+    if (!ko.Close())
+      KALDI_ERR << "Error writing flat FST to "
+                << PrintableWxfilename(fst_out_filename);
+
+    KALDI_LOG << "Wrote flat FST with " << CountStates(*fst) << " states to "
+              << PrintableWxfilename(fst_out_filename);
+    delete fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
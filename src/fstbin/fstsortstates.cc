@@ -0,0 +1,141 @@
+// fstbin/fstsortstates.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <algorithm>
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fst/fstlib.h"
+#include "fstext/fstext-utils.h"
+
+namespace kaldi {
+
+// Orders states by decreasing visit count.
+class VisitCountGreater {
+ public:
+  explicit VisitCountGreater(const Vector<double> &counts): counts_(counts) { }
+  bool operator() (int32 a, int32 b) const { return counts_(a) > counts_(b); }
+ private:
+  const Vector<double> &counts_;
+};
+
+// Outputs the states of "fst" in the order in which a breadth-first search
+// from the start state first reaches them, followed by any unreachable states
+// in their original order.
+void GetBreadthFirstOrder(const fst::VectorFst<fst::StdArc> &fst,
+                          std::vector<int32> *states) {
+  typedef fst::StdArc::StateId StateId;
+  StateId num_states = fst.NumStates();
+  std::vector<bool> seen(num_states, false);
+  states->clear();
+  states->reserve(num_states);
+  if (fst.Start() != fst::kNoStateId) {
+    states->push_back(fst.Start());
+    seen[fst.Start()] = true;
+  }
+  // "states" doubles as the queue.
+  for (size_t i = 0; i < states->size(); i++) {
+    StateId s = (*states)[i];
+    for (fst::ArcIterator<fst::VectorFst<fst::StdArc> > aiter(fst, s);
+         !aiter.Done(); aiter.Next()) {
+      StateId t = aiter.Value().nextstate;
+      if (!seen[t]) {
+        seen[t] = true;
+        states->push_back(t);
+      }
+    }
+  }
+  for (StateId s = 0; s < num_states; s++)
+    if (!seen[s])
+      states->push_back(s);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Renumbers the states of an FST (e.g. HCLG.fst) so that states that\n"
+        "the decoder tends to visit together have nearby numbers, which\n"
+        "improves memory locality in decoding.  By default states are put in\n"
+        "breadth-first order from the start state.  With --state-visits, which\n"
+        "is the output of latgen-faster-mapped --write-state-visits on some\n"
+        "representative data, states are ordered by decreasing number of\n"
+        "visits (ties broken by breadth-first order).  The FST is otherwise\n"
+        "unchanged (arc order within states is preserved).\n"
+        "\n"
+        "Usage:  fstsortstates [options] [in.fst [out.fst] ]\n"
+        "e.g.: latgen-faster-mapped --write-state-visits=visits.vec final.mdl \\\n"
+        "         HCLG.fst ark:dev_loglikes.ark ark:/dev/null\n"
+        "      fstsortstates --state-visits=visits.vec HCLG.fst HCLG.sorted.fst\n";
+
+    std::string state_visits_rxfilename;
+    ParseOptions po(usage);
+    po.Register("state-visits", &state_visits_rxfilename, "Vector of visit "
+                "counts per state, as written by latgen-faster-mapped "
+                "--write-state-visits; if not given, use breadth-first order.");
+    po.Read(argc, argv);
+
+    if (po.NumArgs() > 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = po.GetOptArg(1),
+        fst_out_filename = po.GetOptArg(2);
+
+    VectorFst<StdArc> *fst = ReadFstKaldi(fst_in_filename);
+    int32 num_states = fst->NumStates();
+
+    std::vector<int32> states;  // states in their new order.
+    GetBreadthFirstOrder(*fst, &states);
+
+    if (state_visits_rxfilename != "") {
+      Vector<double> state_visits;
+      ReadKaldiObject(state_visits_rxfilename, &state_visits);
+      if (state_visits.Dim() != num_states)
+        KALDI_ERR << "State-visit counts have dimension " << state_visits.Dim()
+                  << " but FST has " << num_states << " states (was a "
+                  << "different graph used?)";
+      std::stable_sort(states.begin(), states.end(),
+                       VisitCountGreater(state_visits));
+      int32 num_visited = 0;
+      for (int32 s = 0; s < num_states; s++)
+        if (state_visits(s) > 0.0) num_visited++;
+      KALDI_LOG << num_visited << " out of " << num_states
+                << " states were visited in the profile.";
+    }
+
+    std::vector<StdArc::StateId> order(num_states);  // old -> new state.
+    for (int32 i = 0; i < num_states; i++)
+      order[states[i]] = i;
+    StateSort(fst, order);
+
+    WriteFstKaldi(*fst, fst_out_filename);
+    delete fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -204,6 +204,112 @@ bool ComposeDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
   return true;
 }
 
+template<class Arc>
+InterpolatedDeterministicOnDemandFst<Arc>::InterpolatedDeterministicOnDemandFst(
+    const std::vector<DeterministicOnDemandFst<Arc>*> &fsts,
+    const std::vector<float> &weights,
+    bool log_linear): fsts_(fsts), weights_(weights),
+                      log_linear_(log_linear) {
+  KALDI_ASSERT(!fsts_.empty() && fsts_.size() == weights_.size());
+  std::vector<StateId> start_states(fsts_.size());
+  for (size_t i = 0; i < fsts_.size(); i++) {
+    KALDI_ASSERT(fsts_[i] != NULL && weights_[i] >= 0.0);
+    start_states[i] = fsts_[i]->Start();
+  }
+  start_state_ = FindOrAddState(start_states);
+}
+
+template<class Arc>
+typename Arc::StateId
+InterpolatedDeterministicOnDemandFst<Arc>::FindOrAddState(
+    const std::vector<StateId> &states) {
+  typedef typename MapType::iterator IterType;
+  std::pair<const std::vector<StateId>, StateId> new_value(
+      states, static_cast<StateId>(state_vec_.size()));
+  std::pair<IterType, bool> result = state_map_.insert(new_value);
+  if (result.second == true) // was inserted
+    state_vec_.push_back(states);
+  return result.first->second;
+}
+
+template<class Arc>
+typename Arc::Weight InterpolatedDeterministicOnDemandFst<Arc>::Combine(
+    const std::vector<Weight> &component_weights) const {
+  if (log_linear_) {
+    double tot_cost = 0.0;
+    for (size_t i = 0; i < component_weights.size(); i++) {
+      if (weights_[i] == 0.0)
+        continue;
+      if (component_weights[i] == Weight::Zero())
+        return Weight::Zero();
+      tot_cost += weights_[i] * component_weights[i].Value();
+    }
+    return Weight(tot_cost);
+  } else {
+    double tot_logprob = kaldi::kLogZeroDouble;
+    for (size_t i = 0; i < component_weights.size(); i++) {
+      if (weights_[i] == 0.0 || component_weights[i] == Weight::Zero())
+        continue;
+      double logprob = kaldi::Log(static_cast<double>(weights_[i])) -
+          component_weights[i].Value();
+      tot_logprob = kaldi::LogAdd(tot_logprob, logprob);
+    }
+    if (tot_logprob == kaldi::kLogZeroDouble)
+      return Weight::Zero();
+    return Weight(-tot_logprob);
+  }
+}
+
+template<class Arc>
+typename Arc::Weight InterpolatedDeterministicOnDemandFst<Arc>::Final(
+    StateId s) {
+  KALDI_ASSERT(s >= 0 && s < static_cast<StateId>(state_vec_.size()));
+  const std::vector<StateId> &states = state_vec_[s];
+  std::vector<Weight> finals(fsts_.size(), Weight::Zero());
+  for (size_t i = 0; i < fsts_.size(); i++) {
+    if (states[i] != kNoStateId)
+      finals[i] = fsts_[i]->Final(states[i]);
+  }
+  return Combine(finals);
+}
+
+template<class Arc>
+bool InterpolatedDeterministicOnDemandFst<Arc>::GetArc(StateId s,
+                                                       Label ilabel,
+                                                       Arc *oarc) {
+  KALDI_ASSERT(ilabel != 0);
+  KALDI_ASSERT(s >= 0 && s < static_cast<StateId>(state_vec_.size()));
+  // Note: we copy the tuple, as FindOrAddState() may reallocate state_vec_.
+  std::vector<StateId> states(state_vec_[s]);
+  std::vector<Weight> arc_weights(fsts_.size(), Weight::Zero());
+  bool found = false;
+  Label olabel = 0;
+  for (size_t i = 0; i < fsts_.size(); i++) {
+    Arc arc;
+    if (states[i] != kNoStateId && fsts_[i]->GetArc(states[i], ilabel, &arc)) {
+      if (!found) {
+        olabel = arc.olabel;
+        found = true;
+      }
+      arc_weights[i] = arc.weight;
+      states[i] = arc.nextstate;
+    } else {
+      states[i] = kNoStateId;
+    }
+  }
+  if (!found)
+    return false;
+  Weight weight = Combine(arc_weights);
+  if (weight == Weight::Zero())
+    return false;
+
+  oarc->ilabel = ilabel;
+  oarc->olabel = olabel;
+  oarc->nextstate = FindOrAddState(states);
+  oarc->weight = weight;
+  return true;
+}
+
 template<class Arc>
 inline size_t CacheDeterministicOnDemandFst<Arc>::GetIndex(
     StateId src_state, Label ilabel) {
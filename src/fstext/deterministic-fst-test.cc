@@ -218,6 +218,79 @@ void TestCompose() {
   }
 }
 
+void TestInterpolate() {
+  cout << "Test interpolation of backoff FSTs" << endl;
+  StdVectorFst *nfst = CreateBackoffFst();
+  ArcSort(nfst, StdILabelCompare());
+  BackoffDeterministicOnDemandFst<StdArc> dfst1(*nfst), dfst2(*nfst);
+
+  // A one-state FST that only has the words 10, 12 and 13.
+  StdVectorFst small_fst;
+  small_fst.AddState();
+  small_fst.SetStart(0);
+  small_fst.SetFinal(0, 0.0);
+  small_fst.AddArc(0, StdArc(10, 10, 1.0, 0));
+  small_fst.AddArc(0, StdArc(12, 12, 1.0, 0));
+  small_fst.AddArc(0, StdArc(13, 13, 1.0, 0));
+  BackoffDeterministicOnDemandFst<StdArc> dfst3(small_fst);
+
+  std::vector<DeterministicOnDemandFst<StdArc>*> fsts;
+  fsts.push_back(&dfst1);
+  fsts.push_back(&dfst2);
+  std::vector<float> weights;
+  weights.push_back(0.3);
+  weights.push_back(0.7);
+
+  // Interpolating an FST with itself should not change anything, linearly or
+  // log-linearly (for weights that sum to one).
+  for (int32 log_linear = 0; log_linear <= 1; log_linear++) {
+    InterpolatedDeterministicOnDemandFst<StdArc> ifst(fsts, weights,
+                                                      log_linear != 0);
+    StdArc arc, iarc;
+    StateId s = dfst1.Start(), is = ifst.Start();
+    for (int32 i = 0; i < 3; i++) {
+      Label ilabel = (i == 0 ? 10 : (i == 1 ? 14 : 15));
+      KALDI_ASSERT(dfst1.GetArc(s, ilabel, &arc) &&
+                   ifst.GetArc(is, ilabel, &iarc));
+      KALDI_ASSERT(ApproxEqual(arc.weight, iarc.weight) &&
+                   iarc.ilabel == ilabel && iarc.olabel == ilabel);
+      s = arc.nextstate;
+      is = iarc.nextstate;
+    }
+    KALDI_ASSERT(ApproxEqual(dfst1.Final(s), ifst.Final(is)));
+    KALDI_ASSERT(!ifst.GetArc(is, 15, &iarc));
+  }
+
+  fsts[1] = &dfst3;
+  weights[0] = weights[1] = 0.5;
+  { // Linear: word 14 is only in the first FST.
+    InterpolatedDeterministicOnDemandFst<StdArc> ifst(fsts, weights);
+    StdArc arc;
+    KALDI_ASSERT(ifst.GetArc(ifst.Start(), 10, &arc));
+    KALDI_ASSERT(ApproxEqual(arc.weight,
+                             Weight(-log(0.5 * exp(0.0) + 0.5 * exp(-1.0)))));
+    StateId s = arc.nextstate;
+    KALDI_ASSERT(ifst.GetArc(s, 14, &arc));
+    KALDI_ASSERT(ApproxEqual(arc.weight, Weight(0.8 - log(0.5))));
+    KALDI_ASSERT(ifst.GetArc(arc.nextstate, 15, &arc));
+    KALDI_ASSERT(ApproxEqual(arc.weight, Weight(0.5 - log(0.5))));
+    KALDI_ASSERT(ApproxEqual(ifst.Final(arc.nextstate),
+                             Weight(0.6 - log(0.5))));
+    // Arcs that lead to the same pair of states lead to the same state.
+    StdArc arc2;
+    KALDI_ASSERT(ifst.GetArc(ifst.Start(), 10, &arc2) &&
+                 arc2.nextstate == s && ifst.NumStates() == 4);
+  }
+  { // Log-linear: word 14 is not in the second FST, so the arc does not exist.
+    InterpolatedDeterministicOnDemandFst<StdArc> ifst(fsts, weights, true);
+    StdArc arc;
+    KALDI_ASSERT(ifst.GetArc(ifst.Start(), 10, &arc));
+    KALDI_ASSERT(ApproxEqual(arc.weight, Weight(0.5)));
+    KALDI_ASSERT(!ifst.GetArc(arc.nextstate, 14, &arc));
+  }
+  delete nfst;
+}
+
 }
 
 
@@ -225,5 +298,6 @@ int main() {
   using namespace fst;
   TestBackoffAndCache();
   TestCompose();
+  TestInterpolate();
 }
   
@@ -184,6 +184,73 @@ class ComposeDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
   StateId start_state_;
 };
     
+/**
+   InterpolatedDeterministicOnDemandFst combines several
+   DeterministicOnDemandFst's that have the same input vocabulary (typically
+   language models, e.g. wrapped ConstArpaLm's) into one.  Its states are
+   tuples of states of the component FSTs; the mapping from tuples to state
+   ids is kept in a hash, so each tuple is only stored once.
+
+   With linear interpolation (the default) the weight of an arc is
+     -log(sum_i weights[i] exp(-w_i)),
+   where w_i is the weight of the arc in component i; a component that has no
+   arc for the label contributes zero (and it contributes nothing to the
+   arcs or final-probs of the states reached from there).  The arc exists if
+   any component has it.  For language models, <weights> should sum to one.
+
+   With log-linear interpolation the weight is sum_i weights[i] w_i, and the
+   arc exists only if all components with nonzero weight have it.  We don't
+   renormalize, which is what you want for rescoring.
+
+   The output label of an arc is taken from the first component that has the
+   arc; the components should agree on it.
+ */
+template<class Arc>
+class InterpolatedDeterministicOnDemandFst:
+      public DeterministicOnDemandFst<Arc> {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// We don't take ownership of the fst's (see the comment for
+  /// ComposeDeterministicOnDemandFst).  <weights> must be the same size as
+  /// <fsts> and nonnegative.
+  InterpolatedDeterministicOnDemandFst(
+      const std::vector<DeterministicOnDemandFst<Arc>*> &fsts,
+      const std::vector<float> &weights,
+      bool log_linear = false);
+
+  virtual StateId Start() { return start_state_; }
+
+  virtual Weight Final(StateId s);
+
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
+
+  /// Returns the number of states created so far.
+  StateId NumStates() const { return state_vec_.size(); }
+
+ private:
+  // Combines the weights <component_weights> of the components (Zero() for a
+  // component that does not have the arc or final-prob); returns Zero() if
+  // the result does not exist.
+  Weight Combine(const std::vector<Weight> &component_weights) const;
+
+  // Returns the state id for the tuple <states>, adding it if necessary.
+  StateId FindOrAddState(const std::vector<StateId> &states);
+
+  std::vector<DeterministicOnDemandFst<Arc>*> fsts_;
+  std::vector<float> weights_;
+  bool log_linear_;
+  typedef unordered_map<std::vector<StateId>, StateId,
+                        kaldi::VectorHasher<StateId> > MapType;
+  MapType state_map_;
+  // Maps from StateId to the tuple of component states; kNoStateId for
+  // components that can no longer be reached (linear interpolation only).
+  std::vector<std::vector<StateId> > state_vec_;
+  StateId start_state_;
+};
+
 template<class Arc>
 class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
  public:
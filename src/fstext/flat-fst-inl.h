@@ -0,0 +1,325 @@
+// fstext/flat-fst-inl.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_FLAT_FST_INL_H_
+#define KALDI_FSTEXT_FLAT_FST_INL_H_
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <intrin.h>
+#endif
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "util/kaldi-io.h"
+
+// Do not include this file directly.  It is included by fstext/flat-fst.h.
+
+namespace fst {
+
+
+inline const std::string &FlatFst::Type() const {
+  static const std::string type("flat");
+  return type;
+}
+
+inline bool FlatFst::IsFlatFst(std::istream &is) {
+  return is.peek() == 'K';
+}
+
+inline long FlatFst::AddToRefCount(Storage *storage, long delta) {
+#ifdef _MSC_VER
+  return _InterlockedExchangeAdd(&storage->ref_count, delta) + delta;
+#else
+  return __sync_add_and_fetch(&storage->ref_count, delta);
+#endif
+}
+
+inline size_t FlatFst::CheckHeader(const Header &header, size_t max_size) {
+  if (strncmp(header.magic, "KFLATFST", 8) != 0) {
+    KALDI_WARN << "Not a FlatFst (bad magic string)";
+    return 0;
+  }
+  if (header.byte_order != kByteOrderMark) {
+    KALDI_WARN << "FlatFst was written on a machine with different byte order.";
+    return 0;
+  }
+  if (header.version != kVersion) {
+    KALDI_WARN << "FlatFst has unsupported version " << header.version;
+    return 0;
+  }
+  if (header.arc_size != static_cast<int32>(sizeof(Arc))) {
+    KALDI_WARN << "FlatFst has arc size " << header.arc_size
+               << ", expected " << sizeof(Arc);
+    return 0;
+  }
+  if (header.start >= static_cast<int64>(header.num_states) ||
+      header.start < kNoStateId) {
+    KALDI_WARN << "FlatFst has invalid start state " << header.start;
+    return 0;
+  }
+  // Check the sizes without overflowing, so that a corrupt header can't make
+  // us allocate or map a wrongly sized object.
+  if (max_size < sizeof(Header) ||
+      header.num_states > (max_size - sizeof(Header)) / sizeof(State)) {
+    KALDI_WARN << "FlatFst has too many states (" << header.num_states
+               << ") for its size";
+    return 0;
+  }
+  size_t states_end = sizeof(Header) + header.num_states * sizeof(State);
+  if (header.num_arcs > (max_size - states_end) / sizeof(Arc)) {
+    KALDI_WARN << "FlatFst has too many arcs (" << header.num_arcs
+               << ") for its size";
+    return 0;
+  }
+  return states_end + header.num_arcs * sizeof(Arc);
+}
+
+inline bool FlatFst::CheckStatesAndArcs(const char *data) {
+  const Header &header = *reinterpret_cast<const Header*>(data);
+  const State *states = reinterpret_cast<const State*>(data + sizeof(Header));
+  const Arc *arcs = reinterpret_cast<const Arc*>(
+      data + sizeof(Header) + header.num_states * sizeof(State));
+  for (uint64 s = 0; s < header.num_states; s++) {
+    const State &state = states[s];
+    // Written so as not to overflow.
+    if (state.first_arc > header.num_arcs ||
+        state.num_arcs > header.num_arcs - state.first_arc) {
+      KALDI_WARN << "FlatFst state " << s << " has arcs " << state.first_arc
+                 << " to " << (state.first_arc + state.num_arcs)
+                 << ", but there are only " << header.num_arcs << " arcs.";
+      return false;
+    }
+    if (state.num_input_epsilons > state.num_arcs ||
+        state.num_output_epsilons > state.num_arcs) {
+      KALDI_WARN << "FlatFst state " << s << " has more epsilons than arcs.";
+      return false;
+    }
+  }
+  for (uint64 a = 0; a < header.num_arcs; a++) {
+    StateId nextstate = arcs[a].nextstate;
+    if (nextstate < 0 || static_cast<uint64>(nextstate) >= header.num_states) {
+      KALDI_WARN << "FlatFst arc " << a << " has invalid next-state "
+                 << nextstate;
+      return false;
+    }
+  }
+  return true;
+}
+
+inline FlatFst::FlatFst(Storage *storage): storage_(storage) {
+  const char *data = static_cast<const char*>(storage->data);
+  header_ = reinterpret_cast<const Header*>(data);
+  states_ = reinterpret_cast<const State*>(data + sizeof(Header));
+  arcs_ = reinterpret_cast<const Arc*>(data + sizeof(Header) +
+                                       header_->num_states * sizeof(State));
+}
+
+inline FlatFst::FlatFst(const FlatFst &other):
+    storage_(other.storage_), header_(other.header_), states_(other.states_),
+    arcs_(other.arcs_) {
+  AddToRefCount(storage_, 1);
+}
+
+inline FlatFst::~FlatFst() {
+  if (AddToRefCount(storage_, -1) == 0)
+    FreeStorage(storage_);
+}
+
+inline void FlatFst::FreeStorage(Storage *storage) {
+  if (storage->is_mmapped) {
+#ifndef _MSC_VER
+    if (munmap(storage->data, storage->size) != 0)
+      KALDI_WARN << "munmap failed: " << strerror(errno);
+#endif
+  } else {
+    delete [] static_cast<uint64*>(storage->data);
+  }
+  delete storage;
+}
+
+inline FlatFst *FlatFst::Read(std::istream &is, bool check) {
+  Header header;
+  if (!is.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    KALDI_ERR << "Error reading FlatFst header.";
+  // We don't know the length of a stream, so only check for overflow.
+  size_t size = CheckHeader(header, std::numeric_limits<size_t>::max());
+  if (size == 0)
+    KALDI_ERR << "Error reading FlatFst: invalid header.";
+  Storage *storage = new Storage();
+  // Allocate as uint64 so that the arrays are aligned.
+  storage->data = new uint64[(size + 7) / 8];
+  storage->size = size;
+  char *data = static_cast<char*>(storage->data);
+  memcpy(data, &header, sizeof(header));
+  if (!is.read(data + sizeof(header), size - sizeof(header))) {
+    FreeStorage(storage);
+    KALDI_ERR << "Error reading FlatFst: file too short.";
+  }
+  if (check && !CheckStatesAndArcs(data)) {
+    FreeStorage(storage);
+    KALDI_ERR << "Error reading FlatFst: invalid states or arcs.";
+  }
+  return new FlatFst(storage);
+}
+
+inline FlatFst *FlatFst::Read(std::string rxfilename, bool check) {
+  if (rxfilename == "") rxfilename = "-";
+#ifdef _MSC_VER
+  // We don't memory-map on Windows.
+  kaldi::Input ki(rxfilename);
+  return Read(ki.Stream(), check);
+#else
+  if (kaldi::ClassifyRxfilename(rxfilename) != kaldi::kFileInput) {
+    kaldi::Input ki(rxfilename);
+    return Read(ki.Stream(), check);
+  }
+  int fd = open(rxfilename.c_str(), O_RDONLY);
+  if (fd == -1)
+    KALDI_ERR << "Could not open " << rxfilename << " for reading: "
+              << strerror(errno);
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    close(fd);
+    KALDI_ERR << "Could not stat " << rxfilename << ": " << strerror(errno);
+  }
+  size_t file_size = stat_buf.st_size;
+  if (file_size < sizeof(Header)) {
+    close(fd);
+    KALDI_ERR << "Error reading FlatFst from " << rxfilename
+              << ": file too short.";
+  }
+  void *data = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // The mapping stays valid after closing the file.
+  if (data == MAP_FAILED)
+    KALDI_ERR << "Could not memory-map " << rxfilename << ": "
+              << strerror(errno);
+  Storage *storage = new Storage();
+  storage->is_mmapped = true;
+  storage->data = data;
+  storage->size = file_size;
+  if (CheckHeader(*static_cast<const Header*>(data), file_size) == 0) {
+    FreeStorage(storage);
+    KALDI_ERR << "Error reading FlatFst from " << rxfilename
+              << ": invalid header or file too short.";
+  }
+  if (check && !CheckStatesAndArcs(static_cast<const char*>(data))) {
+    FreeStorage(storage);
+    KALDI_ERR << "Error reading FlatFst from " << rxfilename
+              << ": invalid states or arcs.";
+  }
+  return new FlatFst(storage);
+#endif
+}
+
+inline void FlatFst::WriteFst(const Fst<StdArc> &fst, std::ostream &os) {
+  KALDI_COMPILE_TIME_ASSERT(sizeof(Header) == 64 && sizeof(State) == 24 &&
+                            sizeof(Arc) == 16);
+  // The arcs are written in order of source state, so we must visit the
+  // states in numerical order, whatever order a StateIterator would give.
+  StateId num_states = CountStates(fst);
+  std::vector<State> states(num_states);
+  uint64 num_arcs = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    State &state = states[s];
+    state.final_cost = fst.Final(s).Value();
+    state.num_arcs = 0;
+    state.num_input_epsilons = 0;
+    state.num_output_epsilons = 0;
+    state.first_arc = num_arcs;
+    for (ArcIterator<Fst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      KALDI_ASSERT(arc.nextstate >= 0 && arc.nextstate < num_states);
+      state.num_arcs++;
+      if (arc.ilabel == 0) state.num_input_epsilons++;
+      if (arc.olabel == 0) state.num_output_epsilons++;
+    }
+    num_arcs += state.num_arcs;
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "KFLATFST", 8);
+  header.byte_order = kByteOrderMark;
+  header.version = kVersion;
+  header.arc_size = sizeof(Arc);
+  header.start = fst.Start();
+  header.num_states = num_states;
+  header.num_arcs = num_arcs;
+  header.properties = (fst.Properties(kTrinaryProperties, true) &
+                       kTrinaryProperties) | kExpanded;
+
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (num_states != 0)
+    os.write(reinterpret_cast<const char*>(&(states[0])),
+             sizeof(State) * num_states);
+  for (StateId s = 0; s < num_states; s++) {
+    for (ArcIterator<Fst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      os.write(reinterpret_cast<const char*>(&arc), sizeof(arc));
+    }
+  }
+  if (!os.good())
+    KALDI_ERR << "Error writing FlatFst.";
+}
+
+
+inline Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename) {
+  if (rxfilename == "") rxfilename = "-"; // interpret "" as stdin,
+  // for compatibility with OpenFst conventions.
+  kaldi::Input ki(rxfilename);
+  if (FlatFst::IsFlatFst(ki.Stream())) {
+    if (kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput) {
+      ki.Close();
+      return FlatFst::Read(rxfilename);  // memory-maps the file.
+    } else {
+      return FlatFst::Read(ki.Stream());
+    }
+  }
+  FstHeader hdr;
+  if (!hdr.Read(ki.Stream(), rxfilename))
+    KALDI_ERR << "Reading FST: error reading FST header from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  if (hdr.ArcType() != StdArc::Type())
+    KALDI_ERR << "FST with arc type " << hdr.ArcType() << " not supported.";
+  FstReadOptions ropts("<unspecified>", &hdr);
+  Fst<StdArc> *fst = NULL;
+  if (hdr.FstType() == "vector") {
+    fst = VectorFst<StdArc>::Read(ki.Stream(), ropts);
+  } else if (hdr.FstType() == "const") {
+    fst = ConstFst<StdArc>::Read(ki.Stream(), ropts);
+  } else {
+    KALDI_ERR << "Reading FST: unsupported FST type: " << hdr.FstType();
+  }
+  if (fst == NULL)
+    KALDI_ERR << "Could not read fst from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  return fst;
+}
+
+
+} // end namespace fst
+
+#endif
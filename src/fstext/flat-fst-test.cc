@@ -0,0 +1,177 @@
+// fstext/flat-fst-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include "fstext/rand-fst.h"
+#include "fstext/flat-fst.h"
+#include "fstext/fstext-utils.h"
+#include "util/kaldi-io.h"
+
+
+namespace fst {
+
+// Checks that the two FSTs have exactly the same states, arcs (in the same
+// order) and final-probs.
+void AssertIdentical(const Fst<StdArc> &fst1, const Fst<StdArc> &fst2) {
+  typedef StdArc::StateId StateId;
+  KALDI_ASSERT(fst1.Start() == fst2.Start());
+  StateId num_states = CountStates(fst1);
+  KALDI_ASSERT(num_states == CountStates(fst2));
+  for (StateId s = 0; s < num_states; s++) {
+    KALDI_ASSERT(fst1.Final(s) == fst2.Final(s));
+    KALDI_ASSERT(fst1.NumArcs(s) == fst2.NumArcs(s));
+    KALDI_ASSERT(fst1.NumInputEpsilons(s) == fst2.NumInputEpsilons(s));
+    KALDI_ASSERT(fst1.NumOutputEpsilons(s) == fst2.NumOutputEpsilons(s));
+    ArcIterator<Fst<StdArc> > aiter1(fst1, s), aiter2(fst2, s);
+    for (; !aiter1.Done(); aiter1.Next(), aiter2.Next()) {
+      KALDI_ASSERT(!aiter2.Done());
+      const StdArc &arc1 = aiter1.Value(), &arc2 = aiter2.Value();
+      KALDI_ASSERT(arc1.ilabel == arc2.ilabel && arc1.olabel == arc2.olabel &&
+                   arc1.weight == arc2.weight &&
+                   arc1.nextstate == arc2.nextstate);
+    }
+    KALDI_ASSERT(aiter2.Done());
+  }
+}
+
+void TestFlatFst(bool memory_map) {
+  VectorFst<StdArc> *fst = RandFst<StdArc>();
+  {
+    kaldi::Output ko("tmp.flat.fst", true, false);
+    FlatFst::WriteFst(*fst, ko.Stream());
+  }
+  // Reading with a filename memory-maps the file; reading from the stream
+  // goes via memory.
+  FlatFst *flat_fst;
+  if (memory_map) {
+    flat_fst = FlatFst::Read("tmp.flat.fst");
+  } else {
+    kaldi::Input ki("tmp.flat.fst");
+    KALDI_ASSERT(FlatFst::IsFlatFst(ki.Stream()));
+    flat_fst = FlatFst::Read(ki.Stream());
+  }
+  AssertIdentical(*fst, *flat_fst);
+  KALDI_ASSERT(flat_fst->Properties(kExpanded, false) == kExpanded);
+  KALDI_ASSERT(flat_fst->Properties(kAcceptor, false) ==
+               fst->Properties(kAcceptor, true));
+
+  {  // Test that copies share the memory and outlive the original.
+    Fst<StdArc> *copy = flat_fst->Copy();
+    delete flat_fst;
+    AssertIdentical(*fst, *copy);
+    delete copy;
+  }
+  {  // ReadFstKaldiGeneric() should accept both formats.
+    Fst<StdArc> *fst2 = ReadFstKaldiGeneric("tmp.flat.fst");
+    KALDI_ASSERT(fst2->Type() == "flat");
+    AssertIdentical(*fst, *fst2);
+    delete fst2;
+    WriteFstKaldi(*fst, "tmp.flat.fst");
+    fst2 = ReadFstKaldiGeneric("tmp.flat.fst");
+    KALDI_ASSERT(fst2->Type() == "vector");
+    AssertIdentical(*fst, *fst2);
+    delete fst2;
+  }
+  delete fst;
+  unlink("tmp.flat.fst");
+}
+
+// Writes "data" to a file and returns true if FlatFst::Read() throws on it.
+bool FlatFstReadFails(const std::string &data, bool memory_map) {
+  {
+    std::ofstream ofs("tmp.flat.fst", std::ios::binary);
+    ofs << data;
+  }
+  bool threw = false;
+  try {
+    FlatFst *flat_fst;
+    if (memory_map) {
+      flat_fst = FlatFst::Read("tmp.flat.fst");
+    } else {
+      kaldi::Input ki("tmp.flat.fst");
+      flat_fst = FlatFst::Read(ki.Stream());
+    }
+    delete flat_fst;
+  } catch (...) {
+    threw = true;
+  }
+  unlink("tmp.flat.fst");
+  return threw;
+}
+
+// Checks that a file whose header claims more states or arcs than the file
+// holds is rejected, including when the sizes would overflow.
+void TestFlatFstBadHeader(bool memory_map) {
+  VectorFst<StdArc> *fst = RandFst<StdArc>();
+  std::ostringstream os;
+  FlatFst::WriteFst(*fst, os);
+  delete fst;
+  std::string data = os.str();
+  // num_states and num_arcs are the uint64s at bytes 24 and 32 of the header.
+  uint64 num_states = std::numeric_limits<uint64>::max() / 8;
+  if (kaldi::RandInt(0, 1) == 0)
+    memcpy(&(data[24]), &num_states, sizeof(num_states));
+  else
+    memcpy(&(data[32]), &num_states, sizeof(num_states));
+  KALDI_ASSERT(FlatFstReadFails(data, memory_map));
+}
+
+// Checks that a file with a state whose arcs are out of range, or an arc
+// whose next-state is out of range, is rejected.
+void TestFlatFstBadArcs(bool memory_map) {
+  VectorFst<StdArc> *fst = RandFst<StdArc>();
+  StdArc::StateId num_states = fst->NumStates();
+  size_t num_arcs = 0;
+  for (StdArc::StateId s = 0; s < num_states; s++)
+    num_arcs += fst->NumArcs(s);
+  std::ostringstream os;
+  FlatFst::WriteFst(*fst, os);
+  delete fst;
+  std::string data = os.str();
+  KALDI_ASSERT(!FlatFstReadFails(data, memory_map));
+  if (num_states == 0) return;
+  // The header is 64 bytes, and is followed by the 24-byte states, with
+  // first_arc at byte 16, and then the 16-byte arcs, with nextstate at byte
+  // 12.
+  if (num_arcs == 0 || kaldi::RandInt(0, 1) == 0) {
+    int32 s = kaldi::RandInt(0, num_states - 1);
+    uint64 first_arc = num_arcs + 1;
+    memcpy(&(data[64 + 24 * s + 16]), &first_arc, sizeof(first_arc));
+  } else {
+    size_t a = kaldi::RandInt(0, num_arcs - 1);
+    int32 nextstate = (kaldi::RandInt(0, 1) == 0 ? -1 : num_states);
+    memcpy(&(data[64 + 24 * num_states + 16 * a + 12]), &nextstate,
+           sizeof(nextstate));
+  }
+  KALDI_ASSERT(FlatFstReadFails(data, memory_map));
+}
+
+} // end namespace fst
+
+int main() {
+  using namespace fst;
+  for (int i = 0; i < 10; i++) {
+    TestFlatFst(i % 2 == 0);
+    TestFlatFstBadHeader(i % 2 == 0);
+    TestFlatFstBadArcs(i % 2 == 0);
+  }
+  std::cout << "Test OK\n";
+}
@@ -0,0 +1,201 @@
+// fstext/flat-fst.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_FLAT_FST_H_
+#define KALDI_FSTEXT_FLAT_FST_H_
+
+#include <string>
+#include <fst/fstlib.h>
+#include "base/kaldi-common.h"
+
+/* This header defines FlatFst, a read-only ExpandedFst<StdArc> whose on-disk
+   representation is identical to its in-memory representation: a fixed-size
+   header, an array of per-state records and an array of StdArcs (ordered by
+   source state).  When the file is a regular file it is memory-mapped rather
+   than read (except on Windows, where it is always read), so several decoding
+   processes on the same machine share one copy of the graph in the page
+   cache.  When the input is a pipe or stdin we fall back to reading it into
+   memory.  By default Read() checks that every state's arcs and every arc's
+   next-state are within range, so that a corrupt or truncated file can't make
+   the decoder read out of bounds; this touches the whole file once.  With
+   check == false even a very large HCLG graph loads in no time and pages are
+   only brought in as the decoder touches them, but the file must be trusted.
+
+   The arc iterator hands out a pointer directly into the arc array, as
+   ConstFst does, so decoding speed is the same as with ConstFst.
+
+   The format is native-endian and is not meant to be portable between
+   machines of different byte order; this is detected on reading.  Use the
+   program fstmakeflat to convert an FST to this format.  The decoding binaries
+   read graphs with ReadFstKaldiGeneric(), which accepts this format as well as
+   the OpenFst "vector" and "const" types.
+*/
+
+namespace fst {
+
+class FlatFst: public ExpandedFst<StdArc> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  typedef Arc::Label Label;
+
+  /// Reads a FlatFst from "rxfilename", which must be in the format written by
+  /// WriteFst().  If rxfilename is an ordinary file it is memory-mapped;
+  /// otherwise (pipe, stdin, or file with offset) it is read into memory.
+  /// If "check" is true, checks each state and arc (see above).  Throws on
+  /// error.
+  static FlatFst *Read(std::string rxfilename, bool check = true);
+
+  /// Reads a FlatFst from a stream (into memory; nothing is memory-mapped).
+  /// Throws on error.
+  static FlatFst *Read(std::istream &is, bool check = true);
+
+  /// Writes "fst" to the stream in the flat format (the stream should be
+  /// binary).  Throws on error.
+  static void WriteFst(const Fst<StdArc> &fst, std::ostream &os);
+
+  /// Returns true if the next bytes in the stream look like the start of a
+  /// FlatFst (only the first byte is examined, with peek(), so this works on
+  /// pipes).  OpenFst's binary formats start with a different byte.
+  static bool IsFlatFst(std::istream &is);
+
+  FlatFst(const FlatFst &other);
+
+  virtual ~FlatFst();
+
+  virtual StateId Start() const { return header_->start; }
+
+  virtual Weight Final(StateId s) const {
+    return Weight(states_[s].final_cost);
+  }
+
+  virtual StateId NumStates() const { return header_->num_states; }
+
+  virtual size_t NumArcs(StateId s) const { return states_[s].num_arcs; }
+
+  virtual size_t NumInputEpsilons(StateId s) const {
+    return states_[s].num_input_epsilons;
+  }
+
+  virtual size_t NumOutputEpsilons(StateId s) const {
+    return states_[s].num_output_epsilons;
+  }
+
+  /// The properties are computed once, by WriteFst(), so "test" makes no
+  /// difference.
+  virtual uint64 Properties(uint64 mask, bool test) const {
+    return header_->properties & mask;
+  }
+
+  virtual const string &Type() const;
+
+  /// The copy shares the underlying memory with this object.
+  virtual FlatFst *Copy(bool safe = false) const { return new FlatFst(*this); }
+
+  virtual const SymbolTable *InputSymbols() const { return NULL; }
+
+  virtual const SymbolTable *OutputSymbols() const { return NULL; }
+
+  virtual void InitStateIterator(StateIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->nstates = header_->num_states;
+  }
+
+  virtual void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->arcs = arcs_ + states_[s].first_arc;
+    data->narcs = states_[s].num_arcs;
+    data->ref_count = NULL;
+  }
+
+ private:
+  // The file starts with this header; its size is a multiple of 8 so that the
+  // arrays that follow are aligned.
+  struct Header {
+    char magic[8];  // "KFLATFST"
+    uint32 byte_order;  // kByteOrderMark as written by the writing machine.
+    int32 version;
+    int32 arc_size;  // sizeof(StdArc), as a sanity check.
+    int32 start;
+    uint64 num_states;
+    uint64 num_arcs;
+    uint64 properties;
+    char padding[16];
+  };
+  struct State {
+    float final_cost;
+    uint32 num_arcs;
+    uint32 num_input_epsilons;
+    uint32 num_output_epsilons;
+    uint64 first_arc;  // index of first arc leaving this state.
+  };
+  // Owns the memory, which is shared between copies of a FlatFst; copies may
+  // be made and deleted in different threads, so ref_count is only changed
+  // with AddToRefCount().
+  struct Storage {
+    volatile long ref_count;
+    bool is_mmapped;
+    void *data;
+    size_t size;  // size in bytes.
+    Storage(): ref_count(1), is_mmapped(false), data(NULL), size(0) { }
+  };
+
+  static const uint32 kByteOrderMark = 0x01020304;
+  static const int32 kVersion = 1;
+
+  // Checks the header and returns the size in bytes that the whole object
+  // should have, or warns and returns 0 if the header is not valid or that
+  // size would be more than "max_size" (e.g. the size of the file).
+  static size_t CheckHeader(const Header &header, size_t max_size);
+
+  // Checks that the arcs of each state are within the arc array and that each
+  // arc's next-state is a valid state; "data" must have passed CheckHeader().
+  // Warns and returns false if not.
+  static bool CheckStatesAndArcs(const char *data);
+
+  // Atomically adds "delta" to storage->ref_count and returns the new value.
+  static long AddToRefCount(Storage *storage, long delta);
+
+  // Takes ownership of the storage (whose ref_count is 1), which must already
+  // have been checked, and sets up the pointers.
+  explicit FlatFst(Storage *storage);
+  static void FreeStorage(Storage *storage);
+
+  Storage *storage_;
+  const Header *header_;
+  const State *states_;
+  const Arc *arcs_;
+
+  FlatFst &operator = (const FlatFst &other);  // Disallow.
+};
+
+
+/// Reads a decoding graph from "rxfilename", which may be in the FlatFst
+/// format (see flat-fst.h) or the OpenFst "vector" or "const" formats.
+/// Throws on error.  This is what the decoding programs use, so any of them
+/// can be given a graph converted with fstmakeflat.
+Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename);
+
+
+} // end namespace fst
+
+#include "fstext/flat-fst-inl.h"
+
+#endif
@@ -32,4 +32,5 @@
 #include "lattice-utils.h"
 #include "determinize-lattice.h"
 #include "deterministic-fst.h"
+#include "flat-fst.h"
 #endif
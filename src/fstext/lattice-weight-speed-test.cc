@@ -0,0 +1,184 @@
+// fstext/lattice-weight-speed-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "base/kaldi-math.h"
+#include "base/timer.h"
+#include "fstext/lattice-weight.h"
+
+namespace fst {
+
+typedef LatticeWeightTpl<float> LatticeWeight;
+typedef CompactLatticeWeightTpl<LatticeWeight, int32> CompactLatticeWeight;
+
+/* This compares the speed of CompactLatticeWeight, whose strings are shared
+   between copies, with UnsharedWeight, which stores its string in a vector as
+   CompactLatticeWeight used to, on the operations that the lattice algorithms
+   do most often with weights: copying them (e.g. copying arcs, or in
+   ArcSort()), Plus(), which returns a copy of one of its arguments, and Times()
+   by a weight with an empty string (e.g. adding a graph or acoustic cost).
+   Times() of two non-empty strings has to make a new string either way, and is
+   slightly slower for CompactLatticeWeight; we time it too.  As in a
+   CompactLattice, most of the strings have a few transition-ids.
+*/
+
+class UnsharedWeight {
+ public:
+  UnsharedWeight() { }
+  UnsharedWeight(const LatticeWeight &w, const vector<int32> &s):
+      weight_(w), string_(s) { }
+  const LatticeWeight &Weight() const { return weight_; }
+  const vector<int32> &String() const { return string_; }
+ private:
+  LatticeWeight weight_;
+  vector<int32> string_;
+};
+
+// As CompactLatticeWeight's Compare(), Plus() and Times() were before the
+// strings were shared.
+inline int Compare(const UnsharedWeight &w1, const UnsharedWeight &w2) {
+  int c1 = Compare(w1.Weight(), w2.Weight());
+  if (c1 != 0) return c1;
+  int l1 = w1.String().size(), l2 = w2.String().size();
+  if (l1 > l2) return -1;
+  else if (l1 < l2) return 1;
+  for (int i = 0; i < l1; i++) {
+    if (w1.String()[i] < w2.String()[i]) return -1;
+    else if (w1.String()[i] > w2.String()[i]) return 1;
+  }
+  return 0;
+}
+
+inline UnsharedWeight Plus(const UnsharedWeight &w1,
+                           const UnsharedWeight &w2) {
+  return (Compare(w1, w2) >= 0 ? w1 : w2);
+}
+
+inline UnsharedWeight Times(const UnsharedWeight &w1,
+                            const UnsharedWeight &w2) {
+  LatticeWeight w = Times(w1.Weight(), w2.Weight());
+  vector<int32> v(w1.String());
+  v.insert(v.end(), w2.String().begin(), w2.String().end());
+  return UnsharedWeight(w, v);
+}
+
+template<class W>
+void RandomWeights(int32 num_weights, int32 max_length, vector<W> *weights) {
+  weights->clear();
+  for (int32 i = 0; i < num_weights; i++) {
+    vector<int32> str(kaldi::RandInt(0, max_length));
+    for (size_t j = 0; j < str.size(); j++)
+      str[j] = kaldi::RandInt(1, 10000);
+    weights->push_back(W(LatticeWeight(kaldi::RandGauss(),
+                                       kaldi::RandGauss()), str));
+  }
+}
+
+// Compares weights by their first cost, in increasing or decreasing order.
+template<class W>
+struct CostCompare {
+  explicit CostCompare(bool increasing): increasing(increasing) { }
+  bool operator() (const W &w1, const W &w2) const {
+    return (w1.Weight().Value1() < w2.Weight().Value1()) == increasing;
+  }
+  bool increasing;
+};
+
+enum Operation { kCopy, kAssign, kPlus, kTimesEmpty, kTimes, kSort,
+                 kNumOperations };
+
+// Does operation "op" on (or with) each of the weights, "num_repeats" times,
+// and returns the time taken in seconds.
+template<class W>
+double TimeOperation(Operation op, const vector<W> &weights,
+                     const vector<W> &others, const vector<W> &costs,
+                     int32 num_repeats) {
+  int32 n = weights.size();
+  vector<W> results(weights);
+  size_t tot_length = 0;  // so the work cannot be optimized away.
+  kaldi::Timer timer;
+  for (int32 r = 0; r < num_repeats; r++) {
+    switch (op) {
+      case kCopy: {  // e.g. copying a lattice's arcs.
+        vector<W> copy(weights);
+        tot_length += copy[r % n].String().size();
+        break;
+      }
+      case kAssign:
+        for (int32 i = 0; i < n; i++) results[i] = others[i];
+        break;
+      case kPlus:
+        for (int32 i = 0; i < n; i++)
+          results[i] = Plus(weights[i], others[i]);
+        break;
+      case kTimesEmpty:
+        for (int32 i = 0; i < n; i++)
+          results[i] = Times(weights[i], costs[i]);
+        break;
+      case kTimes:
+        for (int32 i = 0; i < n; i++)
+          results[i] = Times(weights[i], others[i]);
+        break;
+      case kSort:  // e.g. sorting arcs; the order is reversed each time.
+        std::sort(results.begin(), results.end(), CostCompare<W>(r % 2 == 0));
+        break;
+      default:
+        KALDI_ERR << "Bad operation";
+    }
+    tot_length += results[r % n].String().size();
+  }
+  KALDI_VLOG(2) << "Total length is " << tot_length;
+  return timer.Elapsed();
+}
+
+template<class W>
+void TimeWeights(int32 num_weights, int32 num_repeats,
+                 vector<double> *times) {
+  srand(0);  // So both weight types get the same weights.
+  vector<W> weights, others, costs;
+  RandomWeights(num_weights, 8, &weights);
+  RandomWeights(num_weights, 8, &others);
+  RandomWeights(num_weights, 0, &costs);  // with empty strings.
+  times->clear();
+  for (int32 op = 0; op < kNumOperations; op++)
+    times->push_back(TimeOperation(static_cast<Operation>(op), weights,
+                                   others, costs, num_repeats));
+}
+
+void LatticeWeightSpeedTest() {
+  int32 num_weights = 100000, num_repeats = 50;
+  vector<double> shared_times, unshared_times;
+  TimeWeights<CompactLatticeWeight>(num_weights, num_repeats, &shared_times);
+  TimeWeights<UnsharedWeight>(num_weights, num_repeats, &unshared_times);
+  const char *names[] = { "copy-construct", "assign", "Plus",
+                          "Times by empty string", "Times", "sort" };
+  for (int32 op = 0; op < kNumOperations; op++)
+    KALDI_LOG << "For " << names[op] << " of " << num_weights << " weights, "
+              << num_repeats << " times, took " << unshared_times[op]
+              << " seconds with unshared strings and " << shared_times[op]
+              << " seconds with shared strings (speedup "
+              << (unshared_times[op] / shared_times[op]) << ")";
+}
+
+}  // end namespace fst
+
+int main() {
+  fst::LatticeWeightSpeedTest();
+  std::cout << "Test OK.\n";
+}
@@ -18,6 +18,7 @@
 // limitations under the License.
 #include "base/kaldi-math.h"
 #include "fstext/lattice-weight.h"
+#include "thread/kaldi-thread.h"
 
 namespace fst {
 // these typedefs are the same as in ../lat/kaldi-lattice.h, but
@@ -184,11 +185,83 @@ void CompactLatticeWeightTest() {
   }
 }
 
+// Tests that weights which share their strings behave like separate copies.
+void CompactLatticeWeightSharingTest() {
+  for(int32 i = 0; i < 100; i++) {
+    CompactLatticeWeight l1 = RandomCompactLatticeWeight();
+    vector<int32> str(l1.String());
+    CompactLatticeWeight l2(l1), l3 = l1, l4;
+    l4 = Times(l1, CompactLatticeWeight::One());
+    KALDI_ASSERT(l2 == l1 && l3 == l1 && l4 == l1);
+    KALDI_ASSERT(&(l2.String()) == &(l1.String()));  // no copy was made.
+    l2.SetString(vector<int32>(1, 42));
+    l3.SetWeight(LatticeWeight(3, 4));
+    const CompactLatticeWeight &l4_ref = l4;
+    l4 = l4_ref;  // self-assignment.
+    KALDI_ASSERT(l1.String() == str && l3.String() == str && l4 == l1);
+    KALDI_ASSERT(l2.String().size() == 1 && l2.String()[0] == 42);
+    {
+      CompactLatticeWeight l5(l1);
+      l1 = CompactLatticeWeight::Zero();
+      KALDI_ASSERT(l5.String() == str);  // l5 keeps the string alive.
+    }
+  }
+}
+
+// Copies, assigns and destroys weights that share their strings with the
+// weights in "weights", which are used by several threads at once.
+class SharedStringTestClass: public kaldi::MultiThreadable {
+ public:
+  SharedStringTestClass(const vector<CompactLatticeWeight> *weights,
+                        int32 num_steps):
+      weights_(weights), num_steps_(num_steps) { }
+
+  void operator() () {
+    kaldi::RandomState rand_state;
+    int32 n = weights_->size();
+    vector<CompactLatticeWeight> copies(10);
+    for (int32 i = 0; i < num_steps_; i++) {
+      const CompactLatticeWeight &w =
+          (*weights_)[kaldi::RandInt(0, n - 1, &rand_state)];
+      int32 j = kaldi::RandInt(0, 9, &rand_state);
+      if (i % 2 == 0) {
+        copies[j] = w;
+      } else {
+        CompactLatticeWeight copy(w);
+        copies[j] = Times(copy, CompactLatticeWeight::One());
+      }
+    }
+  }
+
+ private:
+  const vector<CompactLatticeWeight> *weights_;
+  int32 num_steps_;
+};
+
+// Tests that the reference counts of the shared strings are thread-safe; with
+// unlocked counts, strings would sometimes be freed while still in use.
+void CompactLatticeWeightThreadTest() {
+  vector<CompactLatticeWeight> weights;
+  vector<vector<int32> > strings;
+  for (int32 i = 0; i < 5; i++) {
+    vector<int32> str(i + 1, i + 1);
+    weights.push_back(CompactLatticeWeight(LatticeWeight(i, 0), str));
+    strings.push_back(str);
+  }
+  SharedStringTestClass c(&weights, 100000);
+  {
+    kaldi::MultiThreader<SharedStringTestClass> m(4, c);
+  }
+  for (int32 i = 0; i < 5; i++)
+    KALDI_ASSERT(weights[i].String() == strings[i]);
+}
 
 }
 
 int main() {
   fst::LatticeWeightTest();
   fst::CompactLatticeWeightTest();  
+  fst::CompactLatticeWeightSharingTest();
+  fst::CompactLatticeWeightThreadTest();
 }
 
@@ -21,6 +21,9 @@
 #ifndef KALDI_FSTEXT_LATTICE_WEIGHT_H_
 #define KALDI_FSTEXT_LATTICE_WEIGHT_H_
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #include "fst/fstlib.h"
 #include "base/kaldi-common.h"
 
@@ -403,25 +406,83 @@ class CompactLatticeWeightTpl {
   // total order].
   // Times, Divide obvious... (support both left & right division..)
   // CommonDivisor would need to be coded separately.
+  //
+  // The string is never changed once created, and is shared (with a reference
+  // count) between copies of the weight, so copying weights, Plus() and
+  // Times() by a weight with an empty string don't need to allocate memory.
+  // The reference counts are changed atomically, so copies that share a
+  // string may be made, assigned and destroyed in different threads; as for
+  // any other type, one weight object must not be assigned to in one thread
+  // while another thread is using it.
 
-  CompactLatticeWeightTpl() { }
+  CompactLatticeWeightTpl(): string_(NULL) { }
 
   CompactLatticeWeightTpl(const WeightType &w, const vector<IntType> &s):
-      weight_(w), string_(s) { }
+      weight_(w), string_(NewString(s, vector<IntType>())) { }
+
+  // Makes a weight whose string is s1 followed by s2.
+  CompactLatticeWeightTpl(const WeightType &w, const vector<IntType> &s1,
+                          const vector<IntType> &s2):
+      weight_(w), string_(NewString(s1, s2)) { }
+
+  // Makes a weight with the weight "w" and the string of "s", which it
+  // shares.
+  CompactLatticeWeightTpl(
+      const WeightType &w,
+      const CompactLatticeWeightTpl<WeightType, IntType> &s):
+      weight_(w), string_(s.string_) {
+    if (string_ != NULL) AddToRefCount(string_, 1);
+  }
+
+  CompactLatticeWeightTpl(
+      const CompactLatticeWeightTpl<WeightType, IntType> &w):
+      weight_(w.weight_), string_(w.string_) {
+    if (string_ != NULL) AddToRefCount(string_, 1);
+  }
+
+  ~CompactLatticeWeightTpl() { ReleaseString(); }
   
   CompactLatticeWeightTpl &operator=(const CompactLatticeWeightTpl<WeightType, IntType> &w) {
+    // Get w's string first, as &w may be this.
+    SharedString *str = w.string_;
+    if (str != NULL) AddToRefCount(str, 1);
+    ReleaseString();
     weight_ = w.weight_;
-    string_ = w.string_;
+    string_ = str;
     return *this;
   }
 
+#if _MSC_VER >= 1800 || __cplusplus >= 201103L
+  // Moving a weight takes its string without touching the reference count.
+  CompactLatticeWeightTpl(CompactLatticeWeightTpl<WeightType, IntType> &&w):
+      weight_(w.weight_), string_(w.string_) {
+    w.string_ = NULL;
+  }
+
+  CompactLatticeWeightTpl &operator=(
+      CompactLatticeWeightTpl<WeightType, IntType> &&w) {
+    if (&w != this) {
+      ReleaseString();
+      weight_ = w.weight_;
+      string_ = w.string_;
+      w.string_ = NULL;
+    }
+    return *this;
+  }
+#endif
+
   const W &Weight() const { return weight_; }
 
-  const vector<IntType> &String() const { return string_; }
+  const vector<IntType> &String() const {
+    return (string_ != NULL ? string_->str : EmptyString());
+  }
 
   void SetWeight(const W &w) { weight_ = w; }
 
-  void SetString(const vector<IntType> &s) { string_ = s; }
+  void SetString(const vector<IntType> &s) {
+    ReleaseString();
+    string_ = NewString(s, vector<IntType>());
+  }
   
   static const CompactLatticeWeightTpl<WeightType, IntType> Zero() {
     return CompactLatticeWeightTpl<WeightType, IntType>(
@@ -452,10 +513,8 @@ class CompactLatticeWeightTpl {
 
   
   CompactLatticeWeightTpl<WeightType, IntType> Reverse() const {
-    size_t s = string_.size();
-    vector<IntType> v(s);
-    for(size_t i = 0; i < s; i++)
-      v[i] = string_[s-i-1];
+    const vector<IntType> &str = String();
+    vector<IntType> v(str.rbegin(), str.rend());
     return CompactLatticeWeightTpl<WeightType, IntType>(weight_, v);
   }
   
@@ -465,13 +524,13 @@ class CompactLatticeWeightTpl {
     // w_ == zero.
     if (!weight_.Member()) return false;
     if (weight_ == WeightType::Zero())
-      return string_.empty();
+      return String().empty();
     else
       return true;
   }
 
   CompactLatticeWeightTpl Quantize(float delta = kDelta) const {
-    return CompactLatticeWeightTpl(weight_.Quantize(delta), string_);
+    return CompactLatticeWeightTpl(weight_.Quantize(delta), *this);
   }
 
   static uint64 Properties() {
@@ -491,10 +550,11 @@ class CompactLatticeWeightTpl {
       strm.clear(std::ios::badbit);
       return strm;
     }
-    string_.resize(sz);
+    vector<IntType> str(sz);
     for(int32 i = 0; i < sz; i++) {
-      ReadType(strm, &(string_[i]));
+      ReadType(strm, &(str[i]));
     }
+    SetString(str);
     return strm;
   }
 
@@ -503,26 +563,65 @@ class CompactLatticeWeightTpl {
   ostream &Write(ostream &strm) const {
     weight_.Write(strm);
     if (strm.fail()){ return strm; }
-    int32 sz = static_cast<int32>(string_.size());
+    const vector<IntType> &str = String();
+    int32 sz = static_cast<int32>(str.size());
     WriteType(strm, sz);
     for(int32 i = 0; i < sz; i++)
-      WriteType(strm, string_[i]);
+      WriteType(strm, str[i]);
     return strm;
   }
   size_t Hash() const {
     size_t ans = weight_.Hash();
     // any weird numbers here are largish primes
-    size_t sz = string_.size(), mult = 6967;
+    const vector<IntType> &str = String();
+    size_t sz = str.size(), mult = 6967;
     for(size_t i = 0; i < sz; i++) {
-      ans += string_[i] * mult;
+      ans += str[i] * mult;
       mult *= 7499;
     }
     return ans;
   }
  private:
-  W weight_;
-  vector<IntType> string_; 
+  struct SharedString {
+    SharedString(const vector<IntType> &s1, const vector<IntType> &s2):
+        ref_count(1) {
+      str.reserve(s1.size() + s2.size());
+      str.insert(str.end(), s1.begin(), s1.end());
+      str.insert(str.end(), s2.begin(), s2.end());
+    }
+    vector<IntType> str;  // never changed after construction.
+    volatile long ref_count;  // only changed with AddToRefCount().
+  };
+
+  // Atomically adds "delta" to s->ref_count and returns the new value.
+  static inline long AddToRefCount(SharedString *s, long delta) {
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd(&s->ref_count, delta) + delta;
+#else
+    return __sync_add_and_fetch(&s->ref_count, delta);
+#endif
+  }
+
+  // Returns a new string that is s1 followed by s2.  Empty strings are
+  // represented as NULL, so they are never allocated.
+  static SharedString *NewString(const vector<IntType> &s1,
+                                 const vector<IntType> &s2) {
+    return (s1.empty() && s2.empty() ? NULL : new SharedString(s1, s2));
+  }
+
+  void ReleaseString() {
+    if (string_ != NULL && AddToRefCount(string_, -1) == 0)
+      delete string_;
+    string_ = NULL;
+  }
 
+  static const vector<IntType> &EmptyString() {
+    static const vector<IntType> empty;
+    return empty;
+  }
+
+  W weight_;
+  SharedString *string_;
 };
 
 template<class WeightType, class IntType>
@@ -616,13 +715,13 @@ inline CompactLatticeWeightTpl<WeightType, IntType> Times(
   if (w == WeightType::Zero()) {
     return CompactLatticeWeightTpl<WeightType, IntType>::Zero();
     // special case to ensure zero is unique
+  } else if (w2.String().empty()) {  // share the string of w1.
+    return CompactLatticeWeightTpl<WeightType, IntType>(w, w1);
+  } else if (w1.String().empty()) {  // share the string of w2.
+    return CompactLatticeWeightTpl<WeightType, IntType>(w, w2);
   } else {
-    vector<IntType> v;
-    v.resize(w1.String().size() + w2.String().size());
-    typename vector<IntType>::iterator iter = v.begin();
-    iter = std::copy(w1.String().begin(), w1.String().end(), iter); // returns end of first range.
-    std::copy(w2.String().begin(), w2.String().end(), iter);
-    return CompactLatticeWeightTpl<WeightType, IntType>(w, v);
+    return CompactLatticeWeightTpl<WeightType, IntType>(w, w1.String(),
+                                                        w2.String());
   }
 }
 
@@ -643,7 +742,9 @@ inline CompactLatticeWeightTpl<WeightType, IntType> Divide(const CompactLatticeW
   }
   WeightType w = Divide(w1.Weight(), w2.Weight());
 
-  const vector<IntType> v1 = w1.String(), v2 = w2.String();
+  const vector<IntType> &v1 = w1.String(), &v2 = w2.String();
+  if (v2.empty() && div != DIVIDE_ANY)  // share the string of w1.
+    return CompactLatticeWeightTpl<WeightType, IntType>(w, w1);
   if (v2.size() > v1.size()) {
     std::cerr << "Error in Divide (CompactLatticeWeightTpl): cannot divide, length mismatch.\n";
     exit(1);
@@ -740,6 +841,8 @@ class CompactLatticeWeightCommonDivisorTpl {
       s1b++;
       s2b++;
     }
+    if (s1b == s1e)  // w1's string is the prefix; share it.
+      return Weight(Plus(w1.Weight(), w2.Weight()), w1);
     return Weight(Plus(w1.Weight(), w2.Weight()), vector<IntType>(w1.String().begin(), s1b));
   }
 };
@@ -756,7 +859,7 @@ inline CompactLatticeWeightTpl<Weight, IntType> ScaleTupleWeight(
     const CompactLatticeWeightTpl<Weight, IntType> &w,
     const vector<vector<ScaleFloatType> > &scale) {
   return CompactLatticeWeightTpl<Weight, IntType>(
-      ScaleTupleWeight(w.Weight(), scale), w.String());
+      ScaleTupleWeight(w.Weight(), scale), w);  // shares the string.
 }
 
 /** Define some ConvertLatticeWeight functions that are used in various lattice
@@ -0,0 +1,157 @@
+// fstext/shared-cache-deterministic-fst-inl.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_SHARED_CACHE_DETERMINISTIC_FST_INL_H_
+#define KALDI_FSTEXT_SHARED_CACHE_DETERMINISTIC_FST_INL_H_
+
+#include "base/kaldi-common.h"
+
+namespace fst {
+// Do not include this file directly.  It is included by
+// shared-cache-deterministic-fst.h.
+
+template<class Arc>
+SharedCacheDeterministicOnDemandFst<Arc>::SharedCacheDeterministicOnDemandFst(
+    DeterministicOnDemandFst<Arc> *fst,
+    size_t num_cached_arcs,
+    int32 num_shards): fst_(fst) {
+  KALDI_ASSERT(num_shards > 0 &&
+               num_cached_arcs >= static_cast<size_t>(num_shards));
+  shard_size_ = num_cached_arcs / num_shards;
+  shards_.resize(num_shards);
+  for (int32 i = 0; i < num_shards; i++)
+    shards_[i] = new Shard();
+}
+
+template<class Arc>
+SharedCacheDeterministicOnDemandFst<Arc>::~SharedCacheDeterministicOnDemandFst() {
+  kaldi::DeletePointers(&shards_);
+}
+
+template<class Arc>
+typename Arc::StateId SharedCacheDeterministicOnDemandFst<Arc>::Start() {
+  fst_mutex_.Lock();
+  StateId ans = fst_->Start();
+  fst_mutex_.Unlock();
+  return ans;
+}
+
+template<class Arc>
+typename Arc::Weight SharedCacheDeterministicOnDemandFst<Arc>::Final(
+    StateId s) {
+  fst_mutex_.Lock();
+  Weight ans = fst_->Final(s);
+  fst_mutex_.Unlock();
+  return ans;
+}
+
+template<class Arc>
+void SharedCacheDeterministicOnDemandFst<Arc>::Insert(Shard *shard,
+                                                      StateId s,
+                                                      const Arc &arc) {
+  CacheElement elem;
+  elem.state = s;
+  elem.arc = arc;
+  elem.used = false;
+  KeyType key(s, arc.ilabel);
+  std::vector<CacheElement> &elements = shard->elements;
+  if (elements.size() < shard_size_) {
+    shard->index[key] = elements.size();
+    elements.push_back(elem);
+    return;
+  }
+  // Advances the eviction pointer to the first element that has not been used
+  // since it last passed; this terminates as we clear <used> as we go.
+  while (elements[shard->next_evict].used) {
+    elements[shard->next_evict].used = false;
+    shard->next_evict = (shard->next_evict + 1) % elements.size();
+  }
+  CacheElement &old_elem = elements[shard->next_evict];
+  shard->index.erase(KeyType(old_elem.state, old_elem.arc.ilabel));
+  old_elem = elem;
+  shard->index[key] = shard->next_evict;
+  shard->next_evict = (shard->next_evict + 1) % elements.size();
+}
+
+template<class Arc>
+bool SharedCacheDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
+                                                      Arc *oarc) {
+  typedef typename unordered_map<KeyType, size_t,
+      kaldi::PairHasher<StateId> >::iterator IterType;
+  KALDI_ASSERT(s >= 0 && ilabel != 0);
+  Shard *shard = GetShard(s, ilabel);
+  KeyType key(s, ilabel);
+
+  shard->mutex.Lock();
+  IterType iter = shard->index.find(key);
+  if (iter != shard->index.end()) {
+    CacheElement &elem = shard->elements[iter->second];
+    elem.used = true;
+    *oarc = elem.arc;
+    shard->num_hits++;
+    shard->mutex.Unlock();
+    return true;
+  }
+  shard->num_misses++;
+  shard->mutex.Unlock();
+
+  // We don't hold the lock of the shard while we call fst_, so other threads
+  // can use the shard meanwhile.
+  Arc arc;
+  fst_mutex_.Lock();
+  bool ans = fst_->GetArc(s, ilabel, &arc);
+  fst_mutex_.Unlock();
+  if (!ans)
+    return false;
+
+  shard->mutex.Lock();
+  // Another thread may have added the arc meanwhile.
+  if (shard->index.find(key) == shard->index.end())
+    Insert(shard, s, arc);
+  shard->mutex.Unlock();
+  *oarc = arc;
+  return true;
+}
+
+template<class Arc>
+void SharedCacheDeterministicOnDemandFst<Arc>::GetStats(
+    int64 *num_hits, int64 *num_misses) const {
+  *num_hits = 0;
+  *num_misses = 0;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    shards_[i]->mutex.Lock();
+    *num_hits += shards_[i]->num_hits;
+    *num_misses += shards_[i]->num_misses;
+    shards_[i]->mutex.Unlock();
+  }
+}
+
+template<class Arc>
+void SharedCacheDeterministicOnDemandFst<Arc>::PrintStats() const {
+  int64 num_hits, num_misses;
+  GetStats(&num_hits, &num_misses);
+  KALDI_LOG << "Arc cache: " << num_hits << " hits and " << num_misses
+            << " misses, hit rate is "
+            << (num_hits + num_misses == 0 ? 0.0 :
+                static_cast<double>(num_hits) / (num_hits + num_misses));
+}
+
+} // end namespace fst
+
+#endif  // KALDI_FSTEXT_SHARED_CACHE_DETERMINISTIC_FST_INL_H_
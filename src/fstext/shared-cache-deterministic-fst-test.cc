@@ -0,0 +1,128 @@
+// fstext/shared-cache-deterministic-fst-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fstext/shared-cache-deterministic-fst.h"
+#include "thread/kaldi-thread.h"
+
+namespace fst {
+
+typedef fst::StdArc          StdArc;
+typedef fst::StdArc::Label   Label;
+typedef fst::StdArc::StateId StateId;
+typedef fst::StdVectorFst    StdVectorFst;
+typedef fst::StdArc::Weight  Weight;
+
+// The same backoff FST as in deterministic-fst-test.cc.
+StdVectorFst* CreateBackoffFst() {
+  StdVectorFst *fst = new StdVectorFst();
+  fst->AddState();   // state 0
+  fst->SetStart(0);
+  fst->AddArc(0, StdArc(10, 10, 0.0, 1));
+
+  fst->AddState();    // state 1
+  fst->AddArc(1, StdArc(12, 12, 0.0, 4));
+  fst->AddArc(1, StdArc(0,0,  0.1,2));  // backoff from 1 to 2
+
+  fst->AddState();    // state 2
+  fst->AddArc(2, StdArc(13, 13, 0.2, 4));
+  fst->AddArc(2, StdArc(0,0,  0.3,3));  // backoff from 2 to 3
+
+  fst->AddState();     // state 3
+  fst->AddArc(3, StdArc(14, 14, 0.4, 4));
+
+  fst->AddState();    // state 4
+  fst->AddArc(4, StdArc(15, 15, 0.5, 5));
+
+  fst->AddState();     // state 5
+  fst->SetFinal(5, 0.6);
+
+  return fst;
+}
+
+// Walks randomly through the backoff FST using <shared_fst>, checking that it
+// agrees with a BackoffDeterministicOnDemandFst of its own.
+class SharedCacheTestClass: public kaldi::MultiThreadable {
+ public:
+  SharedCacheTestClass(const StdVectorFst *fst,
+                       SharedCacheDeterministicOnDemandFst<StdArc> *shared_fst,
+                       int32 num_steps):
+      fst_(fst), shared_fst_(shared_fst), num_steps_(num_steps) { }
+
+  void operator() () {
+    BackoffDeterministicOnDemandFst<StdArc> dfst(*fst_);
+    kaldi::RandomState rand_state;
+    const Label labels[] = { 10, 12, 13, 14, 15 };
+    StateId s = dfst.Start();
+    KALDI_ASSERT(shared_fst_->Start() == s);
+    for (int32 i = 0; i < num_steps_; i++) {
+      Label ilabel = labels[kaldi::RandInt(0, 4, &rand_state)];
+      StdArc arc, shared_arc;
+      bool ans = dfst.GetArc(s, ilabel, &arc);
+      KALDI_ASSERT(shared_fst_->GetArc(s, ilabel, &shared_arc) == ans);
+      if (ans) {
+        KALDI_ASSERT(arc.ilabel == shared_arc.ilabel &&
+                     arc.olabel == shared_arc.olabel &&
+                     arc.nextstate == shared_arc.nextstate &&
+                     arc.weight == shared_arc.weight);
+        s = arc.nextstate;
+        KALDI_ASSERT(dfst.Final(s) == shared_fst_->Final(s));
+        if (dfst.Final(s) != Weight::Zero())
+          s = dfst.Start();
+      }
+    }
+  }
+
+ private:
+  const StdVectorFst *fst_;
+  SharedCacheDeterministicOnDemandFst<StdArc> *shared_fst_;
+  int32 num_steps_;
+};
+
+void TestSharedCache() {
+  StdVectorFst *nfst = CreateBackoffFst();
+  ArcSort(nfst, StdILabelCompare());
+  BackoffDeterministicOnDemandFst<StdArc> dfst(*nfst);
+
+  int32 num_threads = 4, num_steps = 1000;
+  for (int32 cache_size = 2; cache_size <= 64; cache_size *= 4) {
+    // With a small cache, arcs are evicted all the time.
+    SharedCacheDeterministicOnDemandFst<StdArc> shared_fst(&dfst, cache_size,
+                                                           2);
+    SharedCacheTestClass c(nfst, &shared_fst, num_steps);
+    {
+      kaldi::MultiThreader<SharedCacheTestClass> m(num_threads, c);
+    }
+    int64 num_hits, num_misses;
+    shared_fst.GetStats(&num_hits, &num_misses);
+    KALDI_ASSERT(num_hits + num_misses == num_threads * num_steps);
+    // A cache that can hold all the arcs must have had hits (lookups of arcs
+    // that don't exist always miss).
+    if (cache_size == 32)
+      KALDI_ASSERT(num_hits > 0);
+    shared_fst.PrintStats();
+  }
+  delete nfst;
+}
+
+}  // end namespace fst
+
+int main() {
+  fst::TestSharedCache();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,120 @@
+// fstext/shared-cache-deterministic-fst.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_SHARED_CACHE_DETERMINISTIC_FST_H_
+#define KALDI_FSTEXT_SHARED_CACHE_DETERMINISTIC_FST_H_
+
+#include <utility>
+#include <vector>
+
+#include "fstext/deterministic-fst.h"
+#include "thread/kaldi-mutex.h"
+#include "util/stl-utils.h"
+
+namespace fst {
+
+/**
+   SharedCacheDeterministicOnDemandFst is like CacheDeterministicOnDemandFst,
+   but one object can be shared by several threads and decoders (e.g. several
+   LatticeBiglmFasterDecoder's), so they all use the same cache instead of each
+   warming up its own.  Calls to the underlying fst are serialized by a mutex,
+   so it need not be thread-safe itself, but it must not be used directly
+   while this object is in use.  If only one thread uses the fst, use
+   CacheDeterministicOnDemandFst, which has no locking.
+
+   The cache holds at most <num_cached_arcs> arcs.  It is split into
+   <num_shards> parts, each with its own lock; within a part, arcs are evicted
+   in approximately least-recently-used order (by the "clock" algorithm: an
+   arc is only evicted if it has not been used since the eviction pointer last
+   passed it).  As in CacheDeterministicOnDemandFst, arcs that don't exist and
+   final-probs are not cached.
+ */
+template<class Arc>
+class SharedCacheDeterministicOnDemandFst:
+      public DeterministicOnDemandFst<Arc> {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// We don't take ownership of this pointer.
+  SharedCacheDeterministicOnDemandFst(DeterministicOnDemandFst<Arc> *fst,
+                                      size_t num_cached_arcs = 100000,
+                                      int32 num_shards = 16);
+
+  ~SharedCacheDeterministicOnDemandFst();
+
+  virtual StateId Start();
+
+  virtual Weight Final(StateId s);
+
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
+
+  /// Gets the number of calls to GetArc() that were, and were not, answered
+  /// from the cache so far.
+  void GetStats(int64 *num_hits, int64 *num_misses) const;
+
+  /// Prints the hit rate of the cache.
+  void PrintStats() const;
+
+ private:
+  // (state, ilabel).
+  typedef std::pair<StateId, StateId> KeyType;
+
+  struct CacheElement {
+    StateId state;
+    Arc arc;
+    // True if the arc has been used since the eviction pointer last passed.
+    bool used;
+  };
+
+  struct Shard {
+    kaldi::Mutex mutex;
+    unordered_map<KeyType, size_t, kaldi::PairHasher<StateId> > index;
+    std::vector<CacheElement> elements;
+    size_t next_evict;  // The eviction pointer ("clock hand").
+    int64 num_hits;
+    int64 num_misses;
+    Shard(): next_evict(0), num_hits(0), num_misses(0) { }
+  };
+
+  inline Shard *GetShard(StateId s, Label ilabel) {
+    const size_t p1 = 26597, p2 = 50329;  // as in
+    // CacheDeterministicOnDemandFst.
+    return shards_[(static_cast<size_t>(s) * p1 +
+                    static_cast<size_t>(ilabel) * p2) % shards_.size()];
+  }
+
+  // Adds <arc> from <s> to <shard>, evicting another arc if it is full.
+  // Requires the lock of <shard>.
+  void Insert(Shard *shard, StateId s, const Arc &arc);
+
+  DeterministicOnDemandFst<Arc> *fst_;
+  kaldi::Mutex fst_mutex_;  // Serializes calls to fst_.
+  size_t shard_size_;  // Maximum number of arcs in each shard.
+  std::vector<Shard*> shards_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SharedCacheDeterministicOnDemandFst);
+};
+
+} // end namespace fst
+
+#include "fstext/shared-cache-deterministic-fst-inl.h"
+
+#endif  // KALDI_FSTEXT_SHARED_CACHE_DETERMINISTIC_FST_H_
@@ -143,6 +143,17 @@ class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
     return scale_*LogLikelihoodZeroBased(frame,
                                          trans_model_.TransitionIdToPdf(tid));
   }
+
+  // Many transition-ids share a pdf; LogLikelihoodZeroBased() caches the
+  // likelihood of each pdf for the current frame, so each needed pdf is only
+  // evaluated once.
+  virtual void LogLikelihoods(int32 frame, const std::vector<int32> &tids,
+                              std::vector<BaseFloat> *loglikes) {
+    loglikes->resize(tids.size());
+    for (size_t i = 0; i < tids.size(); i++)
+      (*loglikes)[i] = scale_ * LogLikelihoodZeroBased(
+          frame, trans_model_.TransitionIdToPdf(tids[i]));
+  }
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
@@ -29,41 +29,6 @@
 #include "base/timer.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
 
-namespace kaldi {
-
-fst::Fst<fst::StdArc> *ReadNetwork(std::string filename) {
-  // read decoding network FST
-  Input ki(filename); // use ki.Stream() instead of is.
-  if (!ki.Stream().good()) KALDI_ERR << "Could not open decoding-graph FST "
-                                      << filename;
-  fst::FstHeader hdr;
-  if (!hdr.Read(ki.Stream(), "<unknown>")) {
-    KALDI_ERR << "Reading FST: error reading FST header.";
-  }
-  if (hdr.ArcType() != fst::StdArc::Type()) {
-    KALDI_ERR << "FST with arc type " << hdr.ArcType() << " not supported.";
-  }
-  fst::FstReadOptions ropts("<unspecified>", &hdr);
-
-  fst::Fst<fst::StdArc> *decode_fst = NULL;
-
-  if (hdr.FstType() == "vector") {
-    decode_fst = fst::VectorFst<fst::StdArc>::Read(ki.Stream(), ropts);
-  } else if (hdr.FstType() == "const") {
-    decode_fst = fst::ConstFst<fst::StdArc>::Read(ki.Stream(), ropts);
-  } else {
-    KALDI_ERR << "Reading FST: unsupported FST type: " << hdr.FstType();
-  }
-  if (decode_fst == NULL) { // fst code will warn.
-    KALDI_ERR << "Error reading FST (after reading header).";
-    return NULL;
-  } else {
-    return decode_fst;
-  }
-}
-
-}
-
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -129,7 +94,7 @@ int main(int argc, char *argv[]) {
     // It has to do with what happens on UNIX systems if you call fork() on a
     // large process: the page-table entries are duplicated, which requires a
     // lot of virtual memory.
-    fst::Fst<fst::StdArc> *decode_fst = ReadNetwork(fst_rxfilename);
+    fst::Fst<fst::StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_rxfilename);
     
     BaseFloat tot_like = 0.0;
     kaldi::int64 frame_count = 0;
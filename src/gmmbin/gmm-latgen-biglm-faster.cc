@@ -26,120 +26,11 @@
 #include "tree/context-dep.h"
 #include "hmm/transition-model.h"
 #include "fstext/fstext-lib.h"
-#include "decoder/lattice-biglm-faster-decoder.h"
+#include "decoder/decoder-wrappers.h"
 #include "gmm/decodable-am-diag-gmm.h"
 #include "base/timer.h"
 
 
-namespace kaldi {
-// Takes care of output.  Returns true on success.
-bool DecodeUtterance(LatticeBiglmFasterDecoder &decoder, // not const but is really an input.
-                     DecodableInterface &decodable, // not const but is really an input.
-                     const TransitionModel &trans_model,
-                     const fst::SymbolTable *word_syms,
-                     std::string utt,
-                     double acoustic_scale,
-                     bool determinize,
-                     bool allow_partial,
-                     Int32VectorWriter *alignment_writer,
-                     Int32VectorWriter *words_writer,
-                     CompactLatticeWriter *compact_lattice_writer,
-                     LatticeWriter *lattice_writer,
-                     double *like_ptr) {  // puts utterance's like in like_ptr on success.
-  using fst::VectorFst;
-
-  if (!decoder.Decode(&decodable)) {
-    KALDI_WARN << "Failed to decode file " << utt;
-    return false;
-  }
-  if (!decoder.ReachedFinal()) {
-    if (allow_partial) {
-      KALDI_WARN << "Outputting partial output for utterance " << utt
-                 << " since no final-state reached\n";
-    } else {
-      KALDI_WARN << "Not producing output for utterance " << utt
-                 << " since no final-state reached and "
-                 << "--allow-partial=false.\n";
-      return false;
-    }
-  }
-
-  double likelihood;
-  LatticeWeight weight;
-  int32 num_frames;
-  { // First do some stuff with word-level traceback...
-    VectorFst<LatticeArc> decoded;
-    decoder.GetBestPath(&decoded);
-    if (decoded.NumStates() == 0)
-      // Shouldn't really reach this point as already checked success.
-      KALDI_ERR << "Failed to get traceback for utterance " << utt;
-
-    std::vector<int32> alignment;
-    std::vector<int32> words;
-    GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-    num_frames = alignment.size();
-    if (words_writer->IsOpen())
-      words_writer->Write(utt, words);
-    if (alignment_writer->IsOpen())
-      alignment_writer->Write(utt, alignment);
-    if (word_syms != NULL) {
-      std::cerr << utt << ' ';
-      for (size_t i = 0; i < words.size(); i++) {
-        std::string s = word_syms->Find(words[i]);
-        if (s == "")
-          KALDI_ERR << "Word-id " << words[i] <<" not in symbol table.";
-        std::cerr << s << ' ';
-      }
-      std::cerr << '\n';
-    }
-    likelihood = -(weight.Value1() + weight.Value2());
-  }
-
-  // Get lattice, and do determinization if requested.
-  Lattice lat;
-  decoder.GetRawLattice(&lat);
-  if (lat.NumStates() == 0)
-    KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
-  fst::Connect(&lat);
-  if (determinize) {
-    CompactLattice clat;
-    if (!DeterminizeLatticePhonePrunedWrapper(
-            trans_model,
-            &lat,
-            decoder.GetOptions().lattice_beam,
-            &clat,
-            decoder.GetOptions().det_opts))
-      KALDI_WARN << "Determinization finished earlier than the beam for "
-                 << "utterance " << utt;
-    // We'll write the lattice without acoustic scaling.
-    if (acoustic_scale != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
-    compact_lattice_writer->Write(utt, clat);
-  } else {
-    Lattice fst;
-    decoder.GetRawLattice(&fst);
-    if (fst.NumStates() == 0)
-      KALDI_ERR << "Unexpected problem getting lattice for utterance "
-                << utt;
-    fst::Connect(&fst); // Will get rid of this later... shouldn't have any
-    // disconnected states there, but we seem to.
-    if (acoustic_scale != 0.0) // We'll write the lattice without acoustic scaling
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &fst); 
-    lattice_writer->Write(utt, fst);
-  }
-  KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
-            << (likelihood / num_frames) << " over "
-            << num_frames << " frames.";
-  KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
-                << weight.Value1() << " + " << weight.Value2();
-  *like_ptr = likelihood;
-  return true;
-}
-
-}
-
-
-
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -161,9 +52,11 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeBiglmFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
     
     std::string word_syms_filename;
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
@@ -208,7 +101,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -251,11 +145,11 @@ int main(int argc, char *argv[]) {
 
 
           double like;
-          if (DecodeUtterance(decoder, gmm_decodable, trans_model, word_syms,
-                              utt, acoustic_scale, determinize, allow_partial,
-                              &alignment_writer, &words_writer,
-                              &compact_lattice_writer, &lattice_writer,
-                              &like)) {
+          if (DecodeUtteranceLatticeBiglmFaster(
+                  decoder, gmm_decodable, trans_model, word_syms, utt,
+                  acoustic_scale, determinize, allow_partial,
+                  &alignment_writer, &words_writer, &compact_lattice_writer,
+                  &lattice_writer, &like)) {
             tot_like += like;
             frame_count += features.NumRows();
             num_success++;
@@ -285,11 +179,11 @@ int main(int argc, char *argv[]) {
         DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                acoustic_scale);
         double like;
-        if (DecodeUtterance(decoder, gmm_decodable, trans_model, word_syms, utt,
-                            acoustic_scale, determinize, allow_partial,
-                            &alignment_writer, &words_writer,
-                            &compact_lattice_writer, &lattice_writer,
-                            &like)) {
+        if (DecodeUtteranceLatticeBiglmFaster(
+                decoder, gmm_decodable, trans_model, word_syms, utt,
+                acoustic_scale, determinize, allow_partial, &alignment_writer,
+                &words_writer, &compact_lattice_writer, &lattice_writer,
+                &like)) {
           tot_like += like;
           frame_count += features.NumRows();
           num_success++;
@@ -52,10 +52,12 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 0.1;
     BaseFloat log_sum_exp_prune = 0.0;
     LatticeFasterDecoderConfig latgen_config;
+    CompactLatticeWriteOptions lattice_write_opts;
     TaskSequencerConfig sequencer_config; // has --num-threads option
     
     std::string word_syms_filename;
     latgen_config.Register(&po);
+    lattice_write_opts.Register(&po);
     sequencer_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
@@ -93,7 +95,8 @@ int main(int argc, char *argv[]) {
     bool determinize = latgen_config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -113,6 +116,7 @@ int main(int argc, char *argv[]) {
     int num_done = 0, num_err = 0;
     VectorFst<StdArc> *decode_fst = NULL; // only used if there is a single
                                           // decoding graph.
+    LatticeFasterDecoderPool *decoder_pool = NULL;  // likewise.
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
       
@@ -121,6 +125,8 @@ int main(int argc, char *argv[]) {
       // Input FST is just one FST, not a table of FSTs.
 
       decode_fst = fst::ReadFstKaldi(fst_in_str);
+      // Decoders are reused across utterances, keeping their storage.
+      decoder_pool = new LatticeFasterDecoderPool(*decode_fst, latgen_config);
       
       {    
         for (; !feature_reader.Done(); feature_reader.Next()) {
@@ -135,8 +141,6 @@ int main(int argc, char *argv[]) {
             continue;
           }
           
-          LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
-                                                                   latgen_config);
           // takes ownership of "features"
           DecodableAmDiagGmmScaled *gmm_decodable =
               new DecodableAmDiagGmmScaled(am_gmm, trans_model, 
@@ -146,11 +150,12 @@ int main(int argc, char *argv[]) {
 
           DecodeUtteranceLatticeFasterClass *task =
               new DecodeUtteranceLatticeFasterClass(
-                  decoder, gmm_decodable, // takes ownership of these two.
+                  NULL, gmm_decodable, // takes ownership of the decodable.
                   trans_model, word_syms, utt, acoustic_scale, determinize,
                   allow_partial, &alignment_writer, &words_writer,
                   &compact_lattice_writer, &lattice_writer,
-                  &tot_like, &frame_count, &num_done, &num_err, NULL);
+                  &tot_like, &frame_count, &num_done, &num_err, NULL,
+                  decoder_pool);
             
           sequencer.Run(task); // takes ownership of "task",
           // and will delete it when done.
@@ -199,6 +204,7 @@ int main(int argc, char *argv[]) {
     }
     sequencer.Wait();
 
+    delete decoder_pool;  // must be deleted before decode_fst.
     if (decode_fst != NULL) delete decode_fst;
     
     double elapsed = timer.Elapsed();
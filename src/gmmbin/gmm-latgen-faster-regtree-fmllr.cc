@@ -49,9 +49,11 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
 
     std::string word_syms_filename, utt2spk_rspecifier;
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("utt2spk", &utt2spk_rspecifier, "rspecifier for utterance to "
                 "speaker map used to load the transform");
     po.Register("acoustic-scale", &acoustic_scale,
@@ -99,7 +101,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
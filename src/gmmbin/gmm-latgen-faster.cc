@@ -48,15 +48,19 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
+    ImplicitSelfLoopsConfig self_loops_config;
     
     std::string word_syms_filename;
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename,
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "If true, produce output even if end state was not reached.");
+    self_loops_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -84,7 +88,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -99,6 +104,9 @@ int main(int argc, char *argv[]) {
         KALDI_ERR << "Could not read symbol table from file "
                    << word_syms_filename;
 
+    // Used for all the lattices if --determinize-num-threads > 1.
+    PersistentMultiThreader det_threader(config.det_opts.num_threads);
+
     double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
     int num_done = 0, num_err = 0;
@@ -106,10 +114,13 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
-      
+      fst::Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
+      std::vector<ImplicitSelfLoop> self_loops;
+
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
+        SetUpImplicitSelfLoops(self_loops_config, trans_model, *decode_fst,
+                               &self_loops, &decoder);
     
         for (; !feature_reader.Done(); feature_reader.Next()) {
           std::string utt = feature_reader.Key();
@@ -129,7 +140,7 @@ int main(int argc, char *argv[]) {
                   decoder, gmm_decodable, trans_model, word_syms, utt,
                   acoustic_scale, determinize, allow_partial, &alignment_writer,
                   &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &like)) {
+                  &like, &det_threader)) {
             tot_like += like;
             frame_count += features.NumRows();
             num_done++;
@@ -138,6 +149,9 @@ int main(int argc, char *argv[]) {
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
+      if (self_loops_config.implicit_self_loops)
+        KALDI_ERR << "--implicit-self-loops is not supported when decoding "
+                  << "with a table of FSTs.";
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);          
       for (; !fst_reader.Done(); fst_reader.Next()) {
@@ -163,7 +177,7 @@ int main(int argc, char *argv[]) {
                 decoder, gmm_decodable, trans_model, word_syms, utt,
                 acoustic_scale, determinize, allow_partial, &alignment_writer,
                 &words_writer, &compact_lattice_writer, &lattice_writer,
-                &like)) {
+                &like, &det_threader)) {
           tot_like += like;
           frame_count += features.NumRows();
           num_done++;
@@ -59,7 +59,9 @@ int main(int argc, char *argv[]) {
         
     std::string word_syms_filename, utt2spk_rspecifier;
     LatticeFasterDecoderConfig decoder_opts;
+    CompactLatticeWriteOptions lattice_write_opts;
     decoder_opts.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("utt2spk", &utt2spk_rspecifier, "rspecifier for utterance to "
                 "speaker map");
     po.Register("binary", &binary, "Write output in binary mode");
@@ -104,7 +106,8 @@ int main(int argc, char *argv[]) {
     LatticeWriter lattice_writer;
 
     if (lattice_wspecifier != "") {
-      if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+      if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                       lattice_write_opts)
              : lattice_writer.Open(lattice_wspecifier)))
         KALDI_ERR << "Could not open table for writing lattices: "
                   << lattice_wspecifier;
@@ -18,6 +18,8 @@
 // limitations under the License.
 
 #include "hmm/hmm-utils.h"
+#include "hmm/hmm-topology.h"
+#include "tree/context-dep.h"
 
 namespace kaldi {
 
@@ -184,11 +186,89 @@ void TestConvertPhnxToProns() {
   
 }
 
+// Checks that GetImplicitSelfLoops() describes exactly the self-loops and
+// weight changes that AddSelfLoops() makes.
+void TestImplicitSelfLoops() {
+  using namespace fst;
+  typedef StdArc::Weight Weight;
+  std::vector<int32> phones;
+  phones.push_back(1);
+  for (int32 i = 2; i < 20; i++)
+    if (Rand() % 2 == 0)
+      phones.push_back(i);
+  int32 N = 2 + Rand() % 2, // context-size N is 2 or 3.
+      P = Rand() % N;  // Central-phone is random on [0, N)
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, N, P,
+                                    true, &num_pdf_classes);
+  HmmTopology topo = GetDefaultTopology(phones);
+  TransitionModel trans_model(*ctx_dep, topo);
+
+  // Make a graph without self-loops that is a union of a few random
+  // sequences of HMMs.
+  HTransducerConfig h_config;
+  VectorFst<StdArc> fst;
+  for (int32 n = 0; n < 3; n++) {
+    VectorFst<StdArc> seq;
+    seq.AddState();
+    seq.SetStart(0);
+    seq.SetFinal(0, Weight::One());
+    int32 len = 1 + Rand() % 4;
+    for (int32 i = 0; i < len; i++) {
+      std::vector<int32> context_window(N);
+      for (int32 j = 0; j < N; j++)
+        context_window[j] = phones[Rand() % phones.size()];
+      VectorFst<StdArc> *hmm = GetHmmAsFst(context_window, *ctx_dep,
+                                           trans_model, h_config);
+      Concat(&seq, *hmm);
+      delete hmm;
+    }
+    if (n == 0) fst = seq;
+    else Union(&fst, seq);
+  }
+  delete ctx_dep;
+
+  std::vector<int32> disambig_syms;
+  BaseFloat self_loop_scale = 0.1 * (1 + Rand() % 10);
+  PrepareForImplicitSelfLoops(trans_model, disambig_syms, &fst);
+  VectorFst<StdArc> fst_with_loops(fst);
+  AddSelfLoops(trans_model, disambig_syms, self_loop_scale, true,
+               &fst_with_loops);
+  std::vector<ImplicitSelfLoop> self_loops;
+  GetImplicitSelfLoops(trans_model, fst, self_loop_scale, &self_loops);
+
+  KALDI_ASSERT(fst_with_loops.NumStates() == fst.NumStates() &&
+               self_loops.size() == static_cast<size_t>(fst.NumStates()));
+  for (int32 s = 0; s < fst.NumStates(); s++) {
+    const ImplicitSelfLoop &info = self_loops[s];
+    Weight forward_weight(info.forward_cost);
+    KALDI_ASSERT(fst_with_loops.Final(s) ==
+                 Times(fst.Final(s), forward_weight));
+    KALDI_ASSERT(fst_with_loops.NumArcs(s) ==
+                 fst.NumArcs(s) + (info.self_loop_tid != 0 ? 1 : 0));
+    ArcIterator<VectorFst<StdArc> > aiter1(fst, s), aiter2(fst_with_loops, s);
+    for (; !aiter1.Done(); aiter1.Next(), aiter2.Next()) {
+      const StdArc &arc1 = aiter1.Value(), &arc2 = aiter2.Value();
+      KALDI_ASSERT(arc1.ilabel == arc2.ilabel && arc1.olabel == arc2.olabel &&
+                   arc1.nextstate == arc2.nextstate &&
+                   arc2.weight == Times(arc1.weight, forward_weight));
+    }
+    if (info.self_loop_tid != 0) {
+      const StdArc &arc = aiter2.Value();
+      KALDI_ASSERT(arc.ilabel == info.self_loop_tid && arc.olabel == 0 &&
+                   arc.nextstate == s &&
+                   arc.weight == Weight(info.self_loop_cost));
+    }
+  }
+}
 
 }
 
 int main() {
   kaldi::TestConvertPhnxToProns();
+  for (int i = 0; i < 5; i++)
+    kaldi::TestImplicitSelfLoops();
   std::cout << "Test OK.\n";
 }
 
@@ -582,6 +582,68 @@ void AddSelfLoops(const TransitionModel &trans_model,
     AddSelfLoopsAfter(trans_model, disambig_syms, self_loop_scale, fst);
 }
 
+void PrepareForImplicitSelfLoops(const TransitionModel &trans_model,
+                                 const std::vector<int32> &disambig_syms,
+                                 fst::VectorFst<fst::StdArc> *fst) {
+  KALDI_ASSERT(fst->Start() != fst::kNoStateId);
+  TidToTstateMapper f(trans_model, disambig_syms);
+  // This is the state-splitting part of AddSelfLoopsBefore().
+  MakePrecedingInputSymbolsSameClass(true, fst, f);
+}
+
+void GetImplicitSelfLoops(const TransitionModel &trans_model,
+                          const fst::Fst<fst::StdArc> &fst,
+                          BaseFloat self_loop_scale,
+                          std::vector<ImplicitSelfLoop> *self_loops) {
+  using namespace fst;
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+
+  // state_in is the transition-state of the arcs entering each state, or 0 for
+  // epsilon and disambiguation symbols, or -1 if we have not seen any yet.
+  StateId num_states = CountStates(fst);
+  std::vector<int32> state_in(num_states, -1);
+  int32 num_tids = trans_model.NumTransitionIds();
+  for (StateIterator<Fst<Arc> > siter(fst); !siter.Done(); siter.Next()) {
+    StateId s = siter.Value();
+    for (ArcIterator<Fst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      int32 trans_state = 0;
+      if (arc.ilabel >= 1 && arc.ilabel <= num_tids) {
+        if (trans_model.IsSelfLoop(arc.ilabel))
+          KALDI_ERR << "GetImplicitSelfLoops: graph already has self-loops.";
+        trans_state = trans_model.TransitionIdToTransitionState(arc.ilabel);
+      }
+      if (state_in[arc.nextstate] == -1)
+        state_in[arc.nextstate] = trans_state;
+      else if (state_in[arc.nextstate] != trans_state)
+        KALDI_ERR << "GetImplicitSelfLoops: state " << arc.nextstate
+                  << " has arcs with different transition-states entering it; "
+                  << "the graph must be prepared with "
+                  << "PrepareForImplicitSelfLoops() (add-self-loops "
+                  << "--implicit=true).";
+    }
+  }
+  self_loops->resize(num_states);
+  for (StateId s = 0; s < num_states; s++) {
+    ImplicitSelfLoop &info = (*self_loops)[s];
+    info.self_loop_tid = 0;
+    info.self_loop_cost = 0.0;
+    info.forward_cost = 0.0;
+    if (state_in[s] > 0) {  // As in AddSelfLoopsBefore().
+      int32 trans_state = state_in[s];
+      info.forward_cost =
+          -trans_model.GetNonSelfLoopLogProb(trans_state) * self_loop_scale;
+      int32 trans_id = trans_model.SelfLoopOf(trans_state);
+      if (trans_id != 0) {
+        info.self_loop_tid = trans_id;
+        info.self_loop_cost =
+            -trans_model.GetTransitionLogProb(trans_id) * self_loop_scale;
+      }
+    }
+  }
+}
+
 // IsReordered returns true if the transitions were possibly reordered.  This reordering
 // can happen in AddSelfLoops, if the "reorder" option was true.
 // This makes the out-transition occur before the self-loop transition.
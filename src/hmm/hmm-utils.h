@@ -191,6 +191,51 @@ void AddSelfLoops(const TransitionModel &trans_model,
                   bool reorder,  // true->dan-style, false->lukas-style.
                   fst::VectorFst<fst::StdArc> *fst);
 
+/// Per-state information needed to decode with a graph that has no self-loops
+/// (c.f. AddSelfLoops() with reorder == true), applying the self-loops on the
+/// fly in the decoder.  See GetImplicitSelfLoops().
+struct ImplicitSelfLoop {
+  int32 self_loop_tid;  // transition-id of the self-loop on this state, or 0.
+  BaseFloat self_loop_cost;  // cost of the self-loop, if there is one.
+  BaseFloat forward_cost;  // cost to add to all arcs leaving this state, and
+                           // to its final-prob.
+};
+
+/**
+  * Prepares a graph without self-loops for decoding with "implicit" self-loops.
+  * This does the same state-splitting as AddSelfLoops() with reorder == true,
+  * so that all arcs entering any given state have transition-ids with the same
+  * transition-state, but it does not add the self-loops or change any weights.
+  * @param trans_model [in] Transition model
+  * @param disambig_syms [in] Sorted, uniq list of disambiguation symbols; only
+  *       used for checks, as in AddSelfLoops().
+  * @param  fst [in, out] The FST to be modified.
+  */
+void PrepareForImplicitSelfLoops(const TransitionModel &trans_model,
+                                 const std::vector<int32> &disambig_syms,
+                                 fst::VectorFst<fst::StdArc> *fst);
+
+/**
+  * Works out, for each state of a graph that was prepared with
+  * PrepareForImplicitSelfLoops(), the self-loop and the cost of the forward
+  * transition that AddSelfLoops() with reorder == true would have put on it.
+  * A decoder that applies these on the fly (see
+  * LatticeFasterDecoder::SetImplicitSelfLoops()) gives the same output as if
+  * it had decoded the graph with self-loops, but the graph has about half as
+  * many arcs.  Input labels that are not transition-ids (i.e. disambiguation
+  * symbols) are treated like epsilon.  Throws if a state has arcs with
+  * different transition-states entering it (i.e. the graph was not prepared).
+  * @param trans_model [in] Transition model
+  * @param fst [in] The graph, without self-loops.
+  * @param self_loop_scale [in] Transition-probability scale for self-loops, as
+  *                    for AddSelfLoops().
+  * @param self_loops [out] The information for each state, indexed by state.
+  */
+void GetImplicitSelfLoops(const TransitionModel &trans_model,
+                          const fst::Fst<fst::StdArc> &fst,
+                          BaseFloat self_loop_scale,
+                          std::vector<ImplicitSelfLoop> *self_loops);
+
 /**
   * Adds transition-probs, with the supplied
   * scales (see \ref hmm_scale), to the graph.
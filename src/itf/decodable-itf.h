@@ -21,6 +21,7 @@
 
 #ifndef KALDI_ITF_DECODABLE_ITF_H_
 #define KALDI_ITF_DECODABLE_ITF_H_ 1
+#include <vector>
 #include "base/kaldi-common.h"
 
 namespace kaldi {
@@ -87,6 +88,22 @@ class DecodableInterface {
   /// returns false before calling this.
   virtual BaseFloat LogLikelihood(int32 frame, int32 index) = 0;
 
+  /// Computes the log likelihoods for a list of indices on one frame, in a
+  /// single call; the output is resized to indices.size() and (*loglikes)[i]
+  /// is what LogLikelihood(frame, indices[i]) would return.  The
+  /// multi-threaded LatticeFasterDecoder uses this to get all the likelihoods
+  /// it needs for a frame at once, which avoids a virtual function call per
+  /// index and lets the acoustic model evaluate them together.  The default
+  /// implementation just calls LogLikelihood() for each index; subclasses may
+  /// override it with something more efficient.
+  virtual void LogLikelihoods(int32 frame,
+                              const std::vector<int32> &indices,
+                              std::vector<BaseFloat> *loglikes) {
+    loglikes->resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+      (*loglikes)[i] = LogLikelihood(frame, indices[i]);
+  }
+
   /// Returns true if this is the last frame.  Frames are zero-based, so the
   /// first frame is zero.  IsLastFrame(-1) will return false, unless the file
   /// is empty (which is a case that I'm not sure all the code will handle, so
@@ -0,0 +1,150 @@
+// lat/determinize-lattice-pruned-parallel-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/determinize-lattice-pruned-parallel.h"
+#include "fstext/lattice-utils.h"
+#include "fstext/fst-test-utils.h"
+#include "lat/kaldi-lattice.h"
+
+namespace fst {
+
+using kaldi::int32;
+using kaldi::Lattice;
+using kaldi::LatticeArc;
+using kaldi::LatticeWeight;
+using kaldi::CompactLattice;
+
+// Makes a random lattice that looks like one from the decoder after Invert():
+// one transition-id (on the output side) per frame, a few words on the input
+// side, and some arcs without transition-ids between states of the same
+// frame.  All states at the last frame are final.
+void RandTimeSyncLattice(int32 num_frames, int32 states_per_frame,
+                         Lattice *lat) {
+  typedef LatticeArc::StateId StateId;
+  lat->DeleteStates();
+  std::vector<std::vector<StateId> > frame_states(num_frames + 1);
+  for (int32 t = 0; t <= num_frames; t++)
+    for (int32 j = 0; j < states_per_frame; j++)
+      frame_states[t].push_back(lat->AddState());
+  lat->SetStart(frame_states[0][0]);
+  for (int32 t = 0; t <= num_frames; t++) {
+    for (int32 j = 0; j < states_per_frame; j++) {
+      StateId s = frame_states[t][j];
+      if (j + 1 < states_per_frame && kaldi::Rand() % 4 == 0) {
+        int32 k = j + 1 + kaldi::Rand() % (states_per_frame - j - 1);
+        LatticeArc arc(1 + kaldi::Rand() % 3, 0,
+                       LatticeWeight(kaldi::RandUniform(), 0.0),
+                       frame_states[t][k]);
+        lat->AddArc(s, arc);
+      }
+      if (t == num_frames) {
+        lat->SetFinal(s, LatticeWeight(kaldi::RandUniform(), 0.0));
+        continue;
+      }
+      int32 num_arcs = 1 + kaldi::Rand() % 2;
+      for (int32 a = 0; a < num_arcs; a++) {
+        int32 word = (kaldi::Rand() % 20 == 0 ? 1 + kaldi::Rand() % 3 : 0);
+        LatticeArc arc(word, 1 + kaldi::Rand() % 10,
+                       LatticeWeight(kaldi::RandUniform(),
+                                     kaldi::RandUniform()),
+                       frame_states[t + 1][kaldi::Rand() % states_per_frame]);
+        lat->AddArc(s, arc);
+      }
+    }
+  }
+  Connect(lat);
+}
+
+// Tests that the parallel version gives the same result as
+// DeterminizeLatticePruned() when the beam is large enough that the pruning
+// makes no difference, and the same best path when it isn't.
+void TestDeterminizeLatticePrunedParallel() {
+  for (int32 i = 0; i < 20; i++) {
+    Lattice lat;
+    RandTimeSyncLattice(40 + kaldi::Rand() % 60, 2 + kaldi::Rand() % 3, &lat);
+    TopSort(&lat);
+    ArcSort(&lat, ILabelCompare<LatticeArc>());
+    int32 num_threads = 2 + kaldi::Rand() % 3;
+    kaldi::PersistentMultiThreader threader(num_threads);
+    for (int32 j = 0; j < 2; j++) {
+      double beam = (j == 0 ? 1000.0 : 2.0);
+      CompactLattice det_clat, parallel_det_clat;
+      bool ans = DeterminizeLatticePruned(lat, beam, &det_clat),
+          parallel_ans = DeterminizeLatticePrunedParallel(
+              lat, beam, &threader, &parallel_det_clat);
+      KALDI_ASSERT(ans && parallel_ans);
+      KALDI_ASSERT(parallel_det_clat.Properties(kIDeterministic, true) &
+                   kIDeterministic);
+      KALDI_LOG << "Lattice with " << lat.NumStates() << " states and beam "
+                << beam << " determinized to " << det_clat.NumStates()
+                << " states, or " << parallel_det_clat.NumStates()
+                << " with " << num_threads << " threads.";
+      if (j == 0) {
+        KALDI_ASSERT(RandEquivalent(det_clat, parallel_det_clat, 5/*paths*/,
+                                    0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                    200/*path length, max*/));
+      } else {
+        CompactLattice best_path, parallel_best_path;
+        ShortestPath(det_clat, &best_path);
+        ShortestPath(parallel_det_clat, &parallel_best_path);
+        KALDI_ASSERT(RandEquivalent(best_path, parallel_best_path, 1/*paths*/,
+                                    0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                    200/*path length, max*/));
+      }
+    }
+  }
+}
+
+// Tests the --determinize-num-threads option of
+// DeterminizeLatticePhonePrunedWrapper(), with and without a threader from the
+// caller.  We can only test the word-level pass, as phone determinization
+// needs a real TransitionModel.
+void TestDeterminizeLatticePhonePrunedWrapperParallel() {
+  kaldi::TransitionModel trans_model;
+  DeterminizeLatticePhonePrunedOptions opts;
+  opts.phone_determinize = false;
+  opts.minimize = (kaldi::Rand() % 2 == 0);
+  kaldi::PersistentMultiThreader threader(3);
+  for (int32 i = 0; i < 10; i++) {
+    Lattice lat;
+    RandTimeSyncLattice(40 + kaldi::Rand() % 60, 2 + kaldi::Rand() % 3, &lat);
+    Invert(&lat);  // the wrapper wants the words on the output side.
+    Lattice lat_copy(lat);
+    CompactLattice det_clat, parallel_det_clat;
+    opts.num_threads = 1;
+    KALDI_ASSERT(DeterminizeLatticePhonePrunedWrapper(
+        trans_model, &lat, 1000.0, &det_clat, opts));
+    opts.num_threads = 3;
+    KALDI_ASSERT(DeterminizeLatticePhonePrunedWrapper(
+        trans_model, &lat_copy, 1000.0, &parallel_det_clat, opts,
+        (i % 2 == 0 ? &threader : NULL)));
+    KALDI_ASSERT(RandEquivalent(det_clat, parallel_det_clat, 5/*paths*/,
+                                0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                200/*path length, max*/));
+  }
+}
+
+} // end namespace fst
+
+int main() {
+  using namespace fst;
+  TestDeterminizeLatticePrunedParallel();
+  TestDeterminizeLatticePhonePrunedWrapperParallel();
+  std::cout << "Tests succeeded\n";
+}
@@ -0,0 +1,485 @@
+// lat/determinize-lattice-pruned-parallel.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef _MSC_VER
+#include <unordered_map>
+using std::unordered_map;
+#elif __cplusplus > 199711L || defined(__GXX_EXPERIMENTAL_CXX0X__)
+#include <unordered_map>
+using std::unordered_map;
+#else
+#include <tr1/unordered_map>
+using std::tr1::unordered_map;
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "lat/determinize-lattice-pruned-parallel.h"
+#include "lat/minimize-lattice.h"
+#include "lat/push-lattice.h"
+
+namespace fst {
+
+using kaldi::int32;
+using kaldi::int64;
+using kaldi::Lattice;
+using kaldi::LatticeArc;
+using kaldi::LatticeWeight;
+using kaldi::CompactLattice;
+using kaldi::CompactLatticeArc;
+using kaldi::CompactLatticeWeight;
+
+// We won't make segments shorter than this many frames; for shorter lattices
+// it isn't worth the overhead of splitting them.
+static const int32 kMinFramesPerSegment = 20;
+
+// This class does the work of DeterminizeLatticePrunedParallel(); see the
+// comment there for the algorithm.
+class ParallelLatticeDeterminizer {
+ public:
+  typedef LatticeArc::StateId StateId;
+  typedef LatticeArc::Label Label;
+
+  // "lat" must be connected and topologically sorted, with the words on the
+  // input side.  It is not copied.
+  ParallelLatticeDeterminizer(const Lattice &lat, double prune,
+                              const DeterminizeLatticePrunedOptions &opts):
+      lat_(lat), prune_(prune), opts_(opts), label_offset_(0) { }
+
+  // Works out the state times and where to cut the lattice into (at most)
+  // "max_segments" segments.  Returns the number of segments, which is 1 if
+  // the lattice should not be split.
+  int32 Init(int32 max_segments);
+
+  // Creates segment "i" and determinizes it.  This may be called from
+  // different threads at the same time for different "i".
+  void DeterminizeSegment(int32 i);
+
+  // Joins the determinized segments and determinizes the result.  Returns
+  // false if any of the determinizations stopped early.
+  bool Output(CompactLattice *ofst);
+
+ private:
+  // Sets times_ and frame_entry_; returns false if the lattice is not
+  // time-synchronous, i.e. a state can be reached at two different times.
+  bool ComputeTimes();
+  // Sets alpha_ and beta_.
+  void ComputeCosts();
+  // Sets cuts_.
+  void ChooseCuts(int32 max_segments);
+  void CreateSegment(int32 i, Lattice *segment) const;
+
+  Label BoundaryLabel(StateId q) const { return label_offset_ + q; }
+
+  const Lattice &lat_;
+  double prune_;
+  DeterminizeLatticePrunedOptions opts_;
+
+  // The number of non-epsilon output labels (frames) before each state.
+  std::vector<int32> times_;
+  // frame_entry_[s] is nonzero if state s is entered by an arc with an output
+  // label, so it may start a segment.
+  std::vector<char> frame_entry_;
+  std::vector<double> alpha_;  // Best cost from the start to each state.
+  std::vector<double> beta_;  // Best cost from each state to the end.
+  // Labels from label_offset_ up identify boundary states; they are larger
+  // than any word label.
+  Label label_offset_;
+  // Segment i contains the states with cuts_[i] <= time < cuts_[i+1].
+  std::vector<int32> cuts_;
+  // The states in each segment, in topological order.
+  std::vector<std::vector<StateId> > segment_states_;
+  std::vector<CompactLattice> det_segments_;
+  std::vector<char> det_ok_;
+};
+
+
+bool ParallelLatticeDeterminizer::ComputeTimes() {
+  StateId num_states = lat_.NumStates();
+  times_.assign(num_states, -1);
+  frame_entry_.assign(num_states, 0);
+  times_[lat_.Start()] = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    if (times_[s] < 0) return false;  // Not reached from an earlier state.
+    for (ArcIterator<Lattice> aiter(lat_, s); !aiter.Done(); aiter.Next()) {
+      const LatticeArc &arc = aiter.Value();
+      int32 t = times_[s] + (arc.olabel != 0 ? 1 : 0);
+      if (times_[arc.nextstate] == -1)
+        times_[arc.nextstate] = t;
+      else if (times_[arc.nextstate] != t)
+        return false;
+      if (arc.olabel != 0)
+        frame_entry_[arc.nextstate] = 1;
+    }
+  }
+  return true;
+}
+
+
+void ParallelLatticeDeterminizer::ComputeCosts() {
+  StateId num_states = lat_.NumStates();
+  double infinity = std::numeric_limits<double>::infinity();
+  alpha_.assign(num_states, infinity);
+  beta_.assign(num_states, infinity);
+  alpha_[lat_.Start()] = 0.0;
+  for (StateId s = 0; s < num_states; s++) {
+    for (ArcIterator<Lattice> aiter(lat_, s); !aiter.Done(); aiter.Next()) {
+      const LatticeArc &arc = aiter.Value();
+      alpha_[arc.nextstate] = std::min(alpha_[arc.nextstate],
+                                       alpha_[s] + ConvertToCost(arc.weight));
+    }
+  }
+  for (StateId s = num_states - 1; s >= 0; s--) {
+    double cost = ConvertToCost(lat_.Final(s));
+    for (ArcIterator<Lattice> aiter(lat_, s); !aiter.Done(); aiter.Next()) {
+      const LatticeArc &arc = aiter.Value();
+      cost = std::min(cost, ConvertToCost(arc.weight) + beta_[arc.nextstate]);
+    }
+    beta_[s] = cost;
+  }
+}
+
+
+void ParallelLatticeDeterminizer::ChooseCuts(int32 max_segments) {
+  StateId num_states = lat_.NumStates();
+  // We may only cut at or before the time of the earliest final state, so
+  // that all successful paths go through every cut.
+  int32 end_time = std::numeric_limits<int32>::max();
+  for (StateId s = 0; s < num_states; s++)
+    if (lat_.Final(s) != LatticeWeight::Zero())
+      end_time = std::min(end_time, times_[s]);
+  int32 num_segments = std::min(max_segments, end_time / kMinFramesPerSegment);
+
+  cuts_.clear();
+  cuts_.push_back(0);
+  if (num_segments > 1) {
+    // num_entries[t] is the number of states at time t that are entered by an
+    // arc with an output label; this is the number of boundary states we would
+    // have if we cut at time t.
+    std::vector<int32> num_entries(end_time + 1, 0);
+    for (StateId s = 0; s < num_states; s++)
+      if (frame_entry_[s] && times_[s] <= end_time)
+        num_entries[times_[s]]++;
+    for (int32 i = 1; i < num_segments; i++) {
+      // Look for the cut with the fewest boundary states within half a
+      // segment of the i'th evenly spaced time, preferring cuts closer to it.
+      int32 target = (static_cast<int64>(i) * end_time) / num_segments,
+          begin = (static_cast<int64>(2 * i - 1) * end_time) /
+                  (2 * num_segments),
+          end = (static_cast<int64>(2 * i + 1) * end_time) /
+                (2 * num_segments),
+          best_t = target;
+      for (int32 t = std::max(begin, 1); t < end; t++) {
+        if (num_entries[t] < num_entries[best_t] ||
+            (num_entries[t] == num_entries[best_t] &&
+             std::abs(t - target) < std::abs(best_t - target)))
+          best_t = t;
+      }
+      cuts_.push_back(best_t);
+    }
+  }
+  cuts_.push_back(std::numeric_limits<int32>::max());
+}
+
+
+int32 ParallelLatticeDeterminizer::Init(int32 max_segments) {
+  if (!ComputeTimes())
+    return 1;
+  StateId num_states = lat_.NumStates();
+  Label max_label = 0;
+  for (StateId s = 0; s < num_states; s++)
+    for (ArcIterator<Lattice> aiter(lat_, s); !aiter.Done(); aiter.Next())
+      max_label = std::max(max_label, aiter.Value().ilabel);
+  if (static_cast<int64>(max_label) + 1 + num_states >
+      std::numeric_limits<Label>::max())
+    return 1;  // No room for the boundary labels.
+  label_offset_ = max_label + 1;
+
+  ChooseCuts(max_segments);
+  int32 num_segments = cuts_.size() - 1;
+  if (num_segments <= 1)
+    return 1;
+  ComputeCosts();
+  segment_states_.resize(num_segments);
+  for (StateId s = 0; s < num_states; s++) {
+    int32 i = std::upper_bound(cuts_.begin(), cuts_.end(), times_[s]) -
+        cuts_.begin() - 1;
+    segment_states_[i].push_back(s);
+  }
+  det_segments_.resize(num_segments);
+  det_ok_.resize(num_segments, 0);
+  if (kaldi::GetVerboseLevel() >= 2) {
+    std::ostringstream os;
+    for (int32 i = 1; i < num_segments; i++)
+      os << ' ' << cuts_[i];
+    KALDI_VLOG(2) << "Cutting lattice with " << num_states
+                  << " states at times" << os.str();
+  }
+  return num_segments;
+}
+
+
+void ParallelLatticeDeterminizer::CreateSegment(int32 i,
+                                                Lattice *segment) const {
+  int32 begin_time = cuts_[i], end_time = cuts_[i + 1];
+  const std::vector<StateId> &states = segment_states_[i];
+  segment->DeleteStates();
+  unordered_map<StateId, StateId> state_map;
+  for (size_t j = 0; j < states.size(); j++)
+    state_map[states[j]] = segment->AddState();
+
+  if (i == 0) {
+    segment->SetStart(state_map[lat_.Start()]);
+  } else {
+    // The start state has an arc to each state the segment can be entered
+    // in, with the best cost of getting there.
+    StateId start = segment->AddState();
+    segment->SetStart(start);
+    for (size_t j = 0; j < states.size(); j++) {
+      StateId q = states[j];
+      if (times_[q] == begin_time && frame_entry_[q])
+        segment->AddArc(start, LatticeArc(BoundaryLabel(q), 0,
+                                          LatticeWeight(alpha_[q], 0.0),
+                                          state_map[q]));
+    }
+  }
+
+  // Maps each state the segment can be left to (which is in the next segment)
+  // to the state in "segment" that has an arc with the best cost from it to
+  // the end.
+  unordered_map<StateId, StateId> exit_map;
+  for (size_t j = 0; j < states.size(); j++) {
+    StateId s = states[j], seg_s = state_map[s];
+    segment->SetFinal(seg_s, lat_.Final(s));  // only in the last segment.
+    for (ArcIterator<Lattice> aiter(lat_, s); !aiter.Done(); aiter.Next()) {
+      LatticeArc arc(aiter.Value());
+      StateId q = arc.nextstate;
+      if (times_[q] < end_time) {
+        arc.nextstate = state_map[q];
+      } else {
+        unordered_map<StateId, StateId>::iterator iter = exit_map.find(q);
+        if (iter == exit_map.end()) {
+          StateId exit_state = segment->AddState(),
+              final_state = segment->AddState();
+          segment->AddArc(exit_state, LatticeArc(BoundaryLabel(q), 0,
+                                                 LatticeWeight(beta_[q], 0.0),
+                                                 final_state));
+          segment->SetFinal(final_state, LatticeWeight::One());
+          iter = exit_map.insert(std::make_pair(q, exit_state)).first;
+        }
+        arc.nextstate = iter->second;
+      }
+      segment->AddArc(seg_s, arc);
+    }
+  }
+  TopSort(segment);
+  ArcSort(segment, ILabelCompare<LatticeArc>());
+}
+
+
+void ParallelLatticeDeterminizer::DeterminizeSegment(int32 i) {
+  Lattice segment;
+  CreateSegment(i, &segment);
+  det_ok_[i] = DeterminizeLatticePruned(segment, prune_, &(det_segments_[i]),
+                                        opts_);
+}
+
+
+bool ParallelLatticeDeterminizer::Output(CompactLattice *ofst) {
+  int32 num_segments = det_segments_.size();
+  bool ans = true;
+  const std::vector<int32> empty_string;
+  CompactLattice joined;
+  // For each segment, the arcs from its start state, indexed by the boundary
+  // state they lead to, with the cost of getting there removed.
+  std::vector<std::map<StateId, CompactLatticeArc> > entry_arcs(num_segments);
+  // For each segment, the (final-state, boundary-state) pairs for its exits.
+  std::vector<std::vector<std::pair<StateId, StateId> > > exits(num_segments);
+
+  for (int32 i = 0; i < num_segments; i++) {
+    if (!det_ok_[i])
+      ans = false;
+    const CompactLattice &det = det_segments_[i];
+    if (det.Start() == kNoStateId) {
+      KALDI_WARN << "Empty lattice after determinizing segment " << i;
+      ofst->DeleteStates();
+      return false;
+    }
+    StateId offset = joined.NumStates();
+    for (StateId s = 0; s < det.NumStates(); s++)
+      joined.AddState();
+    if (i == 0)
+      joined.SetStart(det.Start());
+    for (StateId s = 0; s < det.NumStates(); s++) {
+      joined.SetFinal(s + offset, det.Final(s));
+      for (ArcIterator<CompactLattice> aiter(det, s); !aiter.Done();
+           aiter.Next()) {
+        CompactLatticeArc arc(aiter.Value());
+        if (arc.ilabel >= label_offset_) {
+          StateId q = arc.ilabel - label_offset_;
+          arc.ilabel = arc.olabel = 0;
+          arc.nextstate += offset;
+          if (i > 0 && s == det.Start()) {
+            arc.weight = Times(CompactLatticeWeight(
+                LatticeWeight(-alpha_[q], 0.0), empty_string), arc.weight);
+            entry_arcs[i][q] = arc;
+            continue;
+          }
+          KALDI_ASSERT(det.NumArcs(aiter.Value().nextstate) == 0);
+          arc.weight = Times(arc.weight, CompactLatticeWeight(
+              LatticeWeight(-beta_[q], 0.0), empty_string));
+          exits[i].push_back(std::make_pair(arc.nextstate, q));
+        } else {
+          arc.nextstate += offset;
+        }
+        joined.AddArc(s + offset, arc);
+      }
+    }
+    det_segments_[i].DeleteStates();  // Free the memory.
+  }
+
+  // Replace the final-probs of the exits with arcs into the next segment.
+  for (int32 i = 0; i + 1 < num_segments; i++) {
+    for (size_t j = 0; j < exits[i].size(); j++) {
+      StateId s = exits[i][j].first, q = exits[i][j].second;
+      CompactLatticeWeight final_weight = joined.Final(s);
+      if (final_weight == CompactLatticeWeight::Zero())
+        continue;  // Already done; there may be several arcs into s.
+      joined.SetFinal(s, CompactLatticeWeight::Zero());
+      std::map<StateId, CompactLatticeArc>::const_iterator iter =
+          entry_arcs[i + 1].find(q);
+      if (iter != entry_arcs[i + 1].end()) {  // Else, it was pruned.
+        CompactLatticeArc arc(iter->second);
+        arc.weight = Times(final_weight, arc.weight);
+        joined.AddArc(s, arc);
+      }
+    }
+  }
+  Connect(&joined);
+
+  // The joined lattice is close to deterministic, so this is fast compared with
+  // determinizing the original lattice.
+  Lattice lat;
+  ConvertLattice(joined, &lat, false);  // false: words on the input side.
+  joined.DeleteStates();
+  TopSort(&lat);
+  ArcSort(&lat, ILabelCompare<LatticeArc>());
+  if (!DeterminizeLatticePruned(lat, prune_, ofst, opts_))
+    ans = false;
+  return ans;
+}
+
+
+class DeterminizeSegmentsJob: public kaldi::PersistentMultiThreader::Job {
+ public:
+  DeterminizeSegmentsJob(ParallelLatticeDeterminizer *determinizer,
+                         int32 num_segments):
+      determinizer_(determinizer), num_segments_(num_segments) { }
+  virtual void operator () (int32 thread_id, int32 num_threads) {
+    for (int32 i = thread_id; i < num_segments_; i += num_threads)
+      determinizer_->DeterminizeSegment(i);
+  }
+ private:
+  ParallelLatticeDeterminizer *determinizer_;
+  int32 num_segments_;
+};
+
+
+bool DeterminizeLatticePrunedParallel(
+    const ExpandedFst<LatticeArc> &ifst,
+    double prune,
+    kaldi::PersistentMultiThreader *threader,
+    CompactLattice *ofst,
+    DeterminizeLatticePrunedOptions opts) {
+  if (threader == NULL || threader->NumThreads() <= 1)
+    return DeterminizeLatticePruned(ifst, prune, ofst, opts);
+  Lattice lat(ifst);
+  Connect(&lat);
+  if (lat.Start() == kNoStateId ||
+      (lat.Properties(kTopSorted, true) == 0 && !TopSort(&lat)))
+    return DeterminizeLatticePruned(ifst, prune, ofst, opts);
+
+  ParallelLatticeDeterminizer determinizer(lat, prune, opts);
+  int32 num_segments = determinizer.Init(threader->NumThreads());
+  if (num_segments <= 1)
+    return DeterminizeLatticePruned(lat, prune, ofst, opts);
+  DeterminizeSegmentsJob job(&determinizer, num_segments);
+  threader->Run(&job);
+  return determinizer.Output(ofst);
+}
+
+
+bool DeterminizeLatticePhonePrunedParallel(
+    const kaldi::TransitionModel &trans_model,
+    MutableFst<LatticeArc> *ifst,
+    double prune,
+    kaldi::PersistentMultiThreader *threader,
+    MutableFst<CompactLatticeArc> *ofst,
+    DeterminizeLatticePhonePrunedOptions opts) {
+  // This follows DeterminizeLatticePhonePruned() in
+  // determinize-lattice-pruned.cc.
+  bool ans = true;
+  if ((opts.phone_determinize || opts.word_determinize) == false) {
+    KALDI_WARN << "Both --phone-determinize and --word-determinize are set to "
+               << "false, copying lattice without determinization.";
+    ConvertLattice(*ifst, ofst, false);
+    return ans;
+  }
+
+  DeterminizeLatticePrunedOptions det_opts;
+  det_opts.delta = opts.delta;
+  det_opts.max_mem = opts.max_mem;
+
+  CompactLattice clat;
+  if (opts.phone_determinize) {
+    KALDI_VLOG(1) << "Doing first pass of determinization on phone + word "
+                  << "lattices.";
+    LatticeArc::Label first_phone_label =
+        DeterminizeLatticeInsertPhones(trans_model, ifst);
+    TopSort(ifst);
+    ans = DeterminizeLatticePrunedParallel(*ifst, prune, threader, &clat,
+                                           det_opts) && ans;
+    ConvertLattice(clat, ifst, false);  // false: words on the input side.
+    DeterminizeLatticeDeletePhones(first_phone_label, ifst);
+    TopSort(ifst);
+    if (!opts.word_determinize) {
+      ConvertLattice(*ifst, ofst, false);
+      return ans;
+    }
+  }
+
+  KALDI_VLOG(1) << "Doing second pass of determinization on word lattices.";
+  ans = DeterminizeLatticePrunedParallel(*ifst, prune, threader, &clat,
+                                         det_opts) && ans;
+  if (opts.minimize) {
+    KALDI_VLOG(1) << "Pushing and minimizing on word lattices.";
+    ans = PushCompactLatticeStrings(&clat) && ans;
+    ans = PushCompactLatticeWeights(&clat) && ans;
+    ans = MinimizeCompactLattice(&clat) && ans;
+  }
+  *ofst = clat;
+  return ans;
+}
+
+} // end namespace fst
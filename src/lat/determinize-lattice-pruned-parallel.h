@@ -0,0 +1,92 @@
+// lat/determinize-lattice-pruned-parallel.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_DETERMINIZE_LATTICE_PRUNED_PARALLEL_H_
+#define KALDI_LAT_DETERMINIZE_LATTICE_PRUNED_PARALLEL_H_
+
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "thread/kaldi-thread.h"
+
+namespace fst {
+
+/// @addtogroup fst_extensions
+///  @{
+
+/**
+   This is a multi-threaded version of DeterminizeLatticePruned(), for long
+   lattices.  As for that function, "ifst" should have the words on the input
+   side and the transition-ids on the output side (i.e. you need to Invert()
+   a normal Lattice first), and it should preferably be topologically sorted.
+
+   The segments are determinized by the threads of "threader", which is
+   kept by the caller so that the threads can be reused for many lattices.
+
+   We work out the time (number of non-epsilon output labels) of each state,
+   and cut the lattice into threader->NumThreads() segments at frame
+   boundaries where few states are entered; every path crosses each such
+   boundary on exactly one arc.  Each segment is given a start arc for each
+   state "q" its paths can begin in, labeled with a special symbol for q and
+   carrying the best cost of getting to q, and an end arc for each state its
+   paths can leave to, likewise labeled and carrying the best cost from that
+   state to the end.
+   This means that the segments are determinized (in parallel) keeping the
+   best path for each word sequence and boundary state, and with the same
+   pruning as for the whole lattice.  We then remove the boundary costs, join
+   the determinized segments through the boundary states and determinize the
+   result, which is much smaller than "ifst", to get the output.
+
+   The result is the same as DeterminizeLatticePruned() would give, up to
+   small differences in pruning and roundoff.  The options (e.g. max_mem,
+   max_states) apply separately to each segment and to the final pass.  If
+   "threader" is NULL or has one thread, or the lattice is too short to be
+   worth splitting or not time-synchronous, we just call
+   DeterminizeLatticePruned().  Returns false if any of the determinizations
+   stopped early (see DeterminizeLatticePruned()).
+*/
+bool DeterminizeLatticePrunedParallel(
+    const ExpandedFst<kaldi::LatticeArc> &ifst,
+    double prune,
+    kaldi::PersistentMultiThreader *threader,
+    kaldi::CompactLattice *ofst,
+    DeterminizeLatticePrunedOptions opts = DeterminizeLatticePrunedOptions());
+
+/**
+   This is the "destructive" version of DeterminizeLatticePhonePruned() for
+   Lattice, but it does both passes of determinization with
+   DeterminizeLatticePrunedParallel(), using "threader".  This is what
+   DeterminizeLatticePhonePrunedWrapper() calls if opts.num_threads > 1.  As
+   for that function, "ifst" should have the words on the input side and be
+   topologically sorted; it may be modified.
+*/
+bool DeterminizeLatticePhonePrunedParallel(
+    const kaldi::TransitionModel &trans_model,
+    MutableFst<kaldi::LatticeArc> *ifst,
+    double prune,
+    kaldi::PersistentMultiThreader *threader,
+    MutableFst<kaldi::CompactLatticeArc> *ofst,
+    DeterminizeLatticePhonePrunedOptions opts
+      = DeterminizeLatticePhonePrunedOptions());
+
+/// @} end "addtogroup fst_extensions"
+
+} // end namespace fst
+
+#endif  // KALDI_LAT_DETERMINIZE_LATTICE_PRUNED_PARALLEL_H_
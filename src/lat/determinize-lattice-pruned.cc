@@ -38,6 +38,8 @@ using std::tr1::unordered_map;
 #include "lat/minimize-lattice.h"   // for minimization
 #include "lat/push-lattice.h"       // for minimization
 #include "lat/determinize-lattice-pruned.h"
+#include "lat/determinize-lattice-pruned-parallel.h"
+#include "thread/kaldi-thread.h"
 
 namespace fst {
 
@@ -1499,7 +1501,8 @@ bool DeterminizeLatticePhonePrunedWrapper(
     MutableFst<kaldi::LatticeArc> *ifst,
     double beam,
     MutableFst<kaldi::CompactLatticeArc> *ofst,
-    DeterminizeLatticePhonePrunedOptions opts) {
+    DeterminizeLatticePhonePrunedOptions opts,
+    kaldi::PersistentMultiThreader *threader) {
   bool ans = true;
   Invert(ifst);
   if (ifst->Properties(fst::kTopSorted, true) == 0) {
@@ -1512,8 +1515,19 @@ bool DeterminizeLatticePhonePrunedWrapper(
   }
   ILabelCompare<kaldi::LatticeArc> ilabel_comp;
   ArcSort(ifst, ilabel_comp);
-  ans = DeterminizeLatticePhonePruned<kaldi::LatticeWeight, kaldi::int32>(
-      trans_model, ifst, beam, ofst, opts);
+  if (opts.num_threads > 1) {
+    if (threader != NULL) {
+      ans = DeterminizeLatticePhonePrunedParallel(trans_model, ifst, beam,
+                                                  threader, ofst, opts);
+    } else {
+      kaldi::PersistentMultiThreader tmp_threader(opts.num_threads);
+      ans = DeterminizeLatticePhonePrunedParallel(trans_model, ifst, beam,
+                                                  &tmp_threader, ofst, opts);
+    }
+  } else {
+    ans = DeterminizeLatticePhonePruned<kaldi::LatticeWeight, kaldi::int32>(
+        trans_model, ifst, beam, ofst, opts);
+  }
   Connect(ofst);
   return ans;
 }
@@ -32,6 +32,8 @@
 #include "itf/options-itf.h"
 #include "lat/kaldi-lattice.h"
 
+namespace kaldi { class PersistentMultiThreader; }
+
 namespace fst {
 
 /// \addtogroup fst_extensions
@@ -155,11 +157,16 @@ struct DeterminizeLatticePhonePrunedOptions {
   bool word_determinize;
   // minimize: if true, push and minimize after determinization.
   bool minimize;
+  // num_threads: if > 1, DeterminizeLatticePhonePrunedWrapper() determinizes
+  // time segments of the lattice in parallel; see
+  // determinize-lattice-pruned-parallel.h.
+  int num_threads;
   DeterminizeLatticePhonePrunedOptions(): delta(kDelta),
                                           max_mem(50000000),
                                           phone_determinize(true),
                                           word_determinize(true),
-                                          minimize(false) {}
+                                          minimize(false),
+                                          num_threads(1) {}
   void Register (kaldi::OptionsItf *po) {
     po->Register("delta", &delta, "Tolerance used in determinization");
     po->Register("max-mem", &max_mem, "Maximum approximate memory usage in "
@@ -172,6 +179,9 @@ struct DeterminizeLatticePhonePrunedOptions {
                  "--phone-determinize)");
     po->Register("minimize", &minimize, "If true, push and minimize after "
                  "determinization.");
+    po->Register("determinize-num-threads", &num_threads, "If >1, the number "
+                 "of threads used to determinize time segments of the lattice "
+                 "in parallel.");
   }
 };
 
@@ -278,6 +288,10 @@ bool DeterminizeLatticePhonePruned(
     Unlike other determinization routines, the function
     requires "ifst" to have transition-id's on the input side and words on the
     output side.
+    If opts.num_threads > 1 it calls DeterminizeLatticePhonePrunedParallel()
+    instead, using the threads of "threader" if it is not NULL (callers that
+    determinize many lattices should keep one PersistentMultiThreader with
+    opts.num_threads threads for all of them), else of a temporary one.
 */
 bool DeterminizeLatticePhonePrunedWrapper(
     const kaldi::TransitionModel &trans_model,
@@ -285,7 +299,8 @@ bool DeterminizeLatticePhonePrunedWrapper(
     double prune,
     MutableFst<kaldi::CompactLatticeArc> *ofst,
     DeterminizeLatticePhonePrunedOptions opts
-      = DeterminizeLatticePhonePrunedOptions());
+      = DeterminizeLatticePhonePrunedOptions(),
+    kaldi::PersistentMultiThreader *threader = NULL);
 
 /// @} end "addtogroup fst_extensions"
 
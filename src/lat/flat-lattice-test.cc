@@ -0,0 +1,217 @@
+// lat/flat-lattice-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/flat-lattice.h"
+#include "lat/lattice-functions.h"
+#include "fstext/rand-fst.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// ApproxEqual() works in float; this compares log-probabilities in double,
+// allowing for them to be -infinity or close to zero.
+static bool LogProbsEqual(double a, double b, double tolerance = 1.0e-10) {
+  if (a == b) return true;  // handles infinities.
+  return std::abs(a - b) <= tolerance * (1.0 + std::abs(a) + std::abs(b));
+}
+
+// Computes alpha and beta the way lattice-functions.cc used to, with
+// LogAdd(); returns the total forward log-probability.
+double NaiveForwardBackward(const Lattice &lat, std::vector<double> *alpha,
+                            std::vector<double> *beta) {
+  typedef Lattice::Arc Arc;
+  int32 num_states = lat.NumStates();
+  alpha->assign(num_states, kLogZeroDouble);
+  beta->assign(num_states, kLogZeroDouble);
+  double tot_forward_prob = kLogZeroDouble;
+  (*alpha)[0] = 0.0;
+  for (int32 s = 0; s < num_states; s++) {
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      (*alpha)[arc.nextstate] = LogAdd((*alpha)[arc.nextstate],
+                                       (*alpha)[s] - ConvertToCost(arc.weight));
+    }
+    tot_forward_prob = LogAdd(tot_forward_prob,
+                              (*alpha)[s] - ConvertToCost(lat.Final(s)));
+  }
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    double this_beta = -ConvertToCost(lat.Final(s));
+    for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      this_beta = LogAdd(this_beta,
+                         (*beta)[arc.nextstate] - ConvertToCost(arc.weight));
+    }
+    (*beta)[s] = this_beta;
+  }
+  return tot_forward_prob;
+}
+
+// Returns a random acyclic lattice with start state 0, in topological order,
+// with a state that is not reachable and a state from which no final state can
+// be reached.
+Lattice *RandTopSortedLattice() {
+  fst::RandFstOptions opts;
+  opts.acyclic = true;
+  opts.allow_empty = false;
+  opts.weight_multiplier = 0.5;
+  Lattice *lat = fst::RandPairFst<LatticeArc>(opts);
+  if (lat->Properties(fst::kTopSorted, true) == 0) fst::TopSort(lat);
+  // A state with no arcs out that is not final, and a final state with no
+  // arcs in.
+  int32 dead_end = lat->AddState(), unreachable = lat->AddState();
+  lat->AddArc(0, LatticeArc(1, 1, LatticeWeight(1.0, 2.0), dead_end));
+  lat->SetFinal(unreachable, LatticeWeight(0.5, 0.5));
+  return lat;
+}
+
+void TestFlatLatticeForwardBackward() {
+  for (int32 i = 0; i < 50; i++) {
+    Lattice *lat = RandTopSortedLattice();
+    if (lat->Start() != 0) {
+      delete lat;
+      continue;
+    }
+    FlatLattice flat(*lat);
+    KALDI_ASSERT(flat.NumStates() == lat->NumStates() &&
+                 flat.NumArcs() == fst::NumArcs(*lat));
+
+    std::vector<double> alpha, beta, ref_alpha, ref_beta;
+    double tot_forward = FlatLatticeForward(flat, &alpha),
+        tot_backward = FlatLatticeBackward(flat, &beta),
+        ref_tot = NaiveForwardBackward(*lat, &ref_alpha, &ref_beta);
+    for (int32 s = 0; s < flat.NumStates(); s++) {
+      KALDI_ASSERT(LogProbsEqual(alpha[s], ref_alpha[s]) &&
+                   LogProbsEqual(beta[s], ref_beta[s]));
+    }
+    KALDI_ASSERT(alpha[lat->NumStates() - 1] == kLogZeroDouble &&
+                 beta[lat->NumStates() - 2] == kLogZeroDouble);
+    KALDI_ASSERT(LogProbsEqual(tot_forward, ref_tot) &&
+                 LogProbsEqual(tot_backward, ref_tot));
+
+    // ComputeCompactLatticeAlphas() and ComputeCompactLatticeBetas() should
+    // agree with the reference too, given a CompactLattice with the same
+    // states and the same total weights on its arcs.
+    CompactLattice clat;
+    ConvertLattice(*lat, &clat);
+    std::vector<double> clat_alpha, clat_beta;
+    if (clat.Properties(fst::kTopSorted, true) != 0 && clat.Start() == 0) {
+      KALDI_ASSERT(ComputeCompactLatticeAlphas(clat, &clat_alpha) &&
+                   ComputeCompactLatticeBetas(clat, &clat_beta));
+      KALDI_ASSERT(clat_alpha.size() == clat.NumStates() &&
+                   clat_beta.size() == clat.NumStates() &&
+                   LogProbsEqual(clat_beta[0], ref_beta[0], 1.0e-05));
+    }
+    delete lat;
+  }
+}
+
+// Returns a lattice with a start state on frame 0, "states_per_frame" states
+// on each of frames 1 to "num_frames", and an arc with a transition-id from
+// every state on each frame to every state on the next; the states on the last
+// frame are final.  The states are numbered in topological order.
+Lattice *RandFrameLattice(int32 num_frames, int32 states_per_frame) {
+  Lattice *lat = new Lattice;
+  lat->SetStart(lat->AddState());
+  for (int32 t = 1; t <= num_frames; t++) {
+    int32 first_prev = (t == 1 ? 0 : lat->NumStates() - states_per_frame),
+        num_prev = (t == 1 ? 1 : states_per_frame),
+        first_cur = lat->NumStates();
+    for (int32 j = 0; j < states_per_frame; j++)
+      lat->AddState();
+    for (int32 i = 0; i < num_prev; i++) {
+      for (int32 j = 0; j < states_per_frame; j++) {
+        LatticeArc arc(1 + Rand() % 5, 0,
+                       LatticeWeight(RandUniform(), RandUniform()),
+                       first_cur + j);
+        lat->AddArc(first_prev + i, arc);
+      }
+    }
+  }
+  for (int32 j = 0; j < states_per_frame; j++)
+    lat->SetFinal(lat->NumStates() - 1 - j,
+                  LatticeWeight(RandUniform(), RandUniform()));
+  return lat;
+}
+
+// Tests that LatticeForwardBackward() gives posteriors summing to one on
+// each frame, and the expected acoustic log-likelihood.
+void TestLatticeForwardBackward() {
+  for (int32 i = 0; i < 10; i++) {
+    int32 num_frames = 1 + Rand() % 20, states_per_frame = 1 + Rand() % 4;
+    Lattice *lat = RandFrameLattice(num_frames, states_per_frame);
+
+    Posterior post;
+    double acoustic_like_sum;
+    BaseFloat tot_like = LatticeForwardBackward(*lat, &post,
+                                                &acoustic_like_sum);
+    std::vector<double> ref_alpha, ref_beta;
+    double ref_tot = NaiveForwardBackward(*lat, &ref_alpha, &ref_beta);
+    KALDI_ASSERT(LogProbsEqual(tot_like, ref_tot, 1.0e-06));
+    KALDI_ASSERT(post.size() == num_frames);
+    for (int32 t = 0; t < num_frames; t++) {
+      double frame_post = 0.0;
+      for (size_t k = 0; k < post[t].size(); k++)
+        frame_post += post[t][k].second;
+      KALDI_ASSERT(ApproxEqual(frame_post, 1.0, 1.0e-04));
+    }
+    // All the acoustic costs are in [0, 1) and there are num_frames + 1 of
+    // them on each path.
+    KALDI_ASSERT(acoustic_like_sum <= 0.0 &&
+                 acoustic_like_sum >= -(num_frames + 1));
+    delete lat;
+  }
+}
+
+// Compares the speed of FlatLattice with that of the LogAdd() code it
+// replaces, on a lattice shaped like a dense decoder lattice.  Nothing is
+// asserted about the times, which go to the log.
+void TestFlatLatticeSpeed() {
+  int32 num_frames = 1000, states_per_frame = 20, num_repeats = 10;
+  Lattice *lat = RandFrameLattice(num_frames, states_per_frame);
+  std::vector<double> alpha, beta;
+  double tot_naive = 0.0, tot_flat = 0.0;
+  Timer naive_timer;
+  for (int32 r = 0; r < num_repeats; r++)
+    tot_naive += NaiveForwardBackward(*lat, &alpha, &beta);
+  double naive_time = naive_timer.Elapsed();
+  Timer flat_timer;
+  for (int32 r = 0; r < num_repeats; r++) {
+    FlatLattice flat(*lat);
+    tot_flat += FlatLatticeForward(flat, &alpha);
+    FlatLatticeBackward(flat, &beta);
+  }
+  double flat_time = flat_timer.Elapsed();
+  KALDI_ASSERT(LogProbsEqual(tot_naive, tot_flat));
+  KALDI_LOG << "Forward-backward on a lattice with " << fst::NumArcs(*lat)
+            << " arcs, " << num_repeats << " times, took " << naive_time
+            << " seconds with LogAdd() and " << flat_time
+            << " seconds with FlatLattice (speedup "
+            << (naive_time / flat_time) << ")";
+  delete lat;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  TestFlatLatticeForwardBackward();
+  TestLatticeForwardBackward();
+  TestFlatLatticeSpeed();
+  std::cout << "Tests succeeded\n";
+}
@@ -0,0 +1,131 @@
+// lat/flat-lattice.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "lat/flat-lattice.h"
+#include "base/kaldi-math.h"
+
+namespace kaldi {
+
+template<class Arc>
+void FlatLattice::Init(const fst::VectorFst<Arc> &lat) {
+  typedef typename Arc::StateId StateId;
+  if (lat.Properties(fst::kTopSorted, true) == 0)
+    KALDI_ERR << "Input lattice must be topologically sorted.";
+  KALDI_ASSERT(lat.Start() == 0);
+
+  StateId num_states = lat.NumStates();
+  int32 num_arcs = 0;
+  for (StateId s = 0; s < num_states; s++)
+    num_arcs += lat.NumArcs(s);
+
+  arc_begin.resize(num_states + 1);
+  arc_nextstate.resize(num_arcs);
+  arc_like.resize(num_arcs);
+  final_like.resize(num_states);
+  int32 a = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    arc_begin[s] = a;
+    for (fst::ArcIterator<fst::VectorFst<Arc> > aiter(lat, s); !aiter.Done();
+         aiter.Next(), a++) {
+      const Arc &arc = aiter.Value();
+      arc_nextstate[a] = arc.nextstate;
+      arc_like[a] = -ConvertToCost(arc.weight);
+    }
+    // For non-final states this is -infinity, i.e. kLogZeroDouble.
+    final_like[s] = -ConvertToCost(lat.Final(s));
+  }
+  arc_begin[num_states] = a;
+}
+
+// Explicit instantiations for Lattice and CompactLattice.
+template void FlatLattice::Init(const Lattice &lat);
+template void FlatLattice::Init(const CompactLattice &clat);
+
+
+double FlatLatticeForward(const FlatLattice &lat, std::vector<double> *alpha) {
+  int32 num_states = lat.NumStates();
+  alpha->resize(0);
+  alpha->resize(num_states, kLogZeroDouble);
+  if (num_states == 0) return kLogZeroDouble;
+  // Until we reach state s, (*alpha)[s] is the largest log-likelihood of the
+  // arcs entering it so far and sum[s] is the sum of the exponentials of those
+  // log-likelihoods minus (*alpha)[s]; each arc adds one term, rescaling the
+  // sum if it changes the maximum.
+  std::vector<double> sum(num_states, 0.0);
+  (*alpha)[0] = 0.0;
+  sum[0] = 1.0;
+  const int32 *arc_nextstate = (lat.arc_nextstate.empty() ? NULL :
+                                &(lat.arc_nextstate[0]));
+  const double *arc_like = (lat.arc_like.empty() ? NULL : &(lat.arc_like[0]));
+  double *alpha_data = &((*alpha)[0]), *sum_data = &(sum[0]);
+
+  double max_final = kLogZeroDouble;
+  for (int32 s = 0; s < num_states; s++) {
+    if (sum_data[s] == 0.0) continue;  // Not reachable; alpha is -infinity.
+    double this_alpha = alpha_data[s] + Log(sum_data[s]);
+    alpha_data[s] = this_alpha;
+    max_final = std::max(max_final, this_alpha + lat.final_like[s]);
+    for (int32 a = lat.arc_begin[s]; a < lat.arc_begin[s + 1]; a++) {
+      int32 t = arc_nextstate[a];
+      double x = this_alpha + arc_like[a], max = alpha_data[t];
+      if (x > max) {
+        sum_data[t] = sum_data[t] * Exp(max - x) + 1.0;
+        alpha_data[t] = x;
+      } else if (x != kLogZeroDouble) {
+        sum_data[t] += Exp(x - max);
+      }
+    }
+  }
+  if (max_final == kLogZeroDouble)
+    return kLogZeroDouble;
+  double tot_sum = 0.0;
+  for (int32 s = 0; s < num_states; s++)
+    tot_sum += Exp(alpha_data[s] + lat.final_like[s] - max_final);
+  return max_final + Log(tot_sum);
+}
+
+double FlatLatticeBackward(const FlatLattice &lat, std::vector<double> *beta) {
+  int32 num_states = lat.NumStates();
+  beta->resize(num_states);
+  if (num_states == 0) return kLogZeroDouble;
+  const int32 *arc_nextstate = (lat.arc_nextstate.empty() ? NULL :
+                                &(lat.arc_nextstate[0]));
+  const double *arc_like = (lat.arc_like.empty() ? NULL : &(lat.arc_like[0]));
+  double *beta_data = &((*beta)[0]);
+
+  for (int32 s = num_states - 1; s >= 0; s--) {
+    int32 begin = lat.arc_begin[s], end = lat.arc_begin[s + 1];
+    double final_like = lat.final_like[s], max = final_like;
+    for (int32 a = begin; a < end; a++)
+      max = std::max(max, arc_like[a] + beta_data[arc_nextstate[a]]);
+    if (max == kLogZeroDouble) {  // Can't reach a final state.
+      beta_data[s] = kLogZeroDouble;
+      continue;
+    }
+    double sum = Exp(final_like - max);
+    for (int32 a = begin; a < end; a++)
+      sum += Exp(arc_like[a] + beta_data[arc_nextstate[a]] - max);
+    beta_data[s] = max + Log(sum);
+  }
+  return beta_data[0];
+}
+
+}  // namespace kaldi
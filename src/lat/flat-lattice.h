@@ -0,0 +1,81 @@
+// lat/flat-lattice.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_FLAT_LATTICE_H_
+#define KALDI_LAT_FLAT_LATTICE_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+/**
+   FlatLattice is a copy of the topology and total likelihoods of a
+   topologically sorted Lattice or CompactLattice, in "compressed sparse row"
+   form: the arcs leaving state s are numbered arc_begin[s] ... arc_begin[s+1]
+   - 1, in the order in which the ArcIterator visits them, so a caller that
+   walks the original lattice state by state can find an arc's index by
+   counting.  Only the next-state and the likelihood (the negated graph plus
+   acoustic cost) of each arc are stored; anything else (labels, the acoustic
+   part of the cost) should be read from the original lattice.
+
+   The lattice must be topologically sorted with start state 0 (Init() checks
+   this, and dies if it's not).
+*/
+struct FlatLattice {
+  // Has NumStates() + 1 elements.
+  std::vector<int32> arc_begin;
+  // Indexed by arc.
+  std::vector<int32> arc_nextstate;
+  std::vector<double> arc_like;
+  // Negated final cost, or kLogZeroDouble for non-final states.
+  std::vector<double> final_like;
+
+  FlatLattice() { }
+  explicit FlatLattice(const Lattice &lat) { Init(lat); }
+  explicit FlatLattice(const CompactLattice &clat) { Init(clat); }
+
+  template<class Arc>
+  void Init(const fst::VectorFst<Arc> &lat);
+
+  int32 NumStates() const { return final_like.size(); }
+  int32 NumArcs() const { return arc_nextstate.size(); }
+};
+
+
+/// Computes the forward (log-)probabilities "alpha" for each state of "lat",
+/// not including the final-probs, and returns the total log-probability of
+/// the lattice; unreachable states get kLogZeroDouble.  Each state keeps a
+/// running maximum and a sum of exponentials relative to it, so the
+/// computation needs one Exp() per arc and one Log() per state, where LogAdd()
+/// would need an Exp() and a Log1p() per arc.
+double FlatLatticeForward(const FlatLattice &lat, std::vector<double> *alpha);
+
+/// Computes the backward (log-)probabilities "beta" for each state of "lat",
+/// including the final-probs, and returns beta[0], the total log-probability.
+/// Each beta is the maximum over the state's arcs and final-prob plus the Log()
+/// of the sum of their Exp() relative to it, so again there is one Exp() per
+/// arc (and per state, for the final-prob) and one Log() per state.
+double FlatLatticeBackward(const FlatLattice &lat, std::vector<double> *beta);
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_FLAT_LATTICE_H_
@@ -155,6 +155,91 @@ void TestLatticeTableCross(bool binary) {
 }
 
 
+// Write in the compressed format, read as CompactLattice and as Lattice.
+void TestCompressedCompactLatticeTable(bool binary) {
+  CompactLatticeWriteOptions write_opts;
+  write_opts.compress = true;
+  // The random weights are multiples of 0.25, so we should get them back.
+  write_opts.weight_quantum = (Rand() % 2 == 0 ? 0.25 : 0.0);
+  CompactLatticeWriter writer(binary ? "ark:tmpf" : "ark,t:tmpf", write_opts);
+  int N = 10;
+  std::vector<CompactLattice*> lat_vec(N);
+  for (int i = 0; i < N; i++) {
+    char buf[2];
+    buf[0] = '0' + i;
+    buf[1] = '\0';
+    std::string key = "key" + std::string(buf);
+    CompactLattice *fst = RandCompactLattice();
+    lat_vec[i] = fst;
+    writer.Write(key, *fst);
+  }
+  writer.Close();
+
+  RandomAccessCompactLatticeReader reader("ark:tmpf");
+  RandomAccessLatticeReader lattice_reader("ark:tmpf");
+  for (int i = 0; i < N; i++) {
+    char buf[2];
+    buf[0] = '0' + i;
+    buf[1] = '\0';
+    std::string key = "key" + std::string(buf);
+    const CompactLattice &fst = reader.Value(key);
+    KALDI_ASSERT(fst::RandEquivalent(fst, *(lat_vec[i]), 5, 0.01, Rand(), 10));
+    CompactLattice fst2;
+    ConvertLattice(lattice_reader.Value(key), &fst2);
+    KALDI_ASSERT(fst::RandEquivalent(fst2, *(lat_vec[i]), 5, 0.01, Rand(), 10));
+    delete lat_vec[i];
+  }
+}
+
+// Test that with exact weights, a topologically sorted lattice comes back
+// unchanged from the compressed format.
+void TestCompressedCompactLatticeExact() {
+  for (int i = 0; i < 10; i++) {
+    CompactLattice *fst = RandCompactLattice();
+    bool acyclic = TopSort(fst);
+    std::ostringstream os;
+    KALDI_ASSERT(WriteCompressedCompactLattice(os, *fst, 0.0));
+    std::istringstream is(os.str());
+    CompactLattice *fst2 = NULL;
+    KALDI_ASSERT(ReadCompactLattice(is, true, &fst2));
+    if (acyclic)
+      KALDI_ASSERT(fst::Equal(*fst, *fst2));
+    else
+      KALDI_ASSERT(fst::RandEquivalent(*fst, *fst2, 5, 0.01, Rand(), 10));
+    delete fst;
+    delete fst2;
+  }
+}
+
+// Test that corrupt sizes in the compressed format make reading fail rather
+// than allocate huge amounts of memory.
+void TestCompressedCompactLatticeCorrupt() {
+  {  // The size of the data is much more than there is.
+    std::ostringstream os;
+    WriteToken(os, true, "<CompressedLattice>");
+    WriteBasicType(os, true, static_cast<BaseFloat>(0.01));
+    WriteBasicType(os, true, static_cast<int64>(1) << 40);
+    os << "abc";
+    std::istringstream is(os.str());
+    CompactLattice *fst = NULL;
+    KALDI_ASSERT(!ReadCompressedCompactLattice(is, &fst) && fst == NULL);
+  }
+  {  // A final-weight whose transition-id string is a run of 2^40 + 1 ones.
+    // The bytes are: one state; the start state is 0 (written as 1); state 0
+    // has no arcs and is final; its weight is (0, 0); its string has one run,
+    // of (zig-zag encoded) value 1 and length 2^40 + 1.
+    const unsigned char data[] = { 1, 1, 1, 0, 0, 1, 2,
+                                   0x80, 0x80, 0x80, 0x80, 0x80, 0x20 };
+    std::ostringstream os;
+    WriteToken(os, true, "<CompressedLattice>");
+    WriteBasicType(os, true, static_cast<BaseFloat>(0.01));
+    WriteBasicType(os, true, static_cast<int64>(sizeof(data)));
+    os.write(reinterpret_cast<const char*>(data), sizeof(data));
+    std::istringstream is(os.str());
+    CompactLattice *fst = NULL;
+    KALDI_ASSERT(!ReadCompressedCompactLattice(is, &fst) && fst == NULL);
+  }
+}
 
 } // end namespace kaldi
 
@@ -166,7 +251,10 @@ int main() {
     TestCompactLatticeTableCross(binary);
     TestLatticeTable(binary);
     TestLatticeTableCross(binary);
+    TestCompressedCompactLatticeTable(binary);
   }
+  TestCompressedCompactLatticeExact();
+  TestCompressedCompactLatticeCorrupt();
   std::cout << "Test OK\n";
   
   unlink("tmpf");
@@ -19,6 +19,10 @@
 // limitations under the License.
 
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include "lat/kaldi-lattice.h"
 #include "fst/script/print-impl.h"
 
@@ -95,6 +99,330 @@ bool WriteCompactLattice(std::ostream &os, bool binary,
   }
 }
 
+// The following functions are for the format written by
+// WriteCompressedCompactLattice().  It consists of the token
+// "<CompressedLattice>", the weight quantum (as a float; zero means the weights
+// are exact), the number of bytes in the rest of the lattice (as an int64), and
+// then the following sequence of variable-length unsigned integers [varints],
+// where "signed" means zigzag-coded (0, -1, 1, -2 ... -> 0, 1, 2, 3 ...):
+//   num-states, start-state + 1 (zero if none)
+//   for each state s: num-arcs * 2 + is-final
+//     if is-final: weight, string
+//     for each arc: label, signed (next-state - s), weight, string
+// A weight is its two values as signed multiples of the quantum, or if the
+// quantum is zero, as two raw floats.  A string is the number of runs of
+// identical transition-ids, then for each run, the signed difference from
+// the previous run's transition-id (or from zero) and the run length minus one.
+
+static inline void WriteVarint(uint64 value, std::string *buf) {
+  while (value >= 128) {
+    buf->push_back(static_cast<char>((value & 127) | 128));
+    value >>= 7;
+  }
+  buf->push_back(static_cast<char>(value));
+}
+
+static inline uint64 ZigZagEncode(int64 value) {
+  return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+}
+
+static inline int64 ZigZagDecode(uint64 value) {
+  return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+}
+
+static void WriteCompressedWeight(const LatticeWeight &w,
+                                  BaseFloat weight_quantum,
+                                  std::string *buf) {
+  if (weight_quantum != 0.0) {
+    WriteVarint(ZigZagEncode(static_cast<int64>(
+        std::floor(w.Value1() / weight_quantum + 0.5))), buf);
+    WriteVarint(ZigZagEncode(static_cast<int64>(
+        std::floor(w.Value2() / weight_quantum + 0.5))), buf);
+  } else {
+    float values[2] = { w.Value1(), w.Value2() };
+    buf->append(reinterpret_cast<const char*>(values), sizeof(values));
+  }
+}
+
+static void WriteCompressedString(const std::vector<int32> &str,
+                                  std::string *buf) {
+  size_t num_runs = 0;
+  for (size_t i = 0; i < str.size(); i++)
+    if (i == 0 || str[i] != str[i - 1])
+      num_runs++;
+  WriteVarint(num_runs, buf);
+  int32 prev = 0;
+  for (size_t i = 0; i < str.size(); ) {
+    size_t j = i + 1;
+    while (j < str.size() && str[j] == str[i])
+      j++;
+    WriteVarint(ZigZagEncode(static_cast<int64>(str[i]) - prev), buf);
+    WriteVarint(j - i - 1, buf);
+    prev = str[i];
+    i = j;
+  }
+}
+
+// Returns true if all the weights in "clat" can be written as multiples of
+// "weight_quantum"; this fails if some are infinite (or enormous).
+static bool CanQuantizeWeights(const CompactLattice &clat,
+                               BaseFloat weight_quantum) {
+  double limit = 1.0e+15 * weight_quantum;
+  for (CompactLattice::StateId s = 0; s < clat.NumStates(); s++) {
+    LatticeWeight w = clat.Final(s).Weight();
+    if (clat.Final(s) != CompactLatticeWeight::Zero() &&
+        !(std::abs(w.Value1()) < limit && std::abs(w.Value2()) < limit))
+      return false;
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      w = aiter.Value().weight.Weight();
+      if (!(std::abs(w.Value1()) < limit && std::abs(w.Value2()) < limit))
+        return false;
+    }
+  }
+  return true;
+}
+
+// Outputs a topological order of the states of "clat" if it is acyclic and
+// not already topologically sorted; otherwise, their original order.
+static void GetCompressedStateOrder(const CompactLattice &clat,
+                                    std::vector<int32> *order) {
+  typedef CompactLattice::StateId StateId;
+  StateId num_states = clat.NumStates();
+  order->clear();
+  if (clat.Properties(fst::kTopSorted, true) == 0) {
+    std::vector<int32> num_preceding(num_states, 0);
+    for (StateId s = 0; s < num_states; s++)
+      for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+           aiter.Next())
+        num_preceding[aiter.Value().nextstate]++;
+    for (StateId s = 0; s < num_states; s++)
+      if (num_preceding[s] == 0)
+        order->push_back(s);
+    for (size_t i = 0; i < order->size(); i++) {
+      for (fst::ArcIterator<CompactLattice> aiter(clat, (*order)[i]);
+           !aiter.Done(); aiter.Next())
+        if (--num_preceding[aiter.Value().nextstate] == 0)
+          order->push_back(aiter.Value().nextstate);
+    }
+  }
+  if (order->size() != static_cast<size_t>(num_states)) {  // Sorted or cyclic.
+    order->resize(num_states);
+    for (StateId s = 0; s < num_states; s++)
+      (*order)[s] = s;
+  }
+}
+
+bool WriteCompressedCompactLattice(std::ostream &os,
+                                   const CompactLattice &clat,
+                                   BaseFloat weight_quantum) {
+  typedef CompactLattice::StateId StateId;
+  KALDI_ASSERT(weight_quantum >= 0.0);
+  if (weight_quantum != 0.0 && !CanQuantizeWeights(clat, weight_quantum))
+    weight_quantum = 0.0;
+
+  std::vector<int32> order, new_state;
+  GetCompressedStateOrder(clat, &order);
+  StateId num_states = clat.NumStates();
+  new_state.resize(num_states);
+  for (StateId i = 0; i < num_states; i++)
+    new_state[order[i]] = i;
+
+  std::string buf;
+  WriteVarint(num_states, &buf);
+  WriteVarint(clat.Start() == fst::kNoStateId ? 0 : new_state[clat.Start()] + 1,
+              &buf);
+  for (StateId i = 0; i < num_states; i++) {
+    StateId s = order[i];
+    const CompactLatticeWeight &final_weight = clat.Final(s);
+    bool is_final = (final_weight != CompactLatticeWeight::Zero());
+    WriteVarint(clat.NumArcs(s) * 2 + (is_final ? 1 : 0), &buf);
+    if (is_final) {
+      WriteCompressedWeight(final_weight.Weight(), weight_quantum, &buf);
+      WriteCompressedString(final_weight.String(), &buf);
+    }
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      if (arc.ilabel != arc.olabel) {
+        KALDI_WARN << "Writing compressed lattice: lattice is not an acceptor.";
+        return false;
+      }
+      WriteVarint(arc.ilabel, &buf);
+      WriteVarint(ZigZagEncode(static_cast<int64>(new_state[arc.nextstate]) -
+                               i), &buf);
+      WriteCompressedWeight(arc.weight.Weight(), weight_quantum, &buf);
+      WriteCompressedString(arc.weight.String(), &buf);
+    }
+  }
+  WriteToken(os, true, "<CompressedLattice>");
+  WriteBasicType(os, true, weight_quantum);
+  WriteBasicType(os, true, static_cast<int64>(buf.size()));
+  os.write(buf.data(), buf.size());
+  return os.good();
+}
+
+/// This class decodes the body of the format written by
+/// WriteCompressedCompactLattice().  All the functions return false if the
+/// data is corrupted or runs out.
+class CompressedLatticeDecoder {
+ public:
+  CompressedLatticeDecoder(const std::string &buf, BaseFloat weight_quantum):
+      pos_(reinterpret_cast<const unsigned char*>(buf.data())),
+      end_(pos_ + buf.size()), weight_quantum_(weight_quantum),
+      string_length_left_((1 << 20) + 32 * static_cast<uint64>(buf.size())) { }
+
+  bool Decode(CompactLattice *clat) {
+    typedef CompactLattice::StateId StateId;
+    uint64 num_states, start;
+    // Each state takes at least one byte, which limits num_states.
+    if (!ReadVarint(&num_states) || num_states > BytesLeft() ||
+        !ReadVarint(&start) || start > num_states)
+      return false;
+    clat->DeleteStates();
+    for (uint64 i = 0; i < num_states; i++)
+      clat->AddState();
+    if (start != 0)
+      clat->SetStart(start - 1);
+    for (StateId s = 0; s < static_cast<StateId>(num_states); s++) {
+      uint64 header;
+      if (!ReadVarint(&header) || header / 2 > BytesLeft())
+        return false;
+      uint64 num_arcs = header / 2;
+      if (header % 2 == 1) {
+        CompactLatticeWeight final_weight;
+        if (!ReadWeight(&final_weight))
+          return false;
+        clat->SetFinal(s, final_weight);
+      }
+      for (uint64 a = 0; a < num_arcs; a++) {
+        uint64 label, offset;
+        CompactLatticeArc arc;
+        if (!ReadVarint(&label) || label > std::numeric_limits<int32>::max() ||
+            !ReadVarint(&offset))
+          return false;
+        int64 nextstate = s + ZigZagDecode(offset);
+        if (nextstate < 0 || nextstate >= static_cast<int64>(num_states) ||
+            !ReadWeight(&arc.weight))
+          return false;
+        arc.ilabel = arc.olabel = label;
+        arc.nextstate = nextstate;
+        clat->AddArc(s, arc);
+      }
+    }
+    return (pos_ == end_);
+  }
+
+ private:
+  uint64 BytesLeft() const { return end_ - pos_; }
+
+  bool ReadVarint(uint64 *value) {
+    uint64 ans = 0;
+    for (int32 shift = 0; shift < 64; shift += 7) {
+      if (pos_ == end_)
+        return false;
+      unsigned char c = *(pos_++);
+      ans |= static_cast<uint64>(c & 127) << shift;
+      if ((c & 128) == 0) {
+        *value = ans;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ReadWeight(CompactLatticeWeight *weight) {
+    float values[2];
+    if (weight_quantum_ != 0.0) {
+      for (int32 i = 0; i < 2; i++) {
+        uint64 value;
+        if (!ReadVarint(&value))
+          return false;
+        values[i] = ZigZagDecode(value) * weight_quantum_;
+      }
+    } else {
+      if (BytesLeft() < sizeof(values))
+        return false;
+      std::memcpy(values, pos_, sizeof(values));
+      pos_ += sizeof(values);
+    }
+    uint64 num_runs;
+    // Each run takes at least two bytes.
+    if (!ReadVarint(&num_runs) || num_runs > BytesLeft() / 2)
+      return false;
+    std::vector<int32> str;
+    int64 prev = 0;
+    for (uint64 r = 0; r < num_runs; r++) {
+      uint64 diff, length;
+      // The run has length + 1 elements; see the comment on
+      // string_length_left_.
+      if (!ReadVarint(&diff) || !ReadVarint(&length) ||
+          length >= string_length_left_)
+        return false;
+      string_length_left_ -= length + 1;
+      int64 value = prev + ZigZagDecode(diff);
+      if (value < std::numeric_limits<int32>::min() ||
+          value > std::numeric_limits<int32>::max())
+        return false;
+      str.insert(str.end(), length + 1, static_cast<int32>(value));
+      prev = value;
+    }
+    *weight = CompactLatticeWeight(LatticeWeight(values[0], values[1]), str);
+    return true;
+  }
+
+  const unsigned char *pos_;
+  const unsigned char *end_;
+  BaseFloat weight_quantum_;
+  // A run takes only a few bytes however long it is, so to stop corrupt data
+  // from making us allocate huge strings we limit the total length of the
+  // strings to 2^20 plus 32 per byte of data, which is far more than real
+  // lattices need.  This is how much of that is left.
+  uint64 string_length_left_;
+};
+
+bool ReadCompressedCompactLattice(std::istream &is, CompactLattice **clat) {
+  KALDI_ASSERT(*clat == NULL);
+  BaseFloat weight_quantum;
+  int64 size;
+  try {
+    ExpectToken(is, true, "<CompressedLattice>");
+    ReadBasicType(is, true, &weight_quantum);
+    ReadBasicType(is, true, &size);
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Reading compressed lattice: error reading header: "
+               << e.what();
+    return false;
+  }
+  if (size < 0) {
+    KALDI_WARN << "Reading compressed lattice: bad size " << size;
+    return false;
+  }
+  // We read in chunks so that a corrupt size makes us fail at the end of the
+  // stream rather than allocate a huge buffer.
+  std::string buf;
+  const int64 chunk_size = 1 << 20;
+  while (static_cast<int64>(buf.size()) < size) {
+    size_t offset = buf.size();
+    buf.resize(offset + std::min(chunk_size,
+                                 size - static_cast<int64>(offset)));
+    if (!is.read(&(buf[offset]), buf.size() - offset)) {
+      KALDI_WARN << "Reading compressed lattice: unexpected end of stream.";
+      return false;
+    }
+  }
+  CompactLattice *ans = new CompactLattice();
+  CompressedLatticeDecoder decoder(buf, weight_quantum);
+  if (!decoder.Decode(ans)) {
+    KALDI_WARN << "Reading compressed lattice: lattice data is corrupted.";
+    delete ans;
+    return false;
+  }
+  *clat = ans;
+  return true;
+}
+
+
 /// LatticeReader provides (static) functions for reading both Lattice
 /// and CompactLattice, in text form.
 class LatticeReader {
@@ -311,6 +639,8 @@ bool ReadCompactLattice(std::istream &is, bool binary,
                         CompactLattice **clat) {
   KALDI_ASSERT(*clat == NULL);
   if (binary) {
+    if (is.peek() == '<')  // written by WriteCompressedCompactLattice().
+      return ReadCompressedCompactLattice(is, clat);
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading compact lattice: error reading FST header.";
@@ -380,8 +710,9 @@ bool CompactLatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadCompactLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != '<') { // 214 is first char of FST magic number,
+    // on little-endian machines which is all we support (\326 octal); '<'
+    // starts the compressed format.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
@@ -430,6 +761,13 @@ bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat) {
   KALDI_ASSERT(*lat == NULL);
   if (binary) {
+    if (is.peek() == '<') {  // written by WriteCompressedCompactLattice().
+      CompactLattice *clat = NULL;
+      if (!ReadCompressedCompactLattice(is, &clat))
+        return false;
+      *lat = ConvertToLattice(clat);
+      return true;
+    }
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading lattice: error reading FST header.";
@@ -502,8 +840,9 @@ bool LatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != '<') { // 214 is first char of FST magic number,
+    // on little-endian machines which is all we support (\326 octal); '<'
+    // starts the compressed format.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
@@ -65,6 +65,48 @@ bool ReadCompactLattice(std::istream &is, bool binary,
 bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat);
 
+/// Writes "clat" in a compressed binary format that is typically several times
+/// smaller than the OpenFst format written by WriteCompactLattice().  The
+/// states are numbered in topological order and the next-states are written
+/// as differences from the current state; labels, next-states and the run
+/// lengths of the transition-id strings are written as variable-length
+/// integers, and the weights are rounded to multiples of "weight_quantum"
+/// (e.g. 0.01), or written exactly if weight_quantum == 0.0.  The state
+/// numbering of the lattice will not, in general, be preserved.
+/// ReadCompactLattice() and ReadLattice() (in binary mode), and the lattice
+/// holders, detect this format automatically.  CompactLatticeWriter uses it
+/// if so configured; see CompactLatticeWriteOptions.  The reader rejects data
+/// whose transition-id strings would add up to more than 2^20 plus 32 per
+/// byte of data, so that a corrupt file can't make it allocate huge strings;
+/// real lattices are far below this.
+bool WriteCompressedCompactLattice(std::ostream &os,
+                                   const CompactLattice &clat,
+                                   BaseFloat weight_quantum = 0.01);
+
+// the following function reads the format written by
+// WriteCompressedCompactLattice(); it requires that *clat be NULL when called.
+bool ReadCompressedCompactLattice(std::istream &is, CompactLattice **clat);
+
+
+/// Options for the format in which CompactLatticeWriter writes lattices in
+/// binary mode.  Programs that write lattices can register these and pass
+/// them to the constructor or Open() of each CompactLatticeWriter.
+struct CompactLatticeWriteOptions {
+  bool compress;
+  BaseFloat weight_quantum;
+
+  CompactLatticeWriteOptions(): compress(false), weight_quantum(0.01) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("compress-lattices", &compress, "If true, write lattices in "
+                 "binary mode in a compressed format that is several times "
+                 "smaller (see also --lattice-weight-quantum).  All programs "
+                 "that read lattices detect this format.");
+    po->Register("lattice-weight-quantum", &weight_quantum, "With "
+                 "--compress-lattices=true, the lattice weights are rounded to "
+                 "multiples of this; if zero, they are written exactly.");
+  }
+};
 
 class CompactLatticeHolder {
  public:
@@ -96,6 +138,63 @@ class CompactLatticeHolder {
   T *t_;
 };
 
+/// A holder used only for writing, by CompactLatticeWriter: its objects are a
+/// lattice together with the options to write it with, so that each writer
+/// can have its own options.
+class CompactLatticeWithOptionsHolder {
+ public:
+  struct T {
+    const CompactLattice *clat;
+    const CompactLatticeWriteOptions *opts;
+  };
+
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    if (binary && t.opts->compress)
+      return WriteCompressedCompactLattice(os, *t.clat, t.opts->weight_quantum);
+    return CompactLatticeHolder::Write(os, binary, *t.clat);
+  }
+};
+
+/// CompactLatticeWriter has the same interface as TableWriter, but the
+/// constructor and Open() also take the CompactLatticeWriteOptions that say
+/// in which format to write the lattices.
+class CompactLatticeWriter {
+ public:
+  CompactLatticeWriter() { }
+
+  explicit CompactLatticeWriter(
+      const std::string &wspecifier,
+      const CompactLatticeWriteOptions &opts = CompactLatticeWriteOptions()) {
+    if (wspecifier != "" && !Open(wspecifier, opts))
+      KALDI_ERR << "CompactLatticeWriter: failed to write to " << wspecifier;
+  }
+
+  bool Open(const std::string &wspecifier,
+            const CompactLatticeWriteOptions &opts =
+            CompactLatticeWriteOptions()) {
+    KALDI_ASSERT(opts.weight_quantum >= 0.0);
+    opts_ = opts;
+    return writer_.Open(wspecifier);
+  }
+
+  bool IsOpen() const { return writer_.IsOpen(); }
+
+  void Write(const std::string &key, const CompactLattice &value) const {
+    CompactLatticeWithOptionsHolder::T t;
+    t.clat = &value;
+    t.opts = &opts_;
+    writer_.Write(key, t);
+  }
+
+  void Flush() { writer_.Flush(); }
+
+  bool Close() { return writer_.Close(); }
+
+ private:
+  TableWriter<CompactLatticeWithOptionsHolder> writer_;
+  CompactLatticeWriteOptions opts_;
+};
+
 class LatticeHolder {
  public:
   typedef Lattice T;
@@ -130,7 +229,6 @@ typedef TableWriter<LatticeHolder> LatticeWriter;
 typedef SequentialTableReader<LatticeHolder> SequentialLatticeReader;
 typedef RandomAccessTableReader<LatticeHolder> RandomAccessLatticeReader;
 
-typedef TableWriter<CompactLatticeHolder> CompactLatticeWriter;
 typedef SequentialTableReader<CompactLatticeHolder> SequentialCompactLatticeReader;
 typedef RandomAccessTableReader<CompactLatticeHolder> RandomAccessCompactLatticeReader;
 
@@ -24,6 +24,7 @@
 
 
 #include "lat/lattice-functions.h"
+#include "lat/flat-lattice.h"
 #include "hmm/transition-model.h"
 #include "util/stl-utils.h"
 #include "base/kaldi-math.h"
@@ -107,13 +108,6 @@ int32 CompactLatticeStateTimes(const CompactLattice &lat, vector<int32> *times)
 
 bool ComputeCompactLatticeAlphas(const CompactLattice &clat,
                                  vector<double> *alpha) {
-  using namespace fst;
-
-  // typedef the arc, weight types
-  typedef CompactLattice::Arc Arc;
-  typedef Arc::Weight Weight;
-  typedef Arc::StateId StateId;
-
   //Make sure the lattice is topologically sorted.
   if (clat.Properties(fst::kTopSorted, true) == 0) {
     KALDI_WARN << "Input lattice must be topologically sorted.";
@@ -124,34 +118,15 @@ bool ComputeCompactLatticeAlphas(const CompactLattice &clat,
     return false;
   }
 
-  int32 num_states = clat.NumStates();
-  (*alpha).resize(0);
-  (*alpha).resize(num_states, kLogZeroDouble);
-
-  // Now propagate alphas forward. Note that we don't acount the weight of the
-  // final state to alpha[final_state] -- we acount it to beta[final_state];
-  (*alpha)[0] = 0.0;
-  for (StateId s = 0; s < num_states; s++) {
-    double this_alpha = (*alpha)[s];
-    for (ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -(arc.weight.Weight().Value1() + arc.weight.Weight().Value2());
-      (*alpha)[arc.nextstate] = LogAdd((*alpha)[arc.nextstate], this_alpha + arc_like);
-    }
-  }
-
+  // Note that we don't acount the weight of the final state to
+  // alpha[final_state] -- we acount it to beta[final_state];
+  FlatLattice flat(clat);
+  FlatLatticeForward(flat, alpha);
   return true;
 }
 
 bool ComputeCompactLatticeBetas(const CompactLattice &clat,
                                 vector<double> *beta) {
-  using namespace fst;
-
-  // typedef the arc, weight types
-  typedef CompactLattice::Arc Arc;
-  typedef Arc::Weight Weight;
-  typedef Arc::StateId StateId;
-
   // Make sure the lattice is topologically sorted.
   if (clat.Properties(fst::kTopSorted, true) == 0) {
     KALDI_WARN << "Input lattice must be topologically sorted.";
@@ -162,24 +137,10 @@ bool ComputeCompactLatticeBetas(const CompactLattice &clat,
     return false;
   }
 
-  int32 num_states = clat.NumStates();
-  (*beta).resize(0);
-  (*beta).resize(num_states, kLogZeroDouble);
-
-  // Now propagate betas backward. Note that beta[final_state] contains the
-  // weight of the final state in the lattice -- compare that with alpha.
-  for (StateId s = num_states-1; s >= 0; s--) {
-    Weight f = clat.Final(s);
-    double this_beta = -(f.Weight().Value1()+f.Weight().Value2());
-    for (ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -(arc.weight.Weight().Value1()+arc.weight.Weight().Value2());
-      double arc_beta = (*beta)[arc.nextstate] + arc_like;
-      this_beta = LogAdd(this_beta, arc_beta);
-    }
-    (*beta)[s] = this_beta;
-  }
-
+  // Note that beta[final_state] contains the weight of the final state in the
+  // lattice -- compare that with alpha.
+  FlatLattice flat(clat);
+  FlatLatticeBackward(flat, beta);
   return true;
 }
 
@@ -289,39 +250,21 @@ BaseFloat LatticeForwardBackward(const Lattice &lat, Posterior *post,
   int32 num_states = lat.NumStates();
   vector<int32> state_times;
   int32 max_time = LatticeStateTimes(lat, &state_times);
-  std::vector<double> alpha(num_states, kLogZeroDouble);
-  std::vector<double> &beta(alpha); // we re-use the same memory for
-  // this, but it's semantically distinct so we name it differently.
-  double tot_forward_prob = kLogZeroDouble;
+  std::vector<double> alpha, beta;
+  // Propagate alphas forward and betas backward.
+  FlatLattice flat(lat);
+  double tot_forward_prob = FlatLatticeForward(flat, &alpha),
+      tot_backward_prob = FlatLatticeBackward(flat, &beta);
 
   post->clear();
   post->resize(max_time);
 
-  alpha[0] = 0.0;
-  // Propagate alphas forward.
   for (StateId s = 0; s < num_states; s++) {
-    double this_alpha = alpha[s];
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight);
-      alpha[arc.nextstate] = LogAdd(alpha[arc.nextstate], this_alpha + arc_like);
-    }
-    Weight f = lat.Final(s);
-    if (f != Weight::Zero()) {
-      double final_like = this_alpha - (f.Value1() + f.Value2());
-      tot_forward_prob = LogAdd(tot_forward_prob, final_like);
-      KALDI_ASSERT(state_times[s] == max_time &&
-                   "Lattice is inconsistent (final-prob not at max_time)");
-    }
-  }
-  for (StateId s = num_states-1; s >= 0; s--) {
     Weight f = lat.Final(s);
-    double this_beta = -(f.Value1() + f.Value2());
     for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
       const Arc &arc = aiter.Value();
       double arc_like = -ConvertToCost(arc.weight),
           arc_beta = beta[arc.nextstate] + arc_like;
-      this_beta = LogAdd(this_beta, arc_beta);
       int32 transition_id = arc.ilabel;
 
       // The following "if" is an optimization to avoid un-needed exp().
@@ -335,14 +278,16 @@ BaseFloat LatticeForwardBackward(const Lattice &lat, Posterior *post,
           *acoustic_like_sum -= posterior * arc.weight.Value2();
       }
     }
-    if (acoustic_like_sum != NULL && f != Weight::Zero()) {
-      double final_logprob = - ConvertToCost(f),
-          posterior = exp(alpha[s] + final_logprob - tot_forward_prob);
-      *acoustic_like_sum -= posterior * f.Value2();
+    if (f != Weight::Zero()) {
+      KALDI_ASSERT(state_times[s] == max_time &&
+                   "Lattice is inconsistent (final-prob not at max_time)");
+      if (acoustic_like_sum != NULL) {
+        double final_logprob = - ConvertToCost(f),
+            posterior = exp(alpha[s] + final_logprob - tot_forward_prob);
+        *acoustic_like_sum -= posterior * f.Value2();
+      }
     }
-    beta[s] = this_beta;
   }
-  double tot_backward_prob = beta[0];
   if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-8)) {
     KALDI_WARN << "Total forward probability over lattice = " << tot_forward_prob
               << ", while total backward probability = " << tot_backward_prob;
@@ -761,48 +706,25 @@ BaseFloat LatticeForwardBackwardMpeVariants(
   vector<int32> state_times;
   int32 max_time = LatticeStateTimes(lat, &state_times);
   KALDI_ASSERT(max_time == static_cast<int32>(num_ali.size()));
-  std::vector<double> alpha(num_states, kLogZeroDouble),
+  std::vector<double> alpha, beta,
       alpha_smbr(num_states, 0), //forward variable for sMBR
-      beta(num_states, kLogZeroDouble),
       beta_smbr(num_states, 0); //backward variable for sMBR
 
-  double tot_forward_prob = kLogZeroDouble;
   double tot_forward_score = 0;
 
   post->clear();
   post->resize(max_time);
 
-  alpha[0] = 0.0;
   // First Pass Forward,
-  for (StateId s = 0; s < num_states; s++) {
-    double this_alpha = alpha[s];
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight);
-      alpha[arc.nextstate] = LogAdd(alpha[arc.nextstate], this_alpha + arc_like);
-    }
-    Weight f = lat.Final(s);
-    if (f != Weight::Zero()) {
-      double final_like = this_alpha - (f.Value1() + f.Value2());
-      tot_forward_prob = LogAdd(tot_forward_prob, final_like);
+  FlatLattice flat(lat);
+  double tot_forward_prob = FlatLatticeForward(flat, &alpha);
+  for (StateId s = 0; s < num_states; s++)
+    if (flat.final_like[s] != kLogZeroDouble)
       KALDI_ASSERT(state_times[s] == max_time &&
                    "Lattice is inconsistent (final-prob not at max_time)");
-    }
-  }
   // First Pass Backward,
-  for (StateId s = num_states-1; s >= 0; s--) {
-    Weight f = lat.Final(s);
-    double this_beta = -(f.Value1() + f.Value2());
-    for (ArcIterator<Lattice> aiter(lat, s); !aiter.Done(); aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      double arc_like = -ConvertToCost(arc.weight),
-          arc_beta = beta[arc.nextstate] + arc_like;
-      this_beta = LogAdd(this_beta, arc_beta);
-    }
-    beta[s] = this_beta;
-  }
+  double tot_backward_prob = FlatLatticeBackward(flat, &beta);
   // First Pass Forward-Backward Check
-  double tot_backward_prob = beta[0];
   // may loose the condition somehow here 1e-6 (was 1e-8)
   if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-6)) {
     KALDI_ERR << "Total forward probability over lattice = " << tot_forward_prob
@@ -0,0 +1,167 @@
+// lat/lattice-rescore-ctm-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/lattice-rescore-ctm.h"
+#include "lat/lattice-functions.h"
+#include "lat/sausages.h"
+
+namespace kaldi {
+
+// Returns a bigram LM on the words 1 ... num_words with random costs; state 0
+// is the sentence start and state w is the history w.  If "backoff" is false
+// it has an arc for every word from each state, so the LM FST and
+// BackoffDeterministicOnDemandFst give the same costs.  Otherwise each history
+// state has arcs for only some words, and an epsilon arc to a unigram state
+// that has an arc for every word, as in an ARPA LM converted by arpa2fst.
+fst::VectorFst<fst::StdArc> *RandBigramLm(int32 num_words, bool backoff) {
+  using fst::StdArc;
+  fst::VectorFst<StdArc> *lm = new fst::VectorFst<StdArc>;
+  int32 num_states = num_words + (backoff ? 2 : 1),
+      unigram_state = num_words + 1;
+  for (int32 s = 0; s < num_states; s++) {
+    lm->AddState();
+    lm->SetFinal(s, StdArc::Weight(2.0 * RandUniform()));
+  }
+  lm->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    for (int32 w = 1; w <= num_words; w++)
+      if (!backoff || s == unigram_state || RandInt(0, 1) == 0)
+        lm->AddArc(s, StdArc(w, w, StdArc::Weight(5.0 * RandUniform()), w));
+    if (backoff && s != unigram_state)
+      lm->AddArc(s, StdArc(0, 0, StdArc::Weight(2.0 * RandUniform()),
+                           unigram_state));
+  }
+  fst::ArcSort(lm, fst::ILabelCompare<StdArc>());
+  return lm;
+}
+
+// Returns a lattice as latgen-faster-mapped writes it: the raw lattice, whose
+// paths all have "num_frames" transition-ids, is determinized with the
+// acoustic scale applied, which is then removed.
+void RandDecodedLattice(int32 num_words, int32 num_frames,
+                        BaseFloat acoustic_scale, CompactLattice *clat) {
+  Lattice lat;
+  for (int32 t = 0; t <= num_frames; t++)
+    lat.AddState();
+  lat.SetStart(0);
+  lat.SetFinal(num_frames, LatticeWeight::One());
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 num_arcs = RandInt(1, 3);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 word = (RandInt(0, 2) == 0 ? RandInt(1, num_words) : 0);
+      LatticeWeight weight(RandUniform(), 10.0 * RandUniform());
+      lat.AddArc(t, LatticeArc(RandInt(1, 20), word, weight, t + 1));
+    }
+  }
+  fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &lat);
+  fst::Invert(&lat);
+  DeterminizeLattice(lat, clat);
+  fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), clat);
+}
+
+// Does what lattice-lmrescore does with the LM FST "lm" and "lm_scale".
+void LmRescoreReference(const fst::VectorFst<fst::StdArc> &lm,
+                        BaseFloat lm_scale, CompactLattice *clat) {
+  fst::VectorFst<LatticeArc> lm_lat;
+  fst::ArcMap(lm, &lm_lat, fst::StdToLatticeMapper<BaseFloat>());
+  Lattice lat;
+  ConvertLattice(*clat, &lat);
+  fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale), &lat);
+  fst::ArcSort(&lat, fst::OLabelCompare<LatticeArc>());
+  Lattice composed_lat;
+  fst::Compose(lat, lm_lat, &composed_lat);
+  fst::Invert(&composed_lat);
+  DeterminizeLattice(composed_lat, clat);
+  fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), clat);
+}
+
+// Does what lattice-lmrescore-const-arpa does, with the LM "lm".
+void ConstArpaRescoreReference(fst::DeterministicOnDemandFst<fst::StdArc> *lm,
+                               CompactLattice *clat) {
+  ArcSort(clat, fst::OLabelCompare<CompactLatticeArc>());
+  CompactLattice composed_clat;
+  ComposeCompactLatticeDeterministic(*clat, lm, &composed_clat);
+  Lattice composed_lat;
+  ConvertLattice(composed_clat, &composed_lat);
+  Invert(&composed_lat);
+  DeterminizeLattice(composed_lat, clat);
+}
+
+// The ctm from RescoreCompactLatticeToCtm() must be the one we get from
+// latgen-faster-mapped, lattice-lmrescore --lm-scale=-1.0,
+// lattice-lmrescore-const-arpa, lattice-add-penalty and lattice-to-ctm-conf
+// run one after the other (we don't test the word alignment, which needs a
+// real model).  The old LM has backoff arcs, which lattice-lmrescore treats
+// as epsilons.
+void TestRescoreCompactLatticeToCtm() {
+  int32 num_words = RandInt(1, 5);
+  BaseFloat acoustic_scale = 0.05 + 0.95 * RandUniform();
+  CompactLattice clat;
+  RandDecodedLattice(num_words, RandInt(1, 20), acoustic_scale, &clat);
+  fst::VectorFst<fst::StdArc> *old_lm = RandBigramLm(num_words, true),
+      *new_lm = RandBigramLm(num_words, false);
+  fst::VectorFst<LatticeArc> old_lm_lat;
+  fst::ArcMap(*old_lm, &old_lm_lat, fst::StdToLatticeMapper<BaseFloat>());
+  fst::BackoffDeterministicOnDemandFst<fst::StdArc> new_lm_dfst(*new_lm);
+
+  LatticeRescoreCtmOptions opts;
+  opts.acoustic_scale = acoustic_scale;
+  opts.word_ins_penalty = RandUniform();
+  opts.decode_mbr = (RandInt(0, 1) == 0);
+
+  // The sequential pipeline.
+  CompactLattice ref_clat(clat);
+  LmRescoreReference(*old_lm, -1.0, &ref_clat);
+  ConstArpaRescoreReference(&new_lm_dfst, &ref_clat);
+  AddWordInsPenToCompactLattice(opts.word_ins_penalty, &ref_clat);
+  TopSortCompactLatticeIfNeeded(&ref_clat);
+  fst::ScaleLattice(fst::LatticeScale(1.0, acoustic_scale), &ref_clat);
+  MinimumBayesRisk mbr(ref_clat, opts.decode_mbr);
+
+  TransitionModel trans_model;  // Not used, as we don't word-align.
+  std::vector<int32> words;
+  std::vector<std::pair<BaseFloat, BaseFloat> > times;
+  std::vector<BaseFloat> conf;
+  BaseFloat bayes_risk;
+  KALDI_ASSERT(RescoreCompactLatticeToCtm(opts, trans_model, NULL,
+                                          &old_lm_lat, &new_lm_dfst, "utt",
+                                          &clat, &words, &times, &conf,
+                                          &bayes_risk));
+
+  KALDI_ASSERT(words == mbr.GetOneBest());
+  KALDI_ASSERT(std::abs(bayes_risk - mbr.GetBayesRisk()) < 0.01);
+  for (size_t i = 0; i < words.size(); i++) {
+    KALDI_ASSERT(std::abs(times[i].first - mbr.GetOneBestTimes()[i].first) <
+                 0.01);
+    KALDI_ASSERT(std::abs(times[i].second - mbr.GetOneBestTimes()[i].second) <
+                 0.01);
+    KALDI_ASSERT(std::abs(conf[i] - mbr.GetOneBestConfidences()[i]) < 0.01);
+  }
+  delete old_lm;
+  delete new_lm;
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++)
+    TestRescoreCompactLatticeToCtm();
+  KALDI_LOG << "Test OK.";
+}
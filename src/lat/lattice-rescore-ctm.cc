@@ -0,0 +1,135 @@
+// lat/lattice-rescore-ctm.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/lattice-rescore-ctm.h"
+#include "lat/lattice-functions.h"
+#include "lat/sausages.h"
+#include "fstext/table-matcher.h"
+
+namespace kaldi {
+
+bool RescoreCompactLattice(BaseFloat lm_scale,
+                           const fst::Fst<LatticeArc> &lm,
+                           CompactLattice *clat) {
+  if (lm_scale == 0.0) return true;
+  Lattice lat;
+  ConvertLattice(*clat, &lat);
+  // As in lattice-lmrescore: we scale by the inverse of "lm_scale" before
+  // composing and by "lm_scale" after determinizing, to take the best path
+  // through the LM whatever the sign of "lm_scale".
+  fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale), &lat);
+  ArcSort(&lat, fst::OLabelCompare<LatticeArc>());
+
+  // We look up the arcs of "lm".  We don't keep a TableComposeCache between
+  // calls, as lattice-lmrescore does, because it could not be shared between
+  // threads.
+  fst::TableComposeOptions compose_opts(fst::TableMatcherOptions(),
+                                        true, fst::SEQUENCE_FILTER,
+                                        fst::MATCH_INPUT);
+  Lattice composed_lat;
+  TableCompose(lat, lm, &composed_lat, compose_opts);
+  Invert(&composed_lat);  // make it so word labels are on the input.
+  DeterminizeLattice(composed_lat, clat);
+  fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), clat);
+  return (clat->Start() != fst::kNoStateId);
+}
+
+bool RescoreCompactLatticeDeterministic(
+    BaseFloat lm_scale,
+    fst::DeterministicOnDemandFst<fst::StdArc> *lm,
+    CompactLattice *clat) {
+  if (lm_scale == 0.0) return true;
+  // Before composing with the LM FST, we scale the lattice weights by the
+  // inverse of "lm_scale".  We'll later scale by "lm_scale".  We do it this
+  // way so we can determinize and it will give the right effect (taking the
+  // "best path" through the LM) regardless of the sign of lm_scale.
+  fst::ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale), clat);
+  ArcSort(clat, fst::OLabelCompare<CompactLatticeArc>());
+
+  CompactLattice composed_clat;
+  ComposeCompactLatticeDeterministic(*clat, lm, &composed_clat);
+
+  Lattice composed_lat;
+  ConvertLattice(composed_clat, &composed_lat);
+  Invert(&composed_lat);
+  DeterminizeLattice(composed_lat, clat);
+  fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), clat);
+  return (clat->Start() != fst::kNoStateId);
+}
+
+
+bool RescoreCompactLatticeToCtm(
+    const LatticeRescoreCtmOptions &opts,
+    const TransitionModel &trans_model,
+    const WordBoundaryInfo *word_boundary_info,
+    const fst::Fst<LatticeArc> *old_lm,
+    fst::DeterministicOnDemandFst<fst::StdArc> *new_lm,
+    const std::string &utt,
+    CompactLattice *clat,
+    std::vector<int32> *words,
+    std::vector<std::pair<BaseFloat, BaseFloat> > *times,
+    std::vector<BaseFloat> *conf,
+    BaseFloat *bayes_risk) {
+  if (old_lm != NULL && !RescoreCompactLattice(-1.0, *old_lm, clat)) {
+    KALDI_WARN << "Empty lattice for utterance " << utt
+               << " after removing the old LM (incompatible LM?)";
+    return false;
+  }
+  if (new_lm != NULL &&
+      !RescoreCompactLatticeDeterministic(1.0, new_lm, clat)) {
+    KALDI_WARN << "Empty lattice for utterance " << utt
+               << " after adding the new LM (incompatible LM?)";
+    return false;
+  }
+  if (opts.word_ins_penalty != 0.0)
+    AddWordInsPenToCompactLattice(opts.word_ins_penalty, clat);
+
+  if (word_boundary_info != NULL) {
+    CompactLattice aligned_clat;
+    int32 max_states = (opts.max_expand > 0 ?
+                        1000 + opts.max_expand * clat->NumStates() : 0);
+    if (!WordAlignLattice(*clat, trans_model, *word_boundary_info,
+                          max_states, &aligned_clat)) {
+      if (aligned_clat.Start() == fst::kNoStateId) {
+        KALDI_WARN << "Lattice for " << utt << " did not align correctly, "
+                   << "producing no output.";
+        return false;
+      }
+      KALDI_WARN << "Using partially word-aligned lattice for " << utt;
+    }
+    *clat = aligned_clat;
+  }
+  if (clat->Start() == fst::kNoStateId) {
+    KALDI_WARN << "Word-aligned lattice was empty for utterance " << utt;
+    return false;
+  }
+  TopSortCompactLatticeIfNeeded(clat);
+
+  fst::ScaleLattice(fst::AcousticLatticeScale(opts.acoustic_scale), clat);
+  MinimumBayesRisk mbr(*clat, opts.decode_mbr);
+  *words = mbr.GetOneBest();
+  *times = mbr.GetOneBestTimes();
+  *conf = mbr.GetOneBestConfidences();
+  *bayes_risk = mbr.GetBayesRisk();
+  KALDI_ASSERT(conf->size() == words->size() && words->size() == times->size());
+  return true;
+}
+
+
+}  // end namespace kaldi.
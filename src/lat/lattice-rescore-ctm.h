@@ -0,0 +1,119 @@
+// lat/lattice-rescore-ctm.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_LATTICE_RESCORE_CTM_H_
+#define KALDI_LAT_LATTICE_RESCORE_CTM_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "fstext/deterministic-fst.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/word-align-lattice.h"
+
+// This header contains code for going from a lattice to a ctm in one process,
+// doing what lattice-lmrescore, lattice-lmrescore-const-arpa,
+// lattice-add-penalty, lattice-align-words and lattice-to-ctm-conf would
+// otherwise do with the lattices written to disk in between.
+
+namespace kaldi {
+
+
+struct LatticeRescoreCtmOptions {
+  BaseFloat acoustic_scale;
+  BaseFloat word_ins_penalty;
+  int32 max_expand;
+  bool decode_mbr;
+
+  LatticeRescoreCtmOptions(): acoustic_scale(1.0), word_ins_penalty(0.0),
+                              max_expand(0), decode_mbr(true) { }
+
+  // Note: we don't register acoustic_scale, as binaries that decode have
+  // their own --acoustic-scale option; they have to set it.
+  void Register(OptionsItf *po) {
+    po->Register("word-ins-penalty", &word_ins_penalty, "Word insertion "
+                 "penalty added to the rescored lattice before computing the "
+                 "ctm (as lattice-add-penalty would).");
+    po->Register("max-expand", &max_expand, "If >0, the maximum factor by "
+                 "which word alignment may expand a lattice before we give up "
+                 "on it (as for lattice-align-words).");
+    po->Register("decode-mbr", &decode_mbr, "If true, do Minimum Bayes Risk "
+                 "decoding for the ctm (else, Maximum a Posteriori)");
+  }
+};
+
+
+/// Rescores the lattice "clat" with the LM FST "lm", scaled by "lm_scale" (use
+/// -1.0 to remove an LM and 1.0 to add one); this is what lattice-lmrescore
+/// does.  "lm" is the LM FST (e.g. G.fst projected on its output) mapped to
+/// the lattice semiring with StdToLatticeMapper, and should be sorted on its
+/// input labels.  The lattice is composed with "lm", treating its backoff
+/// arcs as epsilons, and determinized, keeping the best path through the LM
+/// for each word sequence.  Returns false if the result was empty (e.g. the
+/// LM does not match the lattice).
+bool RescoreCompactLattice(BaseFloat lm_scale,
+                           const fst::Fst<LatticeArc> &lm,
+                           CompactLattice *clat);
+
+
+/// Rescores the lattice "clat" with the language model "lm", scaled by
+/// "lm_scale" (use -1.0 to remove an LM and 1.0 to add one); this is what
+/// lattice-lmrescore-const-arpa does.  The lattice is composed with "lm" and
+/// determinized, keeping the best path for each word sequence.  Returns false
+/// if the result was empty (e.g. the LM does not match the lattice).
+bool RescoreCompactLatticeDeterministic(
+    BaseFloat lm_scale,
+    fst::DeterministicOnDemandFst<fst::StdArc> *lm,
+    CompactLattice *clat);
+
+
+/// Does the same as the pipeline lattice-lmrescore --lm-scale=-1.0 (with
+/// "old_lm"), lattice-lmrescore-const-arpa (with "new_lm"),
+/// lattice-add-penalty, lattice-align-words and lattice-to-ctm-conf.  "clat"
+/// should be as the decoding binaries write it, i.e. without acoustic
+/// scaling; it is changed by this function.  opts.acoustic_scale is applied
+/// only to the posteriors, as for lattice-to-ctm-conf --acoustic-scale, so the
+/// path kept for each word sequence while rescoring is the same as in the
+/// pipeline.  "old_lm" is used as by RescoreCompactLattice() and "new_lm" as
+/// by RescoreCompactLatticeDeterministic(); they may be NULL if there is
+/// nothing to remove or add.  If "word_boundary_info" is NULL the lattice is
+/// assumed to be word-aligned already.  The outputs are those of
+/// MinimumBayesRisk; the times are in frames.  Returns false (with a warning
+/// mentioning "utt") if there is no output.
+bool RescoreCompactLatticeToCtm(
+    const LatticeRescoreCtmOptions &opts,
+    const TransitionModel &trans_model,
+    const WordBoundaryInfo *word_boundary_info,
+    const fst::Fst<LatticeArc> *old_lm,
+    fst::DeterministicOnDemandFst<fst::StdArc> *new_lm,
+    const std::string &utt,
+    CompactLattice *clat,
+    std::vector<int32> *words,
+    std::vector<std::pair<BaseFloat, BaseFloat> > *times,
+    std::vector<BaseFloat> *conf,
+    BaseFloat *bayes_risk);
+
+
+}  // end namespace kaldi.
+
+
+#endif  // KALDI_LAT_LATTICE_RESCORE_CTM_H_
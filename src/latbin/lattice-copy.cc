@@ -38,11 +38,14 @@ int main(int argc, char *argv[]) {
         "format to standard from compact lattice.)\n"
         "Usage: lattice-copy [options] lattice-rspecifier lattice-wspecifier\n"
         " e.g.: lattice-copy --write-compact=false ark:1.lats ark,t:text.lats\n"
+        "   or: lattice-copy --compress-lattices=true ark:1.lats ark:1_compressed.lats\n"
         "See also: lattice-to-fst, and the script egs/wsj/s5/utils/convert_slf.pl\n";
     
     ParseOptions po(usage);
     bool write_compact = true;
+    CompactLatticeWriteOptions write_opts;
     po.Register("write-compact", &write_compact, "If true, write in normal (compact) form.");
+    write_opts.Register(&po);
     
     po.Read(argc, argv);
 
@@ -56,9 +59,12 @@ int main(int argc, char *argv[]) {
 
     int32 n_done = 0;
     
+    if (write_opts.compress && !write_compact)
+      KALDI_ERR << "--compress-lattices=true requires --write-compact=true";
+
     if (write_compact) {
       SequentialCompactLatticeReader lattice_reader(lats_rspecifier);
-      CompactLatticeWriter lattice_writer(lats_wspecifier);
+      CompactLatticeWriter lattice_writer(lats_wspecifier, write_opts);
       for (; !lattice_reader.Done(); lattice_reader.Next(), n_done++)
         lattice_writer.Write(lattice_reader.Key(), lattice_reader.Value());
     } else {
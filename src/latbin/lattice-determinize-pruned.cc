@@ -20,6 +20,7 @@
 #include "util/common-utils.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/determinize-lattice-pruned.h"
+#include "lat/determinize-lattice-pruned-parallel.h"
 #include "lat/lattice-functions.h"
 #include "lat/push-lattice.h"
 #include "lat/minimize-lattice.h"
@@ -42,6 +43,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     BaseFloat beam = 10.0;
     bool minimize = false;
+    int32 num_threads = 1;
     fst::DeterminizeLatticePrunedOptions opts; // Options used in DeterminizeLatticePruned--
     // this options class does not have its own Register function as it's viewed as
     // being more part of "fst world", so we register its elements independently.
@@ -53,6 +55,9 @@ int main(int argc, char *argv[]) {
     po.Register("beam", &beam, "Pruning beam [applied after acoustic scaling].");
     po.Register("minimize", &minimize,
                 "If true, push and minimize after determinization");
+    po.Register("num-threads", &num_threads, "Number of threads to use for "
+                "determinizing each lattice; long lattices are cut into this "
+                "many pieces, which are determinized in parallel.");
     opts.Register(&po);
     po.Read(argc, argv);
 
@@ -74,6 +79,9 @@ int main(int argc, char *argv[]) {
 
     int32 n_done = 0, n_warn = 0;
 
+    // The same threads are used for all the lattices.
+    PersistentMultiThreader threader(num_threads);
+
     if (acoustic_scale == 0.0)
       KALDI_ERR << "Do not use a zero acoustic scale (cannot be inverted)";
 
@@ -93,7 +101,8 @@ int main(int argc, char *argv[]) {
       }
       fst::ArcSort(&lat, fst::ILabelCompare<LatticeArc>());
       CompactLattice det_clat;
-      if (!DeterminizeLatticePruned(lat, beam, &det_clat, opts)) {
+      if (!DeterminizeLatticePrunedParallel(lat, beam, &threader, &det_clat,
+                                            opts)) {
         KALDI_WARN << "For key " << key << ", determinization did not succeed"
             "(partial output will be pruned tighter than the specified beam.)";
         n_warn++;
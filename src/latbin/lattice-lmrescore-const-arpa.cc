@@ -37,32 +37,65 @@ int main(int argc, char *argv[]) {
         "rescoring is done by composing with the wrapped LM using a special\n"
         "type of composition algorithm. Determinization will be applied on\n"
         "the composed lattice.\n"
+        "If more than one language model is given, they are interpolated on\n"
+        "the fly (see --lm-weights and --log-linear); they must have the same\n"
+        "vocabulary.\n"
         "\n"
         "Usage: lattice-lmrescore-const-arpa [options] lattice-rspecifier \\\n"
-        "                                   const-arpa-in lattice-wspecifier\n"
+        "              const-arpa-in1 [const-arpa-in2 ...] lattice-wspecifier\n"
         " e.g.: lattice-lmrescore-const-arpa --lm-scale=-1.0 ark:in.lats \\\n"
-        "                                   const_arpa ark:out.lats\n";
+        "                                   const_arpa ark:out.lats\n"
+        " or:   lattice-lmrescore-const-arpa --lm-weights=0.8,0.2 \\\n"
+        "           ark:in.lats general.carpa domain.carpa ark:out.lats\n";
       
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    int32 lm_cache_size = 1000000, max_lm_states = 1000000;
+    std::string lm_weights_str;
+    bool log_linear = false;
     
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    po.Register("lm-cache-size", &lm_cache_size, "Number of n-gram lookups "
+                "to cache; the cache is kept from one lattice to the next.");
+    po.Register("max-lm-states", &max_lm_states, "If more than this many "
+                "history states of the language model have been visited, we "
+                "start a new cache for the next lattice, to limit memory "
+                "use.");
+    po.Register("lm-weights", &lm_weights_str, "Comma-separated list of "
+                "interpolation weights, one per language model (default: "
+                "equal weights).");
+    po.Register("log-linear", &log_linear, "If true, interpolate the "
+                "language models log-linearly, i.e. add up their scaled "
+                "log-probabilities; otherwise interpolate the probabilities.");
     
     po.Read(argc, argv);
 
-    if (po.NumArgs() != 3) {
+    if (po.NumArgs() < 3) {
       po.PrintUsage();
       exit(1);
     }
 
+    int32 num_lms = po.NumArgs() - 2;
     std::string lats_rspecifier = po.GetArg(1),
-        lm_rxfilename = po.GetArg(2),
-        lats_wspecifier = po.GetArg(3);
-
-    // Reads the language model in ConstArpaLm format.
-    ConstArpaLm const_arpa;
-    ReadKaldiObject(lm_rxfilename, &const_arpa);
+        lats_wspecifier = po.GetArg(num_lms + 2);
+
+    std::vector<float> lm_weights(num_lms, 1.0 / num_lms);
+    if (!lm_weights_str.empty() &&
+        (!SplitStringToFloats(lm_weights_str, ",", false, &lm_weights) ||
+         lm_weights.size() != static_cast<size_t>(num_lms)))
+      KALDI_ERR << "Bad --lm-weights option '" << lm_weights_str << "': "
+                << "expected " << num_lms << " comma-separated weights.";
+
+    // Reads the language models in ConstArpaLm format.
+    std::vector<ConstArpaLm*> const_arpas(num_lms);
+    std::vector<ConstArpaLmCache*> lm_caches(num_lms);
+    for (int32 i = 0; i < num_lms; i++) {
+      const_arpas[i] = new ConstArpaLm();
+      const_arpas[i]->ReadMapped(po.GetArg(i + 2));
+      lm_caches[i] = new ConstArpaLmCache(*(const_arpas[i]), lm_cache_size,
+                                          false, max_lm_states);
+    }
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
@@ -83,14 +116,26 @@ int main(int argc, char *argv[]) {
         fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale), &clat);
         ArcSort(&clat, fst::OLabelCompare<CompactLatticeArc>());
 
-        // Wraps the ConstArpaLm format language model into FST. We re-create it
-        // for each lattice to prevent memory usage increasing with time.
-        ConstArpaLmDeterministicFst const_arpa_fst(const_arpa);
+        // Wraps the ConstArpaLm format language models into FSTs. The
+        // history states are kept in <lm_caches> across lattices, as the same
+        // ones are reached again and again; the caches start afresh when they
+        // have more than --max-lm-states, to prevent memory usage increasing
+        // with time.
+        std::vector<fst::DeterministicOnDemandFst<fst::StdArc>*>
+            const_arpa_fsts(num_lms);
+        for (int32 i = 0; i < num_lms; i++)
+          const_arpa_fsts[i] = new ConstArpaLmDeterministicFst(lm_caches[i]);
+        fst::DeterministicOnDemandFst<fst::StdArc> *lm_fst = const_arpa_fsts[0];
+        if (num_lms > 1)
+          lm_fst = new fst::InterpolatedDeterministicOnDemandFst<fst::StdArc>(
+              const_arpa_fsts, lm_weights, log_linear);
 
         // Composes lattice with language model.        
         CompactLattice composed_clat;
-        ComposeCompactLatticeDeterministic(clat,
-                                           &const_arpa_fst, &composed_clat);
+        ComposeCompactLatticeDeterministic(clat, lm_fst, &composed_clat);
+        if (num_lms > 1)
+          delete lm_fst;
+        DeletePointers(&const_arpa_fsts);
 
         // Determinizes the composed lattice.
         Lattice composed_lat;
@@ -114,6 +159,8 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    DeletePointers(&lm_caches);
+    DeletePointers(&const_arpas);
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
@@ -0,0 +1,173 @@
+// lm/arpa-file-parser-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "lm/arpa-file-parser.h"
+
+namespace kaldi {
+
+// A small trigram LM; the bigram "b d" has a word that is not a unigram.
+static const char *kTestArpa =
+    "\n"
+    "\\data\\\n"
+    "ngram 1=5\n"
+    "ngram 2=5\n"
+    "ngram 3=2\n"
+    "\n"
+    "\\1-grams:\n"
+    "-99\t<s>\t-0.3\n"
+    "-1.0\t</s>\n"
+    "-0.8\ta\t-0.4\n"
+    "-0.9\tb\t-0.3\n"
+    "-1.2\tc\n"
+    "\n"
+    "\\2-grams:\n"
+    "-0.5\t<s> a\t-0.1\n"
+    "-0.6\ta b\t-0.2\n"
+    "-0.4\tb </s>\n"
+    "-0.7 a  c \n"
+    "-0.3\tb d\n"
+    "\n"
+    "\\3-grams:\n"
+    "-0.2\t<s> a b\n"
+    "-0.25\ta b </s>\n"
+    "\n"
+    "\\end\\\n";
+
+// The same, with the words <s>, </s>, a, b, c and d mapped to 1, ..., 6.
+static const char *kTestIntegerArpa =
+    "\\data\\\n"
+    "ngram 1=5\n"
+    "ngram 2=5\n"
+    "ngram 3=2\n"
+    "\n"
+    "\\1-grams:\n"
+    "-99\t1\t-0.3\n"
+    "-1.0\t2\n"
+    "-0.8\t3\t-0.4\n"
+    "-0.9\t4\t-0.3\n"
+    "-1.2\t5\n"
+    "\n"
+    "\\2-grams:\n"
+    "-0.5\t1 3\t-0.1\n"
+    "-0.6\t3 4\t-0.2\n"
+    "-0.4\t4 2\n"
+    "-0.7 3  5 \n"
+    "-0.3\t4 6\n"
+    "\n"
+    "\\3-grams:\n"
+    "-0.2\t1 3 4\n"
+    "-0.25\t3 4 2\n"
+    "\n"
+    "\\end\\\n";
+
+// Remembers the n-grams it is given.
+class TestArpaFileParser : public ArpaFileParser {
+ public:
+  TestArpaFileParser(const ArpaParseOptions &options,
+                     fst::SymbolTable *symbols):
+      ArpaFileParser(options, symbols), header_available_(false),
+      read_complete_(false) { }
+
+  std::vector<NGram> ngrams_;
+  bool header_available_;
+  bool read_complete_;
+
+ protected:
+  virtual void HeaderAvailable() {
+    KALDI_ASSERT(ngrams_.empty());
+    header_available_ = true;
+  }
+
+  virtual void ConsumeNGram(const NGram &ngram) {
+    KALDI_ASSERT(header_available_ && !read_complete_);
+    // N-grams must come in increasing order.
+    KALDI_ASSERT(ngrams_.empty() ||
+                 ngrams_.back().words.size() <= ngram.words.size());
+    ngrams_.push_back(ngram);
+  }
+
+  virtual void ReadComplete() { read_complete_ = true; }
+};
+
+void TestArpaFileParserSymbols() {
+  for (int32 num_threads = 1; num_threads <= 3; num_threads++) {
+    ArpaParseOptions options;
+    options.num_threads = num_threads;
+    options.lines_per_chunk = (num_threads == 1 ? 100000 : num_threads - 1);
+    fst::SymbolTable symbols("test");
+    symbols.AddSymbol("<eps>");
+    symbols.AddSymbol("b");
+    TestArpaFileParser parser(options, &symbols);
+    std::istringstream is(kTestArpa);
+    parser.Read(is);
+
+    KALDI_ASSERT(parser.read_complete_ && parser.NgramOrder() == 3);
+    KALDI_ASSERT(parser.NgramCounts()[1] == 5 && parser.NgramCounts()[2] == 5);
+    // "b d" is skipped as "d" is not among the unigrams.
+    KALDI_ASSERT(parser.ngrams_.size() == 11);
+    KALDI_ASSERT(symbols.NumSymbols() == 6 && symbols.Find("b") == 1 &&
+                 symbols.Find("<s>") == 2 && symbols.Find("c") == 5 &&
+                 symbols.Find("d") == fst::SymbolTable::kNoSymbol);
+
+    const NGram &unigram = parser.ngrams_[3];
+    KALDI_ASSERT(unigram.words.size() == 1 && unigram.words[0] == 1 &&
+                 unigram.logprob == -0.9f && unigram.backoff == -0.3f);
+    const NGram &bigram = parser.ngrams_[8];
+    KALDI_ASSERT(bigram.words.size() == 2 && bigram.words[0] == 4 &&
+                 bigram.words[1] == 5 && bigram.logprob == -0.7f &&
+                 bigram.backoff == 0.0f);
+    const NGram &trigram = parser.ngrams_[10];
+    KALDI_ASSERT(trigram.words.size() == 3 && trigram.words[0] == 4 &&
+                 trigram.words[1] == 1 && trigram.words[2] == 3 &&
+                 trigram.logprob == -0.25f);
+  }
+}
+
+void TestArpaFileParserIntegers() {
+  std::vector<NGram> ngrams;
+  for (int32 num_threads = 1; num_threads <= 4; num_threads++) {
+    ArpaParseOptions options;
+    options.num_threads = num_threads;
+    options.lines_per_chunk = num_threads;
+    TestArpaFileParser parser(options, NULL);
+    std::istringstream is(kTestIntegerArpa);
+    parser.Read(is);
+    KALDI_ASSERT(parser.ngrams_.size() == 12);
+    if (num_threads == 1) {
+      ngrams = parser.ngrams_;
+      KALDI_ASSERT(ngrams[9].words[0] == 4 && ngrams[9].words[1] == 6);
+    } else {
+      for (size_t i = 0; i < ngrams.size(); i++)
+        KALDI_ASSERT(parser.ngrams_[i].words == ngrams[i].words &&
+                     parser.ngrams_[i].logprob == ngrams[i].logprob &&
+                     parser.ngrams_[i].backoff == ngrams[i].backoff);
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  TestArpaFileParserSymbols();
+  TestArpaFileParserIntegers();
+  std::cout << "Tests succeeded\n";
+}
@@ -0,0 +1,288 @@
+// lm/arpa-file-parser.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include "lm/arpa-file-parser.h"
+#include "thread/kaldi-task-sequence.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+/**
+   ArpaParseTask parses a chunk of lines from one "\N-grams:" section of an
+   ARPA file in operator (), which TaskSequencer runs in parallel with other
+   chunks; its destructor, which TaskSequencer calls for one chunk at a time
+   and in order, gives the n-grams to the ArpaFileParser.
+ */
+class ArpaParseTask {
+ public:
+  // Takes the contents of <lines>.
+  ArpaParseTask(ArpaFileParser *parser, int32 order,
+                std::vector<std::string> *lines):
+      parser_(parser), order_(order), num_skipped_(0) {
+    lines_.swap(*lines);
+  }
+
+  void operator () ();
+
+  ~ArpaParseTask();
+
+ private:
+  ArpaFileParser *parser_;
+  int32 order_;
+  std::vector<std::string> lines_;
+
+  // The words of the parsed n-grams, <order_> per n-gram. For unigrams when
+  // there is a symbol table, the words are in <unigram_words_> instead, as we
+  // can only add them to the table in the destructor.
+  std::vector<int32> words_;
+  std::vector<std::string> unigram_words_;
+  std::vector<float> logprobs_;
+  std::vector<float> backoffs_;
+  // Number of n-grams skipped because of unknown words, and the first of them.
+  // We don't warn from the threads, but leave it to ArpaFileParser::Read() to
+  // warn once for each order.
+  int32 num_skipped_;
+  std::string first_skipped_;
+};
+
+void ArpaParseTask::operator () () {
+  const fst::SymbolTable *symbols = parser_->symbols_;
+  bool defer_words = (symbols != NULL && order_ == 1);
+  std::string word;
+  for (size_t i = 0; i < lines_.size(); i++) {
+    const std::string &line = lines_[i];
+    const char *cur = line.c_str();
+    while (isspace(*cur))
+      cur++;
+    if (*cur == '\0')  // Ignores empty lines.
+      continue;
+
+    char *end;
+    float logprob = KALDI_STRTOF(cur, &end);
+    if (end == cur || !KALDI_ISFINITE(logprob))
+      KALDI_ERR << "Bad log-probability in ARPA file [parsing " << order_
+                << "-grams]: " << line;
+    cur = end;
+
+    size_t num_words = words_.size();
+    bool unknown_word = false;
+    for (int32 j = 0; j < order_; j++) {
+      while (isspace(*cur))
+        cur++;
+      const char *word_end = cur;
+      while (*word_end != '\0' && !isspace(*word_end))
+        word_end++;
+      if (word_end == cur)
+        KALDI_ERR << "Too few words in ARPA file [parsing " << order_
+                  << "-grams]: " << line;
+      word.assign(cur, word_end - cur);
+      cur = word_end;
+
+      int32 id = -1;
+      if (symbols == NULL) {
+        if (!ConvertStringToInteger(word, &id) || id < 0)
+          KALDI_ERR << "Word " << word << " is not a non-negative integer "
+                    << "[parsing " << order_ << "-grams]: " << line;
+      } else if (defer_words) {
+        unigram_words_.push_back(word);
+      } else {
+        int64 symbol = symbols->Find(word);
+        if (symbol == fst::SymbolTable::kNoSymbol)
+          unknown_word = true;
+        id = symbol;
+      }
+      words_.push_back(id);
+    }
+
+    float backoff = 0.0;
+    while (isspace(*cur))
+      cur++;
+    if (*cur != '\0') {
+      backoff = KALDI_STRTOF(cur, &end);
+      if (end == cur || !KALDI_ISFINITE(backoff))
+        KALDI_ERR << "Bad backoff log-probability in ARPA file [parsing "
+                  << order_ << "-grams]: " << line;
+      cur = end;
+      while (isspace(*cur))
+        cur++;
+      if (*cur != '\0')
+        KALDI_ERR << "Junk " << cur << " at end of line [parsing " << order_
+                  << "-grams]: " << line;
+    }
+
+    if (unknown_word) {
+      // The words of higher-order n-grams should all be among the unigrams.
+      if (num_skipped_ == 0)
+        first_skipped_ = line;
+      words_.resize(num_words);
+      num_skipped_++;
+      continue;
+    }
+    logprobs_.push_back(logprob);
+    backoffs_.push_back(backoff);
+  }
+  // We don't need the text any more.
+  std::vector<std::string>().swap(lines_);
+}
+
+ArpaParseTask::~ArpaParseTask() {
+  NGram ngram;
+  ngram.words.resize(order_);
+  size_t num_ngrams = logprobs_.size();
+  for (size_t i = 0; i < num_ngrams; i++) {
+    if (!unigram_words_.empty()) {
+      ngram.words[0] = parser_->symbols_->AddSymbol(unigram_words_[i]);
+    } else {
+      std::copy(words_.begin() + i * order_, words_.begin() + (i + 1) * order_,
+                ngram.words.begin());
+    }
+    ngram.logprob = logprobs_[i];
+    ngram.backoff = backoffs_[i];
+    parser_->ConsumeNGram(ngram);
+  }
+  parser_->num_ngrams_read_[order_] += num_ngrams + num_skipped_;
+  if (num_skipped_ > 0) {
+    if (parser_->num_ngrams_skipped_[order_] == 0)
+      parser_->first_skipped_ngram_[order_] = first_skipped_;
+    parser_->num_ngrams_skipped_[order_] += num_skipped_;
+  }
+}
+
+ArpaFileParser::ArpaFileParser(const ArpaParseOptions &options,
+                               fst::SymbolTable *symbols):
+    options_(options), symbols_(symbols) {
+  KALDI_ASSERT(options_.num_threads > 0 && options_.lines_per_chunk > 0);
+}
+
+void ArpaFileParser::ReadHeader(std::istream &is, std::string *line) {
+  ngram_counts_.clear();
+  bool keyword_found = false;
+  while (std::getline(is, *line)) {
+    Trim(line);
+    if (*line == "\\data\\") {
+      keyword_found = true;
+      break;
+    }
+  }
+  if (!keyword_found)
+    KALDI_ERR << "\\data\\ token not found in ARPA file.";
+
+  // Looks for lines like "ngram 1=1000", which means there are 1000 unigrams,
+  // until the first section keyword (which starts with backslash).
+  while (std::getline(is, *line)) {
+    Trim(line);
+    if (!line->empty() && (*line)[0] == '\\')
+      break;
+    if (line->empty())
+      continue;
+    std::size_t equal_symbol_pos = line->find("=");
+    if (equal_symbol_pos != std::string::npos)
+      line->replace(equal_symbol_pos, 1, " = ");  // Inserts spaces around "="
+    std::vector<std::string> col;
+    SplitStringToVector(*line, " \t", true, &col);
+    int32 order;
+    int64 count;
+    if (col.size() == 4 && col[0] == "ngram" && col[2] == "=" &&
+        ConvertStringToInteger(col[1], &order) && order > 0 &&
+        ConvertStringToInteger(col[3], &count) && count >= 0) {
+      if (ngram_counts_.size() <= order)
+        ngram_counts_.resize(order + 1, 0);
+      ngram_counts_[order] = count;
+    } else {
+      KALDI_WARN << "Uninterpretable line in \"\\data\\\" section: " << *line;
+    }
+  }
+  if (ngram_counts_.empty())
+    KALDI_ERR << "No n-gram counts found in \"\\data\\\" section.";
+}
+
+void ArpaFileParser::Read(std::istream &is) {
+  std::string line;
+  ReadHeader(is, &line);
+  HeaderAvailable();
+  num_ngrams_read_.assign(ngram_counts_.size(), 0);
+  num_ngrams_skipped_.assign(ngram_counts_.size(), 0);
+  first_skipped_ngram_.assign(ngram_counts_.size(), std::string());
+
+  int32 order = 0;
+  bool end_found = false, more = !is.fail();
+  while (more) {
+    if (line == "\\end\\") {
+      end_found = true;
+      break;
+    }
+    // Looks for the next "\N-grams:" keyword.
+    int32 next_order;
+    std::size_t pos = line.find("-grams:");
+    if (pos == std::string::npos || line[0] != '\\' ||
+        !ConvertStringToInteger(line.substr(1, pos - 1), &next_order) ||
+        line.size() != pos + 7)
+      KALDI_ERR << "Unexpected line in ARPA file: " << line;
+    if (next_order <= order || next_order > NgramOrder())
+      KALDI_ERR << "Unexpected section " << line << " in ARPA file of order "
+                << NgramOrder();
+    order = next_order;
+    KALDI_LOG << "Reading \"" << line << "\" section.";
+
+    // The tasks parse the chunks of lines in parallel; the destructor of
+    // <sequencer> waits for them all to be consumed, so the n-grams of each
+    // order are all consumed before the next order starts (and for unigrams,
+    // the symbol table is complete before the threads look up words in it).
+    TaskSequencerConfig sequencer_config;
+    sequencer_config.num_threads = options_.num_threads;
+    TaskSequencer<ArpaParseTask> sequencer(sequencer_config);
+    std::vector<std::string> lines;
+    more = false;
+    while (std::getline(is, line)) {
+      if (!line.empty() && line[0] == '\\') {
+        Trim(&line);
+        more = true;
+        break;
+      }
+      lines.push_back(std::string());
+      lines.back().swap(line);
+      if (lines.size() == static_cast<size_t>(options_.lines_per_chunk)) {
+        sequencer.Run(new ArpaParseTask(this, order, &lines));
+        lines.clear();
+      }
+    }
+    if (!lines.empty())
+      sequencer.Run(new ArpaParseTask(this, order, &lines));
+  }
+  if (!end_found)
+    KALDI_WARN << "ARPA file ended without \"\\end\\\".";
+
+  for (int32 i = 1; i < ngram_counts_.size(); i++) {
+    if (num_ngrams_skipped_[i] > 0)
+      KALDI_WARN << "Skipped " << num_ngrams_skipped_[i] << " n-grams of order "
+                 << i << " with words that are not among the unigrams, e.g.: "
+                 << first_skipped_ngram_[i];
+    if (num_ngrams_read_[i] != ngram_counts_[i])
+      KALDI_WARN << "Header said there would be " << ngram_counts_[i]
+                 << " n-grams of order " << i << ", but we saw "
+                 << num_ngrams_read_[i];
+  }
+  ReadComplete();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,122 @@
+// lm/arpa-file-parser.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_ARPA_FILE_PARSER_H_
+#define KALDI_LM_ARPA_FILE_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include <fst/fstlib.h>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+struct ArpaParseOptions {
+  int32 num_threads;
+  int32 lines_per_chunk;
+
+  ArpaParseOptions(): num_threads(1), lines_per_chunk(100000) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("num-threads", &num_threads, "Number of threads used to "
+                 "parse the ARPA file (the n-grams are still added to the "
+                 "model in order, by one thread at a time).");
+    po->Register("lines-per-chunk", &lines_per_chunk, "Number of lines of the "
+                 "ARPA file that each thread parses at a time.");
+  }
+};
+
+/// An n-gram from an ARPA file.
+struct NGram {
+  /// The words, in the order they appear in the file.
+  std::vector<int32> words;
+  /// The log-probability (base 10, as in the file).
+  float logprob;
+  /// The backoff log-probability (base 10), or zero if there is none.
+  float backoff;
+};
+
+/**
+   ArpaFileParser reads an ARPA format language model and gives each n-gram to
+   ConsumeNGram(), which derived classes implement, with the words already
+   converted to integers; it never holds more than a few chunks of the file in
+   memory.  The lines of each "\N-grams:" section are read in chunks, which
+   are parsed by up to ArpaParseOptions::num_threads threads at once; the
+   n-grams are then passed to ConsumeNGram() in the order of the file, by one
+   thread at a time (so ConsumeNGram() needs no locking, but it may be called
+   from different threads).  All n-grams of one order are consumed before
+   any of the next order is.
+ */
+class ArpaFileParser {
+ public:
+  /// If <symbols> is NULL, the words in the file must be integers. Otherwise
+  /// words are mapped through <symbols>: words in the unigram section are
+  /// added to it if necessary, and n-grams of higher orders with words that
+  /// are not in it are skipped with a warning. We don't take ownership of
+  /// <symbols>.
+  ArpaFileParser(const ArpaParseOptions &options, fst::SymbolTable *symbols);
+
+  virtual ~ArpaFileParser() { }
+
+  /// Reads the ARPA file; dies on error.
+  void Read(std::istream &is);
+
+  /// Returns the n-gram counts from the "\data\" section, indexed by order;
+  /// element 0 is unused.
+  const std::vector<int64> &NgramCounts() const { return ngram_counts_; }
+
+  /// Returns the n-gram order, as given by the "\data\" section.
+  int32 NgramOrder() const { return ngram_counts_.size() - 1; }
+
+ protected:
+  /// Called after the "\data\" section is read.
+  virtual void HeaderAvailable() { }
+
+  /// Called for each n-gram, as described above.
+  virtual void ConsumeNGram(const NGram &ngram) = 0;
+
+  /// Called after the whole file is read.
+  virtual void ReadComplete() { }
+
+ private:
+  friend class ArpaParseTask;
+
+  // Reads the "\data\" section, and returns the line after it (which should
+  // start the first "\N-grams:" section) in <line>.
+  void ReadHeader(std::istream &is, std::string *line);
+
+  ArpaParseOptions options_;
+  fst::SymbolTable *symbols_;
+  std::vector<int64> ngram_counts_;
+  // Number of n-grams of each order actually read.
+  std::vector<int64> num_ngrams_read_;
+  // Number of n-grams of each order skipped because they had words that are
+  // not among the unigrams, and the first of them, for the warning.
+  std::vector<int64> num_ngrams_skipped_;
+  std::vector<std::string> first_skipped_ngram_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ArpaFileParser);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LM_ARPA_FILE_PARSER_H_
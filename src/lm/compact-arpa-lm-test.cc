@@ -0,0 +1,138 @@
+// lm/compact-arpa-lm-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <sstream>
+
+#include "lm/compact-arpa-lm.h"
+
+namespace kaldi {
+
+// A small 4-gram LM over integer words: 1 is <s>, 2 is </s>, 3 is <unk>.
+static const char *kTestArpa =
+    "\n"
+    "\\data\\\n"
+    "ngram 1=7\n"
+    "ngram 2=6\n"
+    "ngram 3=3\n"
+    "ngram 4=1\n"
+    "\n"
+    "\\1-grams:\n"
+    "-99\t1\t-0.3\n"
+    "-1.0\t2\n"
+    "-1.5\t3\t-0.2\n"
+    "-0.8\t4\t-0.4\n"
+    "-0.9\t5\t-0.3\n"
+    "-1.2\t6\n"
+    "-1.3\t9\t-0.15\n"
+    "\n"
+    "\\2-grams:\n"
+    "-0.5\t1 4\t-0.1\n"
+    "-0.6\t4 5\t-0.2\n"
+    "-0.4\t5 2\n"
+    "-0.7\t4 6\n"
+    "-0.3\t5 4\t-0.05\n"
+    "-0.35\t9 5\n"
+    "\n"
+    "\\3-grams:\n"
+    "-0.2\t1 4 5\t-0.12\n"
+    "-0.25\t4 5 2\n"
+    "-0.15\t5 4 5\n"
+    "\n"
+    "\\4-grams:\n"
+    "-0.1\t1 4 5 2\n"
+    "\n"
+    "\\end\\\n";
+
+// Tests that CompactArpaLm gives the same answers as ConstArpaLm; the test LM
+// has few enough distinct values that quantization loses nothing.
+void TestCompactArpaLm(const ConstArpaLm &lm, const CompactArpaLm &compact_lm) {
+  KALDI_ASSERT(compact_lm.NgramOrder() == lm.NgramOrder() &&
+               compact_lm.BosSymbol() == lm.BosSymbol() &&
+               compact_lm.EosSymbol() == lm.EosSymbol() &&
+               compact_lm.UnkSymbol() == lm.UnkSymbol());
+  for (int32 n = 0; n < 500; n++) {
+    std::vector<int32> hist;
+    int32 length = Rand() % (lm.NgramOrder() + 1);
+    for (int32 j = 0; j < length; j++)
+      hist.push_back(1 + Rand() % 10);
+    int32 word = 1 + Rand() % 10;
+    KALDI_ASSERT(compact_lm.GetNgramLogprob(word, hist) ==
+                 lm.GetNgramLogprob(word, hist));
+    KALDI_ASSERT(compact_lm.HistoryStateExists(hist) ==
+                 lm.HistoryStateExists(hist));
+  }
+
+  // The FST wrappers should agree too, including on the history states, which
+  // are created in the same order. We use a small shared cache for the compact
+  // LM, so that there are collisions.
+  ConstArpaLmCache compact_cache(compact_lm, 7, true);
+  {
+    CompactArpaLmDeterministicFst compact_fst(&compact_cache);
+    ConstArpaLmDeterministicFst fst(lm);
+    for (int32 n = 0; n < 20; n++) {
+      fst::StdArc::StateId s = fst.Start(), compact_s = compact_fst.Start();
+      for (int32 j = 0; j < 10; j++) {
+        KALDI_ASSERT(s == compact_s);
+        KALDI_ASSERT(fst.Final(s) == compact_fst.Final(compact_s));
+        fst::StdArc arc, compact_arc;
+        int32 word = 4 + Rand() % 6;
+        KALDI_ASSERT(fst.GetArc(s, word, &arc) &&
+                     compact_fst.GetArc(compact_s, word, &compact_arc));
+        KALDI_ASSERT(arc.weight == compact_arc.weight);
+        s = arc.nextstate;
+        compact_s = compact_arc.nextstate;
+      }
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  {
+    std::ofstream os("compact-arpa-lm-test.arpa");
+    os << kTestArpa;
+  }
+  BuildConstArpaLm(false, 1, 2, 3, "compact-arpa-lm-test.arpa",
+                   "compact-arpa-lm-test.carpa");
+  ConstArpaLm lm;
+  ReadKaldiObject("compact-arpa-lm-test.carpa", &lm);
+
+  for (int32 i = 0; i < 3; i++) {
+    CompactArpaLmOptions opts;
+    opts.logprob_bits = (i == 0 ? 16 : 8);
+    opts.backoff_bits = (i == 0 ? 16 : 4);
+    opts.word_bits = (i == 2 ? 20 : 0);
+    opts.buckets_per_ngram = (i == 2 ? 3.0 : 1.25);
+    CompactArpaLm compact_lm;
+    compact_lm.Init(lm, opts);
+    TestCompactArpaLm(lm, compact_lm);
+
+    std::ostringstream os;
+    compact_lm.Write(os, true);
+    std::istringstream is(os.str());
+    CompactArpaLm compact_lm2;
+    compact_lm2.Read(is, true);
+    KALDI_ASSERT(compact_lm2.MemorySize() == compact_lm.MemorySize());
+    TestCompactArpaLm(lm, compact_lm2);
+  }
+  std::cout << "Tests succeeded\n";
+}
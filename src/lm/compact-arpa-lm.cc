@@ -0,0 +1,521 @@
+// lm/compact-arpa-lm.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "lm/compact-arpa-lm.h"
+
+namespace kaldi {
+
+// Returns the smallest number of bits (at least 1) that can represent
+// <max_value>.
+static int32 NumBits(uint64 max_value) {
+  int32 ans = 1;
+  while (ans < 64 && (max_value >> ans) != 0)
+    ans++;
+  return ans;
+}
+
+// Makes a sorted codebook of at most 2^num_bits values for quantizing
+// <values>, which this function sorts.  If there are few enough distinct
+// values, they are all in the codebook; otherwise we split the sorted values
+// into bins with equal numbers of values, and each bin is represented by its
+// mean.  If <keep_zero> is true, zero is one of the codebook values.
+static void MakeCodebook(int32 num_bits, bool keep_zero,
+                         std::vector<float> *values,
+                         std::vector<float> *codebook) {
+  size_t num_codes = static_cast<size_t>(1) << num_bits;
+  codebook->clear();
+  if (keep_zero) {
+    codebook->push_back(0.0);
+    num_codes--;
+    values->erase(std::remove(values->begin(), values->end(), 0.0f),
+                  values->end());
+  }
+  std::sort(values->begin(), values->end());
+  std::vector<float> distinct(*values);
+  distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                 distinct.end());
+  if (distinct.size() <= num_codes) {
+    codebook->insert(codebook->end(), distinct.begin(), distinct.end());
+  } else {
+    size_t num_values = values->size();
+    for (size_t i = 0; i < num_codes; i++) {
+      size_t begin = num_values * i / num_codes,
+          end = num_values * (i + 1) / num_codes;
+      if (begin == end) continue;
+      double sum = 0.0;
+      for (size_t j = begin; j < end; j++)
+        sum += (*values)[j];
+      codebook->push_back(sum / (end - begin));
+    }
+  }
+  std::sort(codebook->begin(), codebook->end());
+  codebook->erase(std::unique(codebook->begin(), codebook->end()),
+                  codebook->end());
+  if (codebook->empty())
+    codebook->push_back(0.0);
+}
+
+// Returns the index of the value in the sorted <codebook> that is nearest to
+// <value>.
+static uint64 Quantize(const std::vector<float> &codebook, float value) {
+  std::vector<float>::const_iterator iter =
+      std::lower_bound(codebook.begin(), codebook.end(), value);
+  if (iter == codebook.end())
+    return codebook.size() - 1;
+  if (iter == codebook.begin())
+    return 0;
+  uint64 i = iter - codebook.begin();
+  return (value - codebook[i - 1] < codebook[i] - value ? i - 1 : i);
+}
+
+static void WriteCodebook(std::ostream &os, bool binary,
+                          const std::vector<float> &codebook) {
+  int32 size = codebook.size();
+  WriteBasicType(os, binary, size);
+  for (int32 i = 0; i < size; i++)
+    WriteBasicType(os, binary, codebook[i]);
+}
+
+static void ReadCodebook(std::istream &is, bool binary,
+                         std::vector<float> *codebook) {
+  int32 size;
+  ReadBasicType(is, binary, &size);
+  KALDI_ASSERT(size >= 0);
+  codebook->resize(size);
+  for (int32 i = 0; i < size; i++)
+    ReadBasicType(is, binary, &((*codebook)[i]));
+}
+
+void CompactArpaLm::SetBits(uint64 offset, int32 num_bits, uint64 value,
+                            std::vector<uint64> *data) {
+  KALDI_ASSERT(num_bits > 0 && num_bits <= 64);
+  uint64 mask = (num_bits == 64 ? ~static_cast<uint64>(0) :
+                 (static_cast<uint64>(1) << num_bits) - 1);
+  KALDI_ASSERT((value & ~mask) == 0);
+  uint64 i = offset >> 6;
+  int32 shift = static_cast<int32>(offset & 63);
+  (*data)[i] = ((*data)[i] & ~(mask << shift)) | (value << shift);
+  if (shift + num_bits > 64) {
+    uint64 high_mask = (static_cast<uint64>(1) << (shift + num_bits - 64)) - 1;
+    (*data)[i + 1] = ((*data)[i + 1] & ~high_mask) | (value >> (64 - shift));
+  }
+}
+
+int64 CompactArpaLm::HashBucket(const NgramTable &table,
+                                const int64 history_index, const int32 word) {
+  uint64 h = static_cast<uint64>(history_index) * 0x9E3779B97F4A7C15ULL ^
+      static_cast<uint64>(word);
+  // The finalizer of MurmurHash3, so that all bits of the key affect the
+  // bucket.
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return static_cast<int64>(h % static_cast<uint64>(table.num_buckets));
+}
+
+int64 CompactArpaLm::FindInTable(const int32 order, const int64 history_index,
+                                 const int32 word) const {
+  const NgramTable &table = tables_[order];
+  uint64 empty_word = (static_cast<uint64>(1) << word_bits_) - 1;
+  if (word < 0 || static_cast<uint64>(word) >= empty_word)
+    return -1;
+  int64 bucket = HashBucket(table, history_index, word);
+  while (true) {
+    uint64 this_word = GetField(table, bucket, 0, word_bits_);
+    if (this_word == empty_word)
+      return -1;
+    if (this_word == static_cast<uint64>(word) &&
+        GetField(table, bucket, word_bits_, table.history_bits) ==
+        static_cast<uint64>(history_index))
+      return bucket;
+    if (++bucket == table.num_buckets)
+      bucket = 0;
+  }
+}
+
+int64 CompactArpaLm::FindNgram(const int32 *seq, const int32 seq_size) const {
+  KALDI_ASSERT(seq_size > 0 && seq_size <= ngram_order_);
+  int32 word = seq[0];
+  if (word < 0 || word >= static_cast<int32>(unigrams_.size()) ||
+      (unigrams_[word].flags & kExists) == 0)
+    return -1;
+  int64 index = word;
+  for (int32 i = 1; i < seq_size && index != -1; i++)
+    index = FindInTable(i + 1, index, seq[i]);
+  return index;
+}
+
+float CompactArpaLm::NgramLogprob(const int32 order, const int64 index) const {
+  if (order == 1)
+    return unigrams_[index].logprob;
+  const NgramTable &table = tables_[order];
+  return table.logprobs[GetField(table, index,
+                                 word_bits_ + table.history_bits,
+                                 table.logprob_bits)];
+}
+
+float CompactArpaLm::NgramBackoffLogprob(const int32 order,
+                                         const int64 index) const {
+  if (order == 1)
+    return unigrams_[index].backoff_logprob;
+  const NgramTable &table = tables_[order];
+  KALDI_ASSERT(table.has_backoff);
+  return table.backoff_logprobs[
+      GetField(table, index, word_bits_ + table.history_bits +
+               table.logprob_bits, table.backoff_bits)];
+}
+
+bool CompactArpaLm::NgramHasChildren(const int32 order,
+                                     const int64 index) const {
+  if (order == 1)
+    return (unigrams_[index].flags & kHasChildren) != 0;
+  const NgramTable &table = tables_[order];
+  if (!table.has_backoff)
+    return false;
+  return GetField(table, index, table.bucket_bits - 1, 1) != 0;
+}
+
+void CompactArpaLm::Init(const ConstArpaLm &lm,
+                         const CompactArpaLmOptions &opts) {
+  KALDI_ASSERT(!initialized_);
+  if (opts.logprob_bits < 1 || opts.logprob_bits > 16 ||
+      opts.backoff_bits < 1 || opts.backoff_bits > 16)
+    KALDI_ERR << "--logprob-bits and --backoff-bits must be from 1 to 16.";
+  if (opts.buckets_per_ngram <= 1.0)
+    KALDI_ERR << "--buckets-per-ngram must be greater than one.";
+
+  bos_symbol_ = lm.BosSymbol();
+  eos_symbol_ = lm.EosSymbol();
+  unk_symbol_ = lm.UnkSymbol();
+  ngram_order_ = lm.NgramOrder();
+
+  std::vector<ArpaLine> lines;
+  lm.GetArpaLines(&lines);
+  std::vector<std::vector<const ArpaLine*> > ngrams(ngram_order_ + 1);
+  int32 max_word = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    int32 order = lines[i].words.size();
+    KALDI_ASSERT(order > 0 && order <= ngram_order_);
+    ngrams[order].push_back(&(lines[i]));
+    if (order == 1)
+      max_word = std::max(max_word, lines[i].words[0]);
+  }
+
+  // All word-ids must be less than the one that marks empty buckets.
+  word_bits_ = NumBits(max_word + 1);
+  if (opts.word_bits != 0) {
+    if (opts.word_bits < word_bits_ || opts.word_bits > 32)
+      KALDI_ERR << "--word-bits=" << opts.word_bits << " is invalid; the "
+                << "language model needs at least " << word_bits_ << " bits.";
+    word_bits_ = opts.word_bits;
+  }
+
+  Unigram empty_unigram = { 0.0, 0.0, 0 };
+  unigrams_.assign(max_word + 1, empty_unigram);
+  for (size_t i = 0; i < ngrams[1].size(); i++) {
+    const ArpaLine &line = *(ngrams[1][i]);
+    Unigram &unigram = unigrams_[line.words[0]];
+    unigram.logprob = line.logprob;
+    unigram.backoff_logprob = line.backoff_logprob;
+    unigram.flags = kExists;
+  }
+
+  tables_.resize(ngram_order_ + 1);
+  for (int32 order = 2; order <= ngram_order_; order++)
+    InitTable(order, opts, ngrams[order]);
+  initialized_ = true;
+
+  KALDI_LOG << "Created compact language model with " << word_bits_
+            << " bits per word-id, taking " << MemorySize() << " bytes.";
+}
+
+void CompactArpaLm::InitTable(const int32 order,
+                              const CompactArpaLmOptions &opts,
+                              const std::vector<const ArpaLine*> &ngrams) {
+  NgramTable &table = tables_[order];
+  int64 num_ngrams = ngrams.size();
+  table.num_buckets = std::max(
+      num_ngrams + 1, static_cast<int64>(num_ngrams * opts.buckets_per_ngram));
+  table.history_bits = (order == 2 ? word_bits_ :
+                        NumBits(tables_[order - 1].num_buckets - 1));
+  table.has_backoff = (order < ngram_order_);
+  table.logprob_bits = opts.logprob_bits;
+  table.backoff_bits = (table.has_backoff ? opts.backoff_bits : 0);
+  table.bucket_bits = word_bits_ + table.history_bits + table.logprob_bits +
+      table.backoff_bits + (table.has_backoff ? 1 : 0);
+
+  std::vector<float> logprobs(num_ngrams), backoff_logprobs;
+  for (int64 i = 0; i < num_ngrams; i++)
+    logprobs[i] = ngrams[i]->logprob;
+  MakeCodebook(table.logprob_bits, false, &logprobs, &(table.logprobs));
+  if (table.has_backoff) {
+    backoff_logprobs.resize(num_ngrams);
+    for (int64 i = 0; i < num_ngrams; i++)
+      backoff_logprobs[i] = ngrams[i]->backoff_logprob;
+    MakeCodebook(table.backoff_bits, true, &backoff_logprobs,
+                 &(table.backoff_logprobs));
+  }
+
+  uint64 total_bits = static_cast<uint64>(table.num_buckets) *
+      table.bucket_bits;
+  table.data.assign((total_bits + 63) / 64, 0);
+  uint64 empty_word = (static_cast<uint64>(1) << word_bits_) - 1;
+  for (int64 bucket = 0; bucket < table.num_buckets; bucket++)
+    SetBits(static_cast<uint64>(bucket) * table.bucket_bits, word_bits_,
+            empty_word, &(table.data));
+
+  for (int64 i = 0; i < num_ngrams; i++) {
+    const ArpaLine &line = *(ngrams[i]);
+    // The history of an n-gram is always in the language model; see the
+    // comments in ConstArpaLmBuilder::ConsumeNGram().
+    int64 history_index = FindNgram(&(line.words[0]), order - 1);
+    KALDI_ASSERT(history_index != -1);
+    if (order == 2) {
+      unigrams_[history_index].flags |= kHasChildren;
+    } else {
+      NgramTable &history_table = tables_[order - 1];
+      SetBits(static_cast<uint64>(history_index) * history_table.bucket_bits +
+              history_table.bucket_bits - 1, 1, 1, &(history_table.data));
+    }
+
+    int32 word = line.words.back();
+    int64 bucket = HashBucket(table, history_index, word);
+    while (GetField(table, bucket, 0, word_bits_) != empty_word) {
+      if (++bucket == table.num_buckets)
+        bucket = 0;
+    }
+    uint64 offset = static_cast<uint64>(bucket) * table.bucket_bits;
+    SetBits(offset, word_bits_, word, &(table.data));
+    offset += word_bits_;
+    SetBits(offset, table.history_bits, history_index, &(table.data));
+    offset += table.history_bits;
+    SetBits(offset, table.logprob_bits,
+            Quantize(table.logprobs, line.logprob), &(table.data));
+    offset += table.logprob_bits;
+    if (table.has_backoff) {
+      SetBits(offset, table.backoff_bits,
+              Quantize(table.backoff_logprobs, line.backoff_logprob),
+              &(table.data));
+    }
+  }
+}
+
+int64 CompactArpaLm::MemorySize() const {
+  int64 ans = sizeof(Unigram) * static_cast<int64>(unigrams_.size());
+  for (int32 order = 2; order <= ngram_order_; order++) {
+    const NgramTable &table = tables_[order];
+    ans += sizeof(uint64) * static_cast<int64>(table.data.size()) +
+        sizeof(float) * (table.logprobs.size() +
+                         table.backoff_logprobs.size());
+  }
+  return ans;
+}
+
+void CompactArpaLm::Write(std::ostream &os, bool binary) const {
+  KALDI_ASSERT(initialized_);
+  WriteToken(os, binary, "<CompactArpaLm>");
+  WriteToken(os, binary, "<NgramOrder>");
+  WriteBasicType(os, binary, ngram_order_);
+  WriteToken(os, binary, "<BosSymbol>");
+  WriteBasicType(os, binary, bos_symbol_);
+  WriteToken(os, binary, "<EosSymbol>");
+  WriteBasicType(os, binary, eos_symbol_);
+  WriteToken(os, binary, "<UnkSymbol>");
+  WriteBasicType(os, binary, unk_symbol_);
+  WriteToken(os, binary, "<WordBits>");
+  WriteBasicType(os, binary, word_bits_);
+
+  WriteToken(os, binary, "<Unigrams>");
+  int32 num_words = unigrams_.size();
+  WriteBasicType(os, binary, num_words);
+  for (int32 i = 0; i < num_words; i++) {
+    WriteBasicType(os, binary, unigrams_[i].logprob);
+    WriteBasicType(os, binary, unigrams_[i].backoff_logprob);
+    WriteBasicType(os, binary, unigrams_[i].flags);
+  }
+
+  for (int32 order = 2; order <= ngram_order_; order++) {
+    const NgramTable &table = tables_[order];
+    WriteToken(os, binary, "<NgramTable>");
+    WriteBasicType(os, binary, table.num_buckets);
+    WriteBasicType(os, binary, table.history_bits);
+    WriteBasicType(os, binary, table.logprob_bits);
+    WriteBasicType(os, binary, table.backoff_bits);
+    WriteBasicType(os, binary, table.has_backoff);
+    WriteCodebook(os, binary, table.logprobs);
+    WriteCodebook(os, binary, table.backoff_logprobs);
+    WriteIntegerVector(os, binary, table.data);
+  }
+  WriteToken(os, binary, "</CompactArpaLm>");
+}
+
+void CompactArpaLm::Read(std::istream &is, bool binary) {
+  KALDI_ASSERT(!initialized_);
+  ExpectToken(is, binary, "<CompactArpaLm>");
+  ExpectToken(is, binary, "<NgramOrder>");
+  ReadBasicType(is, binary, &ngram_order_);
+  ExpectToken(is, binary, "<BosSymbol>");
+  ReadBasicType(is, binary, &bos_symbol_);
+  ExpectToken(is, binary, "<EosSymbol>");
+  ReadBasicType(is, binary, &eos_symbol_);
+  ExpectToken(is, binary, "<UnkSymbol>");
+  ReadBasicType(is, binary, &unk_symbol_);
+  ExpectToken(is, binary, "<WordBits>");
+  ReadBasicType(is, binary, &word_bits_);
+  KALDI_ASSERT(ngram_order_ > 0 && word_bits_ > 0 && word_bits_ <= 32);
+
+  ExpectToken(is, binary, "<Unigrams>");
+  int32 num_words;
+  ReadBasicType(is, binary, &num_words);
+  KALDI_ASSERT(num_words > 0);
+  unigrams_.resize(num_words);
+  for (int32 i = 0; i < num_words; i++) {
+    ReadBasicType(is, binary, &(unigrams_[i].logprob));
+    ReadBasicType(is, binary, &(unigrams_[i].backoff_logprob));
+    ReadBasicType(is, binary, &(unigrams_[i].flags));
+  }
+
+  tables_.clear();
+  tables_.resize(ngram_order_ + 1);
+  for (int32 order = 2; order <= ngram_order_; order++) {
+    NgramTable &table = tables_[order];
+    ExpectToken(is, binary, "<NgramTable>");
+    ReadBasicType(is, binary, &(table.num_buckets));
+    ReadBasicType(is, binary, &(table.history_bits));
+    ReadBasicType(is, binary, &(table.logprob_bits));
+    ReadBasicType(is, binary, &(table.backoff_bits));
+    ReadBasicType(is, binary, &(table.has_backoff));
+    ReadCodebook(is, binary, &(table.logprobs));
+    ReadCodebook(is, binary, &(table.backoff_logprobs));
+    ReadIntegerVector(is, binary, &(table.data));
+    table.bucket_bits = word_bits_ + table.history_bits + table.logprob_bits +
+        table.backoff_bits + (table.has_backoff ? 1 : 0);
+    uint64 total_bits = static_cast<uint64>(table.num_buckets) *
+        table.bucket_bits;
+    if (table.num_buckets <= 0 || table.logprobs.empty() ||
+        table.has_backoff == table.backoff_logprobs.empty() ||
+        table.data.size() != (total_bits + 63) / 64)
+      KALDI_ERR << "Error reading CompactArpaLm: inconsistent table for order "
+                << order;
+  }
+  ExpectToken(is, binary, "</CompactArpaLm>");
+  initialized_ = true;
+}
+
+bool CompactArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
+  KALDI_ASSERT(initialized_);
+  // As for ConstArpaLm, the empty word sequence is the history state of all
+  // unigrams.
+  if (hist.empty())
+    return true;
+  if (hist.size() >= static_cast<size_t>(ngram_order_))
+    return false;
+  int64 index = FindNgram(&(hist[0]), hist.size());
+  return (index != -1 && NgramHasChildren(hist.size(), index));
+}
+
+int64 CompactArpaLm::HistoryId(const int32 *seq, const int32 seq_size) const {
+  KALDI_ASSERT(initialized_ && seq_size > 0);
+  if (seq_size >= ngram_order_)
+    return -1;
+  int64 index = FindNgram(seq, seq_size);
+  if (index == -1 || !NgramHasChildren(seq_size, index))
+    return -1;
+  return index * ngram_order_ + seq_size - 1;
+}
+
+float CompactArpaLm::GetNgramLogprob(const int32 word,
+                                     const std::vector<int32>& hist) const {
+  return GetNgramLogprob(word, (hist.empty() ? NULL : &(hist[0])),
+                         hist.size());
+}
+
+float CompactArpaLm::GetNgramLogprob(const int32 word, const int32 *hist,
+                                     const int32 hist_size) const {
+  KALDI_ASSERT(initialized_);
+
+  // If the history size plus one is larger than <ngram_order_>, remove the old
+  // words.
+  int32 mapped_hist_size = hist_size;
+  const int32 *mapped_hist = hist;
+  if (mapped_hist_size >= ngram_order_) {
+    mapped_hist += mapped_hist_size - (ngram_order_ - 1);
+    mapped_hist_size = ngram_order_ - 1;
+  }
+
+  // Maps out-of-vocabulary words to <unk>, if <unk> is specified, as
+  // ConstArpaLm does.
+  int32 num_words = unigrams_.size();
+  int32 mapped_word = word;
+  std::vector<int32> hist_copy;
+  if (unk_symbol_ != -1) {
+    KALDI_ASSERT(mapped_word >= 0);
+    if (mapped_word >= num_words ||
+        (unigrams_[mapped_word].flags & kExists) == 0) {
+      mapped_word = unk_symbol_;
+    }
+    for (int32 i = 0; i < mapped_hist_size; ++i) {
+      KALDI_ASSERT(mapped_hist[i] >= 0);
+      if (mapped_hist[i] >= num_words ||
+          (unigrams_[mapped_hist[i]].flags & kExists) == 0) {
+        if (hist_copy.empty())
+          hist_copy.assign(mapped_hist, mapped_hist + mapped_hist_size);
+        hist_copy[i] = unk_symbol_;
+      }
+    }
+    if (!hist_copy.empty())
+      mapped_hist = &(hist_copy[0]);
+  }
+
+  return GetNgramLogprobRecurse(mapped_word, mapped_hist, mapped_hist_size);
+}
+
+float CompactArpaLm::GetNgramLogprobRecurse(
+    const int32 word, const int32 *hist, const int32 hist_size) const {
+  // Unigram case.
+  if (hist_size == 0) {
+    if (word < 0 || word >= static_cast<int32>(unigrams_.size()) ||
+        (unigrams_[word].flags & kExists) == 0) {
+      // This is for the case where <unk> is not defined.
+      return std::numeric_limits<float>::min();
+    } else {
+      return unigrams_[word].logprob;
+    }
+  }
+
+  // High n-gram orders.
+  float backoff_logprob = 0.0;
+  int64 history_index = FindNgram(hist, hist_size);
+  if (history_index != -1) {
+    int64 index = FindInTable(hist_size + 1, history_index, word);
+    if (index != -1)
+      return NgramLogprob(hist_size + 1, index);
+    backoff_logprob = NgramBackoffLogprob(hist_size, history_index);
+  }
+  // Backs off to the history without its first word.
+  return backoff_logprob +
+      GetNgramLogprobRecurse(word, hist + 1, hist_size - 1);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,221 @@
+// lm/compact-arpa-lm.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LM_COMPACT_ARPA_LM_H_
+#define KALDI_LM_COMPACT_ARPA_LM_H_
+
+#include "base/kaldi-common.h"
+#include "fstext/deterministic-fst.h"
+#include "itf/options-itf.h"
+#include "lm/const-arpa-lm.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+struct CompactArpaLmOptions {
+  int32 logprob_bits;
+  int32 backoff_bits;
+  int32 word_bits;
+  BaseFloat buckets_per_ngram;
+
+  CompactArpaLmOptions(): logprob_bits(8), backoff_bits(8), word_bits(0),
+                          buckets_per_ngram(1.25) { }
+
+  void Register(OptionsItf *po) {
+    po->Register("logprob-bits", &logprob_bits, "Number of bits (1 to 16) to "
+                 "which the log-probabilities of n-grams of order two and "
+                 "higher are quantized; 8 or 16 are the usual choices.");
+    po->Register("backoff-bits", &backoff_bits, "Number of bits (1 to 16) to "
+                 "which the backoff log-probabilities of n-grams of order two "
+                 "and higher are quantized.");
+    po->Register("word-bits", &word_bits, "Number of bits for each word-id in "
+                 "the hash tables; if 0, the smallest number that can "
+                 "represent all the word-ids.");
+    po->Register("buckets-per-ngram", &buckets_per_ngram, "Size of each hash "
+                 "table, relative to the number of n-grams in it; larger "
+                 "values mean faster lookup but more memory.");
+  }
+};
+
+/**
+   CompactArpaLm is a smaller alternative to ConstArpaLm, with the same query
+   interface. The unigrams are stored as floats in an array indexed by word.
+   The n-grams of each higher order are stored in a hash table with linear
+   probing, whose entries are bit-packed: each contains the last word of the
+   n-gram, the index in the table of the previous order of the n-gram without
+   its last word (this identifies the n-gram exactly, so unlike schemes with
+   fingerprints there are no false hits), and the log-probability and backoff
+   log-probability, quantized to a few bits with a separate codebook for each
+   order. Backoffs of zero are always represented exactly.
+
+   You create it from a ConstArpaLm with Init(), e.g. with the program
+   const-arpa-to-compact-arpa, which also reports the size and the
+   quantization error. It implements ArpaLmInterface, so ConstArpaLmCache and
+   ConstArpaLmDeterministicFst work with it.
+ */
+class CompactArpaLm: public ArpaLmInterface {
+ public:
+  CompactArpaLm(): bos_symbol_(-1), eos_symbol_(-1), unk_symbol_(-1),
+                   ngram_order_(0), word_bits_(0), initialized_(false) { }
+
+  // Creates the compact language model from <lm>.
+  void Init(const ConstArpaLm &lm, const CompactArpaLmOptions &opts);
+
+  void Read(std::istream &is, bool binary);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  // As ConstArpaLm::GetNgramLogprob(); it first maps possible
+  // out-of-vocabulary words to <unk>, if <unk> is defined.
+  virtual float GetNgramLogprob(const int32 word,
+                                const std::vector<int32>& hist) const;
+
+  float GetNgramLogprob(const int32 word, const int32 *hist,
+                        const int32 hist_size) const;
+
+  // Returns true if the history word sequence <hist> has successor, which means
+  // <hist> will be a state in the FST format language model.
+  bool HistoryStateExists(const std::vector<int32>& hist) const;
+
+  // Combines the order of <seq> and its index in the table of that order.
+  virtual int64 HistoryId(const int32 *seq, const int32 seq_size) const;
+
+  virtual int32 BosSymbol() const { return bos_symbol_; }
+  virtual int32 EosSymbol() const { return eos_symbol_; }
+  int32 UnkSymbol() const { return unk_symbol_; }
+  virtual int32 NgramOrder() const { return ngram_order_; }
+
+  // Returns the number of bytes taken by the tables of the language model.
+  int64 MemorySize() const;
+
+ private:
+  struct Unigram {
+    float logprob;
+    float backoff_logprob;
+    // kExists if the word is in the language model, plus kHasChildren if it
+    // is the history of some bigram.
+    int32 flags;
+  };
+
+  static const int32 kExists = 1;
+  static const int32 kHasChildren = 2;
+
+  // Hash table for the n-grams of one order (two or higher).
+  struct NgramTable {
+    // Number of buckets; at least one more than the number of n-grams.
+    int64 num_buckets;
+    // Number of bits for the index of the history n-gram in the table of the
+    // previous order (for bigrams, the word-id of the history).
+    int32 history_bits;
+    // Total number of bits per bucket.
+    int32 bucket_bits;
+    // False for the highest order, whose buckets have no backoff and no
+    // has-children bit.
+    bool has_backoff;
+    // Codebooks: the quantized values are indexes into these.
+    std::vector<float> logprobs;
+    std::vector<float> backoff_logprobs;
+    // The buckets, each one with the following fields, from the low bits up:
+    // word (word_bits_; all ones for an empty bucket), history index
+    // (history_bits), log-probability (logprob_bits), backoff log-probability
+    // (backoff_bits) and has-children (1 bit); the last two only if
+    // has_backoff is true.
+    std::vector<uint64> data;
+    int32 logprob_bits;
+    int32 backoff_bits;
+  };
+
+  // Returns the table index of the n-gram <seq>, of order <seq_size>, or -1
+  // if it is not in the language model. For unigrams the index is the word.
+  int64 FindNgram(const int32 *seq, const int32 seq_size) const;
+
+  // Returns the bucket of the n-gram of order <order> (at least two) made of
+  // the n-gram at <history_index> in the table of the previous order and
+  // <word>, or -1 if it is not in the language model.
+  int64 FindInTable(const int32 order, const int64 history_index,
+                    const int32 word) const;
+
+  // Returns the first bucket to try for the given n-gram.
+  static int64 HashBucket(const NgramTable &table, const int64 history_index,
+                          const int32 word);
+
+  float NgramLogprob(const int32 order, const int64 index) const;
+  float NgramBackoffLogprob(const int32 order, const int64 index) const;
+  bool NgramHasChildren(const int32 order, const int64 index) const;
+
+  // Reads <num_bits> (at most 64) bits of <data> starting at bit <offset>.
+  static inline uint64 GetBits(const std::vector<uint64> &data, uint64 offset,
+                               int32 num_bits) {
+    uint64 i = offset >> 6;
+    int32 shift = static_cast<int32>(offset & 63);
+    uint64 ans = data[i] >> shift;
+    if (shift + num_bits > 64)
+      ans |= data[i + 1] << (64 - shift);
+    if (num_bits < 64)
+      ans &= (static_cast<uint64>(1) << num_bits) - 1;
+    return ans;
+  }
+
+  static void SetBits(uint64 offset, int32 num_bits, uint64 value,
+                      std::vector<uint64> *data);
+
+  // Returns the field of <table> at bucket <bucket>, <field_offset> bits into
+  // the bucket.
+  static inline uint64 GetField(const NgramTable &table, int64 bucket,
+                                int32 field_offset, int32 num_bits) {
+    return GetBits(table.data, static_cast<uint64>(bucket) * table.bucket_bits
+                   + field_offset, num_bits);
+  }
+
+  // Looks up the log-probability with backoff, as
+  // ConstArpaLm::GetNgramLogprobRecurse().
+  float GetNgramLogprobRecurse(const int32 word, const int32 *hist,
+                               const int32 hist_size) const;
+
+  // Builds the table for the n-grams of order <order>, which must be sorted
+  // as in the Arpa format; the tables of the lower orders must exist.
+  void InitTable(const int32 order, const CompactArpaLmOptions &opts,
+                 const std::vector<const ArpaLine*> &ngrams);
+
+  int32 bos_symbol_;
+  int32 eos_symbol_;
+  int32 unk_symbol_;
+  int32 ngram_order_;
+
+  // Number of bits for a word-id. Word-id (1 << word_bits_) - 1 marks empty
+  // buckets, so all word-ids are less than it.
+  int32 word_bits_;
+
+  // Indexed by word.
+  std::vector<Unigram> unigrams_;
+
+  // Indexed by n-gram order; the first two elements are unused.
+  std::vector<NgramTable> tables_;
+
+  bool initialized_;
+};
+
+// ConstArpaLmDeterministicFst works with any ArpaLmInterface, and so with
+// CompactArpaLm; its history states and arc cache are those of a
+// ConstArpaLmCache, which may be shared between threads.
+typedef ConstArpaLmDeterministicFst CompactArpaLmDeterministicFst;
+
+} // namespace kaldi
+
+#endif  // KALDI_LM_COMPACT_ARPA_LM_H_
@@ -0,0 +1,181 @@
+// lm/const-arpa-lm-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+#include <map>
+
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// A small trigram LM over integer words: 1 is <s>, 2 is </s>, 3 is <unk>.
+// Word 6 has no successors, and the history "4 6" does not exist.
+static const char *kTestArpa =
+    "\n"
+    "\\data\\\n"
+    "ngram 1=6\n"
+    "ngram 2=5\n"
+    "ngram 3=2\n"
+    "\n"
+    "\\1-grams:\n"
+    "-99\t1\t-0.3\n"
+    "-1.0\t2\n"
+    "-1.5\t3\t-0.2\n"
+    "-0.8\t4\t-0.4\n"
+    "-0.9\t5\t-0.3\n"
+    "-1.2\t6\n"
+    "\n"
+    "\\2-grams:\n"
+    "-0.5\t1 4\t-0.1\n"
+    "-0.6\t4 5\t-0.2\n"
+    "-0.4\t5 2\n"
+    "-0.7\t4 6\n"
+    "-0.3\t5 4\n"
+    "\n"
+    "\\3-grams:\n"
+    "-0.2\t1 4 5\n"
+    "-0.25\t4 5 2\n"
+    "\n"
+    "\\end\\\n";
+
+void ReadTestLm(ConstArpaLm *lm) {
+  {
+    std::ofstream os("const-arpa-lm-test.arpa");
+    os << kTestArpa;
+  }
+  BuildConstArpaLm(false, 1, 2, 3, "const-arpa-lm-test.arpa",
+                   "const-arpa-lm-test.carpa");
+  ReadKaldiObject("const-arpa-lm-test.carpa", lm);
+}
+
+// Tests that ConstArpaLmCache gives the same log-probabilities as looking them
+// up with GetNgramLogprob() and the word histories, and that its history
+// states correspond one-to-one with the backed-off word histories.
+void TestConstArpaLmCache(const ConstArpaLm &lm) {
+  for (int32 i = 0; i < 4; i++) {
+    // A tiny cache, so that there are plenty of collisions.
+    int32 num_cached_arcs = (i % 2 == 0 ? 7 : 1000);
+    ConstArpaLmCache cache(lm, num_cached_arcs, (i >= 2));
+    ConstArpaLmCache::Table *table = cache.AcquireTable();
+    std::map<int32, std::vector<int32> > state_to_hist;
+    std::map<std::vector<int32>, int32> hist_to_state;
+    for (int32 n = 0; n < 50; n++) {
+      int32 state = table->Start();
+      std::vector<int32> hist(1, lm.BosSymbol());
+      int32 length = Rand() % 10;
+      for (int32 j = 0; j <= length; j++) {
+        if (state_to_hist.count(state) == 0) {
+          KALDI_ASSERT(hist_to_state.count(hist) == 0);
+          state_to_hist[state] = hist;
+          hist_to_state[hist] = state;
+        }
+        KALDI_ASSERT(state_to_hist[state] == hist);
+        // Words 4 to 7; word 7 is not in the LM so it is mapped to <unk>.
+        int32 word = (j == length ? lm.EosSymbol() : 4 + Rand() % 4);
+        float ref_logprob = lm.GetNgramLogprob(word, hist), logprob;
+        int32 next_state;
+        KALDI_ASSERT(table->GetArc(state, word, &logprob, &next_state));
+        KALDI_ASSERT(logprob == ref_logprob);
+        if (j == length) {
+          KALDI_ASSERT(table->FinalLogprob(state) == ref_logprob);
+          break;
+        }
+        // This is how the history states used to be worked out.
+        hist.push_back(word);
+        while (hist.size() >= lm.NgramOrder())
+          hist.erase(hist.begin());
+        while (!lm.HistoryStateExists(hist))
+          hist.erase(hist.begin());
+        state = next_state;
+      }
+    }
+    // The cache may also have the states after </s>, which we didn't visit.
+    KALDI_ASSERT(table->NumStates() >=
+                 static_cast<int32>(state_to_hist.size()));
+    cache.ReleaseTable(table);
+  }
+}
+
+// Tests that ConstArpaLmCache starts a new table once the current one has more
+// than <max_states> history states, and that the old one still works until it
+// is released.
+void TestConstArpaLmCacheMaxStates(const ConstArpaLm &lm) {
+  ConstArpaLmCache cache(lm, 1000, true, 2);
+  ConstArpaLmCache::Table *table1 = cache.AcquireTable();
+  KALDI_ASSERT(cache.AcquireTable() == table1);
+  cache.ReleaseTable(table1);
+  int32 state = table1->Start(), next_state;
+  float logprob;
+  for (int32 j = 0; j < 10; j++, state = next_state)
+    KALDI_ASSERT(table1->GetArc(state, 4 + j % 3, &logprob, &next_state));
+  KALDI_ASSERT(table1->NumStates() > 2);
+  ConstArpaLmCache::Table *table2 = cache.AcquireTable();
+  KALDI_ASSERT(table2 != table1 && table2->NumStates() == 1);
+  std::vector<int32> hist(1, lm.BosSymbol());
+  KALDI_ASSERT(table1->FinalLogprob(table1->Start()) ==
+               lm.GetNgramLogprob(lm.EosSymbol(), hist));
+  cache.ReleaseTable(table1);  // deletes it.
+  KALDI_ASSERT(table2->FinalLogprob(table2->Start()) ==
+               lm.GetNgramLogprob(lm.EosSymbol(), hist));
+  cache.ReleaseTable(table2);
+}
+
+// Tests that ReadMapped() of the format written by Write() (which it reads the
+// normal way), ReadMapped() of the format written by WriteMappable() (which it
+// memory-maps) and Read() of the latter give the same log-probabilities as
+// <lm>.
+void TestConstArpaLmReadMapped(const ConstArpaLm &lm) {
+  ConstArpaLm read_lm;
+  read_lm.ReadMapped("const-arpa-lm-test.carpa");
+  {
+    Output ko("const-arpa-lm-test-mappable.carpa", true);
+    read_lm.WriteMappable(ko.Stream(), true);
+  }
+  ConstArpaLm mapped_lm, copied_lm;
+  mapped_lm.ReadMapped("const-arpa-lm-test-mappable.carpa");
+  ReadKaldiObject("const-arpa-lm-test-mappable.carpa", &copied_lm);
+  KALDI_ASSERT(read_lm.NgramOrder() == lm.NgramOrder() &&
+               mapped_lm.NgramOrder() == lm.NgramOrder() &&
+               copied_lm.NgramOrder() == lm.NgramOrder());
+  for (int32 n = 0; n < 100; n++) {
+    std::vector<int32> hist;
+    int32 length = Rand() % lm.NgramOrder();
+    for (int32 j = 0; j < length; j++)
+      hist.push_back(1 + Rand() % 7);
+    int32 word = 1 + Rand() % 7;
+    float logprob = lm.GetNgramLogprob(word, hist);
+    KALDI_ASSERT(read_lm.GetNgramLogprob(word, hist) == logprob &&
+                 mapped_lm.GetNgramLogprob(word, hist) == logprob &&
+                 copied_lm.GetNgramLogprob(word, hist) == logprob);
+    KALDI_ASSERT(mapped_lm.HistoryStateExists(hist) ==
+                 lm.HistoryStateExists(hist));
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  ConstArpaLm lm;
+  ReadTestLm(&lm);
+  TestConstArpaLmCache(lm);
+  TestConstArpaLmCacheMaxStates(lm);
+  TestConstArpaLmReadMapped(lm);
+  std::cout << "Tests succeeded\n";
+}
@@ -17,6 +17,16 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <sstream>
 
 #include "lm/const-arpa-lm.h"
@@ -25,24 +35,6 @@
 
 namespace kaldi {
 
-// Auxiliary struct for converting ConstArpaLm format langugae model to Arpa
-// format.
-struct ArpaLine {
-  std::vector<int32> words; // Sequence of words to be printed.
-  float logprob;            // Logprob corresponds to word sequence.
-  float backoff_logprob;    // Backoff_logprob corresponds to word sequence.
-  // Comparison function for sorting.
-  bool operator < (const ArpaLine &other) const {
-    if (words.size() < other.words.size()) {
-      return true;
-    } else if (words.size() > other.words.size()) {
-      return false;
-    } else {
-      return words < other.words;
-    }
-  }
-};
-
 // Auxiliary class to build ConstArpaLm. We first use this class to figure out
 // the relative address of different LmStates, and then put everything into one
 // block in memory.
@@ -167,20 +159,25 @@ class LmState {
 };
 
 // Class to build ConstArpaLm from Arpa format language model. It relies on the
-// auxiliary class LmState above.
-class ConstArpaLmBuilder {
+// auxiliary class LmState above. ArpaFileParser gives us the n-grams, with the
+// words as integers, as it reads the Arpa file.
+class ConstArpaLmBuilder : public ArpaFileParser {
  public:
   ConstArpaLmBuilder(
-      const bool natural_base, const int32 bos_symbol,
-      const int32 eos_symbol, const int32 unk_symbol) :
-      natural_base_(natural_base), bos_symbol_(bos_symbol),
-      eos_symbol_(eos_symbol), unk_symbol_(unk_symbol) {
+      const ArpaParseOptions &options, const bool natural_base,
+      const int32 bos_symbol, const int32 eos_symbol,
+      const int32 unk_symbol) :
+      ArpaFileParser(options, NULL), natural_base_(natural_base),
+      bos_symbol_(bos_symbol), eos_symbol_(eos_symbol),
+      unk_symbol_(unk_symbol) {
     ngram_order_ = 0;
     num_words_ = 0;
+    max_word_id_ = 0;
     overflow_buffer_size_ = 0;
     lm_states_size_ = 0;
     max_address_offset_ = pow(2, 30) - 1;
     is_built_ = false;
+    write_mappable_ = false;
     lm_states_ = NULL;
     unigram_states_ = NULL;
     overflow_buffer_ = NULL; 
@@ -202,9 +199,14 @@ class ConstArpaLmBuilder {
   // Reads in the Arpa format language model, parses it and creates LmStates.
   void Read(std::istream &is, bool binary);
 
-  // Writes ConstArpaLm.
+  // Writes ConstArpaLm, in the format of ConstArpaLm::WriteMappable() if
+  // SetWriteMappable(true) was called, else of ConstArpaLm::Write().
   void Write(std::ostream &os, bool binary) const;
 
+  void SetWriteMappable(const bool write_mappable) {
+    write_mappable_ = write_mappable;
+  }
+
   // Builds ConstArpaLm.
   void Build();
 
@@ -214,6 +216,14 @@ class ConstArpaLmBuilder {
     max_address_offset_ = max_address_offset;
   }
 
+ protected:
+  virtual void HeaderAvailable();
+
+  // Puts the n-gram into the corresponding LmState in <seq_to_state_>.
+  virtual void ConsumeNGram(const NGram &ngram);
+
+  virtual void ReadComplete();
+
  private:
   struct WordsAndLmStatePairLessThan {
     bool operator()(
@@ -231,6 +241,10 @@ class ConstArpaLmBuilder {
   // Indicating if ConstArpaLm has been built or not.
   bool is_built_;
 
+  // If true, Write() writes the format that ConstArpaLm::ReadMapped() can
+  // memory-map.
+  bool write_mappable_;
+
   // Maximum relative address for the child. We put it here just for testing.
   // The default value is 30-bits and should not be changed except for testing.
   int32 max_address_offset_;
@@ -253,6 +267,9 @@ class ConstArpaLmBuilder {
   // array.
   int32 num_words_;
 
+  // Largest word-id seen so far in the unigrams.
+  int32 max_word_id_;
+
   // Number of entries in the overflow buffer for pointers that couldn't be
   // represented as a 30-bit relative index.
   int32 overflow_buffer_size_;
@@ -275,201 +292,92 @@ class ConstArpaLmBuilder {
                 LmState*, VectorHasher<int32> > seq_to_state_;
 };
 
-// Reads in the Arpa format language model, parses it and puts the word sequence
-// into the corresponding LmState in <seq_to_state_>.
 void ConstArpaLmBuilder::Read(std::istream &is, bool binary) {
   if (binary) {
     KALDI_ERR << "binary-mode reading is not implemented for "
         << "ConstArpaLmBuilder.";
   }
+  ArpaFileParser::Read(is);
+}
 
-  std::string line;
-
-  // Number of n-grams from "\data\" section. Those numbers should match the
-  // actual number of n-grams from "\N-grams:" sections.
-  // Note that when we convert the words in the Arpa format language model into
-  // integers, we remove lines with OOV words. We also modify the n-gram counts
-  // in "\data\" correspondingly.
-  std::vector<int32> num_ngrams;
-
-  // Processes "\data\" section.
-  bool keyword_found = false;
-  while (getline(is, line) && !is.eof()) {
-    // The section keywords starts with backslash. We terminate the while loop
-    // if a new section is found.
-    if (!line.empty() && line[0] == '\\') {
-      if (line.find("-grams:") != std::string::npos) break;
-      if (line.find("\\end\\") != std::string::npos) break;
-    }
-
-    std::size_t equal_symbol_pos = line.find("=");
-    if (equal_symbol_pos != std::string::npos)
-      line.replace(equal_symbol_pos, 1, " = "); // Inserts spaces around "="
-    std::vector<std::string> col;
-    SplitStringToVector(line, " \t", true, &col);
-
-    // Looks for keyword "\data\".
-    if (!keyword_found && col.size() == 1 && col[0] == "\\data\\") {
-      KALDI_LOG << "Reading \"\\data\\\" section.";
-      keyword_found = true;
-      continue;
-    }
+void ConstArpaLmBuilder::HeaderAvailable() {
+  ngram_order_ = NgramOrder();
+}
 
-    // Enters "\data\" section, and looks for patterns like"ngram 1=1000", which
-    // means there are 1000 unigrams.
-    if (keyword_found && col.size() == 4 && col[0] == "ngram") {
-      if (col[2] == "=") {
-        int32 order, ngram_count;
-        if (!ConvertStringToInteger(col[1], &order)) {
-          KALDI_ERR << "bad line: " << line << "; fail to convert "
-              << col[1] << " to integer.";
-        }
-        if (!ConvertStringToInteger(col[3], &ngram_count)) {
-          KALDI_ERR << "bad line: " << line << "; fail to convert "
-              << col[3] << " to integer.";
-        }
-        if (num_ngrams.size() <= order) {
-          num_ngrams.resize(order + 1);
-        }
-        num_ngrams[order] = ngram_count;
-      } else {
-        KALDI_WARN << "Uninterpretable line \"\\data\\\" section: " << line;
-      }
-    } else if (keyword_found) {
-      KALDI_WARN << "Uninterpretable line \"\\data\\\" section: " << line;
-    }
+// Puts the word sequence into the corresponding LmState in <seq_to_state_>.
+// Note that when we convert the words in the Arpa format language model into
+// integers, we remove lines with OOV words, so the n-gram counts in "\data\"
+// may be larger than the actual numbers.
+void ConstArpaLmBuilder::ConsumeNGram(const NGram &ngram) {
+  int32 cur_order = ngram.words.size();
+  if (cur_order == ngram_order_ && ngram.backoff != 0.0 && ngram_order_ > 1) {
+    KALDI_ERR << "Backoff probability detected for final-order entry.";
   }
-  if (num_ngrams.size() == 0)
-    KALDI_ERR << "Fail to read \"\\data\\\" section.";
-  ngram_order_ = num_ngrams.size() - 1;
-
-  // Processes "\N-grams:" section.
-  int32 max_word_id = 0;
-  for (int32 cur_order = 1; cur_order < num_ngrams.size(); ++cur_order) {
-    // Skips n-grams with zero count.
-    if (num_ngrams[cur_order] == 0) continue;
-
-    keyword_found = false;
-    int32 ngram_count = 0;
-    std::ostringstream keyword;
-    keyword << "\\" << cur_order << "-grams:";
-    // We use "do ... while" loop since one line has already been read.
-    do {
-      // The section keywords starts with backslash. We terminate the while loop
-      // if a new section is found.
-      if (!line.empty() && line[0] == '\\') {
-        if (line.find("-grams:") != std::string::npos && keyword_found) break;
-        if (line.find("\\end\\") != std::string::npos) break;
-      }
-
-      std::vector<std::string> col;
-      SplitStringToVector(line, " \t", true, &col);
-
-      // Looks for keyword "\N-gram:" if the keyword has not been located.
-      if (!keyword_found && col.size() == 1 && col[0] == keyword.str()) {
-        KALDI_LOG << "Reading \"" << keyword.str() << "\" section.";
-        ngram_count = 0;
-        keyword_found = true;
-        continue;
-      }
-
-      // Enters "\N-grams:" section if the keyword has been located.
-      if (keyword_found && col.size() > 0) {
-        KALDI_ASSERT(col.size() >= 1 + cur_order);
-        KALDI_ASSERT(col.size() <= 2 + cur_order);// backoff_logprob could be 0.
-        if (cur_order == ngram_order_ && col.size() == 2 + cur_order) {
-          KALDI_ERR << "Backoff probability detected for final-order entry \""
-              << line << "\".";
-        }
-        ngram_count++;
 
-        // If backoff_logprob is 0, it will not appear in Arpa format language
-        // model. We put it back so the processing afterwards will be easier.
-        if (col.size() == 1 + cur_order) {
-          col.push_back("0");
-        }
+  // Creates LmState for the current word sequence.
+  bool is_unigram = (cur_order == 1) ? true : false;
+  float logprob = ngram.logprob;
+  float backoff_logprob = ngram.backoff;
+  if (natural_base_) {
+    logprob *= log(10);
+    backoff_logprob *= log(10);
+  }
 
-        // Creates LmState for the current word sequence.
-        bool is_unigram = (cur_order == 1) ? true : false;
-        float logprob;
-        float backoff_logprob;
-        KALDI_ASSERT(ConvertStringToReal(col[0], &logprob));
-        KALDI_ASSERT(ConvertStringToReal(col[1 + cur_order], &backoff_logprob));
-        if (natural_base_) {
-          logprob *= log(10);
-          backoff_logprob *= log(10);
-        }
-       
-        // If <ngram_order_> is larger than 1, then we do not create LmState for
-        // the final order entry. We only keep the log probability for it.
-        LmState *lm_state = NULL;
-        if (cur_order != ngram_order_ || ngram_order_ == 1) {
-          lm_state = new LmState(is_unigram,
-                                 (cur_order == ngram_order_ - 1),
-                                 logprob, backoff_logprob);
-        }
+  // If <ngram_order_> is larger than 1, then we do not create LmState for
+  // the final order entry. We only keep the log probability for it.
+  LmState *lm_state = NULL;
+  if (cur_order != ngram_order_ || ngram_order_ == 1) {
+    lm_state = new LmState(is_unigram,
+                           (cur_order == ngram_order_ - 1),
+                           logprob, backoff_logprob);
+  }
 
-        // Figures out the sequence of words.
-        std::vector<int32> seq(cur_order, 0);
-        for (int32 index = 0; index < cur_order; ++index) {
-          int32 word;
-          if (!ConvertStringToInteger(col[1 + index], &word)) {
-            KALDI_ERR << "bad line: " << line << "; fail to convert "
-                << col[1 + index] << " to integer.";
-          }
-          seq[index] = word;
-        }
+  // The sequence of words.
+  const std::vector<int32> &seq = ngram.words;
 
-        // If <ngram_order_> is larger than 1, then we do not insert LmState to
-        // <seq_to_state_>.
-        if (cur_order != ngram_order_ || ngram_order_ == 1) {
-          KALDI_ASSERT(lm_state != NULL);
-          KALDI_ASSERT(seq_to_state_.find(seq) == seq_to_state_.end());
-          seq_to_state_[seq] = lm_state;
-        }
+  // If <ngram_order_> is larger than 1, then we do not insert LmState to
+  // <seq_to_state_>.
+  if (cur_order != ngram_order_ || ngram_order_ == 1) {
+    KALDI_ASSERT(lm_state != NULL);
+    KALDI_ASSERT(seq_to_state_.find(seq) == seq_to_state_.end());
+    seq_to_state_[seq] = lm_state;
+  }
 
-        // If n-gram order is larger than 1, we have to add possible child to
-        // existing LmStates. We have the following two assumptions:
-        // 1. N-grams are processed from small order to larger ones, i.e., from
-        //    1, 2, ... to the highest order.
-        // 2. If a n-gram exists in the Arpa format language model, then the
-        //    "history" n-gram also exists. For example, if "A B C" is a valid
-        //    n-gram, then "A B" is also a valid n-gram.
-        if (cur_order > 1) {
-          std::vector<int32> hist(seq.begin(), seq.begin() + cur_order - 1);
-          int32 word = seq[seq.size() - 1];
-          unordered_map<std::vector<int32>,
-                        LmState*, VectorHasher<int32> >::iterator hist_iter;
-          hist_iter = seq_to_state_.find(hist);
-          KALDI_ASSERT(hist_iter != seq_to_state_.end());
-          if (cur_order != ngram_order_ || ngram_order_ == 1) {
-            KALDI_ASSERT(lm_state != NULL);
-            KALDI_ASSERT(!hist_iter->second->IsChildFinalOrder());
-            hist_iter->second->AddChild(word, lm_state);
-          } else {
-            KALDI_ASSERT(lm_state == NULL);
-            KALDI_ASSERT(hist_iter->second->IsChildFinalOrder());
-            hist_iter->second->AddChild(word, logprob);
-          }
-        } else {
-          // Figures out <max_word_id>.
-          KALDI_ASSERT(seq.size() == 1);
-          if (seq[0] > max_word_id) {
-            max_word_id = seq[0];
-          }
-        }
-      }
-    } while (getline(is, line) && !is.eof());
-    if (ngram_count > num_ngrams[cur_order] ||
-        (ngram_count == 0 && num_ngrams[cur_order] != 0)) {
-      KALDI_ERR << "Header said there would be " << num_ngrams[cur_order]
-                << " n-grams of order " << cur_order << ", but we saw "
-                << ngram_count;
+  // If n-gram order is larger than 1, we have to add possible child to
+  // existing LmStates. We have the following two assumptions:
+  // 1. N-grams are processed from small order to larger ones, i.e., from
+  //    1, 2, ... to the highest order (ArpaFileParser guarantees this).
+  // 2. If a n-gram exists in the Arpa format language model, then the
+  //    "history" n-gram also exists. For example, if "A B C" is a valid
+  //    n-gram, then "A B" is also a valid n-gram.
+  if (cur_order > 1) {
+    std::vector<int32> hist(seq.begin(), seq.begin() + cur_order - 1);
+    int32 word = seq[seq.size() - 1];
+    unordered_map<std::vector<int32>,
+                  LmState*, VectorHasher<int32> >::iterator hist_iter;
+    hist_iter = seq_to_state_.find(hist);
+    KALDI_ASSERT(hist_iter != seq_to_state_.end());
+    if (cur_order != ngram_order_ || ngram_order_ == 1) {
+      KALDI_ASSERT(lm_state != NULL);
+      KALDI_ASSERT(!hist_iter->second->IsChildFinalOrder());
+      hist_iter->second->AddChild(word, lm_state);
+    } else {
+      KALDI_ASSERT(lm_state == NULL);
+      KALDI_ASSERT(hist_iter->second->IsChildFinalOrder());
+      hist_iter->second->AddChild(word, logprob);
+    }
+  } else {
+    // Figures out <max_word_id_>.
+    KALDI_ASSERT(seq.size() == 1);
+    if (seq[0] > max_word_id_) {
+      max_word_id_ = seq[0];
     }
   }
+}
 
-  // <num_words_> is <max_word_id> plus 1.
-  num_words_ = max_word_id + 1;
+void ConstArpaLmBuilder::ReadComplete() {
+  // <num_words_> is <max_word_id_> plus 1.
+  num_words_ = max_word_id_ + 1;
 }
 
 // ConstArpaLm can be built in the following steps, assuming we have already
@@ -631,11 +539,89 @@ void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
   }
   KALDI_ASSERT(is_built_);
 
+  // ConstArpaLm keeps offsets into <lm_states_> rather than pointers. The
+  // offset is tricky:
+  // 1. If the original address is NULL, then we set the offset to zero.
+  // 2. If the original address is not NULL, we set it to the following:
+  //      unigram_states_[i] - lm_states_ + 1
+  //    we plus 1 to ensure that the above value is positive.
+  std::vector<int64> unigram_offsets(num_words_, 0),
+      overflow_offsets(overflow_buffer_size_, 0);
+  for (int32 i = 0; i < num_words_; ++i) {
+    if (unigram_states_[i] != NULL)
+      unigram_offsets[i] = unigram_states_[i] - lm_states_ + 1;
+  }
+  for (int32 i = 0; i < overflow_buffer_size_; ++i) {
+    if (overflow_buffer_[i] != NULL)
+      overflow_offsets[i] = overflow_buffer_[i] - lm_states_ + 1;
+  }
+
   // Creates ConstArpaLm.
-  ConstArpaLm const_arpa_lm(bos_symbol_, eos_symbol_, unk_symbol_, ngram_order_,
-                            num_words_, overflow_buffer_size_, lm_states_size_,
-                            unigram_states_, overflow_buffer_, lm_states_);
-  const_arpa_lm.Write(os, binary);
+  ConstArpaLm const_arpa_lm(
+      bos_symbol_, eos_symbol_, unk_symbol_, ngram_order_, num_words_,
+      overflow_buffer_size_, lm_states_size_, &(unigram_offsets[0]),
+      (overflow_offsets.empty() ? NULL : &(overflow_offsets[0])), lm_states_);
+  if (write_mappable_)
+    const_arpa_lm.WriteMappable(os, binary);
+  else
+    const_arpa_lm.Write(os, binary);
+}
+
+// Header of the format written by ConstArpaLm::WriteMappable(); it is followed by the
+// unigram table (int64), the overflow buffer (int64) and the LmStates (int32),
+// exactly as they are in memory. Its size is a multiple of 8, so that if it
+// starts at an 8-byte boundary, so do the arrays.
+struct ConstArpaLmHeader {
+  uint32 byte_order;
+  int32 version;
+  int32 bos_symbol;
+  int32 eos_symbol;
+  int32 unk_symbol;
+  int32 ngram_order;
+  int32 num_words;
+  int32 overflow_buffer_size;
+  int32 lm_states_size;
+  int32 padding;
+};
+
+static const uint32 kConstArpaLmByteOrderMark = 0x01020304;
+static const int32 kConstArpaLmVersion = 1;
+
+// Checks the header, and returns the size in bytes of the header and arrays
+// together, or prints a warning and returns zero if it is not valid.
+static size_t CheckConstArpaLmHeader(const ConstArpaLmHeader &header) {
+  if (header.byte_order != kConstArpaLmByteOrderMark) {
+    KALDI_WARN << "ConstArpaLm was written on a machine with different byte "
+               << "order.";
+    return 0;
+  }
+  if (header.version != kConstArpaLmVersion) {
+    KALDI_WARN << "ConstArpaLm has unsupported version " << header.version;
+    return 0;
+  }
+  if (header.num_words <= 0 || header.overflow_buffer_size < 0 ||
+      header.lm_states_size <= 0) {
+    KALDI_WARN << "ConstArpaLm has invalid sizes.";
+    return 0;
+  }
+  return sizeof(ConstArpaLmHeader) +
+      static_cast<size_t>(header.num_words) * sizeof(int64) +
+      static_cast<size_t>(header.overflow_buffer_size) * sizeof(int64) +
+      static_cast<size_t>(header.lm_states_size) * sizeof(int32);
+}
+
+ConstArpaLm::~ConstArpaLm() {
+  if (memory_assigned_) {
+    delete[] lm_states_;
+    delete[] unigram_states_;
+    delete[] overflow_buffer_;
+  }
+#ifndef _MSC_VER
+  if (mapped_data_ != NULL) {
+    if (munmap(mapped_data_, mapped_size_) != 0)
+      KALDI_WARN << "munmap failed: " << strerror(errno);
+  }
+#endif
 }
 
 void ConstArpaLm::Write(std::ostream &os, bool binary) const {
@@ -656,34 +642,60 @@ void ConstArpaLm::Write(std::ostream &os, bool binary) const {
     WriteBasicType(os, binary, lm_states_[i]);
   }
 
-  // Unigram section. We write memory offset to disk instead of the absolute
-  // pointers.
+  // Unigram section. These are already memory offsets (see UnigramState()),
+  // which is what we write to disk.
   WriteBasicType(os, binary, num_words_);
   for (int32 i = 0; i < num_words_; ++i) {
-    // The relative address here is a little bit tricky:
-    // 1. If the original address is NULL, then we set the relative address to
-    //    zero.
-    // 2. If the original address is not NULL, we set it to the following:
-    //      unigram_states_[i] - lm_states_ + 1
-    //    we plus 1 to ensure that the above value is positive.
-    int64 tmp_address = (unigram_states_[i] == NULL) ? 0 :
-        unigram_states_[i] - lm_states_ + 1;
-    WriteBasicType(os, binary, tmp_address);
-  }
-
-  // Overflow section. We write memory offset to disk instead of the absolute
-  // pointers.
+    WriteBasicType(os, binary, unigram_states_[i]);
+  }
+
+  // Overflow section, likewise.
   WriteBasicType(os, binary, overflow_buffer_size_);
   for (int32 i = 0; i < overflow_buffer_size_; ++i) {
-    // The relative address here is a little bit tricky:
-    // 1. If the original address is NULL, then we set the relative address to
-    //    zero.
-    // 2. If the original address is not NULL, we set it to the following:
-    //      overflow_buffer_[i] - lm_states_ + 1
-    //    we plus 1 to ensure that the above value is positive.
-    int64 tmp_address = (overflow_buffer_[i] == NULL) ? 0 :
-        overflow_buffer_[i] - lm_states_ + 1;
-    WriteBasicType(os, binary, tmp_address);
+    WriteBasicType(os, binary, overflow_buffer_[i]);
+  }
+}
+
+void ConstArpaLm::WriteMappable(std::ostream &os, bool binary) const {
+  KALDI_ASSERT(initialized_);
+  if (!binary) {
+    KALDI_ERR << "text-mode writing is not implemented for ConstArpaLm.";
+  }
+
+  WriteToken(os, binary, "<ConstArpaLm>");
+  // We pad so that the header starts at an 8-byte boundary of the file, which
+  // ReadMapped() requires; the byte after the token says how many bytes of
+  // padding follow it. If we can't tell where we are in the file (e.g. if
+  // writing to a pipe) we don't pad, and ReadMapped() will read the file the
+  // normal way if it ends up misaligned.
+  std::streamoff pos = os.tellp();
+  int32 padding = (pos < 0 ? 0 : (8 - (pos + 1) % 8) % 8);
+  os.put(static_cast<char>(padding));
+  for (int32 i = 0; i < padding; ++i)
+    os.put('\0');
+
+  ConstArpaLmHeader header;
+  header.byte_order = kConstArpaLmByteOrderMark;
+  header.version = kConstArpaLmVersion;
+  header.bos_symbol = bos_symbol_;
+  header.eos_symbol = eos_symbol_;
+  header.unk_symbol = unk_symbol_;
+  header.ngram_order = ngram_order_;
+  header.num_words = num_words_;
+  header.overflow_buffer_size = overflow_buffer_size_;
+  header.lm_states_size = lm_states_size_;
+  header.padding = 0;
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char*>(unigram_states_),
+           sizeof(int64) * num_words_);
+  if (overflow_buffer_size_ > 0) {
+    os.write(reinterpret_cast<const char*>(overflow_buffer_),
+             sizeof(int64) * overflow_buffer_size_);
+  }
+  os.write(reinterpret_cast<const char*>(lm_states_),
+           sizeof(int32) * lm_states_size_);
+  if (!os.good()) {
+    KALDI_ERR << "Error writing ConstArpaLm.";
   }
 }
 
@@ -693,41 +705,73 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
     KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
   }
 
-  // Misc info.
-  ReadBasicType(is, binary, &bos_symbol_);
-  ReadBasicType(is, binary, &eos_symbol_);
-  ReadBasicType(is, binary, &unk_symbol_);
-  ReadBasicType(is, binary, &ngram_order_);
+  int64 *unigram_states = NULL, *overflow_buffer = NULL;
+  int32 *lm_states = NULL;
+  bool too_short = false;
+  if (is.peek() == '<') {
+    // The format written by WriteMappable().
+    ExpectToken(is, binary, "<ConstArpaLm>");
+    int32 padding = is.get();
+    is.ignore(padding);
+    ConstArpaLmHeader header;
+    if (!is.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        CheckConstArpaLmHeader(header) == 0) {
+      KALDI_ERR << "Error reading ConstArpaLm: invalid header.";
+    }
+    bos_symbol_ = header.bos_symbol;
+    eos_symbol_ = header.eos_symbol;
+    unk_symbol_ = header.unk_symbol;
+    ngram_order_ = header.ngram_order;
+    num_words_ = header.num_words;
+    overflow_buffer_size_ = header.overflow_buffer_size;
+    lm_states_size_ = header.lm_states_size;
+    unigram_states = new int64[num_words_];
+    overflow_buffer = new int64[overflow_buffer_size_];
+    lm_states = new int32[lm_states_size_];
+    is.read(reinterpret_cast<char*>(unigram_states),
+            sizeof(int64) * num_words_);
+    is.read(reinterpret_cast<char*>(overflow_buffer),
+            sizeof(int64) * overflow_buffer_size_);
+    is.read(reinterpret_cast<char*>(lm_states),
+            sizeof(int32) * lm_states_size_);
+    too_short = !is.good();
+  } else {
+    // The format written by Write(), in which the arrays are written element
+    // by element.
+    // Misc info.
+    ReadBasicType(is, binary, &bos_symbol_);
+    ReadBasicType(is, binary, &eos_symbol_);
+    ReadBasicType(is, binary, &unk_symbol_);
+    ReadBasicType(is, binary, &ngram_order_);
+
+    // LmStates section.
+    ReadBasicType(is, binary, &lm_states_size_);
+    lm_states = new int32[lm_states_size_];
+    for (int32 i = 0; i < lm_states_size_; ++i) {
+      ReadBasicType(is, binary, &lm_states[i]);
+    }
 
-  // LmStates section.
-  ReadBasicType(is, binary, &lm_states_size_);
-  lm_states_ = new int32[lm_states_size_];
-  for (int32 i = 0; i < lm_states_size_; ++i) {
-    ReadBasicType(is, binary, &lm_states_[i]);
-  }
+    // Unigram section. The memory offsets were written in the same way as we
+    // store them.
+    ReadBasicType(is, binary, &num_words_);
+    unigram_states = new int64[num_words_];
+    for (int32 i = 0; i < num_words_; ++i) {
+      ReadBasicType(is, binary, &unigram_states[i]);
+    }
 
-  // Unigram section. We write memory offset to disk instead of the absolute
-  // pointers.
-  ReadBasicType(is, binary, &num_words_);
-  unigram_states_ = new int32*[num_words_];
-  for (int32 i = 0; i < num_words_; ++i) {
-    int64 tmp_address;
-    ReadBasicType(is, binary, &tmp_address);
-    // Check out how we compute the relative address in ConstArpaLm::Write().
-    unigram_states_[i] =
-        (tmp_address == 0) ? NULL : lm_states_ + tmp_address - 1;
+    // Overflow section.
+    ReadBasicType(is, binary, &overflow_buffer_size_);
+    overflow_buffer = new int64[overflow_buffer_size_];
+    for (int32 i = 0; i < overflow_buffer_size_; ++i) {
+      ReadBasicType(is, binary, &overflow_buffer[i]);
+    }
   }
-
-  // Overflow section. We write memory offset to disk instead of the absolute
-  // pointers.
-  ReadBasicType(is, binary, &overflow_buffer_size_);
-  overflow_buffer_ = new int32*[overflow_buffer_size_];
-  for (int32 i = 0; i < overflow_buffer_size_; ++i) {
-    int64 tmp_address;
-    ReadBasicType(is, binary, &tmp_address);
-    // Check out how we compute the relative address in ConstArpaLm::Write().
-    overflow_buffer_[i] =
-        (tmp_address == 0) ? NULL : lm_states_ + tmp_address - 1;
+  lm_states_ = lm_states;
+  unigram_states_ = unigram_states;
+  overflow_buffer_ = overflow_buffer;
+  memory_assigned_ = true;
+  if (too_short) {
+    KALDI_ERR << "Error reading ConstArpaLm: file too short.";
   }
   KALDI_ASSERT(ngram_order_ > 0);
   KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
@@ -735,8 +779,123 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   KALDI_ASSERT(unk_symbol_ < num_words_ &&
                (unk_symbol_ > 0 || unk_symbol_ == -1));
   lm_states_end_ = lm_states_ + lm_states_size_ - 1;
-  memory_assigned_ = true;
-  initialized_ = true;;
+  initialized_ = true;
+}
+
+bool ConstArpaLm::SetArrays(const char *data, size_t size) {
+  if (size < sizeof(ConstArpaLmHeader))
+    return false;
+  const ConstArpaLmHeader &header =
+      *reinterpret_cast<const ConstArpaLmHeader*>(data);
+  size_t expected_size = CheckConstArpaLmHeader(header);
+  if (expected_size == 0 || expected_size > size)
+    return false;
+  bos_symbol_ = header.bos_symbol;
+  eos_symbol_ = header.eos_symbol;
+  unk_symbol_ = header.unk_symbol;
+  ngram_order_ = header.ngram_order;
+  num_words_ = header.num_words;
+  overflow_buffer_size_ = header.overflow_buffer_size;
+  lm_states_size_ = header.lm_states_size;
+  data += sizeof(ConstArpaLmHeader);
+  unigram_states_ = reinterpret_cast<const int64*>(data);
+  data += sizeof(int64) * num_words_;
+  overflow_buffer_ = reinterpret_cast<const int64*>(data);
+  data += sizeof(int64) * overflow_buffer_size_;
+  lm_states_ = reinterpret_cast<const int32*>(data);
+  return true;
+}
+
+#ifndef _MSC_VER
+namespace {
+// A read-only stream buffer over a block of memory, so that we can read a file
+// we have already memory-mapped with the usual Read() code.
+class MemoryStreambuf: public std::streambuf {
+ public:
+  MemoryStreambuf(char *data, size_t size) { setg(data, data, data + size); }
+};
+}  // namespace
+#endif
+
+void ConstArpaLm::ReadMapped(const std::string &rxfilename) {
+  KALDI_ASSERT(!initialized_);
+#ifdef _MSC_VER
+  // Memory-mapping is not implemented on Windows.
+  ReadKaldiObject(rxfilename, this);
+#else
+  if (ClassifyRxfilename(rxfilename) != kFileInput) {
+    ReadKaldiObject(rxfilename, this);
+    return;
+  }
+
+  int fd = open(rxfilename.c_str(), O_RDONLY);
+  if (fd == -1)
+    KALDI_ERR << "Could not open " << rxfilename << " for reading: "
+              << strerror(errno);
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) != 0) {
+    close(fd);
+    KALDI_ERR << "Could not stat " << rxfilename << ": " << strerror(errno);
+  }
+  size_t file_size = stat_buf.st_size;
+  if (file_size == 0) {
+    close(fd);
+    KALDI_ERR << "Error reading ConstArpaLm from " << rxfilename
+              << ": file is empty.";
+  }
+  void *data = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // The mapping stays valid after closing the file.
+  if (data == MAP_FAILED)
+    KALDI_ERR << "Could not memory-map " << rxfilename << ": "
+              << strerror(errno);
+  char *char_data = static_cast<char*>(data);
+
+  // The binary-mode header "\0B", then the token and the padding byte of the
+  // format written by WriteMappable().
+  const std::string prefix("\0B<ConstArpaLm> ", 16);
+  if (file_size > prefix.size() &&
+      prefix.compare(0, prefix.size(), char_data, prefix.size()) == 0) {
+    size_t offset = prefix.size() + 1 +
+        static_cast<unsigned char>(char_data[prefix.size()]);
+    if (offset % 8 == 0) {
+      if (offset > file_size ||
+          !SetArrays(char_data + offset, file_size - offset)) {
+        munmap(data, file_size);
+        KALDI_ERR << "Error reading ConstArpaLm from " << rxfilename
+                  << ": invalid header or file too short.";
+      }
+      mapped_data_ = data;
+      mapped_size_ = file_size;
+      KALDI_ASSERT(ngram_order_ > 0);
+      KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
+      KALDI_ASSERT(eos_symbol_ < num_words_ && eos_symbol_ > 0);
+      KALDI_ASSERT(unk_symbol_ < num_words_ &&
+                   (unk_symbol_ > 0 || unk_symbol_ == -1));
+      lm_states_end_ = lm_states_ + lm_states_size_ - 1;
+      initialized_ = true;
+      return;
+    }
+    // E.g. the file was written to a pipe so we couldn't align it.
+    KALDI_VLOG(1) << "ConstArpaLm in " << rxfilename << " is not aligned for "
+                  << "memory-mapping; reading it instead.";
+  }
+
+  // The format written by Write(), or a misaligned one: read it from the
+  // mapping, rather than opening the file again.
+  try {
+    MemoryStreambuf buf(char_data, file_size);
+    std::istream is(&buf);
+    bool binary = true;
+    if (!InitKaldiInputStream(is, &binary))
+      KALDI_ERR << "Error reading ConstArpaLm from " << rxfilename
+                << ": could not read header.";
+    Read(is, binary);
+  } catch(...) {
+    munmap(data, file_size);
+    throw;
+  }
+  munmap(data, file_size);
+#endif
 }
 
 bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
@@ -747,7 +906,7 @@ bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
   }
 
   // Tries to locate the LmState of the given word sequence.
-  int32* lm_state = GetLmState(hist);
+  const int32* lm_state = GetLmState(&(hist[0]), hist.size());
   if (lm_state == NULL) {
     // <lm_state> does not exist means <hist> has no child.
     return false;
@@ -768,90 +927,113 @@ bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
 
 float ConstArpaLm::GetNgramLogprob(const int32 word,
                                    const std::vector<int32>& hist) const {
+  return GetNgramLogprob(word, (hist.empty() ? NULL : &(hist[0])),
+                         hist.size());
+}
+
+int64 ConstArpaLm::HistoryId(const int32 *seq, const int32 seq_size) const {
+  KALDI_ASSERT(seq_size > 0);
+  const int32* lm_state = GetLmState(seq, seq_size);
+  // <lm_state + 2> points to <num_children>.
+  if (lm_state == NULL || *(lm_state + 2) == 0)
+    return -1;
+  return lm_state - lm_states_;
+}
+
+float ConstArpaLm::GetNgramLogprob(const int32 word, const int32 *hist,
+                                   const int32 hist_size) const {
   KALDI_ASSERT(initialized_);
 
   // If the history size plus one is larger than <ngram_order_>, remove the old
   // words.
-  std::vector<int32> mapped_hist(hist);
-  while (mapped_hist.size() >= ngram_order_) {
-    mapped_hist.erase(mapped_hist.begin(), mapped_hist.begin() + 1);
+  int32 mapped_hist_size = hist_size;
+  const int32 *mapped_hist = hist;
+  if (mapped_hist_size >= ngram_order_) {
+    mapped_hist += mapped_hist_size - (ngram_order_ - 1);
+    mapped_hist_size = ngram_order_ - 1;
   }
-  KALDI_ASSERT(mapped_hist.size() + 1 <= ngram_order_);
+  KALDI_ASSERT(mapped_hist_size + 1 <= ngram_order_);
 
   // TODO(guoguo): check with Dan if this is reasonable.
   // Maps possible out-of-vocabulary words to <unk>. If a word does not have a
   // corresponding LmState, we treat it as <unk>. We map it to <unk> if <unk> is
-  // specified.
+  // specified.  We only copy the history if we have to change it.
   int32 mapped_word = word;
+  std::vector<int32> hist_copy;
   if (unk_symbol_ != -1) {
     KALDI_ASSERT(mapped_word >= 0);
-    if (mapped_word >= num_words_ || unigram_states_[mapped_word] == NULL) {
+    if (mapped_word >= num_words_ || UnigramState(mapped_word) == NULL) {
       mapped_word = unk_symbol_;
     }
-    for (int32 i = 0; i < mapped_hist.size(); ++i) {
+    for (int32 i = 0; i < mapped_hist_size; ++i) {
       KALDI_ASSERT(mapped_hist[i] >= 0);
       if (mapped_hist[i] >= num_words_ ||
-          unigram_states_[mapped_hist[i]] == NULL) {
-        mapped_hist[i] = unk_symbol_;
+          UnigramState(mapped_hist[i]) == NULL) {
+        if (hist_copy.empty())
+          hist_copy.assign(mapped_hist, mapped_hist + mapped_hist_size);
+        hist_copy[i] = unk_symbol_;
       }
     }
+    if (!hist_copy.empty())
+      mapped_hist = &(hist_copy[0]);
   }
 
   // Loops up n-gram probability.
-  return GetNgramLogprobRecurse(mapped_word, mapped_hist);
+  return GetNgramLogprobRecurse(mapped_word, mapped_hist, mapped_hist_size);
 }
 
 float ConstArpaLm::GetNgramLogprobRecurse(
-    const int32 word, const std::vector<int32>& hist) const {
+    const int32 word, const int32 *hist, const int32 hist_size) const {
   KALDI_ASSERT(initialized_);
-  KALDI_ASSERT(hist.size() + 1 <= ngram_order_);
+  KALDI_ASSERT(hist_size + 1 <= ngram_order_);
 
   // Unigram case.
-  if (hist.size() == 0) {
-    if (word >= num_words_ || unigram_states_[word] == NULL) {
+  if (hist_size == 0) {
+    if (word >= num_words_ || UnigramState(word) == NULL) {
       // If <unk> is defined, then the word sequence should have already been
       // mapped to <unk> is necessary; this is for the case where <unk> is not
       // defined.
       return std::numeric_limits<float>::min();
     } else {
-      return *reinterpret_cast<float*>(unigram_states_[word]);
+      return *reinterpret_cast<const float*>(UnigramState(word));
     }
   }
 
   // High n-gram orders.
   float logprob = 0.0;
   float backoff_logprob = 0.0;
-  int32* state;
-  if ((state = GetLmState(hist)) != NULL) {
+  const int32* state;
+  if ((state = GetLmState(hist, hist_size)) != NULL) {
     int32 child_info;
-    int32* child_lm_state = NULL;
+    const int32* child_lm_state = NULL;
     if (GetChildInfo(word, state, &child_info)) {
       DecodeChildInfo(child_info, state, &child_lm_state, &logprob);
       return logprob;
     } else {
-      backoff_logprob = *reinterpret_cast<float*>(state + 1);
+      backoff_logprob = *reinterpret_cast<const float*>(state + 1);
     }
   }
-  std::vector<int32> new_hist(hist);
-  new_hist.erase(new_hist.begin(), new_hist.begin() + 1);
-  return backoff_logprob + GetNgramLogprobRecurse(word, new_hist);
+  // Backs off to the history without its first word.
+  return backoff_logprob +
+      GetNgramLogprobRecurse(word, hist + 1, hist_size - 1);
 }
 
-int32* ConstArpaLm::GetLmState(const std::vector<int32>& seq) const {
+const int32* ConstArpaLm::GetLmState(const int32 *seq,
+                                     const int32 seq_size) const {
   KALDI_ASSERT(initialized_);
 
   // No LmState exists for empty word sequence.
-  if (seq.size() == 0) return NULL;
+  if (seq_size == 0) return NULL;
 
   // If <unk> is defined, then the word sequence should have already been mapped
   // to <unk> is necessary; this is for the case where <unk> is not defined.
-  if (seq[0] >= num_words_ || unigram_states_[seq[0]] == NULL) return NULL;
-  int32* parent = unigram_states_[seq[0]];
+  if (seq[0] >= num_words_ || UnigramState(seq[0]) == NULL) return NULL;
+  const int32* parent = UnigramState(seq[0]);
 
   int32 child_info;
-  int32* child_lm_state = NULL;
+  const int32* child_lm_state = NULL;
   float logprob;
-  for (int32 i = 1; i < seq.size(); ++i) {
+  for (int32 i = 1; i < seq_size; ++i) {
     if (!GetChildInfo(seq[i], parent, &child_info)) {
       return NULL;
     }
@@ -866,7 +1048,7 @@ int32* ConstArpaLm::GetLmState(const std::vector<int32>& seq) const {
 }
 
 bool ConstArpaLm::GetChildInfo(const int32 word,
-                               int32* parent, int32* child_info) const {
+                               const int32* parent, int32* child_info) const {
   KALDI_ASSERT(initialized_);
 
   KALDI_ASSERT(parent != NULL);
@@ -899,8 +1081,8 @@ bool ConstArpaLm::GetChildInfo(const int32 word,
 }
 
 void ConstArpaLm::DecodeChildInfo(const int32 child_info,
-                                  int32* parent,
-                                  int32** child_lm_state,
+                                  const int32* parent,
+                                  const int32** child_lm_state,
                                   float* logprob) const {
   KALDI_ASSERT(initialized_);
 
@@ -914,18 +1096,19 @@ void ConstArpaLm::DecodeChildInfo(const int32 child_info,
     int32 child_offset = child_info / 2;
     if (child_offset > 0) {
       *child_lm_state = parent + child_offset;
-      *logprob = *reinterpret_cast<float*>(*child_lm_state);
+      *logprob = *reinterpret_cast<const float*>(*child_lm_state);
     } else {
       KALDI_ASSERT(-child_offset < overflow_buffer_size_);
-      *child_lm_state = overflow_buffer_[-child_offset];
-      *logprob = *reinterpret_cast<float*>(*child_lm_state);
+      KALDI_ASSERT(overflow_buffer_[-child_offset] != 0);
+      *child_lm_state = lm_states_ + overflow_buffer_[-child_offset] - 1;
+      *logprob = *reinterpret_cast<const float*>(*child_lm_state);
     }
     KALDI_ASSERT(*child_lm_state >= lm_states_);
     KALDI_ASSERT(*child_lm_state <= lm_states_end_);
   }
 }
 
-void ConstArpaLm::WriteArpaRecurse(int32* lm_state,
+void ConstArpaLm::WriteArpaRecurse(const int32* lm_state,
                                    const std::vector<int32>& seq,
                                    std::vector<ArpaLine> *output) const {
   if (lm_state == NULL) return;
@@ -936,8 +1119,8 @@ void ConstArpaLm::WriteArpaRecurse(int32* lm_state,
   // Inserts the current LmState to <output>.
   ArpaLine arpa_line;
   arpa_line.words = seq;
-  arpa_line.logprob = *reinterpret_cast<float*>(lm_state);
-  arpa_line.backoff_logprob = *reinterpret_cast<float*>(lm_state + 1);
+  arpa_line.logprob = *reinterpret_cast<const float*>(lm_state);
+  arpa_line.backoff_logprob = *reinterpret_cast<const float*>(lm_state + 1);
   output->push_back(arpa_line);
 
   // Scans for possible children, and recursively adds child to <output>.
@@ -948,7 +1131,7 @@ void ConstArpaLm::WriteArpaRecurse(int32* lm_state,
     new_seq.push_back(*(lm_state + 3 + 2 * i));
     int32 child_info = *(lm_state + 4 + 2 * i);
     float logprob;
-    int32* child_lm_state = NULL;
+    const int32* child_lm_state = NULL;
     DecodeChildInfo(child_info, lm_state, &child_lm_state, &logprob);
 
     if (child_lm_state == NULL) {
@@ -964,19 +1147,25 @@ void ConstArpaLm::WriteArpaRecurse(int32* lm_state,
   }
 }
 
-void ConstArpaLm::WriteArpa(std::ostream &os) const {
+void ConstArpaLm::GetArpaLines(std::vector<ArpaLine> *lines) const {
   KALDI_ASSERT(initialized_);
 
-  std::vector<ArpaLine> tmp_output;
+  lines->clear();
   for (int32 i = 0; i < num_words_; ++i) {
-    if (unigram_states_[i] != NULL) {
+    if (UnigramState(i) != NULL) {
       std::vector<int32> seq(1, i);
-      WriteArpaRecurse(unigram_states_[i], seq, &tmp_output);
+      WriteArpaRecurse(UnigramState(i), seq, lines);
     }
   }
+  std::sort(lines->begin(), lines->end());
+}
+
+void ConstArpaLm::WriteArpa(std::ostream &os) const {
+  KALDI_ASSERT(initialized_);
 
-  // Sorts ArpaLines and collects head information.
-  std::sort(tmp_output.begin(), tmp_output.end());
+  // Collects the sorted ArpaLines and the head information.
+  std::vector<ArpaLine> tmp_output;
+  GetArpaLines(&tmp_output);
   std::vector<int32> ngram_count(1, 0);
   for (int32 i = 0; i < tmp_output.size(); ++i) {
     if (tmp_output[i].words.size() >= ngram_count.size()) {
@@ -1025,62 +1214,226 @@ void ConstArpaLm::WriteArpa(std::ostream &os) const {
   os << std::endl << "\\end\\" << std::endl;
 }
 
-ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
-    const ConstArpaLm& lm) : lm_(lm) {
-  // Creates a history state for <s>.
-  std::vector<Label> bos_state(1, lm_.BosSymbol());
-  state_to_wseq_.push_back(bos_state);
-  wseq_to_state_[bos_state] = 0;
-  start_state_ = 0;
+ConstArpaLmCache::Table::Table(const ArpaLmInterface &lm,
+                               int32 num_cached_arcs, bool thread_safe) :
+    lm_(lm), max_history_(lm.NgramOrder() - 1), thread_safe_(thread_safe),
+    num_users_(0) {
+  // We only need several shards if there are several threads.
+  KALDI_ASSERT(num_cached_arcs > 0);
+  int32 num_shards = (thread_safe ? std::min(16, num_cached_arcs) : 1);
+  shards_.resize(num_shards);
+  for (int32 i = 0; i < num_shards; i++) {
+    shards_[i] = new Shard();
+    shards_[i]->elements.resize(num_cached_arcs / num_shards);
+    for (size_t j = 0; j < shards_[i]->elements.size(); j++)
+      shards_[i]->elements[j].state = -1;  // Invalidates the element.
+  }
+
+  // Creates the start state, for the history <s>. We keep <s> in it even if it
+  // has no successors in the language model, as its backoff weight applies.
+  int32 bos_symbol = lm_.BosSymbol();
+  if (max_history_ == 0) {
+    FindOrAddState(-1, NULL, 0);
+  } else {
+    int64 history_id = lm_.HistoryId(&bos_symbol, 1);
+    AddState(&bos_symbol, 1);
+    if (history_id != -1)
+      history_id_to_state_[history_id] = 0;
+  }
 }
 
-fst::StdArc::Weight ConstArpaLmDeterministicFst::Final(StateId s) {
-  // At this point, we should have created the state.
-  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  const std::vector<Label>& wseq = state_to_wseq_[s];
-  float logprob = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
-  return Weight(-logprob);
+ConstArpaLmCache::Table::~Table() {
+  DeletePointers(&shards_);
 }
 
-bool ConstArpaLmDeterministicFst::GetArc(StateId s,
-                                         Label ilabel, fst::StdArc *oarc) {
-  // At this point, we should have created the state.
-  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  std::vector<Label> wseq = state_to_wseq_[s];
+int32 ConstArpaLmCache::Table::AddState(const int32 *words, int32 size) {
+  KALDI_ASSERT(size <= max_history_);
+  int32 state = history_sizes_.size();
+  history_sizes_.push_back(size);
+  history_words_.resize(history_words_.size() + max_history_);
+  std::copy(words, words + size, history_words_.begin() + state * max_history_);
+  return state;
+}
 
-  float logprob = lm_.GetNgramLogprob(ilabel, wseq);
-  if (logprob == std::numeric_limits<float>::min()) {
-    return false;
+int32 ConstArpaLmCache::Table::FindOrAddState(int64 history_id,
+                                              const int32 *words, int32 size) {
+  unordered_map<int64, int32>::const_iterator iter =
+      history_id_to_state_.find(history_id);
+  if (iter != history_id_to_state_.end())
+    return iter->second;
+  int32 state = AddState(words, size);
+  history_id_to_state_[history_id] = state;
+  return state;
+}
+
+void ConstArpaLmCache::Table::GetHistory(int32 state,
+                                         std::vector<int32> *words) {
+  if (thread_safe_) states_mutex_.Lock();
+  KALDI_ASSERT(static_cast<size_t>(state) < history_sizes_.size());
+  std::vector<int32>::const_iterator begin =
+      history_words_.begin() + static_cast<size_t>(state) * max_history_;
+  words->assign(begin, begin + history_sizes_[state]);
+  if (thread_safe_) states_mutex_.Unlock();
+}
+
+int32 ConstArpaLmCache::Table::NextState(const std::vector<int32> &words,
+                                         int32 word) {
+  // The new history is <word> after the last <max_history_> - 1 words of the
+  // old one; we back off to the longest suffix of it that has successors in
+  // the language model. We look it up without the lock, as the language model
+  // is not changed.
+  std::vector<int32> new_words;
+  int64 history_id = -1;
+  if (max_history_ > 0) {
+    int32 size = words.size();
+    new_words.assign(words.begin() + std::max(0, size + 1 - max_history_),
+                     words.end());
+    new_words.push_back(word);
+    while (!new_words.empty()) {
+      history_id = lm_.HistoryId(&(new_words[0]), new_words.size());
+      if (history_id != -1)
+        break;
+      new_words.erase(new_words.begin());
+    }
   }
+  if (thread_safe_) states_mutex_.Lock();
+  int32 ans = FindOrAddState(history_id,
+                             (new_words.empty() ? NULL : &(new_words[0])),
+                             new_words.size());
+  if (thread_safe_) states_mutex_.Unlock();
+  return ans;
+}
 
-  // Locates the next state in ConstArpaLm. Note that OOV and backoff have been
-  // taken care of in ConstArpaLm.
-  wseq.push_back(ilabel);
-  while (wseq.size() >= lm_.NgramOrder()) {
-    // History state has at most lm_.NgramOrder() -1 words in the state.
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
+bool ConstArpaLmCache::Table::GetArc(int32 state, int32 word,
+                                     float *logprob, int32 *next_state) {
+  const size_t p1 = 26597, p2 = 50329;  // primes, as in
+  // CacheDeterministicOnDemandFst.
+  size_t hash = static_cast<size_t>(state) * p1 +
+      static_cast<size_t>(word) * p2;
+  Shard *shard = shards_[hash % shards_.size()];
+  CacheElement &elem =
+      shard->elements[(hash / shards_.size()) % shard->elements.size()];
+
+  if (thread_safe_) shard->mutex.Lock();
+  if (elem.state == state && elem.word == word) {
+    *logprob = elem.logprob;
+    *next_state = elem.next_state;
+    if (thread_safe_) shard->mutex.Unlock();
+    return true;
   }
-  while (!lm_.HistoryStateExists(wseq)) {
-    KALDI_ASSERT(wseq.size() > 0);
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
+  if (thread_safe_) shard->mutex.Unlock();
+
+  // We don't hold the lock of the shard while we walk the trie, so other
+  // threads can use the shard meanwhile.
+  std::vector<int32> words;
+  GetHistory(state, &words);
+  *logprob = lm_.GetNgramLogprob(word, words);
+  // Note: we don't cache anything if the word has zero probability, as in
+  // CacheDeterministicOnDemandFst.
+  if (*logprob == std::numeric_limits<float>::min())
+    return false;
+  *next_state = NextState(words, word);
+
+  if (thread_safe_) shard->mutex.Lock();
+  elem.state = state;
+  elem.word = word;
+  elem.logprob = *logprob;
+  elem.next_state = *next_state;
+  if (thread_safe_) shard->mutex.Unlock();
+  return true;
+}
+
+float ConstArpaLmCache::Table::FinalLogprob(int32 state) {
+  std::vector<int32> words;
+  GetHistory(state, &words);
+  return lm_.GetNgramLogprob(lm_.EosSymbol(), words);
+}
+
+int32 ConstArpaLmCache::Table::NumStates() {
+  if (thread_safe_) states_mutex_.Lock();
+  int32 ans = history_sizes_.size();
+  if (thread_safe_) states_mutex_.Unlock();
+  return ans;
+}
+
+ConstArpaLmCache::ConstArpaLmCache(const ArpaLmInterface &lm,
+                                   int32 num_cached_arcs, bool thread_safe,
+                                   int32 max_states) :
+    lm_(lm), num_cached_arcs_(num_cached_arcs), thread_safe_(thread_safe),
+    max_states_(max_states), num_retired_tables_(0) {
+  KALDI_ASSERT(num_cached_arcs > 0 && max_states > 0);
+  table_ = new Table(lm_, num_cached_arcs_, thread_safe_);
+}
+
+ConstArpaLmCache::~ConstArpaLmCache() {
+  KALDI_ASSERT(table_->num_users_ == 0 && num_retired_tables_ == 0 &&
+               "Destroying ConstArpaLmCache while its tables are in use.");
+  delete table_;
+}
+
+ConstArpaLmCache::Table *ConstArpaLmCache::AcquireTable() {
+  if (thread_safe_) mutex_.Lock();
+  if (table_->NumStates() > max_states_) {
+    KALDI_VLOG(1) << "Starting a new table of language model history states, "
+                  << "as the old one has " << table_->NumStates() << " states.";
+    if (table_->num_users_ == 0)
+      delete table_;
+    else
+      num_retired_tables_++;
+    table_ = new Table(lm_, num_cached_arcs_, thread_safe_);
   }
+  table_->num_users_++;
+  Table *ans = table_;
+  if (thread_safe_) mutex_.Unlock();
+  return ans;
+}
 
-  std::pair<const std::vector<Label>, StateId> wseq_state_pair(
-      wseq, static_cast<Label>(state_to_wseq_.size()));
+void ConstArpaLmCache::ReleaseTable(Table *table) {
+  if (thread_safe_) mutex_.Lock();
+  KALDI_ASSERT(table->num_users_ > 0);
+  table->num_users_--;
+  if (table->num_users_ == 0 && table != table_) {
+    delete table;
+    num_retired_tables_--;
+  }
+  if (thread_safe_) mutex_.Unlock();
+}
 
-  // Attemps to insert the current <wseq_state_pair>. If the pair already exists
-  // then it returns false.
-  typedef MapType::iterator IterType;
-  std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
+ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
+    const ArpaLmInterface& lm) : cache_(new ConstArpaLmCache(lm)),
+                                 delete_cache_(true) {
+  table_ = cache_->AcquireTable();
+  start_state_ = table_->Start();
+}
 
-  // If the pair was just inserted, then also add it to <state_to_wseq_>.
-  if (result.second == true)
-    state_to_wseq_.push_back(wseq);
+ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
+    ConstArpaLmCache *cache) : cache_(cache), delete_cache_(false) {
+  table_ = cache_->AcquireTable();
+  start_state_ = table_->Start();
+}
+
+ConstArpaLmDeterministicFst::~ConstArpaLmDeterministicFst() {
+  cache_->ReleaseTable(table_);
+  if (delete_cache_)
+    delete cache_;
+}
+
+fst::StdArc::Weight ConstArpaLmDeterministicFst::Final(StateId s) {
+  return Weight(-table_->FinalLogprob(s));
+}
+
+bool ConstArpaLmDeterministicFst::GetArc(StateId s,
+                                         Label ilabel, fst::StdArc *oarc) {
+  float logprob;
+  int32 next_state;
+  if (!table_->GetArc(s, ilabel, &logprob, &next_state))
+    return false;
 
-  // Creates the arc.
+  // Creates the arc. Note that OOV and backoff have been taken care of in
+  // ConstArpaLm and ConstArpaLmCache.
   oarc->ilabel = ilabel;
   oarc->olabel = ilabel;
-  oarc->nextstate = result.first->second;
+  oarc->nextstate = next_state;
   oarc->weight = Weight(-logprob);
 
   return true;
@@ -1089,9 +1442,12 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
 bool BuildConstArpaLm(const bool natural_base, const int32 bos_symbol,
                       const int32 eos_symbol, const int32 unk_symbol,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename) {
-  ConstArpaLmBuilder lm_builder(natural_base, bos_symbol,
+                      const std::string& const_arpa_wxfilename,
+                      const ArpaParseOptions &options,
+                      const bool mappable) {
+  ConstArpaLmBuilder lm_builder(options, natural_base, bos_symbol,
                                 eos_symbol, unk_symbol);
+  lm_builder.SetWriteMappable(mappable);
   ReadKaldiObject(arpa_rxfilename, &lm_builder);
   lm_builder.Build();
   WriteKaldiObject(lm_builder, const_arpa_wxfilename, true);
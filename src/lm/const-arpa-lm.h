@@ -22,14 +22,55 @@
 
 #include "base/kaldi-common.h"
 #include "fstext/deterministic-fst.h"
+#include "lm/arpa-file-parser.h"
+#include "thread/kaldi-mutex.h"
 #include "util/common-utils.h"
 
 namespace kaldi {
 
-// Forward declaration of Auxiliary struct ArpaLine.
-struct ArpaLine;
+// Auxiliary struct for converting ConstArpaLm format langugae model to Arpa
+// format.
+struct ArpaLine {
+  std::vector<int32> words; // Sequence of words to be printed.
+  float logprob;            // Logprob corresponds to word sequence.
+  float backoff_logprob;    // Backoff_logprob corresponds to word sequence.
+  // Comparison function for sorting.
+  bool operator < (const ArpaLine &other) const {
+    if (words.size() < other.words.size()) {
+      return true;
+    } else if (words.size() > other.words.size()) {
+      return false;
+    } else {
+      return words < other.words;
+    }
+  }
+};
 
-class ConstArpaLm {
+/**
+ The interface that ConstArpaLmCache (and so ConstArpaLmDeterministicFst)
+ needs from a backoff language model; ConstArpaLm and CompactArpaLm implement
+ it.
+ */
+class ArpaLmInterface {
+ public:
+  virtual int32 BosSymbol() const = 0;
+  virtual int32 EosSymbol() const = 0;
+  virtual int32 NgramOrder() const = 0;
+
+  // Returns the log-probability of <word> after the history <hist>, or
+  // std::numeric_limits<float>::min() if it has zero probability.
+  virtual float GetNgramLogprob(const int32 word,
+                                const std::vector<int32>& hist) const = 0;
+
+  // If the history of <seq_size> (at least one) words in <seq> has successors
+  // in the language model, returns a non-negative number that identifies it
+  // among the histories of the model; otherwise returns -1.
+  virtual int64 HistoryId(const int32 *seq, const int32 seq_size) const = 0;
+
+  virtual ~ArpaLmInterface() { }
+};
+
+class ConstArpaLm: public ArpaLmInterface {
  public:
 
   // Default constructor, will be used if you are going to load the ConstArpaLm
@@ -39,23 +80,27 @@ class ConstArpaLm {
     unigram_states_ = NULL;
     overflow_buffer_ = NULL;
     memory_assigned_ = false;
+    mapped_data_ = NULL;
+    mapped_size_ = 0;
     initialized_ = false;
   }
 
   // Special constructor, will be used when you initialize ConstArpaLm from
-  // scratch through this constructor.
+  // scratch through this constructor. The unigram and overflow tables are
+  // offsets into <lm_states>, as described for <unigram_states_> below. We
+  // don't take ownership of the arrays.
   ConstArpaLm(const int32 bos_symbol, const int32 eos_symbol,
               const int32 unk_symbol, const int32 ngram_order,
               const int32 num_words, const int32 overflow_buffer_size,
-              const int32 lm_states_size, int32** unigram_states,
-              int32** overflow_buffer, int32* lm_states) :
+              const int32 lm_states_size, const int64* unigram_states,
+              const int64* overflow_buffer, const int32* lm_states) :
       bos_symbol_(bos_symbol), eos_symbol_(eos_symbol),
       unk_symbol_(unk_symbol), ngram_order_(ngram_order),
       num_words_(num_words), overflow_buffer_size_(overflow_buffer_size),
       lm_states_size_(lm_states_size), unigram_states_(unigram_states),
       overflow_buffer_(overflow_buffer), lm_states_(lm_states) {
     KALDI_ASSERT(unigram_states_ != NULL);
-    KALDI_ASSERT(overflow_buffer_ != NULL);
+    KALDI_ASSERT(overflow_buffer_ != NULL || overflow_buffer_size_ == 0);
     KALDI_ASSERT(lm_states_ != NULL);
     KALDI_ASSERT(ngram_order_ > 0);
     KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
@@ -64,53 +109,97 @@ class ConstArpaLm {
                  (unk_symbol_ > 0 || unk_symbol_ == -1));
     lm_states_end_ = lm_states_ + lm_states_size_ - 1;
     memory_assigned_ = false;
+    mapped_data_ = NULL;
+    mapped_size_ = 0;
     initialized_ = true;
   }
 
-  ~ConstArpaLm() {
-    if (memory_assigned_) {
-      delete[] lm_states_;
-      delete[] unigram_states_;
-      delete[] overflow_buffer_;
-    }
-  }
+  ~ConstArpaLm();
 
-  // Reads the ConstArpaLm format language model.
+  // Reads the ConstArpaLm format language model, in the format written by
+  // either Write() or WriteMappable().
   void Read(std::istream &is, bool binary);
 
-  // Writes the language model in ConstArpaLm format.
+  // Reads the language model from <rxfilename>. If it is an ordinary file in
+  // the format written by WriteMappable(), it is memory-mapped and used in
+  // place, so loading takes no time and processes that load the same language
+  // model share one copy of it in memory; otherwise (and on Windows) this is
+  // the same as ReadKaldiObject().
+  void ReadMapped(const std::string &rxfilename);
+
+  // Writes the language model in ConstArpaLm format, with the arrays written
+  // element by element.
   void Write(std::ostream &os, bool binary) const;
 
+  // Writes the language model in the versioned format that ReadMapped() can
+  // memory-map: a header followed by the arrays as they are in memory (so it
+  // is not portable between machines with different byte order, which Read()
+  // checks for), aligned to 8 bytes. Older versions of Kaldi can't read it.
+  void WriteMappable(std::ostream &os, bool binary) const;
+
   // Creates Arpa format language model from ConstArpaLm format, and writes it
   // to output stream. This will be useful in testing.
   void WriteArpa(std::ostream &os) const;
 
+  // Outputs all the n-grams in the language model, sorted as in the Arpa
+  // format, with natural-log probabilities; <backoff_logprob> is zero where
+  // the n-gram has none.
+  void GetArpaLines(std::vector<ArpaLine> *lines) const;
+
   // Wrapper of GetNgramLogprobRecurse. It first maps possible out-of-vocabulary
   // words to <unk>, if <unk> is defined, and then calls GetNgramLogprobRecurse.
-  float GetNgramLogprob(const int32 word, const std::vector<int32>& hist) const;
+  virtual float GetNgramLogprob(const int32 word,
+                                const std::vector<int32>& hist) const;
+
+  // As above, but with the history given as an array of <hist_size> words,
+  // which saves copying it in the usual case where no word has to be mapped
+  // to <unk>.
+  float GetNgramLogprob(const int32 word, const int32 *hist,
+                        const int32 hist_size) const;
 
   // Returns true if the history word sequence <hist> has successor, which means
   // <hist> will be a state in the FST format language model.
   bool HistoryStateExists(const std::vector<int32>& hist) const;
 
-  int32 BosSymbol() const { return bos_symbol_; }
-  int32 EosSymbol() const { return eos_symbol_; }
+  // The offset of the LmState of <seq> in <lm_states_>, if it has children.
+  virtual int64 HistoryId(const int32 *seq, const int32 seq_size) const;
+
+  virtual int32 BosSymbol() const { return bos_symbol_; }
+  virtual int32 EosSymbol() const { return eos_symbol_; }
   int32 UnkSymbol() const { return unk_symbol_; }
-  int32 NgramOrder() const { return ngram_order_; }
+  virtual int32 NgramOrder() const { return ngram_order_; }
+
+  // Returns the number of bytes taken by the arrays of the language model.
+  int64 MemorySize() const {
+    return sizeof(int64) * (static_cast<int64>(num_words_) +
+                            overflow_buffer_size_) +
+        sizeof(int32) * static_cast<int64>(lm_states_size_);
+  }
 
  private:
+  // Returns the LmState of unigram <word> (which must be less than
+  // <num_words_>), or NULL if it has none.
+  inline const int32* UnigramState(const int32 word) const {
+    return (unigram_states_[word] == 0 ? NULL :
+            lm_states_ + unigram_states_[word] - 1);
+  }
+
+  // Sets up the arrays from the format written by WriteMappable(), at <data>,
+  // whose size in bytes is <size>. Returns false if it is not valid.
+  bool SetArrays(const char *data, size_t size);
+
   // Loops up n-gram probability for given word sequence. Backoff is handled by
   // recursively calling this function. 
-  float GetNgramLogprobRecurse(const int32 word,
-                               const std::vector<int32>& hist) const;
+  float GetNgramLogprobRecurse(const int32 word, const int32 *hist,
+                               const int32 hist_size) const;
 
-  // Given a word sequence, find the address of the corresponding LmState.
-  // Returns NULL if no corresponding LmState is found.
+  // Given a word sequence of <seq_size> words, find the address of the
+  // corresponding LmState. Returns NULL if no corresponding LmState is found.
   //
   // If the word sequence exists in n-gram language model, but it is a leaf and
   // is not an unigram, we still return NULL, since there is no LmState struct
   // reserved for this sequence. 
-  int32* GetLmState(const std::vector<int32>& seq) const;
+  const int32* GetLmState(const int32 *seq, const int32 seq_size) const;
 
   // Given a pointer to the parent, find the child_info that corresponds to
   // given word. The parent has the following structure:
@@ -121,14 +210,15 @@ class ConstArpaLm {
   //   std::pair<int32, int32> [] children;
   // }
   // It returns false if the child is not found.
-  bool GetChildInfo(const int32 word, int32* parent, int32* child_info) const;
+  bool GetChildInfo(const int32 word, const int32* parent,
+                    int32* child_info) const;
 
   // Decodes <child_info> to get log probability and child LmState. In the leaf
   // case, only <logprob> will be returned, and <child_address> will be NULL.
-  void DecodeChildInfo(const int32 child_info, int32* parent,
-                       int32** child_lm_state, float* logprob) const;
+  void DecodeChildInfo(const int32 child_info, const int32* parent,
+                       const int32** child_lm_state, float* logprob) const;
 
-  void WriteArpaRecurse(int32* lm_state,
+  void WriteArpaRecurse(const int32* lm_state,
                         const std::vector<int32>& seq,
                         std::vector<ArpaLine> *output) const;
 
@@ -136,6 +226,11 @@ class ConstArpaLm {
   // the destructor.
   bool memory_assigned_;
 
+  // If we were loaded by ReadMapped(), the mapped file, which we unmap in the
+  // destructor; otherwise NULL.
+  void *mapped_data_;
+  size_t mapped_size_;
+
   // Makes sure that the language model has been loaded before using it.
   bool initialized_;
 
@@ -165,18 +260,21 @@ class ConstArpaLm {
 
   // Points to the end of <lm_states_>. We use this information to check if
   // there is any illegal visit to the un-reserved memory.
-  int32* lm_states_end_;
+  const int32* lm_states_end_;
 
-  // Loopup table for pointers of unigrams. The pointer could be NULL, for
-  // example for those words that are in words.txt, but not in the language
-  // model.
-  int32** unigram_states_;
+  // Loopup table for the LmStates of unigrams. We store the offset of the
+  // LmState in <lm_states_> plus one, rather than a pointer, so that the table
+  // can be used in place when memory-mapped; zero means there is no LmState,
+  // for example for those words that are in words.txt, but not in the
+  // language model. See UnigramState().
+  const int64* unigram_states_;
 
   // Technically a 32-bit number cannot represent a possibly 64-bit pointer. We
   // therefore use "relative" address instead of "absolute" address, which will
   // be a small number most of the time. This buffer is for the case where the
-  // relative address has more than 30-bits.
-  int32** overflow_buffer_;
+  // relative address has more than 30-bits; it contains offsets as for
+  // <unigram_states_>.
+  const int64* overflow_buffer_;
 
   // Memory chunk that contains the actual LmStates. One LmState has the
   // following structure:
@@ -192,12 +290,154 @@ class ConstArpaLm {
   // bytes, therefore one LmState will occupy the following number of bytes:
   //
   // x = 1 + 1 + 1 + 2 * children.size() = 3 + 2 * children.size() 
-  int32* lm_states_;
+  const int32* lm_states_;
 };
 
 /**
- This class wraps a ConstArpaLm format language model with the interface defined
- in DeterministicOnDemandFst.
+ This class gives a stateful interface to a ConstArpaLm, or any other language
+ model that implements ArpaLmInterface (e.g. CompactArpaLm): instead of passing
+ the history as a word sequence, you pass a history state, which is a small
+ integer, and get back the log-probability of the word and the next history
+ state. History states are created as they are reached, and are the longest
+ suffixes of the word sequence that exist as histories in the language model.
+
+ The history states, and a direct-mapped cache of <num_cached_arcs> answers to
+ GetArc() (as in CacheDeterministicOnDemandFst), are kept in a Table. Users,
+ e.g. ConstArpaLmDeterministicFst, get the current table with AcquireTable()
+ and give it back with ReleaseTable() when they no longer need its history
+ states. So that memory use does not grow with time, once the current table has
+ more than <max_states> history states we start a new one for the next user;
+ the old one is deleted when its last user releases it.
+
+ If <thread_safe> is true, one object may be shared by several threads, e.g.
+ by ConstArpaLmDeterministicFst objects used in different threads, which then
+ share their history states and cache. The cache is then split into shards
+ with a lock each (as in SharedCacheDeterministicOnDemandFst), and the history
+ states have their own lock, which is only needed when the cache misses.
+ */
+class ConstArpaLmCache {
+ public:
+  class Table {
+   public:
+    // Returns the history state for the beginning of the sentence.
+    int32 Start() const { return 0; }
+
+    // Gets the log-probability of <word> after history state <state>, and the
+    // history state after it. Returns false if the word has zero probability,
+    // i.e. it is not in the language model and <unk> is not defined.
+    bool GetArc(int32 state, int32 word, float *logprob, int32 *next_state);
+
+    // Returns the log-probability of </s> after history state <state>.
+    float FinalLogprob(int32 state);
+
+    // Returns the number of history states created so far.
+    int32 NumStates();
+
+   private:
+    friend class ConstArpaLmCache;
+
+    Table(const ArpaLmInterface &lm, int32 num_cached_arcs, bool thread_safe);
+    ~Table();
+
+    struct CacheElement {
+      int32 state;  // -1 if the element is unused.
+      int32 word;
+      float logprob;
+      int32 next_state;
+    };
+
+    struct Shard {
+      Mutex mutex;
+      std::vector<CacheElement> elements;
+    };
+
+    // Adds a history state for the <size> words in <words>, and returns it.
+    // Requires the lock of the history states (as does FindOrAddState()).
+    int32 AddState(const int32 *words, int32 size);
+
+    // Returns the history state for the <size> words in <words>, creating it
+    // if necessary; <history_id> is its ArpaLmInterface::HistoryId(), or -1
+    // for the empty history.
+    int32 FindOrAddState(int64 history_id, const int32 *words, int32 size);
+
+    // Outputs the words of history state <state>.
+    void GetHistory(int32 state, std::vector<int32> *words);
+
+    // Works out the history state after <word> in the history <words>.
+    int32 NextState(const std::vector<int32> &words, int32 word);
+
+    const ArpaLmInterface &lm_;
+
+    // The maximum number of words in a history, lm_.NgramOrder() - 1.
+    int32 max_history_;
+
+    // The words of history state s are history_words_[s * max_history_]
+    // onwards; history_sizes_[s] of them are used.
+    std::vector<int32> history_words_;
+    std::vector<int32> history_sizes_;
+
+    // Maps the HistoryId() of each history, or -1 for the empty one, to its
+    // history state. The start state is only in this map if it is a history
+    // in the language model.
+    unordered_map<int64, int32> history_id_to_state_;
+
+    // Protects the three members above, if <thread_safe_>.
+    Mutex states_mutex_;
+
+    // The cache; the elements for (state, word) are in the shard given by
+    // their hash modulo the number of shards.
+    std::vector<Shard*> shards_;
+
+    bool thread_safe_;
+
+    // The number of users that have acquired this table and not released it;
+    // protected by the lock of the ConstArpaLmCache.
+    int32 num_users_;
+
+    KALDI_DISALLOW_COPY_AND_ASSIGN(Table);
+  };
+
+  // We don't take ownership of <lm>.
+  ConstArpaLmCache(const ArpaLmInterface &lm, int32 num_cached_arcs = 100000,
+                   bool thread_safe = false, int32 max_states = 1000000);
+
+  // All the tables must have been released.
+  ~ConstArpaLmCache();
+
+  // Returns the current table, first starting a new one if it has more than
+  // <max_states> history states. Its history states and the answers of its
+  // GetArc() stay valid until you call ReleaseTable().
+  Table *AcquireTable();
+
+  // Gives back <table>, which must have come from AcquireTable().
+  void ReleaseTable(Table *table);
+
+  const ArpaLmInterface &Lm() const { return lm_; }
+
+ private:
+  const ArpaLmInterface &lm_;
+  int32 num_cached_arcs_;
+  bool thread_safe_;
+  int32 max_states_;
+
+  // The table that AcquireTable() returns. An older table is deleted when
+  // the last of its users releases it.
+  Table *table_;
+  // The number of older tables that are still in use; the destructor checks
+  // that it is zero.
+  int32 num_retired_tables_;
+  Mutex mutex_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConstArpaLmCache);
+};
+
+/**
+ This class wraps a ConstArpaLm format language model (or any other
+ ArpaLmInterface, e.g. CompactArpaLm) with the interface defined in
+ DeterministicOnDemandFst.  Its states are those of a table of a
+ ConstArpaLmCache, which it may share with other objects; it holds the table
+ from construction to destruction, so create one of these for each utterance
+ or lattice if you want the cache to be able to start new tables.
  */
 class ConstArpaLmDeterministicFst :
     public fst::DeterministicOnDemandFst<fst::StdArc> {
@@ -206,7 +446,15 @@ class ConstArpaLmDeterministicFst :
   typedef fst::StdArc::StateId StateId;
   typedef fst::StdArc::Label Label;
 
-  ConstArpaLmDeterministicFst(const ConstArpaLm& lm);
+  // Uses a ConstArpaLmCache of its own, of the default size.
+  ConstArpaLmDeterministicFst(const ArpaLmInterface& lm);
+
+  // Uses <cache>, which may be shared with other objects (if it is shared
+  // between threads, it must have been created with thread_safe == true). We
+  // don't take ownership of <cache>.
+  explicit ConstArpaLmDeterministicFst(ConstArpaLmCache *cache);
+
+  ~ConstArpaLmDeterministicFst();
 
   // We cannot use "const" because the pure virtual function in the interface is
   // not const.
@@ -219,21 +467,25 @@ class ConstArpaLmDeterministicFst :
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
  private:
-  typedef unordered_map<std::vector<Label>,
-                        StateId, VectorHasher<Label> > MapType;
+  ConstArpaLmCache *cache_;
+  bool delete_cache_;
+  ConstArpaLmCache::Table *table_;
   StateId start_state_;
-  MapType wseq_to_state_;
-  std::vector<std::vector<Label> > state_to_wseq_;
-  const ConstArpaLm& lm_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConstArpaLmDeterministicFst);
 };
 
 // Reads in an Arpa format language model and converts it into ConstArpaLm
 // format. We assume that the words in the input Arpa format language model have
-// been converted into integers.
+// been converted into integers. <options> controls how the Arpa file is parsed
+// (see ArpaFileParser). If <mappable> is true, it is written in the format that
+// ConstArpaLm::ReadMapped() can memory-map (see ConstArpaLm::WriteMappable()).
 bool BuildConstArpaLm(const bool natural_base, const int32 bos_symbol,
                       const int32 eos_symbol, const int32 unk_symbol,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename);
+                      const std::string& const_arpa_wxfilename,
+                      const ArpaParseOptions &options = ArpaParseOptions(),
+                      const bool mappable = false);
 
 } // namespace kaldi
 
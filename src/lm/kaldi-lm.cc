@@ -101,7 +101,7 @@ fst::StdVectorFst* LangModelFst::ReadStream(
     delete psyms;
 
     if (gtype == kArpaLm) {
-      LmTable lmt;
+      LmTable lmt(arpa_opts_);
       lmt.ReadFstFromLmFile(strm, pfst_, useNaturalLog, startSent, endSent);
     } else if (gtype== kTextString) {
       ReadTxtString(strm);
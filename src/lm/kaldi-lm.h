@@ -64,12 +64,15 @@ class LangModelFst: public fst::VectorFst<fst::StdArc> {
   typedef fst::StdArc::StateId StateId;
   
 
-  LangModelFst() {
+  /// <arpa_opts> controls how ARPA files are parsed (see ArpaFileParser).
+  explicit LangModelFst(const ArpaParseOptions &arpa_opts = ArpaParseOptions())
+      : arpa_opts_(arpa_opts) {
     pfst_ = new fst::VectorFst<fst::StdArc>;
   }
 
   LangModelFst(const LangModelFst &lm)
-    : pfst_(lm.pfst_ ? new fst::VectorFst<fst::StdArc>(*(lm.pfst_)) : 0) {}
+    : arpa_opts_(lm.arpa_opts_),
+      pfst_(lm.pfst_ ? new fst::VectorFst<fst::StdArc>(*(lm.pfst_)) : 0) {}
 
   ~LangModelFst() {
     if (pfst_) delete pfst_;
@@ -131,6 +134,7 @@ class LangModelFst: public fst::VectorFst<fst::StdArc> {
   }
 
  private:
+  ArpaParseOptions arpa_opts_;
   fst::VectorFst<fst::StdArc> *pfst_;
   fst::VectorFst<fst::StdArc>* ReadStream(std::istream &strm,
                                           const string &sourcename,
@@ -32,35 +32,24 @@ namespace kaldi {
 // typedef fst::StdArc::StateId StateId;
 
 // newly_added will be updated
-LmFstConverter::StateId LmFstConverter::AddStateFromSymb(
-    const std::vector<string> &ngramString,
+LmFstConverter::StateId LmFstConverter::AddStateFromWords(
+    const std::vector<int32> &words,
     int kstart, int kend,
     fst::StdVectorFst *pfst,
     bool &newly_added) {
   fst::StdArc::StateId sid;
-  std::string separator;
-  separator.resize(1);
-  separator[0] = '\0';
-  
-  std::string hist;
-  if (kstart == 0) {
-    hist.append(separator);
-  } else {
-    for (int k = kstart; k >= kend; k--) {
-      hist.append(ngramString[k]);
-      hist.append(separator);
-    }
-  }
+  int n = words.size();
+
+  std::vector<int32> hist;
+  if (kstart != 0)
+    hist.assign(words.begin() + (n - kstart), words.begin() + (n - kend + 1));
 
   newly_added = false;
   sid = FindState(hist);
   if (sid < 0) {
     sid = pfst->AddState();
-    hist_state_[hist] = sid; 
+    hist_state_[hist] = sid;
     newly_added = true;
-    //cerr << "Created state " << sid << " for " << hist << endl;
-  } else {
-    //cerr << "State symbol " << hist << " already exists" << endl;
   }
 
   return sid;
@@ -95,76 +84,129 @@ void LmFstConverter::AddArcsForNgramProb(
     fst::StdVectorFst *fst,
     const string startSent,
     const string endSent) {
+  if (ngram[1] == "<eps>") {
+    KALDI_ERR << "The word <eps> is not allowed as a word in an ARPA LM.";
+  }
+  // add labels to symbol tables
+  std::vector<int32> words(ngram_order);
+  for (int i = 0; i < ngram_order; i++) {
+    words[i] = fst->MutableInputSymbols()->AddSymbol(ngram[ngram_order - i]);
+    fst->MutableOutputSymbols()->AddSymbol(ngram[ngram_order - i]);
+  }
+  int32 bos = fst->MutableInputSymbols()->AddSymbol(startSent),
+      eos = fst->MutableInputSymbols()->AddSymbol(endSent);
+  AddArcsForNgramProb(ngram_order, max_ngram_order, logProb, logBow,
+                      words, fst, bos, eos);
+}
+
+void LmFstConverter::AddArcsForNgramProb(
+    int ngram_order, int max_ngram_order,
+    float logProb,
+    float logBow,
+    const std::vector<int32> &words,
+    fst::StdVectorFst *fst,
+    int32 bos,
+    int32 eos) {
+  KALDI_ASSERT(static_cast<int>(words.size()) == ngram_order);
   fst::StdArc::StateId src, dst, dbo;
-  std::string curwrd = ngram[1];
-  if (curwrd == "<eps>") {
+  int32 curwrd = words.back();
+  if (curwrd == 0) {
     KALDI_ERR << "The word <eps> is not allowed as a word in an ARPA LM.";
   }
-  int64 ilab, olab;
   LmWeight prob = ConvertArpaLogProbToWeight(logProb);
   LmWeight bow  = ConvertArpaLogProbToWeight(logBow);
   bool newSrc, newDbo, newDst = false;
 
   if (ngram_order >= 2) {
     // General case works from N down to 2-grams
-    src = AddStateFromSymb(ngram, ngram_order, 2, fst, newSrc);
+    src = AddStateFromWords(words, ngram_order, 2, fst, newSrc);
     if (ngram_order != max_ngram_order) {
       // add all intermediate levels from 2 to current
       // last ones will be current backoff source and destination
       for (int i = 2; i <= ngram_order; i++) {
-        dst = AddStateFromSymb(ngram, i,   1, fst, newDst);
-        dbo = AddStateFromSymb(ngram, i-1, 1, fst, newDbo);
+        dst = AddStateFromWords(words, i,   1, fst, newDst);
+        dbo = AddStateFromWords(words, i-1, 1, fst, newDbo);
         backoff_state_[dst] = dbo;
       }
     } else {
       // add all intermediate levels from 2 to current
       // last ones will be current backoff source and destination
       for (int i = 2; i <= ngram_order; i++) {
-        dst = AddStateFromSymb(ngram, i-1, 1, fst, newDst);
-        dbo = AddStateFromSymb(ngram, i-2, 1, fst, newDbo);
+        dst = AddStateFromWords(words, i-1, 1, fst, newDst);
+        dbo = AddStateFromWords(words, i-2, 1, fst, newDbo);
         backoff_state_[dst] = dbo;
       }
     }
   } else {
     // special case for 1-grams: start from 0-gram
-    if (curwrd.compare(startSent) != 0) {
-      src = AddStateFromSymb(ngram, 0, 1, fst, newSrc);
+    if (curwrd != bos) {
+      src = AddStateFromWords(words, 0, 1, fst, newSrc);
     } else {
       // extra special case if in addition we are at beginning of sentence
       // starts from initial state and has no cost
       src = fst->Start();
       prob = fst::StdArc::Weight::One();
     }
-    dst = AddStateFromSymb(ngram, 1, 1, fst, newDst);
-    dbo = AddStateFromSymb(ngram, 0, 1, fst, newDbo);
+    dst = AddStateFromWords(words, 1, 1, fst, newDst);
+    dbo = AddStateFromWords(words, 0, 1, fst, newDbo);
     backoff_state_[dst] = dbo;
   }
 
   // state is final if last word is end of sentence
-  if (curwrd.compare(endSent) == 0) {
+  if (curwrd == eos) {
     fst->SetFinal(dst, fst::StdArc::Weight::One());
   }
-  // add labels to symbol tables
-  ilab = fst->MutableInputSymbols()->AddSymbol(curwrd);
-  olab = fst->MutableOutputSymbols()->AddSymbol(curwrd);
 
   // add arc with weight "prob" between source and destination states
-  // cerr << "n-gram prob, fstAddArc: src "<< src << " dst " << dst;
-  // cerr << " lab " << ilab << endl;
-  fst->AddArc(src, fst::StdArc(ilab, olab, prob, dst));
+  fst->AddArc(src, fst::StdArc(curwrd, curwrd, prob, dst));
 
   // add backoffs to any newly created destination state
   // but only if non-final
   if (!IsFinal(fst, dst) && newDst && dbo != dst) {
-    ilab = olab = 0;
-    // cerr << "backoff, fstAddArc: src "<< src << " dst " << dst;
-    // cerr << " lab " << ilab << endl;
-    fst->AddArc(dst, fst::StdArc(ilab, olab, bow, dbo));
+    fst->AddArc(dst, fst::StdArc(0, 0, bow, dbo));
   }
 }
 
 #ifndef HAVE_IRSTLM
 
+/// ArpaFileParser that gives the n-grams to an LmFstConverter; the words are
+/// added to the input symbol table of the FST as the unigrams are read.
+class LmFstArpaParser : public ArpaFileParser {
+ public:
+  LmFstArpaParser(const ArpaParseOptions &opts, LmFstConverter *conv,
+                  fst::StdVectorFst *fst, int32 bos, int32 eos):
+      ArpaFileParser(opts, fst->MutableInputSymbols()), conv_(conv),
+      fst_(fst), bos_(bos), eos_(eos) { }
+
+ protected:
+  virtual void ConsumeNGram(const NGram &ngram) {
+    const std::vector<int32> &words = ngram.words;
+    int32 ngram_order = words.size();
+    // Checks if <s> only appears at the beginning of the ngram, and if </s>
+    // only appears at the end of the ngram.
+    if (ngram_order > 1) {
+      for (int32 i = 0; i < ngram_order; i++) {
+        if ((i != 0 && words[i] == bos_) ||
+            (i != ngram_order - 1 && words[i] == eos_)) {
+          KALDI_WARN << "<s> is not at the beginning of the n-gram, or </s> "
+                     << "is not at the end of the n-gram, skipping it.";
+          return;
+        }
+      }
+    }
+    // Backoff weights of the highest order are ignored.
+    float bow = (ngram_order < NgramOrder() ? ngram.backoff : 0.0);
+    conv_->AddArcsForNgramProb(ngram_order, NgramOrder(), ngram.logprob, bow,
+                               words, fst_, bos_, eos_);
+  }
+
+ private:
+  LmFstConverter *conv_;
+  fst::StdVectorFst *fst_;
+  int32 bos_;
+  int32 eos_;
+};
+
 bool LmTable::ReadFstFromLmFile(std::istream &istrm,
                                 fst::StdVectorFst *fst,
                                 bool useNaturalOpt,
@@ -177,162 +219,19 @@ bool LmTable::ReadFstFromLmFile(std::istream &istrm,
 
   conv_->UseNaturalLog(useNaturalOpt);
 
-  // do not use state symbol table for word histories anymore
-  string inpline;
-  size_t pos1, pos2;
-  int ngram_order, max_ngram_order = 0;
+  fst::SymbolTable *symbols = fst->MutableInputSymbols();
+  if (symbols->Find("<eps>") != 0)
+    KALDI_ERR << "The symbol table must have <eps> as symbol zero.";
+  int32 bos = symbols->AddSymbol(startSent),
+      eos = symbols->AddSymbol(endSent);
 
-  // process \data\ section
-
-  while (getline(istrm, inpline) && !istrm.eof()) {
-    std::istringstream ss(inpline);
-    std::string token;
-    ss >> token >> std::ws;
-    if (token == "\\data\\" && ss.eof()) break;
-  }
-  if (istrm.eof()) {
-    KALDI_ERR << "\\data\\ token not found in arpa file.";
-  }
-
-  while (getline(istrm, inpline) && !istrm.eof()) {
-    // break out of loop if another section is found
-    if (inpline.find("-grams:") != string::npos) break;
-    if (inpline.find("\\end\\") != string::npos) break;
-
-    // look for valid "ngram N = M" lines
-    pos1 = inpline.find("ngram");
-    pos2 = inpline.find("=");
-    if (pos1 == string::npos ||  pos2 == string::npos || pos2 <= pos1) {
-      continue;  // not valid, continue looking
-    }
-    // found valid line
-    ngram_order = atoi(inpline.substr(pos1+5, pos2-(pos1+5)).c_str());
-    if (ngram_order > max_ngram_order) {
-      max_ngram_order = ngram_order;
-    }
-  }
-  if (max_ngram_order == 0) {
-    // reached end of loop without having found any n-gram
-    KALDI_ERR << "No ngrams found in specified file";
-  }
-
-  // process "\N-grams:" sections, we may have already read a "\N-grams:" line
-  // if so, process it, otherwise get another line
-  while (inpline.find("-grams:") != string::npos
-         || (getline(istrm, inpline) && !istrm.eof()) ) {
-    // look for a valid "\N-grams:" section
-    pos1 = inpline.find("\\");
-    pos2 = inpline.find("-grams:");
-    if (pos1 == string::npos || pos2 == string::npos || pos2 <= pos1) {
-      continue;  // not valid line, continue looking for one
-    }
-    // found, set current level
-    ngram_order = atoi(inpline.substr(pos1+1, pos2-(pos1+1)).c_str());
-    cerr << "Processing " << ngram_order << "-grams" << endl;
-
-    // process individual n-grams
-    while (getline(istrm, inpline) && !istrm.eof()) {
-      // break out of inner loop if another section is found
-      if (!inpline.empty() && inpline[0] == '\\') {
-        if (inpline.find("-grams:") != string::npos) break;
-        if (inpline.find("\\end\\") != string::npos) break;
-      }
-      // parse ngram line: first field = prob, other fields = words,
-      // last field = backoff (optional)
-      std::vector<string> ngramString;
-      float prob, bow;
-
-      // eat up space.
-      const char *cur_cstr = inpline.c_str();
-      while (*cur_cstr && isspace(*cur_cstr))
-        cur_cstr++;
-
-      if (*cur_cstr == '\0') // Ignore empty lines.
-        continue;
-      char *next_cstr;
-      // found, parse probability from first field
-      prob = KALDI_STRTOF(cur_cstr, &next_cstr);
-      if (prob != prob || prob - prob != 0) {
-        KALDI_ERR << "nan or inf detected in LM file [parsing " << (ngram_order)
-            << "-grams]: " << inpline;
-      }
-      if (next_cstr == cur_cstr)
-        KALDI_ERR << "Bad line in LM file [parsing "<<(ngram_order)<<"-grams]: "<<inpline;
-      cur_cstr = next_cstr;
-      while (*cur_cstr && isspace(*cur_cstr))
-        cur_cstr++;
-
-      // element 0 will be empty, element 1 will be the current word,
-      // element 2 will be the immediately preceding word, and so on.
-      // Apparently an IRSTLM convention.
-      ngramString.resize(ngram_order + 1);
-      
-      bool illegal_bos_or_eos = false;
-      for (int i = 0; i < ngram_order; i++) {
-        if (*cur_cstr == '\0')
-          KALDI_ERR << "Bad line in LM file [parsing "<<(ngram_order)<<"-grams]: "<<inpline;
-
-        const char *end_cstr = strpbrk(cur_cstr, " \t\r");
-        std::string this_word;
-        if (end_cstr == NULL) {
-          this_word = std::string(cur_cstr);
-          cur_cstr += strlen(cur_cstr);
-        } else {
-          this_word = std::string(cur_cstr, end_cstr-cur_cstr);
-          cur_cstr = end_cstr;
-          while (*cur_cstr && isspace(*cur_cstr))
-            cur_cstr++;
-        }
-
-        // Checks if <s> only appears at the beginning of the ngram, and if </s>
-        // only appears at the end of the ngram.
-        if ((ngram_order > 1 && i != 0 && this_word == "<s>") ||
-            (ngram_order > 1 && i != ngram_order - 1 && this_word == "</s>")) {
-          illegal_bos_or_eos = true;
-          break;
-        }
-
-        ngramString[ngram_order - i].swap(this_word);
-      }
-      if (illegal_bos_or_eos) {
-        KALDI_WARN << "<s> is not at the beginning of the n-gram, or </s> is "
-            << "not at the end of the n-gram, skipping it: " << inpline;
-        continue;
-      }
-
-      bow = 0;
-      if (ngram_order < max_ngram_order) {
-        // try converting anything left in the line to a backoff weight
-        if (*cur_cstr != '\0') {
-          char *end_cstr;
-          bow = KALDI_STRTOF(cur_cstr, &end_cstr);
-          if (bow != bow || bow - bow != 0) {
-            KALDI_ERR << "nan or inf detected in LM file [parsing " << (ngram_order)
-                << "-grams]: " << inpline;
-          }
-          if (end_cstr != cur_cstr) {  // got something.
-            while (*end_cstr != '\0' && isspace(*end_cstr))
-              end_cstr++;
-            if (*end_cstr != '\0')
-              KALDI_ERR << "Junk " << (end_cstr) << " at end of line [parsing "
-                        << (ngram_order) << "-grams]" << inpline;
-          } else {
-            KALDI_ERR << "Junk " << (cur_cstr) << " at end of line [parsing "
-                      << (ngram_order) << "-grams]" << inpline;
-          }
-        }
-      }
-      conv_->AddArcsForNgramProb(ngram_order, max_ngram_order, prob, bow,
-                                 ngramString, fst,
-                                 startSent, endSent);
-    }  // end of loop on individual n-gram lines
-  }
+  LmFstArpaParser parser(opts_, conv_, fst, bos, eos);
+  parser.Read(istrm);
 
   conv_->ConnectUnusedStates(fst);
 
-  // not used anymore: delete pStateSymbs;
-
-  // input and output symbol tables will be deleted by ~fst()
+  // the words were only added to the input symbol table.
+  fst->SetOutputSymbols(fst->InputSymbols());
   return true;
 }
 
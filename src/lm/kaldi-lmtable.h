@@ -48,6 +48,7 @@ using std::tr1::unordered_map;
 #include "fst/fst-decl.h"
 #include "fst/arc.h"
 #include "base/kaldi-common.h"
+#include "lm/arpa-file-parser.h"
 #include "util/stl-utils.h"
 
 namespace kaldi {
@@ -69,7 +70,9 @@ class LmFstConverter {
   typedef fst::StdArc::StateId StateId;
   
   typedef unordered_map<StateId, StateId> BackoffStateMap;
-  typedef unordered_map<std::string, StateId, StringHasher> HistStateMap;
+  // Maps word histories (in the order of the words in the file) to states.
+  typedef unordered_map<std::vector<int32>, StateId,
+                        VectorHasher<int32> > HistStateMap;
 
  public:
 
@@ -79,6 +82,10 @@ class LmFstConverter {
 
   void UseNaturalLog(bool use_natural) { use_natural_log_ = use_natural; }
 
+  /// Adds the arcs for one n-gram. Element 0 of <ngs> is unused, element 1
+  /// is the current word, element 2 the immediately preceding word, and so
+  /// on (the IRSTLM convention). The words are added to the symbol tables of
+  /// <fst> and the n-gram is then given to the version below.
   void AddArcsForNgramProb(int ilev,
                            int maxlev,
                            float prob,
@@ -88,6 +95,19 @@ class LmFstConverter {
                            const string startSent,
                            const string endSent);
 
+  /// As above, but <words> are the labels of the words, in the order they
+  /// appear in the ARPA file (so the current word is the last one); the
+  /// labels must already be in the symbol tables of <fst>. <bos> and <eos>
+  /// are the labels of the begin- and end-of-sentence symbols.
+  void AddArcsForNgramProb(int ilev,
+                           int maxlev,
+                           float prob,
+                           float bow,
+                           const std::vector<int32> &words,
+                           fst::StdVectorFst *fst,
+                           int32 bos,
+                           int32 eos);
+
   float ConvertArpaLogProbToWeight(float lp) {
     if ( use_natural_log_ ) {
       // convert from arpa base 10 log to natural base, then to cost
@@ -106,14 +126,17 @@ class LmFstConverter {
   void ConnectUnusedStates(fst::StdVectorFst *pfst);
 
  private:
-  StateId AddStateFromSymb(const std::vector<string> &ngramString,
+  // Returns the state for the history made of the words that are <kstart>
+  // down to <kend> positions from the end of <words> (counting the last word
+  // as 1); kstart == 0 means the empty history.
+  StateId AddStateFromWords(const std::vector<int32> &words,
                             int kstart,
                             int kend,
                             fst::StdVectorFst *pfst,
                             bool &newly_added);
 
-  StateId FindState(const std::string str) {
-    HistStateMap::const_iterator it = hist_state_.find(str);
+  StateId FindState(const std::vector<int32> &hist) {
+    HistStateMap::const_iterator it = hist_state_.find(hist);
      if (it == hist_state_.end()) return -1;
      else return it->second;
   }
@@ -132,15 +155,20 @@ class LmFstConverter {
 */
 class LmTable {
  public:
-  LmTable() { conv_ = new LmFstConverter; }
+  /// <opts> controls how the ARPA file is parsed (see ArpaFileParser).
+  explicit LmTable(const ArpaParseOptions &opts = ArpaParseOptions()):
+      opts_(opts) { conv_ = new LmFstConverter; }
   ~LmTable() { if (conv_) delete conv_; }
 
+  /// Words are added to the input symbol table of <pfst> as they are read in
+  /// the unigram section; the output symbol table is then set to the same.
   bool ReadFstFromLmFile(std::istream &istrm,
                          fst::StdVectorFst *pfst,
                          bool useNaturalLog,
                          const string startSent,
                          const string endSent);
  private:
+  ArpaParseOptions opts_;
   LmFstConverter *conv_;
 };
 
@@ -153,7 +181,10 @@ class LmTable {
 /// in order to access internal data needed to create an FST.
 class LmTable : public lmtable {
  public:
-  LmTable() { conv_ = new LmFstConverter; }
+  /// <opts> is not used: IRSTLM reads the file itself.
+  explicit LmTable(const ArpaParseOptions &opts = ArpaParseOptions()) {
+    conv_ = new LmFstConverter;
+  }
   ~LmTable() { if (conv_) delete conv_; }
 
   /// in this implementation, needed functions come from parent class, e.g.
@@ -48,6 +48,9 @@ int main(int argc, char *argv[]) {
     int32 unk_symbol = -1;
     int32 bos_symbol = -1;
     int32 eos_symbol = -1;
+    bool mappable = false;
+    ArpaParseOptions arpa_opts;
+    arpa_opts.Register(&po);
     po.Register("natural-base", &natural_base,
                 "If true, use log-base e instead of log-base 10.");
     po.Register("unk-symbol", &unk_symbol,
@@ -59,6 +62,10 @@ int main(int argc, char *argv[]) {
     po.Register("eos-symbol", &eos_symbol,
                 "Integer corresponds to </s>. You must set this to your actual "
                 "EOS integer.");
+    po.Register("mappable", &mappable,
+                "If true, write the language model in a format that programs "
+                "can memory-map instead of reading it, which makes loading "
+                "it fast. Older versions of Kaldi can't read this format.");
 
     po.Read(argc, argv);
 
@@ -77,7 +84,8 @@ int main(int argc, char *argv[]) {
 
     bool ans = BuildConstArpaLm(natural_base, bos_symbol,
                                 eos_symbol, unk_symbol,
-                                arpa_rxfilename, const_arpa_wxfilename);
+                                arpa_rxfilename, const_arpa_wxfilename,
+                                arpa_opts, mappable);
 
     if (ans)
       return 0;
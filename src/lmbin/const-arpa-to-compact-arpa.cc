@@ -0,0 +1,123 @@
+// lmbin/const-arpa-to-compact-arpa.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "base/timer.h"
+#include "lm/compact-arpa-lm.h"
+#include "util/parse-options.h"
+
+int main(int argc, char *argv[]) {
+  using namespace kaldi;
+  typedef kaldi::int32 int32;
+  try {
+    const char *usage  =
+        "Converts a ConstArpaLm format language model into CompactArpaLm\n"
+        "format, which stores the n-grams in bit-packed hash tables with\n"
+        "quantized log-probabilities. Unless --num-test-queries=0, it then\n"
+        "reports the sizes of the two, and the error and speed of the\n"
+        "compact one, on queries made from the n-grams of the language model\n"
+        "(half of them with the last word changed, so that they back off).\n"
+        "\n"
+        "Usage: const-arpa-to-compact-arpa [opts] <const-arpa> <compact-arpa>\n"
+        " e.g.: const-arpa-to-compact-arpa --logprob-bits=8 G.carpa G.compact";
+
+    ParseOptions po(usage);
+
+    CompactArpaLmOptions opts;
+    bool binary = true;
+    int32 num_test_queries = 100000;
+    opts.Register(&po);
+    po.Register("binary", &binary, "Write output in binary mode");
+    po.Register("num-test-queries", &num_test_queries, "Number of queries "
+                "for the report on accuracy and speed.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string const_arpa_rxfilename = po.GetArg(1),
+        compact_arpa_wxfilename = po.GetArg(2);
+
+    ConstArpaLm const_arpa;
+    const_arpa.ReadMapped(const_arpa_rxfilename);
+
+    CompactArpaLm compact_arpa;
+    compact_arpa.Init(const_arpa, opts);
+    WriteKaldiObject(compact_arpa, compact_arpa_wxfilename, binary);
+
+    KALDI_LOG << "ConstArpaLm takes " << const_arpa.MemorySize()
+              << " bytes, CompactArpaLm takes " << compact_arpa.MemorySize()
+              << " bytes (" << (static_cast<double>(const_arpa.MemorySize()) /
+                                compact_arpa.MemorySize())
+              << " times smaller).";
+
+    if (num_test_queries > 0) {
+      std::vector<ArpaLine> lines;
+      const_arpa.GetArpaLines(&lines);
+      std::vector<std::vector<int32> > queries(num_test_queries);
+      for (int32 i = 0; i < num_test_queries; i++) {
+        queries[i] = lines[RandInt(0, lines.size() - 1)].words;
+        if (i % 2 == 1)
+          queries[i].back() = lines[RandInt(0, lines.size() - 1)].words.back();
+      }
+      lines.clear();
+
+      std::vector<float> logprobs(num_test_queries),
+          compact_logprobs(num_test_queries);
+      Timer timer;
+      for (int32 i = 0; i < num_test_queries; i++) {
+        const std::vector<int32> &q = queries[i];
+        logprobs[i] = const_arpa.GetNgramLogprob(q.back(), &(q[0]),
+                                                 q.size() - 1);
+      }
+      double const_arpa_time = timer.Elapsed();
+      timer.Reset();
+      for (int32 i = 0; i < num_test_queries; i++) {
+        const std::vector<int32> &q = queries[i];
+        compact_logprobs[i] = compact_arpa.GetNgramLogprob(q.back(), &(q[0]),
+                                                           q.size() - 1);
+      }
+      double compact_arpa_time = timer.Elapsed();
+
+      double tot_error = 0.0, max_error = 0.0;
+      for (int32 i = 0; i < num_test_queries; i++) {
+        double error = std::abs(logprobs[i] - compact_logprobs[i]);
+        tot_error += error;
+        max_error = std::max(max_error, error);
+      }
+      KALDI_LOG << "Over " << num_test_queries << " queries, the average "
+                << "absolute error in log-probability is "
+                << (tot_error / num_test_queries) << " and the maximum is "
+                << max_error;
+      KALDI_LOG << "Time per query is " << (1.0e+09 * const_arpa_time /
+                                            num_test_queries)
+                << " ns for ConstArpaLm and " << (1.0e+09 * compact_arpa_time /
+                                                 num_test_queries)
+                << " ns for CompactArpaLm.";
+    }
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
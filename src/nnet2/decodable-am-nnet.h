@@ -79,6 +79,16 @@ class DecodableAmNnet: public DecodableInterface {
                       trans_model_.TransitionIdToPdf(transition_id));
   }
 
+  virtual void LogLikelihoods(int32 frame,
+                              const std::vector<int32> &transition_ids,
+                              std::vector<BaseFloat> *loglikes) {
+    loglikes->resize(transition_ids.size());
+    const BaseFloat *row_data = log_probs_.RowData(frame);
+    for (size_t i = 0; i < transition_ids.size(); i++)
+      (*loglikes)[i] =
+          row_data[trans_model_.TransitionIdToPdf(transition_ids[i])];
+  }
+
   virtual int32 NumFramesReady() const { return log_probs_.NumRows(); }
   
   // Indices are one-based!  This is for compatibility with OpenFst.
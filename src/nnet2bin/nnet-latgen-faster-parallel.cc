@@ -48,11 +48,13 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
+    CompactLatticeWriteOptions lattice_write_opts;
     TaskSequencerConfig sequencer_config; // has --num-threads option
     
     std::string word_syms_filename;
     sequencer_config.Register(&po);
     config.Register(&po);
+    lattice_write_opts.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
@@ -83,7 +85,8 @@ int main(int argc, char *argv[]) {
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
@@ -107,10 +110,14 @@ int main(int argc, char *argv[]) {
     kaldi::int64 frame_count = 0;
     int num_done = 0, num_err = 0;
     VectorFst<StdArc> *decode_fst = NULL;
+    LatticeFasterDecoderPool *decoder_pool = NULL;  // only used if there is a
+                                                    // single decoding graph.
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
 
       decode_fst = fst::ReadFstKaldi(fst_in_str);
+      // Decoders are reused across utterances, keeping their storage.
+      decoder_pool = new LatticeFasterDecoderPool(*decode_fst, config);
 
       {
     
@@ -128,16 +135,14 @@ int main(int argc, char *argv[]) {
               new CuMatrix<BaseFloat>(features),
               pad_input, acoustic_scale);
 
-          LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
-                                                                   config);
-
           DecodeUtteranceLatticeFasterClass *task =
               new DecodeUtteranceLatticeFasterClass(
-                  decoder, nnet_decodable, // takes ownership of these two.
+                  NULL, nnet_decodable, // takes ownership of the decodable.
                   trans_model, word_syms, utt, acoustic_scale, determinize,
                   allow_partial, &alignment_writer, &words_writer,
                   &compact_lattice_writer, &lattice_writer,
-                  &tot_like, &frame_count, &num_done, &num_err, NULL);
+                  &tot_like, &frame_count, &num_done, &num_err, NULL,
+                  decoder_pool);
               
           sequencer.Run(task); // takes ownership of "task",
                                // and will delete it when done.
@@ -184,6 +189,7 @@ int main(int argc, char *argv[]) {
       }
     }
     sequencer.Wait(); // Waits for all tasks to be done.
+    delete decoder_pool;  // must be deleted before decode_fst.
     if (decode_fst != NULL) delete decode_fst;   
     
     double elapsed = timer.Elapsed();
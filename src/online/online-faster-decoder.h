@@ -83,7 +83,11 @@ class OnlineFasterDecoder : public FasterDecoder {
       : FasterDecoder(fst, opts), opts_(opts),
         silence_set_(sil_phones), trans_model_(trans_model),
         max_beam_(opts.beam), effective_beam_(FasterDecoder::config_.beam),
-        state_(kEndFeats), frame_(0), utt_frames_(0) {}
+        state_(kEndFeats), frame_(0), utt_frames_(0) {
+    if (opts.rtf_opts.Enabled())
+      KALDI_WARN << "--target-rtf is ignored by this decoder, which adjusts "
+                 << "the beam itself (see --rt-min and --rt-max).";
+  }
 
   DecodeState Decode(DecodableInterface *decodable);
   
@@ -329,12 +329,19 @@ void SingleUtteranceNnet2DecoderThreaded::GetLattice(
                    CompactLatticeWeight::One());
     return;
   }
+  if (!config_.decoder_opts.determinize_lattice) {
+    const_cast<Mutex&>(decoder_mutex_).Unlock();
+    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
+  }
+  if (config_.decoder_opts.determinize_period > 0) {
+    // The lattice was mostly determinized during decoding.
+    decoder_.GetLattice(clat, end_of_utterance);
+    const_cast<Mutex&>(decoder_mutex_).Unlock();
+    return;
+  }
   Lattice raw_lat;
   decoder_.GetRawLattice(&raw_lat, end_of_utterance);
   const_cast<Mutex&>(decoder_mutex_).Unlock();
-  
-  if (!config_.decoder_opts.determinize_lattice)
-    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
   BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
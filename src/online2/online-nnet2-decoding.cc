@@ -53,12 +53,17 @@ void SingleUtteranceNnet2Decoder::GetLattice(bool end_of_utterance,
                                              CompactLattice *clat) const {
   if (NumFramesDecoded() == 0)
     KALDI_ERR << "You cannot get a lattice if you decoded no frames.";
-  Lattice raw_lat;
-  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
-
   if (!config_.decoder_opts.determinize_lattice)
     KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
+  if (config_.decoder_opts.determinize_period > 0) {
+    // The lattice was mostly determinized during decoding.
+    decoder_.GetLattice(clat, end_of_utterance);
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+
   BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
       tmodel_, &raw_lat, lat_beam, clat, config_.decoder_opts.det_opts);
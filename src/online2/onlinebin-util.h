@@ -33,7 +33,8 @@
 
 namespace kaldi {
 
-// Reads a decoding graph from a file
+// Reads a decoding graph from a file (OpenFst "vector" or "const" type, or
+// the memory-mapped "flat" format; see fstext/flat-fst.h).
 fst::Fst<fst::StdArc> *ReadDecodeGraph(std::string filename);
 
 // Prints a string corresponding to (a possibly partial) decode result as
@@ -95,6 +95,7 @@ int main(int argc, char *argv[]) {
     OnlineEndpointConfig endpoint_config;
     OnlineFeaturePipelineCommandLineConfig feature_cmdline_config;
     OnlineGmmDecodingConfig decode_config;
+    CompactLatticeWriteOptions lattice_write_opts;
     
     BaseFloat chunk_length_secs = 0.05;
     bool do_endpointing = false;
@@ -109,6 +110,7 @@ int main(int argc, char *argv[]) {
     
     feature_cmdline_config.Register(&po);
     decode_config.Register(&po);
+    lattice_write_opts.Register(&po);
     endpoint_config.Register(&po);
     
     po.Read(argc, argv);
@@ -129,7 +131,7 @@ int main(int argc, char *argv[]) {
     OnlineGmmDecodingModels gmm_models(decode_config);
     
     
-    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
+    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldiGeneric(fst_rxfilename);
     
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_rxfilename != "")
@@ -143,7 +145,7 @@ int main(int argc, char *argv[]) {
     
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
     RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
-    CompactLatticeWriter clat_writer(clat_wspecifier);
+    CompactLatticeWriter clat_writer(clat_wspecifier, lattice_write_opts);
     
     OnlineTimingStats timing_stats;
     
@@ -103,6 +103,7 @@ int main(int argc, char *argv[]) {
     // as well as the basic features.
     OnlineNnet2FeaturePipelineConfig feature_config;  
     OnlineNnet2DecodingThreadedConfig nnet2_decoding_config;
+    CompactLatticeWriteOptions lattice_write_opts;
     
     BaseFloat chunk_length_secs = 0.05;
     bool do_endpointing = false;
@@ -132,6 +133,7 @@ int main(int argc, char *argv[]) {
     
     feature_config.Register(&po);
     nnet2_decoding_config.Register(&po);
+    lattice_write_opts.Register(&po);
     endpoint_config.Register(&po);
     
     po.Read(argc, argv);
@@ -163,7 +165,7 @@ int main(int argc, char *argv[]) {
       am_nnet.Read(ki.Stream(), binary);
     }
     
-    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
+    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldiGeneric(fst_rxfilename);
     
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_rxfilename != "")
@@ -178,7 +180,7 @@ int main(int argc, char *argv[]) {
     
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
     RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
-    CompactLatticeWriter clat_writer(clat_wspecifier);
+    CompactLatticeWriter clat_writer(clat_wspecifier, lattice_write_opts);
     
     OnlineTimingStats timing_stats;
     
@@ -125,8 +125,10 @@ int main(int argc, char *argv[]) {
         utt2spk_rspecifier;
 
     LatticeFasterDecoderConfig decoder_opts;
+    CompactLatticeWriteOptions lattice_write_opts;
     TaskSequencerConfig sequencer_config; // has --num-threads option
     decoder_opts.Register(&po);
+    lattice_write_opts.Register(&po);
     sequencer_config.Register(&po);
 
     po.Register("acoustic-scale", &acoustic_scale,
@@ -182,7 +184,8 @@ int main(int argc, char *argv[]) {
     LatticeWriter lattice_writer;
     
     bool determinize = decoder_opts.determinize_lattice;    
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                 << lattice_wspecifier;
@@ -105,7 +105,9 @@ int main(int argc, char *argv[]) {
         utt2spk_rspecifier;
 
     LatticeFasterDecoderConfig decoder_opts;
+    CompactLatticeWriteOptions lattice_write_opts;
     decoder_opts.Register(&po);    
+    lattice_write_opts.Register(&po);
 
     po.Register("acoustic-scale", &acoustic_scale,
         "Scaling factor for acoustic likelihoods");
@@ -150,7 +152,8 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter compact_lattice_writer;
     LatticeWriter lattice_writer;
     bool determinize = decoder_opts.determinize_lattice;    
-    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier,
+                                                     lattice_write_opts)
            : lattice_writer.Open(lattice_wspecifier)))
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
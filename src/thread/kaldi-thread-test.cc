@@ -81,6 +81,42 @@ void TestThreads() {
   }
 }
 
+class MySumJob: public PersistentMultiThreader::Job {
+ public:
+  // Each thread sums up part of the integers from 0 to max_to_count-1.
+  MySumJob(int32 max_to_count, int32 num_threads):
+      max_to_count_(max_to_count), partial_sums_(num_threads, 0) { }
+  void operator() (int32 thread_id, int32 num_threads) {
+    int32 block_size = (max_to_count_ + (num_threads - 1)) / num_threads;
+    int32 start = block_size * thread_id,
+        end = std::min(max_to_count_, start + block_size);
+    for (int32 j = start; j < end; j++)
+      partial_sums_[thread_id] += j;
+  }
+  int32 Total() const {
+    int32 ans = 0;
+    for (size_t i = 0; i < partial_sums_.size(); i++)
+      ans += partial_sums_[i];
+    return ans;
+  }
+ private:
+  int32 max_to_count_;
+  std::vector<int32> partial_sums_;
+};
+
+void TestPersistentMultiThreader() {
+  for (int32 num_threads = 1; num_threads <= 4; num_threads++) {
+    PersistentMultiThreader threader(num_threads);
+    KALDI_ASSERT(threader.NumThreads() == num_threads);
+    for (int32 i = 0; i < 100; i++) {  // the same threads are reused.
+      int32 max_to_count = 1000 + i;
+      MySumJob job(max_to_count, num_threads);
+      threader.Run(&job);
+      KALDI_ASSERT(job.Total() == (max_to_count * (max_to_count - 1)) / 2);
+    }
+  }
+}
+
 void TestMutex() {
   for (int32 i = 0; i < 4; i++) {
     Mutex mut;
@@ -104,6 +140,7 @@ void TestMutex() {
 int main() {
   using namespace kaldi;
   TestThreads();
+  TestPersistentMultiThreader();
   for (int i = 0; i < 20; i++)
     TestMutex();
 }
@@ -28,6 +28,59 @@ MultiThreadable::~MultiThreadable() {
   // default implementation does nothing
 }
 
+PersistentMultiThreader::PersistentMultiThreader(int32 num_threads):
+    num_threads_(std::max<int32>(1, num_threads)),
+    start_barrier_(num_threads_), end_barrier_(num_threads_), job_(NULL) {
+  threads_.resize(num_threads_ - 1);
+  worker_args_.resize(num_threads_ - 1);
+  for (int32 i = 0; i + 1 < num_threads_; i++) {
+    worker_args_[i].threader = this;
+    worker_args_[i].thread_id = i + 1;
+    int32 ret;
+    if ((ret = pthread_create(&(threads_[i]), NULL, RunWorker,
+                              &(worker_args_[i])))) {
+      const char *c = strerror(ret);
+      if (c == NULL) { c = "[NULL]"; }
+      KALDI_ERR << "Error creating thread, errno was: " << c;
+    }
+  }
+}
+
+void *PersistentMultiThreader::RunWorker(void *args_in) {
+  WorkerArgs *args = static_cast<WorkerArgs*>(args_in);
+  PersistentMultiThreader *threader = args->threader;
+  while (true) {
+    threader->start_barrier_.Wait();
+    Job *job = threader->job_;
+    if (job == NULL) return NULL;  // we are being told to exit.
+    (*job)(args->thread_id, threader->num_threads_);
+    threader->end_barrier_.Wait();
+  }
+}
+
+void PersistentMultiThreader::Run(Job *job) {
+  KALDI_ASSERT(job != NULL);
+  if (num_threads_ == 1) {
+    (*job)(0, 1);
+    return;
+  }
+  job_ = job;
+  start_barrier_.Wait();
+  (*job)(0, num_threads_);
+  end_barrier_.Wait();
+  job_ = NULL;
+}
+
+PersistentMultiThreader::~PersistentMultiThreader() {
+  if (num_threads_ > 1) {
+    job_ = NULL;
+    start_barrier_.Wait();  // wakes the workers up, and they exit.
+    for (size_t i = 0; i < threads_.size(); i++)
+      if (pthread_join(threads_[i], NULL))
+        KALDI_ERR << "Error rejoining thread.";
+  }
+}
+
 
 
 }  // end namespace kaldi
@@ -173,6 +173,51 @@ template<class C> void RunMultiThreaded(const C &c_in) {
 }
 
 
+/// PersistentMultiThreader is for when you need to run a short parallel job
+/// many times in succession (e.g. once per frame in a decoder), where the
+/// cost of creating threads each time as MultiThreader does would be too
+/// high.  It creates num_threads - 1 worker threads once; each call to Run()
+/// wakes them up, runs the job on all of them and on the calling thread, and
+/// returns when they have all finished.  Unlike MultiThreader, the job object
+/// is not copied: it is shared between the threads, which are told their
+/// index as an argument.
+class PersistentMultiThreader {
+ public:
+  class Job {
+   public:
+    /// Does the part of the job corresponding to thread_id,
+    /// 0 <= thread_id < num_threads.
+    virtual void operator() (int32 thread_id, int32 num_threads) = 0;
+    virtual ~Job() { }
+  };
+
+  explicit PersistentMultiThreader(int32 num_threads);
+
+  int32 NumThreads() const { return num_threads_; }
+
+  /// Runs (*job)(i, NumThreads()) for each thread index i, and returns after
+  /// all of them have finished.  Index zero is run in the calling thread.
+  void Run(Job *job);
+
+  ~PersistentMultiThreader();
+ private:
+  struct WorkerArgs {
+    PersistentMultiThreader *threader;
+    int32 thread_id;
+  };
+  static void *RunWorker(void *args_in);
+
+  int32 num_threads_;
+  std::vector<pthread_t> threads_;  // the num_threads_ - 1 worker threads.
+  std::vector<WorkerArgs> worker_args_;
+  Barrier start_barrier_;  // all threads wait on this before starting a job.
+  Barrier end_barrier_;  // ... and on this after finishing it.
+  Job *job_;  // the current job; NULL tells the workers to exit.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(PersistentMultiThreader);
+};
+
+
 
 } // namespace kaldi
 #endif  // KALDI_THREAD_KALDI_THREAD_H_
@@ -0,0 +1,110 @@
+// util/hash-list-speed-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/hash-list.h"
+#include "util/open-hash-list.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+/* This compares the speed of HashList and OpenHashList when used the way the
+   decoders use them.  Each "frame" we take the list of tokens from the previous
+   frame (obtained with Clear()), and for each of them look up a few successor
+   states, inserting them if they are not present, until we have
+   "num_tokens" tokens; then we Delete() the previous frame's Elems.  As in a
+   decoding graph, most successors are near the source state in numbering
+   (within the same HMM or word), and some jump to a random state anywhere in
+   the graph.
+*/
+template<class H>
+double TimeHash(int32 num_tokens, int32 num_states, int32 num_frames) {
+  typedef typename H::Elem Elem;
+  const int32 arcs_per_token = 4;
+  H hash;
+  hash.SetSize(num_tokens * 2);
+  for (int32 i = 0; i < num_tokens; i++) {
+    int32 state = RandInt(0, num_states - 1);
+    if (hash.Find(state) == NULL)
+      hash.Insert(state, 0.0);
+  }
+  // Generate the random numbers in advance, so we time only the hash.
+  std::vector<int32> offsets(1 << 16);
+  for (size_t i = 0; i < offsets.size(); i++)
+    offsets[i] = (RandInt(0, 9) == 0 ? RandInt(0, num_states - 1) :
+                  RandInt(-5, 20));
+  size_t o = 0;
+  double tot = 0.0;  // so the work cannot be optimized away.
+
+  Timer timer;
+  for (int32 f = 0; f < num_frames; f++) {
+    Elem *prev = hash.Clear(), *tmp;
+    hash.SetSize(num_tokens * 2);
+    int32 count = 0;
+    for (Elem *e = prev; e != NULL; e = e->tail) {
+      for (int32 a = 0; a < arcs_per_token; a++) {
+        int32 state = (e->key + offsets[o++ & 0xFFFF]) % num_states;
+        if (state < 0) state += num_states;
+        Elem *e_found = hash.Find(state);
+        if (e_found == NULL) {
+          if (count < num_tokens) {
+            hash.Insert(state, e->val + 1.0);
+            count++;
+          }
+        } else if (e_found->val > e->val + 1.0) {
+          e_found->val = e->val + 1.0;
+        }
+      }
+    }
+    for (Elem *e = prev; e != NULL; e = tmp) {
+      tot += e->val;
+      tmp = e->tail;
+      hash.Delete(e);
+    }
+  }
+  double ans = timer.Elapsed();
+  for (Elem *e = hash.Clear(), *tmp; e != NULL; e = tmp) {
+    tmp = e->tail;
+    hash.Delete(e);
+  }
+  KALDI_VLOG(2) << "Total is " << tot;
+  return ans;
+}
+
+void HashListSpeedTest() {
+  int32 num_states = 5000000, num_frames = 500;
+  int32 token_counts[] = { 1000, 5000, 20000, 50000 };
+  for (size_t i = 0; i < sizeof(token_counts) / sizeof(int32); i++) {
+    int32 num_tokens = token_counts[i];
+    double t1 = TimeHash<HashList<int32, double> >(num_tokens, num_states,
+                                                   num_frames),
+        t2 = TimeHash<OpenHashList<int32, double> >(num_tokens, num_states,
+                                                    num_frames);
+    KALDI_LOG << "For " << num_tokens << " tokens per frame, HashList took "
+              << t1 << " seconds, OpenHashList took " << t2 << " seconds "
+              << "(speedup " << (t1 / t2) << ")";
+  }
+}
+
+} // end namespace kaldi
+
+int main() {
+  kaldi::HashListSpeedTest();
+  std::cout << "Test OK.\n";
+}
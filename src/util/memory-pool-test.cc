@@ -0,0 +1,80 @@
+// util/memory-pool-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/memory-pool.h"
+#include <set>
+#include <iostream>
+
+namespace kaldi {
+
+struct TestObject {
+  int32 a;
+  BaseFloat b;
+  TestObject *next;
+  TestObject(int32 a, BaseFloat b, TestObject *next): a(a), b(b), next(next) { }
+};
+
+void TestMemoryPool() {
+  MemoryPool<TestObject> pool(1 + Rand() % 20);
+  for (int32 iter = 0; iter < 10; iter++) {
+    std::vector<TestObject*> objects;
+    std::set<TestObject*> distinct;
+    int32 num_objects = Rand() % 500;
+    for (int32 i = 0; i < num_objects; i++) {
+      TestObject *obj = new (pool.Allocate()) TestObject(i, 0.5 * i, NULL);
+      objects.push_back(obj);
+      distinct.insert(obj);
+      if (Rand() % 3 == 0) {  // free a random object.
+        size_t j = Rand() % objects.size();
+        pool.Free(objects[j]);
+        distinct.erase(objects[j]);
+        objects.erase(objects.begin() + j);
+      }
+    }
+    // Make sure no two objects that are live share memory, and that the
+    // contents were not overwritten.
+    KALDI_ASSERT(distinct.size() == objects.size());
+    KALDI_ASSERT(pool.NumInUse() == objects.size());
+    KALDI_ASSERT(pool.PeakNumInUse() >= pool.NumInUse());
+    for (size_t i = 0; i < objects.size(); i++)
+      KALDI_ASSERT(objects[i]->b == 0.5 * objects[i]->a);
+    size_t mem_allocated = pool.MemoryAllocated();
+    pool.FreeAll();
+    KALDI_ASSERT(pool.NumInUse() == 0);
+    // FreeAll() should keep the memory.
+    KALDI_ASSERT(pool.MemoryAllocated() == mem_allocated);
+  }
+  pool.ReleaseMemory();
+  KALDI_ASSERT(pool.MemoryAllocated() == 0);
+  TestObject *obj = new (pool.Allocate()) TestObject(1, 2.0, NULL);
+  KALDI_ASSERT(obj->a == 1 && pool.NumInUse() == 1);
+  pool.Free(obj);
+}
+
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0; i < 10; i++)
+    TestMemoryPool();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,178 @@
+// util/memory-pool.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_MEMORY_POOL_H_
+#define KALDI_UTIL_MEMORY_POOL_H_
+#include <vector>
+#include <cstddef>
+#include <new>
+#include "base/kaldi-common.h"
+
+
+/* This header provides a simple fixed-size-object allocator ("arena") that is
+   used in the decoders for the Token and ForwardLink objects, which are
+   allocated and freed in very large numbers.  Memory is obtained from the
+   system in large blocks; objects that are freed individually go on a free
+   list and are recycled; and FreeAll() releases every object at once in
+   constant time, while keeping the blocks so that the next utterance does not
+   have to go back to the system allocator.  This is similar to what HashList
+   (hash-list.h) does internally for its Elems.
+
+   Objects are created with placement new, e.g.
+     Token *tok = new (pool.Allocate()) Token(...);
+   and returned with pool.Free(tok).  Destructors are never called, so this
+   should only be used for types with trivial destructors.
+
+   See memory-pool-test.cc for an example of how to use this object.
+*/
+
+
+namespace kaldi {
+
+template<class T> class MemoryPool {
+ public:
+  /// The block size is the number of objects we allocate at one time.
+  explicit MemoryPool(size_t block_size = 1024);
+
+  /// Returns uninitialized memory for one object of type T.
+  inline void *Allocate();
+
+  /// Returns the memory for one object to the pool.  It must have been
+  /// obtained from Allocate() on this object, and not freed since.
+  inline void Free(T *t);
+
+  /// Releases all objects at once (any pointers previously returned by
+  /// Allocate() become invalid).  Keeps the memory blocks for reuse.
+  void FreeAll();
+
+  /// Gives the memory blocks back to the system.  Requires that there be no
+  /// objects in use (e.g. call it after FreeAll()).
+  void ReleaseMemory();
+
+  /// Returns the number of objects currently allocated and not freed.
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// Returns the maximum value that NumInUse() has ever had.
+  size_t PeakNumInUse() const { return peak_num_in_use_; }
+
+  /// Resets the peak statistic to the current number of objects in use, e.g.
+  /// so that PeakNumInUse() can be reported per utterance.
+  void ResetPeak() { peak_num_in_use_ = num_in_use_; }
+
+  /// Returns the number of bytes obtained from the system allocator.
+  size_t MemoryAllocated() const {
+    return blocks_.size() * block_size_ * sizeof(Slot);
+  }
+
+  /// Returns the peak arena size in bytes, i.e. PeakNumInUse() times the
+  /// per-object size.
+  size_t PeakMemoryInUse() const { return peak_num_in_use_ * sizeof(Slot); }
+
+  ~MemoryPool();
+ private:
+  // A Slot is either an object or, while it is on the free list, a pointer to
+  // the next free Slot.  The double is there to ensure alignment.
+  union Slot {
+    char data[sizeof(T)];
+    Slot *next;
+    double align;
+  };
+
+  size_t block_size_;
+  std::vector<Slot*> blocks_;  // memory blocks, each of size block_size_.
+  size_t cur_block_;  // index of block we are currently carving up.
+  size_t cur_pos_;  // next unused position in blocks_[cur_block_].
+  Slot *free_head_;  // head of list of individually freed Slots.
+  size_t num_in_use_;
+  size_t peak_num_in_use_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MemoryPool);
+};
+
+
+template<class T>
+MemoryPool<T>::MemoryPool(size_t block_size):
+    block_size_(block_size), cur_block_(0), cur_pos_(block_size),
+    free_head_(NULL), num_in_use_(0), peak_num_in_use_(0) {
+  KALDI_ASSERT(block_size > 0);
+}
+
+template<class T>
+inline void *MemoryPool<T>::Allocate() {
+  Slot *ans;
+  if (free_head_ != NULL) {
+    ans = free_head_;
+    free_head_ = free_head_->next;
+  } else {
+    if (cur_pos_ == block_size_) {  // current block is used up.
+      if (!blocks_.empty() && cur_block_ + 1 < blocks_.size()) {
+        cur_block_++;  // reuse a block kept from before FreeAll().
+      } else {
+        blocks_.push_back(new Slot[block_size_]);
+        cur_block_ = blocks_.size() - 1;
+      }
+      cur_pos_ = 0;
+    }
+    ans = blocks_[cur_block_] + cur_pos_++;
+  }
+  if (++num_in_use_ > peak_num_in_use_)
+    peak_num_in_use_ = num_in_use_;
+  return static_cast<void*>(ans);
+}
+
+template<class T>
+inline void MemoryPool<T>::Free(T *t) {
+  KALDI_PARANOID_ASSERT(num_in_use_ > 0);
+  Slot *s = reinterpret_cast<Slot*>(t);
+  s->next = free_head_;
+  free_head_ = s;
+  num_in_use_--;
+}
+
+template<class T>
+void MemoryPool<T>::FreeAll() {
+  free_head_ = NULL;
+  cur_block_ = 0;
+  // If there are blocks, start carving up the first one again; otherwise the
+  // next Allocate() will allocate a block.
+  cur_pos_ = (blocks_.empty() ? block_size_ : 0);
+  num_in_use_ = 0;
+}
+
+template<class T>
+void MemoryPool<T>::ReleaseMemory() {
+  KALDI_ASSERT(num_in_use_ == 0 && "ReleaseMemory() called with objects "
+               "still in use");
+  for (size_t i = 0; i < blocks_.size(); i++)
+    delete [] blocks_[i];
+  blocks_.clear();
+  FreeAll();
+}
+
+template<class T>
+MemoryPool<T>::~MemoryPool() {
+  for (size_t i = 0; i < blocks_.size(); i++)
+    delete [] blocks_[i];
+}
+
+
+} // end namespace kaldi
+
+#endif
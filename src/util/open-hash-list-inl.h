@@ -0,0 +1,177 @@
+// util/open-hash-list-inl.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+
+// Do not include this file directly.  It is included by open-hash-list.h
+
+
+namespace kaldi {
+
+template<class I, class T> OpenHashList<I, T>::OpenHashList():
+    list_head_(NULL), list_tail_(NULL), num_keys_(0), mask_(0),
+    shift_(64), generation_(1), freed_head_(NULL) { }
+
+template<class I, class T> void OpenHashList<I, T>::SetSize(size_t size) {
+  KALDI_ASSERT(list_head_ == NULL && num_keys_ == 0);  // make sure empty.
+  size_t num_slots = 16;
+  while (num_slots < size) num_slots *= 2;
+  if (num_slots != slots_.size())
+    Rehash(num_slots);
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::Rehash(size_t num_slots) {
+  Slot empty;
+  empty.key = I();
+  empty.generation = 0;
+  empty.elem = NULL;
+  slots_.assign(num_slots, empty);
+  generation_ = 1;
+  mask_ = num_slots - 1;
+  shift_ = 64;
+  for (size_t n = num_slots; n > 1; n /= 2) shift_--;
+  num_keys_ = 0;
+  // Elements with the same key are adjacent in the list; only the first of
+  // each run goes in the index.
+  for (Elem *e = list_head_, *prev = NULL; e != NULL; prev = e, e = e->tail) {
+    if (prev == NULL || prev->key != e->key) {
+      InsertSlot(e);
+      num_keys_++;
+    }
+  }
+}
+
+template<class I, class T>
+typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Clear() {
+  // Invalidate all the slots by moving to a new generation; only when the
+  // counter wraps around do we have to reset them explicitly.
+  if (++generation_ == 0) {
+    for (size_t i = 0; i < slots_.size(); i++)
+      slots_[i].generation = 0;
+    generation_ = 1;
+  }
+  num_keys_ = 0;
+  Elem *ans = list_head_;
+  list_head_ = NULL;
+  list_tail_ = NULL;
+  return ans;
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Delete(Elem *e) {
+  e->tail = freed_head_;
+  freed_head_ = e;
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::New() {
+  if (freed_head_) {
+    Elem *ans = freed_head_;
+    freed_head_ = freed_head_->tail;
+    return ans;
+  } else {
+    Elem *tmp = new Elem[allocate_block_size_];
+    for (size_t i = 0; i+1 < allocate_block_size_; i++)
+      tmp[i].tail = tmp+i+1;
+    tmp[allocate_block_size_-1].tail = NULL;
+    freed_head_ = tmp;
+    allocated_.push_back(tmp);
+    return this->New();
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Find(I key) {
+  if (num_keys_ == 0) return NULL;
+  for (size_t index = HashIndex(key); ; index = (index + 1) & mask_) {
+    const Slot &slot = slots_[index];
+    if (slot.generation != generation_) return NULL;  // empty slot.
+    if (slot.key == key) return slot.elem;
+  }
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::InsertSlot(Elem *elem) {
+  size_t index = HashIndex(elem->key);
+  while (slots_[index].generation == generation_)
+    index = (index + 1) & mask_;
+  Slot &slot = slots_[index];
+  slot.key = elem->key;
+  slot.generation = generation_;
+  slot.elem = elem;
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Insert(I key, T val) {
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = NULL;
+  if (list_tail_ == NULL) list_head_ = elem;
+  else list_tail_->tail = elem;
+  list_tail_ = elem;
+
+  // Keep the load factor at most 3/4, so that probe sequences stay short.
+  if ((num_keys_ + 1) * 4 > slots_.size() * 3) {
+    Rehash(slots_.empty() ? 16 : 2 * slots_.size());  // re-inserts elem too.
+  } else {
+    InsertSlot(elem);
+    num_keys_++;
+  }
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::InsertMore(I key, T val) {
+  Elem *e = Find(key);
+  KALDI_ASSERT(e != NULL);  // we assume there is already one element.
+  // find the last element of the run with this key.
+  while (e->tail != NULL && e->tail->key == key) e = e->tail;
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = e->tail;
+  e->tail = elem;
+  if (list_tail_ == e) list_tail_ = elem;
+}
+
+template<class I, class T>
+OpenHashList<I, T>::~OpenHashList() {
+  // First test whether we had any memory leak, i.e. things for which the user
+  // did not call Delete().
+  size_t num_in_list = 0, num_allocated = 0;
+  for (Elem *e = freed_head_; e != NULL; e = e->tail)
+    num_in_list++;
+  for (size_t i = 0; i < allocated_.size(); i++) {
+    num_allocated += allocate_block_size_;
+    delete[] allocated_[i];
+  }
+  if (num_in_list != num_allocated) {
+    KALDI_WARN << "Possible memory leak: " << num_in_list
+               << " != " << num_allocated
+               << ": you might have forgotten to call Delete on "
+               << "some Elems";
+  }
+}
+
+
+} // end namespace kaldi
+
+#endif
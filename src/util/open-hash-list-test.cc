@@ -0,0 +1,147 @@
+// util/open-hash-list-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/open-hash-list.h"
+#include <map> // for baseline.
+#include <cstdlib>
+#include <iostream>
+
+namespace kaldi {
+
+// This is the same as TestHashList() in hash-list-test.cc.
+template<class Int, class T> void TestOpenHashList() {
+  typedef typename OpenHashList<Int, T>::Elem Elem;
+
+  OpenHashList<Int, T> hash;
+  hash.SetSize(200);
+  std::map<Int, T> m1;
+  for (size_t j = 0; j < 50; j++) {
+    Int key = Rand() % 200;
+    T val = Rand() % 50;
+    m1[key] = val;
+    Elem *e = hash.Find(key);
+    if (e) e->val = val;
+    else  hash.Insert(key, val);
+  }
+
+  std::map<Int, T> m2;
+
+  for (int i = 0; i < 100; i++) {
+    m2.clear();
+    for (typename std::map<Int, T>::const_iterator iter = m1.begin();
+        iter != m1.end();
+        iter++) {
+      m2[iter->first + 1] = iter->second;
+    }
+    std::swap(m1, m2);
+
+    Elem *h = hash.Clear(), *tmp;
+
+    hash.SetSize(100 + Rand() % 100);
+
+    for (; h != NULL; h = tmp) {
+      hash.Insert(h->key + 1, h->val);
+      tmp = h->tail;
+      hash.Delete(h);
+    }
+
+    const Elem *list = hash.GetList();
+    size_t count = 0;
+    for (; list != NULL; list = list->tail, count++) {
+      KALDI_ASSERT(m1[list->key] == list->val);
+    }
+
+    for (size_t j = 0; j < 10; j++) {
+      Int key = Rand() % 200;
+      bool found_m1 = (m1.find(key) != m1.end());
+      Elem *e = hash.Find(key);
+      KALDI_ASSERT( (e != NULL) == found_m1 );
+      if (found_m1)
+        KALDI_ASSERT(m1[key] == e->val);
+    }
+
+    KALDI_ASSERT(m1.size() == count);
+  }
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+}
+
+// Tests that the table grows correctly when SetSize() was given too small a
+// size, that the list is in order of insertion, and that InsertMore() keeps
+// elements with the same key together.
+void TestOpenHashListGrow() {
+  typedef OpenHashList<int32, int32>::Elem Elem;
+  OpenHashList<int32, int32> hash;
+  for (int32 iter = 0; iter < 5; iter++) {
+    hash.SetSize(Rand() % 20);
+    int32 num_keys = Rand() % 5000;
+    std::vector<int32> keys;
+    std::map<int32, int32> counts;
+    for (int32 i = 0; i < num_keys; i++) {
+      int32 key = Rand() % 100000 - 50000;
+      if (hash.Find(key) == NULL) {
+        hash.Insert(key, key * 2);
+        keys.push_back(key);
+      } else {
+        hash.InsertMore(key, key * 2);
+      }
+      counts[key]++;
+    }
+    KALDI_ASSERT(hash.Size() * 3 >= keys.size() * 4);
+    for (size_t i = 0; i < keys.size(); i++) {
+      Elem *e = hash.Find(keys[i]);
+      KALDI_ASSERT(e != NULL && e->key == keys[i] && e->val == keys[i] * 2);
+    }
+    Elem *h = hash.Clear(), *tmp;
+    KALDI_ASSERT(hash.GetList() == NULL);
+    size_t k = 0;
+    for (; h != NULL; k++) {
+      KALDI_ASSERT(k < keys.size() && h->key == keys[k]);
+      KALDI_ASSERT(hash.Find(h->key) == NULL);
+      int32 key = h->key, count = 0;
+      for (; h != NULL && h->key == key; h = tmp, count++) {
+        tmp = h->tail;
+        hash.Delete(h);
+      }
+      KALDI_ASSERT(count == counts[key]);
+    }
+    KALDI_ASSERT(k == keys.size());
+  }
+}
+
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0; i < 3; i++) {
+    TestOpenHashList<int, unsigned int>();
+    TestOpenHashList<unsigned int, int>();
+    TestOpenHashList<short int, long int>();
+    TestOpenHashList<short unsigned int, long int>();
+    TestOpenHashList<char, unsigned char>();
+    TestOpenHashList<unsigned char, int>();
+  }
+  TestOpenHashListGrow();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,174 @@
+// util/open-hash-list.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_H_
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/hash-list.h"
+
+
+/* This header provides OpenHashList, which has exactly the same interface and
+   the same iterate-and-clear-per-frame semantics as HashList (hash-list.h), but
+   a different index.  HashList uses separate chaining: Find() has to follow
+   the list of Elems in the bucket, and each of those is a cache miss.
+   OpenHashList uses open addressing with linear probing over a flat,
+   power-of-two sized array of slots, each of which stores the key next to the
+   pointer to its Elem, so a successful Find() usually touches one cache line of
+   the index and then the Elem it returns, and an unsuccessful one usually
+   touches only the index.  Keys are hashed multiplicatively, so the
+   consecutive state numbers that the decoders use spread out evenly.
+
+   Clear() does not touch the slots: each slot records the "generation" in
+   which it was filled, and Clear() just increments the current generation.
+   Like HashList, the Elems form a singly-linked list (in order of insertion),
+   which the user gets back from Clear() and GetList(); the Elems are allocated
+   in blocks and recycled in the same way.
+
+   The table grows automatically (doubling) if it becomes more than 3/4 full,
+   so SetSize() is only a hint, but as with HashList, calling it with roughly
+   twice the expected number of elements avoids rehashing.
+
+   See open-hash-list-test.cc for an example of its use, and
+   hash-list-speed-test.cc for a comparison with HashList.
+*/
+
+
+namespace kaldi {
+
+template<class I, class T> class OpenHashList {
+
+ public:
+  struct Elem {
+    I key;
+    T val;
+    Elem *tail;
+  };
+
+  /// Constructor takes no arguments.  Call SetSize to inform it of the likely
+  /// size.
+  OpenHashList();
+
+  /// Clears the hash and gives the head of the current list to the user;
+  /// ownership is transferred to the user (the user must call Delete()
+  /// for each element in the list, at his/her leisure).  This takes constant
+  /// time.
+  Elem *Clear();
+
+  /// Gives the head of the current list to the user.  Ownership retained in the
+  /// class.
+  const Elem *GetList() const { return list_head_; }
+
+  /// Think of this like delete().  It is to be called for each Elem in turn
+  /// after you "obtained ownership" by doing Clear().
+  inline void Delete(Elem *e);
+
+  /// This should probably not be needed to be called directly by the user.
+  /// Think of it as opposite to Delete();
+  inline Elem *New();
+
+  /// Find tries to find this element in the current list using the hashtable.
+  /// It returns NULL if not present.  The user is free to modify the "val"
+  /// element of the Elem it returns.
+  inline Elem *Find(I key);
+
+  /// Insert inserts a new element into the hashtable/stored list.  By calling
+  /// this, the user asserts that it is not already present.
+  inline void Insert(I key, T val);
+
+  /// InsertMore inserts another element with the same key into the
+  /// hashtable/stored list.  By calling this, the user asserts that one element
+  /// with that key is already present.  All elements with the same key follow
+  /// each other in the list, and Find() returns the first one.
+  inline void InsertMore(I key, T val);
+
+  /// SetSize tells the object how many slots to allocate (it is rounded up to
+  /// a power of two, and should typically be at least twice the number of
+  /// objects we expect to go in the structure).  It must be called while the
+  /// hash is empty.
+  void SetSize(size_t sz);
+
+  /// Returns the current number of slots.
+  inline size_t Size() { return slots_.size(); }
+
+  ~OpenHashList();
+ private:
+
+  struct Slot {
+    I key;
+    uint32 generation;  // the slot is occupied iff this equals generation_.
+    Elem *elem;  // first Elem with this key.
+  };
+
+  // Returns the slot at which to start probing for "key".
+  inline size_t HashIndex(I key) const {
+    return static_cast<size_t>((static_cast<uint64>(key) *
+                                static_cast<uint64>(11400714819323198485ULL))
+                               >> shift_);
+  }
+
+  // Reallocates the slots, with "num_slots" (a power of two) slots, and
+  // re-inserts any elements currently in the list.
+  void Rehash(size_t num_slots);
+
+  // Puts "elem" into the first free slot for its key.  Does not check whether
+  // the table is full.
+  inline void InsertSlot(Elem *elem);
+
+  Elem *list_head_;  // head of currently stored list.
+  Elem *list_tail_;  // tail of currently stored list (NULL if empty).
+  size_t num_keys_;  // number of occupied slots.
+
+  std::vector<Slot> slots_;  // size is zero or a power of two.
+  size_t mask_;  // slots_.size() - 1.
+  int32 shift_;  // 64 - log2(slots_.size()).
+  uint32 generation_;  // current generation; never zero.
+
+  Elem *freed_head_;  // head of list of currently freed elements.
+
+  std::vector<Elem*> allocated_;  // list of allocated blocks.
+
+  static const size_t allocate_block_size_ = 1024;  // Number of Elements to
+  // allocate in one block.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OpenHashList);
+};
+
+
+/// DecoderHashList is the hash that FasterDecoder, LatticeFasterDecoder and
+/// BiglmFasterDecoder use for their tokens.  It is HashList by default; compile
+/// with -DKALDI_OPEN_HASH_LIST (e.g. by adding it to CXXFLAGS in kaldi.mk) to
+/// make it OpenHashList instead.  "make test_open_hash_list" in src/ runs the
+/// decoder tests built that way.  The two behave identically apart from speed
+/// and the order of the list returned by Clear(), which for OpenHashList is
+/// the order of insertion.
+#ifdef KALDI_OPEN_HASH_LIST
+template<class I, class T>
+class DecoderHashList: public OpenHashList<I, T> { };
+#else
+template<class I, class T>
+class DecoderHashList: public HashList<I, T> { };
+#endif
+
+
+} // end namespace kaldi
+
+#include "util/open-hash-list-inl.h"
+
+#endif